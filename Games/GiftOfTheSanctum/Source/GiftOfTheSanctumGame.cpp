@@ -33,7 +33,7 @@ Zmey::Name GiftOfTheSanctumGame::LoadResources()
 void GiftOfTheSanctumGame::InitializePlayerController(unsigned index)
 {
 	{
-		Zmey::Modules.InputController.AddListenerForAction(Zmey::Name("WalkX"), index, [this, index](float axisValue, float deltaTime)
+		GetWorld()->GetInput().AddListenerForAction(Zmey::Name("WalkX"), index, [this, index](float axisValue, float deltaTime)
 		{
 			auto transform = GetWorld()->GetManager<Zmey::Components::TransformManager>().Lookup(m_Players.Entity[index]);
 			transform.Position().x += NullifyNearZero(axisValue) * deltaTime * m_Players.WalkingSpeed[index];
@@ -41,7 +41,7 @@ void GiftOfTheSanctumGame::InitializePlayerController(unsigned index)
 	}
 
 	{
-		Zmey::Modules.InputController.AddListenerForAction(Zmey::Name("WalkZ"), index, [this, index](float axisValue, float deltaTime)
+		GetWorld()->GetInput().AddListenerForAction(Zmey::Name("WalkZ"), index, [this, index](float axisValue, float deltaTime)
 		{
 			auto transform = GetWorld()->GetManager<Zmey::Components::TransformManager>().Lookup(m_Players.Entity[index]);
 			transform.Position().z += NullifyNearZero(axisValue) * deltaTime * m_Players.WalkingSpeed[index];
@@ -49,7 +49,7 @@ void GiftOfTheSanctumGame::InitializePlayerController(unsigned index)
 	}
 
 	{
-		Zmey::Modules.InputController.AddListenerForAction(Zmey::Name("Cast"), index, [this, index](float axisValue, float deltaTime)
+		GetWorld()->GetInput().AddListenerForAction(Zmey::Name("Cast"), index, [this, index](float axisValue, float deltaTime)
 		{
 			CastSpell(index, 0);
 		});
@@ -82,22 +82,21 @@ void GiftOfTheSanctumGame::Initialize()
 
 	// Debug setup
 	{
-		Zmey::Modules.InputController.AddListenerForAction(Zmey::Name("RespawnPlayers"), 0, [this](float axisValue, float deltaTime)
+		GetWorld()->GetInput().AddListenerForAction(Zmey::Name("RespawnPlayers"), 0, [this](float axisValue, float deltaTime)
 		{
 			SetupPlayersToSpawnPoints();
 		});
 	}
 
 	// Gather spawn points
-	Zmey::tmp::vector<Zmey::EntityId> spawnPoints = tagManager.FindAllByTag(Zmey::Name("SpawnPoint"));
-	m_SpawnPoints = EntityVector(spawnPoints.begin(), spawnPoints.end());
+	m_SpawnPoints.clear();
+	tagManager.ForEachByTag(Zmey::Name("SpawnPoint"), [this](Zmey::EntityId id)
+	{
+		m_SpawnPoints.push_back(id);
+	});
 
 	// SetupPlayersToSpawnPoints
 	SetupPlayersToSpawnPoints();
-
-	GetWorld()->GetManager<Zmey::Components::SpellComponent>().SetSpellExpireListener([this](Zmey::EntityId id) {
-		m_ForErase.push_back(id);
-	});
 }
 
 void GiftOfTheSanctumGame::SetupPlayersToSpawnPoints()
@@ -107,7 +106,7 @@ void GiftOfTheSanctumGame::SetupPlayersToSpawnPoints()
 	for (uint8_t i = 0u; i < MaxPlayers; i++)
 	{
 		auto actor = pxManager.Lookup(m_Players.Entity[i]);
-		actor->TeleportTo(tfManager.Lookup(m_SpawnPoints[i]).Position());
+		actor->TeleportTo(tfManager.Lookup(m_SpawnPoints[i]).GetPosition());
 	}
 }
 
@@ -119,7 +118,7 @@ void GiftOfTheSanctumGame::CastSpell(uint8_t playerIndex, uint8_t spellIndex)
 	auto spellId = GetWorld()->SpawnEntity(Zmey::Name("Spell"));
 	auto spell = pxManager.Lookup(spellId);
 	auto actorForwardVector = Zmey::Vector3(0.f, 0.f, 1.f);
-	spell->TeleportTo(transform.Position() + actorForwardVector * 3.f);
+	spell->TeleportTo(transform.GetPosition() + actorForwardVector * 3.f);
 
 	auto& spellManager = GetWorld()->GetManager<Zmey::Components::SpellComponent>();
 
@@ -130,25 +129,22 @@ void GiftOfTheSanctumGame::CastSpell(uint8_t playerIndex, uint8_t spellIndex)
 void GiftOfTheSanctumGame::Simulate(float deltaTime)
 {
 	m_CurrentTime += deltaTime; // TODO: this has a lot of error
+	for (Zmey::EntityId spell : GetWorld()->GetManager<Zmey::Components::SpellComponent>().GetExpiredSpells())
+	{
+		GetWorld()->QueueDestroyEntity(spell);
+	}
 	if (m_CurrentTime > 10.0f && m_CurrentRing) // every 10 seconds remove one ring
 	{
 		m_CurrentTime = 0.0f;
 		char buffer[30];
 		sprintf_s(buffer, "FloorRing%d", m_CurrentRing);
 		auto ring = GetWorld()->GetManager<Zmey::Components::TagManager>().FindFirstByTag(Zmey::Name(buffer));
-		GetWorld()->DestroyEntity(ring);
+		GetWorld()->QueueDestroyEntity(ring);
 		--m_CurrentRing;
 	}
-
-	for (auto& eraseMe : m_ForErase)
-	{
-		GetWorld()->DestroyEntity(eraseMe);
-	}
-	m_ForErase.clear();
-	DoUI();
 }
 
-void GiftOfTheSanctumGame::DoUI()
+void GiftOfTheSanctumGame::UpdateUI(float deltaTime)
 {
 	// TODO: This setup is to have transparent window which is not interactable
 	// This could be extracted someplace
@@ -34,12 +34,12 @@ public:
 	virtual void Initialize() override;
 	void CastSpell(uint8_t playerIndex, uint8_t spellIndex);
 	virtual void Simulate(float deltaTime) override;
+	virtual void UpdateUI(float deltaTime) override;
 	virtual void Uninitialize() override;
 private:
 	void InitializePlayerController(unsigned index);
 	void SetupPlayersToSpawnPoints();
 	void UpdatePlayers();
-	void DoUI();
 private:
 	Zmey::Utilities::ConstructorInitializable<Zmey::Name> m_WorldName;
 	static const uint8_t MaxPlayers = 2;
@@ -47,8 +47,6 @@ private:
 	HeroCollection m_Players;
 	//SpellCollection m_ActiveSpells;
 
-	std::vector<Zmey::EntityId> m_ForErase;
-
 	EntityVector m_SpawnPoints;
 	float m_CurrentTime = 0.0f;
 	uint8_t m_CurrentRing = 5;
@@ -0,0 +1,175 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include <Zmey/EntityManager.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+namespace Components
+{
+
+// Remembers when each element of a packed component array was last changed, so that several consumers
+// (renderer, physics sync, networking) can each ask what changed since they last looked.
+// Each element carries the version it was last written in. Versions only grow - a consumer keeps the value
+// NextVersion returned to it and passes it to ForEachChangedSince the next time:
+//	tracker.ForEachChangedSince(m_SeenVersion, [](EntityId::IndexType index) { ... });
+//	m_SeenVersion = tracker.NextVersion();
+// A consumer that starts from 0 sees everything.
+// The manager mirrors the layout of its data - Add, SwapAndPop and Permute - and calls MarkChanged on writes.
+// Elements that end up at a new index count as changed. Removed elements aren't reported.
+class ChangeTracker
+{
+public:
+	using IndexType = EntityId::IndexType;
+	using VersionType = uint32_t;
+	// Elements are grouped in blocks that remember their latest version, so unchanged blocks are skipped
+	static constexpr IndexType BlockSize = 64u;
+
+	ChangeTracker()
+	{}
+	ChangeTracker(AllocatorRef allocator)
+		: m_Versions(allocator)
+		, m_BlockVersions(allocator)
+	{}
+
+	// Can be called concurrently for different indices, neighbouring indices share a block version
+	// which is why that one is atomic
+	inline void MarkChanged(IndexType index)
+	{
+		m_Versions[index] = m_Version;
+		m_BlockVersions[index / BlockSize].Store(m_Version);
+	}
+	void MarkChanged(IndexType begin, IndexType end)
+	{
+		if (begin >= end)
+		{
+			return;
+		}
+		std::fill(m_Versions.begin() + begin, m_Versions.begin() + end, m_Version);
+		for (IndexType block = begin / BlockSize; block <= (end - 1u) / BlockSize; ++block)
+		{
+			m_BlockVersions[block].Store(m_Version);
+		}
+	}
+	inline bool HasChangedSince(IndexType index, VersionType version) const
+	{
+		return m_Versions[index] >= version;
+	}
+
+	// Calls func(IndexType) for each element changed at or after the given version
+	template<typename Func>
+	void ForEachChangedSince(VersionType version, const Func& func) const
+	{
+		const IndexType count = IndexType(m_Versions.size());
+		for (IndexType block = 0u; block < m_BlockVersions.size(); ++block)
+		{
+			if (m_BlockVersions[block].Load() < version)
+			{
+				continue;
+			}
+			const IndexType blockEnd = std::min(count, (block + 1u) * BlockSize);
+			for (IndexType i = block * BlockSize; i < blockEnd; ++i)
+			{
+				if (m_Versions[i] >= version)
+				{
+					func(i);
+				}
+			}
+		}
+	}
+
+	// The version writes currently get
+	inline VersionType GetVersion() const
+	{
+		return m_Version;
+	}
+	// Starts a new version and returns it, everything changed from now on is at or after it
+	inline VersionType NextVersion()
+	{
+		return ++m_Version;
+	}
+
+	inline size_t size() const
+	{
+		return m_Versions.size();
+	}
+	// New elements count as changed
+	void Resize(size_t count)
+	{
+		const IndexType oldCount = IndexType(m_Versions.size());
+		m_Versions.resize(count, m_Version);
+		m_BlockVersions.resize((count + BlockSize - 1u) / BlockSize);
+		MarkChanged(oldCount, IndexType(count));
+	}
+	inline void Add()
+	{
+		Resize(m_Versions.size() + 1u);
+	}
+	// The counterpart of SparseSet::Remove
+	void SwapAndPop(IndexType index)
+	{
+		const IndexType last = IndexType(m_Versions.size() - 1u);
+		if (index != last)
+		{
+			MarkChanged(index);
+		}
+		m_Versions.pop_back();
+		m_BlockVersions.resize((m_Versions.size() + BlockSize - 1u) / BlockSize);
+	}
+	// Mirrors data[i] becoming what was data[order[i]]
+	template<typename Indices>
+	void Permute(const Indices& order)
+	{
+		for (IndexType i = 0u; i < order.size(); ++i)
+		{
+			if (order[i] != i)
+			{
+				MarkChanged(i);
+			}
+		}
+	}
+	void Clear()
+	{
+		m_Versions.clear();
+		m_BlockVersions.clear();
+	}
+private:
+	// Relaxed is enough as the versions are only read once the writers have been waited for.
+	// Copyable so it can live in a vector, which is only resized when nobody writes.
+	struct BlockVersion
+	{
+		BlockVersion()
+			: Value(0u)
+		{}
+		BlockVersion(const BlockVersion& other)
+			: Value(other.Load())
+		{}
+		BlockVersion& operator=(const BlockVersion& other)
+		{
+			Value.store(other.Load(), std::memory_order_relaxed);
+			return *this;
+		}
+		inline VersionType Load() const
+		{
+			return Value.load(std::memory_order_relaxed);
+		}
+		// Most writes hit a block already at the current version, skip those to keep the cache line shared
+		inline void Store(VersionType version)
+		{
+			if (Load() != version)
+			{
+				Value.store(version, std::memory_order_relaxed);
+			}
+		}
+		std::atomic<VersionType> Value;
+	};
+	arena::vector<VersionType> m_Versions;
+	arena::vector<BlockVersion> m_BlockVersions;
+	VersionType m_Version = 1u;
+};
+
+}
+}
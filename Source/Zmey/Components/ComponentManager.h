@@ -2,14 +2,17 @@
 
 #include <Zmey/Memory/MemoryManagement.h>
 #include <Zmey/EntityManager.h>
+#include <Zmey/MemoryStream.h>
 
 namespace Zmey
 {
-class MemoryInputStream;
 class World;
 namespace Components
 {
+class EntitySortKeys;
 
+// Managers are constructed while their world's arena is the default allocator (see ScopedDefaultAllocator),
+// so arena:: containers declared as members allocate from it without passing the allocator around.
 class ComponentManager
 {
 public:
@@ -19,8 +22,52 @@ public:
 	virtual ~ComponentManager() {}
 
 	virtual void InitializeFromBlob(const tmp::vector<EntityId>& entities, MemoryInputStream& blob) = 0;
+	// Gives count freshly spawned entities the same data - the blob of a single entity of a class (see World::SpawnEntities).
+	// Managers that spawn often should override this to decode the blob once and fill their arrays in bulk.
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize)
+	{
+		auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+		tmp::vector<EntityId> entity(1u);
+		for (size_t i = 0u; i < count; ++i)
+		{
+			entity[0] = entities[i];
+			MemoryInputStream stream(blob, blobSize);
+			InitializeFromBlob(entity, stream);
+		}
+	}
+	// Runs on a job, possibly alongside managers that don't touch the same components (see DEFINE_COMPONENT_MANAGER_WITH_ACCESS).
+	// Big enough workloads can be split further with Job::ParallelFor.
 	virtual void Simulate(float deltaTime) = 0;
+	// Runs after physics results are in, for work that depends on the final state of the frame
+	virtual void LateSimulate()
+	{}
 	virtual void RemoveEntity(EntityId id) = 0;
+	// Called with the entities destroyed since the last sync point, sorted by index (see EntityIndexLess) and unique.
+	// Managers for which removing an entity isn't O(1) should override this to remove them all in one pass.
+	virtual void RemoveEntities(const EntityId* ids, size_t count)
+	{
+		for (size_t i = 0u; i < count; ++i)
+		{
+			RemoveEntity(ids[i]);
+		}
+	}
+	// Rollback support, see World::SaveSnapshot. Save everything needed to get the manager back to its current
+	// state, preferably as whole arrays (see WriteArray), and read it back in the same order in RestoreSnapshot.
+	virtual void SaveSnapshot(MemoryOutputStream& stream) const
+	{}
+	virtual void RestoreSnapshot(MemoryInputStream& stream)
+	{}
+	// Called once every manager has restored its snapshot, for managers whose state lives outside of the world
+	// and has to be rebuilt from the data of other managers (physics actors from transforms)
+	virtual void FinishRestoringSnapshot()
+	{}
+	// Puts the packed data in the order of the keys, see World::SetSpatialSortInterval. Permuting the arrays
+	// is all there is to it for most managers (see SparseSet::Reorder). Returns false for managers that don't
+	// support it, e.g. because their indices are referenced from elsewhere.
+	virtual bool SortEntities(const EntitySortKeys& keys)
+	{
+		return false;
+	}
 	inline World& GetWorld()
 	{
 		return m_World;
@@ -10,32 +10,127 @@ namespace Components
 {
 namespace
 {
-ComponentIndex GCurrentComponentIndex = 0u;
-stl::array<ComponentManagerEntry*, 256u> GComponentRegistry;
+constexpr size_t MaxComponentManagers = 256u;
+// Filled during static initialization, in whatever order the translation units get initialized in
+ComponentManagerEntry* GRegisteredManagers[MaxComponentManagers];
+size_t GRegisteredManagerCount = 0u;
+bool GIsRegistryBuilt = false;
+
+bool ShortNameLess(const char* lhs, const char* rhs)
+{
+	for (; *lhs && ToLower(*lhs) == ToLower(*rhs); ++lhs, ++rhs)
+	{}
+	return ToLower(*lhs) < ToLower(*rhs);
 }
 
-uint16_t GetNextComponentManagerIndex()
+struct Registry
+{
+	// At most half full so that a perfect hash is quick to find
+	static constexpr size_t MaxSlotBits = 10u;
+
+	Registry()
+		: Count(ComponentIndex(GRegisteredManagerCount))
+	{
+		std::copy(GRegisteredManagers, GRegisteredManagers + Count, Managers);
+		std::sort(Managers, Managers + Count, [](const ComponentManagerEntry* lhs, const ComponentManagerEntry* rhs)
+		{
+			if (lhs->Priority != rhs->Priority)
+			{
+				return lhs->Priority > rhs->Priority;
+			}
+			return ShortNameLess(lhs->ShortName, rhs->ShortName);
+		});
+		for (ComponentIndex i = 0u; i < Count; ++i)
+		{
+			Managers[i]->Index = i;
+			*Managers[i]->ManagerIndex = i;
+		}
+		BuildPerfectHash();
+		GIsRegistryBuilt = true;
+	}
+
+	inline size_t SlotOf(Hash nameHash) const
+	{
+		return size_t((uint64_t(nameHash) * Multiplier) >> (64u - SlotBits));
+	}
+
+	// Looks for a multiplier that sends every name to a different slot, growing the table if none does
+	void BuildPerfectHash()
+	{
+		SlotBits = 4u;
+		while ((size_t(1u) << SlotBits) < 2u * Count)
+		{
+			++SlotBits;
+		}
+		uint64_t candidate = 0x9E3779B97F4A7C15ull;
+		for (; SlotBits <= MaxSlotBits; ++SlotBits)
+		{
+			for (unsigned attempt = 0u; attempt < 4096u; ++attempt)
+			{
+				// Odd multipliers from a simple LCG
+				candidate = candidate * 6364136223846793005ull + 1442695040888963407ull;
+				Multiplier = candidate | 1u;
+				if (TryFillSlots())
+				{
+					return;
+				}
+			}
+		}
+		ASSERT_FATAL(false && "Couldn't find a perfect hash for the component names, are two of them the same?");
+	}
+
+	bool TryFillSlots()
+	{
+		std::fill(Slots, Slots + (size_t(1u) << SlotBits), InvalidComponentIndex);
+		for (ComponentIndex i = 0u; i < Count; ++i)
+		{
+			ComponentIndex& slot = Slots[SlotOf(Managers[i]->ShortNameHash)];
+			if (slot != InvalidComponentIndex)
+			{
+				return false;
+			}
+			slot = i;
+		}
+		return true;
+	}
+
+	ComponentManagerEntry* Managers[MaxComponentManagers];
+	ComponentIndex Count;
+	uint64_t Multiplier = 0u;
+	unsigned SlotBits = 0u;
+	ComponentIndex Slots[size_t(1u) << MaxSlotBits];
+};
+
+const Registry& GetRegistry()
 {
-	ASSERT_FATAL(GCurrentComponentIndex < GComponentRegistry.size());
-	return GCurrentComponentIndex++;
+	static const Registry registry;
+	return registry;
+}
 }
 
 ComponentManagerEntry::ComponentManagerEntry(const char* fullName, const char* shortName,
-	ComponentIndex ComponentIndex,
+	ComponentIndex* managerIndex,
 	InstantiateDelegate instantiate,
 	DefaultsToBlobDelegate defaultsToBlob,
 	ToBlobDelegate toBlob,
-	int8_t priority)
+	int8_t priority,
+	const char* reads,
+	const char* writes)
 	: FullName(fullName)
 	, ShortName(shortName)
 	, ShortNameHash(Zmey::Hash(Zmey::HashHelpers::CaseInsensitiveStringWrapper(shortName)))
-	, Index(ComponentIndex)
+	, Index(InvalidComponentIndex)
+	, ManagerIndex(managerIndex)
 	, Instantiate(instantiate)
 	, DefaultsToBlob(defaultsToBlob)
 	, ToBlob(toBlob)
 	, Priority(priority)
+	, Reads(reads)
+	, Writes(writes)
 {
-	GComponentRegistry[ComponentIndex] = this;
+	ASSERT_FATAL(!GIsRegistryBuilt && "Component managers have to be registered during static initialization");
+	ASSERT_FATAL(GRegisteredManagerCount < MaxComponentManagers);
+	GRegisteredManagers[GRegisteredManagerCount++] = this;
 }
 
 void EmptyDefaultsToBlobImplementation(IDataBlob& blob)
@@ -43,23 +138,47 @@ void EmptyDefaultsToBlobImplementation(IDataBlob& blob)
 void EmptyToBlobImplementation(const nlohmann::json&, IDataBlob& blob)
 {}
 
-const ComponentManagerEntry& GetComponentManager(Hash nameHash)
+ComponentIndex GetComponentManagerCount()
+{
+	return GetRegistry().Count;
+}
+
+const ComponentManagerEntry* FindComponentManager(Hash nameHash)
 {
-	auto it = std::find_if(GComponentRegistry.begin(), GComponentRegistry.begin() + GCurrentComponentIndex, [nameHash](const ComponentManagerEntry* compiler)
+	const Registry& registry = GetRegistry();
+	const ComponentIndex index = registry.Slots[registry.SlotOf(nameHash)];
+	if (index == InvalidComponentIndex || registry.Managers[index]->ShortNameHash != nameHash)
 	{
-		return compiler->ShortNameHash == nameHash;
-	});
-	ASSERT_FATAL(it != GComponentRegistry.end());
-	return **it;
+		return nullptr;
+	}
+	return registry.Managers[index];
+}
+
+const ComponentManagerEntry& GetComponentManager(Hash nameHash)
+{
+	const ComponentManagerEntry* entry = FindComponentManager(nameHash);
+	ASSERT_FATAL(entry);
+	return *entry;
 }
 
 const ComponentManagerEntry* GetComponentManagerAtIndex(ComponentIndex index)
 {
-	if (index >= GComponentRegistry.size())
+	const Registry& registry = GetRegistry();
+	if (index >= registry.Count)
 	{
 		return nullptr;
 	}
-	return GComponentRegistry[index];
+	return registry.Managers[index];
+}
+
+const ComponentManagerEntry& ResolveComponentManager(Hash nameHash, ComponentIndex storedIndex)
+{
+	const ComponentManagerEntry* entry = GetComponentManagerAtIndex(storedIndex);
+	if (entry && entry->ShortNameHash == nameHash)
+	{
+		return *entry;
+	}
+	return GetComponentManager(nameHash);
 }
 
 }
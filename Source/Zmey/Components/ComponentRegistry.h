@@ -23,56 +23,84 @@ namespace Components
 	};
 	struct ComponentManagerEntry
 	{
-		using InstantiateDelegate = ComponentManager* (*)(World&);
+		using InstantiateDelegate = ComponentManager* (*)(World&, IAllocator&);
 		using DefaultsToBlobDelegate = void(*)(IDataBlob& blob);
 		using ToBlobDelegate = void (*)(const nlohmann::json&, IDataBlob& blob);
 
-		ZMEY_API ComponentManagerEntry(const char* fullName, const char* shortName, ComponentIndex componentManagerIndex,
+		ZMEY_API ComponentManagerEntry(const char* fullName, const char* shortName, ComponentIndex* componentManagerIndex,
 				InstantiateDelegate, DefaultsToBlobDelegate, ToBlobDelegate,
-				int8_t priority);
+				int8_t priority, const char* reads, const char* writes);
 		const char* FullName;
 		const char* ShortName;
 		const Hash ShortNameHash;
-		const ComponentIndex Index;
+		// Set when the registry gets built, along with the SZmeyComponentManagerIndex of the class
+		ComponentIndex Index;
+		ComponentIndex* const ManagerIndex;
 		const InstantiateDelegate Instantiate;
 		const DefaultsToBlobDelegate DefaultsToBlob;
 		const ToBlobDelegate ToBlob;
 		const int8_t Priority;
+		// Comma separated short names of the other components the manager touches in Simulate,
+		// see DEFINE_COMPONENT_MANAGER_WITH_ACCESS
+		const char* Reads;
+		const char* Writes;
 	};
 
 	ZMEY_API void EmptyDefaultsToBlobImplementation(IDataBlob& blob);
 	ZMEY_API void EmptyToBlobImplementation(const nlohmann::json&, IDataBlob& blob);
 
-	ZMEY_API ComponentIndex GetNextComponentManagerIndex();
+	// The registry is built on first use, after all managers got registered during static initialization.
+	// Managers are indexed by priority (highest first) and then by short name, so indices don't depend on
+	// the order translation units get initialized in and stay the same across runs and tools.
+	// Looking up a manager by name goes through a perfect hash.
+	ZMEY_API ComponentIndex GetComponentManagerCount();
 	ZMEY_API const ComponentManagerEntry& GetComponentManager(Hash nameHash);
+	// nullptr if there's no manager with that name
+	ZMEY_API const ComponentManagerEntry* FindComponentManager(Hash nameHash);
 	ZMEY_API const ComponentManagerEntry* GetComponentManagerAtIndex(ComponentIndex);
+	// For data that stores the index a manager had when it got written along with its name.
+	// Takes the manager at that index if it still has the name, otherwise looks the name up.
+	ZMEY_API const ComponentManagerEntry& ResolveComponentManager(Hash nameHash, ComponentIndex storedIndex);
 
+	// The world destroys its managers in place and takes their memory back along with everything else in its arena
 	template<typename T>
-	ComponentManager* InstantiateManager(World& world)
+	ComponentManager* InstantiateManager(World& world, IAllocator& allocator)
 	{
-		return new T(world);
+		return new (allocator.Malloc(sizeof(T), alignof(T))) T(world);
 	}
 
 #define DEFINE_COMPONENT_MANAGER(Class, ShortName, DefaultsToBlob, ToBlob) \
 	DEFINE_COMPONENT_MANAGER_WITH_PRIORITY(Class, ShortName, DefaultsToBlob, ToBlob, 0)
 
 #define DEFINE_COMPONENT_MANAGER_WITH_PRIORITY(Class, ShortName, DefaultsToBlob, ToBlob, Priority) \
-	ZMEY_API const Zmey::ComponentIndex Class##::SZmeyComponentManagerIndex = Zmey::Components::GetNextComponentManagerIndex(); \
+	DEFINE_COMPONENT_MANAGER_WITH_ACCESS(Class, ShortName, DefaultsToBlob, ToBlob, Priority, "", "")
+
+// The world runs the Simulate of managers that don't touch the same components concurrently.
+// A manager always writes its own component; Reads and Writes list the short names of any others
+// its Simulate uses, e.g. "Transform, Mesh". "*" stands for all components.
+// Managers that conflict run in the order of their indices.
+#define DEFINE_COMPONENT_MANAGER_WITH_ACCESS(Class, ShortName, DefaultsToBlob, ToBlob, Priority, Reads, Writes) \
+	ZMEY_API Zmey::ComponentIndex Class##::SZmeyComponentManagerIndex = Zmey::InvalidComponentIndex; \
 	static Zmey::Components::ComponentManagerEntry G##ShortName##ComponentManagerRegistration(#Class, #ShortName, \
-		Class##::SZmeyComponentManagerIndex, \
+		&Class##::SZmeyComponentManagerIndex, \
 		&Zmey::Components::InstantiateManager<##Class##>, \
 		DefaultsToBlob, \
 		ToBlob, \
-		Priority)
+		Priority, \
+		Reads, \
+		Writes)
 
+// External managers come from game code that the engine knows nothing about, so they run alone
 #define DEFINE_EXTERNAL_COMPONENT_MANAGER(Class, ShortName, DefaultsToBlob, ToBlob) \
-	const Zmey::ComponentIndex Class##::SZmeyComponentManagerIndex = Zmey::Components::GetNextComponentManagerIndex(); \
+	Zmey::ComponentIndex Class##::SZmeyComponentManagerIndex = Zmey::InvalidComponentIndex; \
 	static Zmey::Components::ComponentManagerEntry G##ShortName##ComponentManagerRegistration(#Class, #ShortName, \
-		Class##::SZmeyComponentManagerIndex, \
+		&Class##::SZmeyComponentManagerIndex, \
 		&Zmey::Components::InstantiateManager<##Class##>, \
 		DefaultsToBlob, \
 		ToBlob, \
-		100)
+		100, \
+		"*", \
+		"*")
 }
 
 }
\ No newline at end of file
@@ -3,13 +3,15 @@
 namespace Zmey
 {
 using ComponentIndex = uint16_t;
+constexpr ComponentIndex InvalidComponentIndex = ComponentIndex(~0u);
 }
+// The index is assigned when the component registry gets built, before the first world is created
 #define DECLARE_COMPONENT_MANAGER(ClassName) \
 	public: \
 		##ClassName(World& world) : ComponentManager(world) {} \
-		ZMEY_API const static Zmey::ComponentIndex SZmeyComponentManagerIndex
+		ZMEY_API static Zmey::ComponentIndex SZmeyComponentManagerIndex
 
 #define DECLARE_EXTERNAL_COMPONENT_MANAGER(ClassName) \
 	public: \
 		##ClassName( Zmey::World& world) : ComponentManager(world) {} \
-		const static Zmey::ComponentIndex SZmeyComponentManagerIndex
+		static Zmey::ComponentIndex SZmeyComponentManagerIndex
@@ -0,0 +1,112 @@
+#include <Zmey/Components/EntitySortKeys.h>
+
+#include <algorithm>
+#include <cfloat>
+
+#include <Zmey/Components/TransformManager.h>
+
+namespace Zmey
+{
+namespace Components
+{
+namespace
+{
+constexpr uint32_t MortonBitsPerAxis = 21u;
+constexpr uint32_t RadixBits = 11u;
+constexpr uint32_t RadixBucketCount = 1u << RadixBits;
+
+// Puts two zero bits after each of the low 21 bits of value
+inline uint64_t SpreadBits(uint32_t value)
+{
+	uint64_t x = value & ((1u << MortonBitsPerAxis) - 1u);
+	x = (x | x << 32u) & 0x001f00000000ffffull;
+	x = (x | x << 16u) & 0x001f0000ff0000ffull;
+	x = (x | x << 8u) & 0x100f00f00f00f00full;
+	x = (x | x << 4u) & 0x10c30c30c30c30c3ull;
+	x = (x | x << 2u) & 0x1249249249249249ull;
+	return x;
+}
+}
+
+void EntitySortKeys::BuildFromTransforms(const TransformManager& transforms)
+{
+	const arena::sparse_set& entities = transforms.GetEntitySet();
+	const EntityId::IndexType count = EntityId::IndexType(entities.size());
+	Vector3 boundsMin(FLT_MAX);
+	Vector3 boundsMax(-FLT_MAX);
+	EntityId::IndexType maxEntityIndex = 0u;
+	for (EntityId::IndexType i = 0u; i < count; ++i)
+	{
+		const Vector3 position(transforms.WorldMatrixAt(i)[3]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+		maxEntityIndex = std::max(maxEntityIndex, entities.EntityAt(i).GetIndex());
+	}
+
+	m_Keys.assign(count > 0u ? maxEntityIndex + 1u : 0u, NoKey);
+	const float cellCount = float((1u << MortonBitsPerAxis) - 1u);
+	const Vector3 scale = cellCount / glm::max(boundsMax - boundsMin, Vector3(FLT_MIN));
+	for (EntityId::IndexType i = 0u; i < count; ++i)
+	{
+		const Vector3 position(transforms.WorldMatrixAt(i)[3]);
+		const glm::uvec3 cell(glm::clamp((position - boundsMin) * scale, Vector3(0.f), Vector3(cellCount)));
+		m_Keys[entities.EntityAt(i).GetIndex()] = SpreadBits(cell.x) | SpreadBits(cell.y) << 1u | SpreadBits(cell.z) << 2u;
+	}
+}
+
+stl::vector<EntityId::IndexType> EntitySortKeys::SortOrder(const arena::sparse_set& entities) const
+{
+	const EntityId::IndexType count = EntityId::IndexType(entities.size());
+	stl::vector<uint64_t> keys(count);
+	stl::vector<EntityId::IndexType> order(count);
+	uint64_t differingBits = 0u;
+	bool isSorted = true;
+	for (EntityId::IndexType i = 0u; i < count; ++i)
+	{
+		keys[i] = KeyOf(entities.EntityAt(i));
+		order[i] = i;
+		differingBits |= keys[i] ^ keys[0];
+		isSorted = isSorted && (i == 0u || keys[i - 1u] <= keys[i]);
+	}
+	if (isSorted)
+	{
+		order.clear();
+		return order;
+	}
+
+	// LSD radix sort, which is stable, skipping the digits all keys share
+	stl::vector<uint64_t> keysScratch(count);
+	stl::vector<EntityId::IndexType> orderScratch(count);
+	stl::vector<uint32_t> offsets(RadixBucketCount);
+	for (uint32_t shift = 0u; shift < 64u; shift += RadixBits)
+	{
+		if (((differingBits >> shift) & (RadixBucketCount - 1u)) == 0u)
+		{
+			continue;
+		}
+		std::fill(offsets.begin(), offsets.end(), 0u);
+		for (EntityId::IndexType i = 0u; i < count; ++i)
+		{
+			++offsets[(keys[i] >> shift) & (RadixBucketCount - 1u)];
+		}
+		uint32_t offset = 0u;
+		for (uint32_t& bucket : offsets)
+		{
+			const uint32_t bucketSize = bucket;
+			bucket = offset;
+			offset += bucketSize;
+		}
+		for (EntityId::IndexType i = 0u; i < count; ++i)
+		{
+			const uint32_t target = offsets[(keys[i] >> shift) & (RadixBucketCount - 1u)]++;
+			keysScratch[target] = keys[i];
+			orderScratch[target] = order[i];
+		}
+		keys.swap(keysScratch);
+		order.swap(orderScratch);
+	}
+	return order;
+}
+
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+
+#include <Zmey/Config.h>
+#include <Zmey/EntityManager.h>
+#include <Zmey/Containers/SparseSet.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+namespace Components
+{
+class TransformManager;
+
+// A key per entity that managers sort their packed data by, see ComponentManager::SortEntities.
+// Keys are looked up by EntityId::GetIndex(), entities without one go after all the rest.
+class EntitySortKeys
+{
+public:
+	static constexpr uint64_t NoKey = ~uint64_t(0u);
+
+	EntitySortKeys()
+	{}
+	EntitySortKeys(AllocatorRef allocator)
+		: m_Keys(allocator)
+	{}
+
+	// Morton codes of the world positions of the transforms within their bounding box, so that entities
+	// close to each other get close keys
+	ZMEY_API void BuildFromTransforms(const TransformManager& transforms);
+
+	inline uint64_t KeyOf(EntityId id) const
+	{
+		return id.GetIndex() < m_Keys.size() ? m_Keys[id.GetIndex()] : NoKey;
+	}
+	// The order that sorts the entities by key, for SparseSet::Reorder - equal keys keep their order.
+	// Empty if they are sorted already. Too big for the temp allocator with many entities, so it's on the heap.
+	ZMEY_API stl::vector<EntityId::IndexType> SortOrder(const arena::sparse_set& entities) const;
+private:
+	arena::vector<uint64_t> m_Keys;
+};
+
+}
+}
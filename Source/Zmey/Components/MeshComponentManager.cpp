@@ -3,6 +3,7 @@
 #include <nlohmann/json.hpp>
 
 #include <Zmey/Components/ComponentRegistry.h>
+#include <Zmey/Components/EntitySortKeys.h>
 #include <Zmey/Components/TransformManager.h>
 #include <Zmey/MemoryStream.h>
 #include <Zmey/Modules.h>
@@ -40,38 +41,75 @@ void MeshComponentManager::InitializeFromBlob(const tmp::vector<EntityId>& entit
 		Zmey::Name name;
 		stream >> name;
 		ASSERT(Zmey::Modules.ResourceLoader.IsResourceReady(name));
-		Graphics::MeshHandle meshHandle = *Zmey::Modules.ResourceLoader.AsMeshHandle(name);
-		m_EntityToIndex[entities[i]] = uint32_t(m_Meshes.size());
+		Graphics::MeshHandle meshHandle = Zmey::Modules.ResourceLoader.AsMeshHandle(name);
+		const auto existingIndex = m_Entities.IndexOf(entities[i]);
+		if (existingIndex != arena::sparse_set::InvalidIndex)
+		{
+			m_Meshes[existingIndex] = meshHandle;
+			m_Changes.MarkChanged(existingIndex);
+			continue;
+		}
+		m_Entities.Insert(entities[i]);
 		m_Meshes.push_back(meshHandle);
+		m_Changes.Add();
 	}
 }
 
+void MeshComponentManager::InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize)
+{
+	Zmey::MemoryInputStream stream(blob, blobSize);
+	Zmey::Name name;
+	stream >> name;
+	ASSERT(Zmey::Modules.ResourceLoader.IsResourceReady(name));
+	const Graphics::MeshHandle meshHandle = Zmey::Modules.ResourceLoader.AsMeshHandle(name);
+	for (size_t i = 0u; i < count; ++i)
+	{
+		m_Entities.Insert(entities[i]);
+	}
+	m_Meshes.resize(m_Meshes.size() + count, meshHandle);
+	m_Changes.Resize(m_Meshes.size());
+}
+
 void MeshComponentManager::Simulate(float deltaTime)
 {
 }
 
 void MeshComponentManager::RemoveEntity(EntityId id)
 {
-	auto findIt = m_EntityToIndex.find(id);
-	if (findIt != m_EntityToIndex.end())
+	const auto index = m_Entities.Remove(id);
+	if (index != arena::sparse_set::InvalidIndex)
 	{
-		// TODO: remove data from entity indexes, or keep some kind of free list for this
-		m_EntityToIndex.erase(findIt);
+		SwapAndPop(m_Meshes, index);
+		m_Changes.SwapAndPop(index);
 	}
 }
 
-stl::vector<std::tuple<EntityId, Graphics::MeshHandle>> MeshComponentManager::GetMeshes()
+void MeshComponentManager::SaveSnapshot(MemoryOutputStream& stream) const
 {
-	stl::vector<std::tuple<EntityId, Graphics::MeshHandle>> result;
-	result.reserve(m_EntityToIndex.size());
-	for (auto& en : m_EntityToIndex)
-	{
-		result.emplace_back(en.first, m_Meshes[en.second]);
-	}
+	m_Entities.Save(stream);
+	WriteArray(stream, m_Meshes);
+}
 
-	return result;
+void MeshComponentManager::RestoreSnapshot(MemoryInputStream& stream)
+{
+	m_Entities.Restore(stream);
+	ReadArray(stream, m_Meshes);
+	m_Changes.Clear();
+	m_Changes.Resize(m_Meshes.size());
 }
 
+bool MeshComponentManager::SortEntities(const EntitySortKeys& keys)
+{
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	const stl::vector<EntityId::IndexType> order = keys.SortOrder(m_Entities);
+	if (!order.empty())
+	{
+		m_Entities.Reorder(order);
+		Permute(m_Meshes, order);
+		m_Changes.Permute(order);
+	}
+	return true;
+}
 
 DEFINE_COMPONENT_MANAGER(MeshComponentManager, Mesh, &MeshComponentDefaults, &MeshComponentToBlob);
 
@@ -1,5 +1,7 @@
 #pragma once
 #include <Zmey/EntityManager.h>
+#include <Zmey/Containers/SparseSet.h>
+#include <Zmey/Components/ChangeTracker.h>
 #include <Zmey/Components/ComponentRegistryCommon.h>
 #include <Zmey/Components/ComponentManager.h>
 #include <Zmey/Graphics/GraphicsObjects.h>
@@ -16,14 +18,32 @@ class MeshComponentManager : public ComponentManager
 	DECLARE_COMPONENT_MANAGER(MeshComponentManager);
 public:
 	virtual void InitializeFromBlob(const tmp::vector<EntityId>&, Zmey::MemoryInputStream&) override;
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize) override;
 	virtual void Simulate(float deltaTime) override;
 	virtual void RemoveEntity(EntityId id) override;
+	virtual void SaveSnapshot(MemoryOutputStream& stream) const override;
+	virtual void RestoreSnapshot(MemoryInputStream& stream) override;
+	virtual bool SortEntities(const EntitySortKeys& keys) override;
 
-	//TODO(alex): remove this after visibility objects are created
-	stl::vector<std::tuple<EntityId, Graphics::MeshHandle>> GetMeshes();
+	// Data of the entity at the given index of the entity set, see Query
+	inline Graphics::MeshHandle MeshAt(EntityId::IndexType index) const
+	{
+		return m_Meshes[index];
+	}
+	inline const arena::sparse_set& GetEntitySet() const
+	{
+		return m_Entities;
+	}
+	// Indices of the entity set whose mesh got set
+	inline ChangeTracker& GetChanges()
+	{
+		return m_Changes;
+	}
 private:
-	stl::vector<Graphics::MeshHandle> m_Meshes;
-	stl::unordered_map<EntityId, EntityId::IndexType> m_EntityToIndex;
+	// Packed, in the order of m_Entities
+	arena::vector<Graphics::MeshHandle> m_Meshes;
+	ChangeTracker m_Changes;
+	arena::sparse_set m_Entities;
 };
 
 }
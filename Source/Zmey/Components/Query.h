@@ -0,0 +1,176 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <Zmey/EntityManager.h>
+#include <Zmey/Containers/SparseSet.h>
+#include <Zmey/Job/ParallelFor.h>
+
+namespace Zmey
+{
+namespace Components
+{
+constexpr uint32_t QueryChunkSize = 256u;
+
+// A run of entities that have all the queried components.
+// Indices[m][i] is where the data of Entities[i] lives in the m-th manager of the query.
+template<size_t ManagerCount>
+struct QueryChunk
+{
+	uint32_t Count;
+	EntityId Entities[QueryChunkSize];
+	EntityId::IndexType Indices[ManagerCount][QueryChunkSize];
+};
+
+// Iterates the entities that have a component in each of the managers.
+// Managers take part by exposing the sparse set that maps their entities to their packed data:
+//	const arena::sparse_set& GetEntitySet() const;
+// Walks the packed entities of the smallest set in order and looks the rest up, a chunk at a time,
+// so the per-entity work is a few array reads and the callbacks see their data in a predictable order.
+// Adding or removing components of the queried types while iterating is not allowed.
+template<typename... Managers>
+class Query
+{
+public:
+	static constexpr size_t ManagerCount = sizeof...(Managers);
+	static_assert(ManagerCount > 0u, "Query needs at least one manager");
+	using IndexType = EntityId::IndexType;
+	using Chunk = QueryChunk<ManagerCount>;
+
+	explicit Query(Managers&... managers)
+		: m_Sets{ &managers.GetEntitySet()... }
+		, m_Driver(0u)
+	{
+		for (size_t i = 1u; i < ManagerCount; ++i)
+		{
+			if (m_Sets[i]->size() < m_Sets[m_Driver]->size())
+			{
+				m_Driver = i;
+			}
+		}
+	}
+
+	// Upper bound of the number of matches - the size of the smallest set
+	inline size_t MaxCount() const
+	{
+		return m_Sets[m_Driver]->size();
+	}
+
+	// func(const Chunk&)
+	template<typename Func>
+	void ForEachChunk(const Func& func) const
+	{
+		ForEachChunkInRange(0u, uint32_t(MaxCount()), func);
+	}
+
+	// func(EntityId, IndexType index in the first manager, IndexType index in the second manager...)
+	template<typename Func>
+	void ForEach(const Func& func) const
+	{
+		ForEachChunk([&func](const Chunk& chunk)
+		{
+			CallForEachEntity(chunk, func, std::index_sequence_for<Managers...>());
+		});
+	}
+
+	// Same as ForEachChunk but chunks get processed concurrently, so func has to be safe to call from multiple jobs.
+	// Can be called only from a Job.
+	template<typename Func>
+	void ParallelForEachChunk(Job::IJobSystem& jobSystem, const char* name, const Func& func, uint32_t minBatchSize = 16u * QueryChunkSize) const
+	{
+		Job::ParallelFor(jobSystem, name, 0u, uint32_t(MaxCount()), minBatchSize, [this, &func](uint32_t begin, uint32_t end)
+		{
+			ForEachChunkInRange(begin, end, func);
+		});
+	}
+
+	// Same as ForEach but entities get processed concurrently, so func has to be safe to call from multiple jobs.
+	// Can be called only from a Job.
+	template<typename Func>
+	void ParallelForEach(Job::IJobSystem& jobSystem, const char* name, const Func& func, uint32_t minBatchSize = 16u * QueryChunkSize) const
+	{
+		ParallelForEachChunk(jobSystem, name, [&func](const Chunk& chunk)
+		{
+			CallForEachEntity(chunk, func, std::index_sequence_for<Managers...>());
+		}, minBatchSize);
+	}
+
+private:
+	template<typename Func>
+	void ForEachChunkInRange(uint32_t begin, uint32_t end, const Func& func) const
+	{
+		const EntityId* entities = m_Sets[m_Driver]->Entities();
+		Chunk chunk;
+		for (uint32_t chunkBegin = begin; chunkBegin < end; chunkBegin += QueryChunkSize)
+		{
+			// Fill the chunk a column at a time so that each pass is a tight loop over a single set
+			const uint32_t count = std::min(end - chunkBegin, QueryChunkSize);
+			bool allMatch = true;
+			for (size_t set = 0u; set < ManagerCount; ++set)
+			{
+				IndexType* indices = chunk.Indices[set];
+				if (set == m_Driver)
+				{
+					for (uint32_t i = 0u; i < count; ++i)
+					{
+						indices[i] = chunkBegin + i;
+					}
+					continue;
+				}
+				for (uint32_t i = 0u; i < count; ++i)
+				{
+					indices[i] = m_Sets[set]->IndexOf(entities[chunkBegin + i]);
+					allMatch &= indices[i] != arena::sparse_set::InvalidIndex;
+				}
+			}
+			std::copy(entities + chunkBegin, entities + chunkBegin + count, chunk.Entities);
+			chunk.Count = allMatch ? count : Compact(chunk, count);
+			if (chunk.Count > 0u)
+			{
+				func(chunk);
+			}
+		}
+	}
+
+	// Drops the entities missing from any of the sets, returns how many are left
+	static uint32_t Compact(Chunk& chunk, uint32_t count)
+	{
+		uint32_t kept = 0u;
+		for (uint32_t i = 0u; i < count; ++i)
+		{
+			bool matches = true;
+			for (size_t set = 0u; set < ManagerCount; ++set)
+			{
+				matches &= chunk.Indices[set][i] != arena::sparse_set::InvalidIndex;
+			}
+			if (!matches)
+			{
+				continue;
+			}
+			chunk.Entities[kept] = chunk.Entities[i];
+			for (size_t set = 0u; set < ManagerCount; ++set)
+			{
+				chunk.Indices[set][kept] = chunk.Indices[set][i];
+			}
+			++kept;
+		}
+		return kept;
+	}
+
+	template<typename Func, size_t... ManagerIndices>
+	static void CallForEachEntity(const Chunk& chunk, const Func& func, std::index_sequence<ManagerIndices...>)
+	{
+		for (uint32_t i = 0u; i < chunk.Count; ++i)
+		{
+			func(chunk.Entities[i], chunk.Indices[ManagerIndices][i]...);
+		}
+	}
+
+	const arena::sparse_set* m_Sets[ManagerCount];
+	size_t m_Driver;
+};
+
+}
+}
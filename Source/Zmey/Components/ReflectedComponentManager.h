@@ -0,0 +1,272 @@
+#pragma once
+#include <type_traits>
+
+#include <Zmey/EntityManager.h>
+#include <Zmey/Logging.h>
+#include <Zmey/MemoryStream.h>
+#include <Zmey/Math/Math.h>
+#include <Zmey/Containers/SparseSet.h>
+#include <Zmey/Components/ComponentRegistryCommon.h>
+#include <Zmey/Components/ComponentManager.h>
+#include <Zmey/Components/EntitySortKeys.h>
+
+// Components described by a single list of fields, one entry per field:
+//	FIELD(Type, Name, "json_key", arguments of the default value's constructor...)
+// e.g.
+//	#define SPELL_FIELDS(FIELD) \
+//		FIELD(float, LifeTime, "life_time", 2.f) \
+//		FIELD(Zmey::Vector3, Offset, "offset", 0.f, 1.f, 0.f)
+//
+// DEFINE_REFLECTED_BLOB_FUNCTIONS(SpellComponentDefaults, SpellComponentToBlob, SPELL_FIELDS) defines the functions
+// DEFINE_COMPONENT_MANAGER takes. They write the fields in the order of the list, so the blob of several entities
+// holds one array per field. Managers with data of their own can use it just for the blob.
+//
+// A manager deriving from ReflectedComponentManager and declared with DECLARE_REFLECTED_COMPONENT_MANAGER(Class, SPELL_FIELDS)
+// instead of DECLARE_COMPONENT_MANAGER gets everything else:
+//	- a packed array per field, m_LifeTime and m_Offset, in the order of the sparse set m_Entities
+//	- Get##Name(EntityId) for each field and a Fields struct with all of them for AddEntity
+//	- InitializeFromBlob reading each field with a single copy, InitializeFromTemplate, RemoveEntity, snapshots and sorting
+// Field types have to be trivially copyable and have a FieldFromJson overload. Use uint8_t for flags, arrays of
+// bool can't be read in bulk.
+
+namespace Zmey
+{
+namespace Components
+{
+
+template<typename Json>
+inline void FieldFromJson(const Json& json, float& value)
+{
+	ASSERT_FATAL(json.is_number());
+	value = json.template get<float>();
+}
+template<typename Json>
+inline void FieldFromJson(const Json& json, bool& value)
+{
+	ASSERT_FATAL(json.is_boolean());
+	value = json.template get<bool>();
+}
+template<typename Json>
+inline void FieldFromJson(const Json& json, uint8_t& value)
+{
+	ASSERT_FATAL(json.is_boolean() || json.is_number_integer());
+	value = json.is_boolean() ? uint8_t(json.template get<bool>()) : json.template get<uint8_t>();
+}
+template<typename Json>
+inline void FieldFromJson(const Json& json, int32_t& value)
+{
+	ASSERT_FATAL(json.is_number_integer());
+	value = json.template get<int32_t>();
+}
+template<typename Json>
+inline void FieldFromJson(const Json& json, uint32_t& value)
+{
+	ASSERT_FATAL(json.is_number_integer());
+	value = json.template get<uint32_t>();
+}
+template<typename Json>
+inline void FieldFromJson(const Json& json, Vector3& value)
+{
+	ASSERT_FATAL(json.is_array() && json.size() == 3u);
+	for (size_t i = 0u; i < 3u; ++i)
+	{
+		value[int(i)] = json[i].template get<float>();
+	}
+}
+// Written as [x, y, z, w]
+template<typename Json>
+inline void FieldFromJson(const Json& json, Quaternion& value)
+{
+	ASSERT_FATAL(json.is_array() && json.size() == 4u);
+	value = Quaternion(json[3].template get<float>(), json[0].template get<float>(), json[1].template get<float>(), json[2].template get<float>());
+}
+
+template<typename Derived>
+class ReflectedComponentManager : public ComponentManager
+{
+public:
+	using IndexType = EntityId::IndexType;
+	static constexpr IndexType InvalidIndex = arena::sparse_set::InvalidIndex;
+
+	ReflectedComponentManager(World& world)
+		: ComponentManager(world)
+	{}
+
+	inline const arena::sparse_set& GetEntitySet() const
+	{
+		return m_Entities;
+	}
+
+	// Replaces the data if the entity already has the component
+	template<typename Fields>
+	void AddEntity(EntityId id, const Fields& fields)
+	{
+		AddEntities(&id, 1u);
+		Self().ForEachField([&fields](auto& data, auto field)
+		{
+			data.push_back(fields.*field);
+		});
+	}
+
+	virtual void InitializeFromBlob(const tmp::vector<EntityId>& entities, MemoryInputStream& stream) override
+	{
+		const size_t first = AddEntities(entities.data(), entities.size());
+		const size_t count = entities.size();
+		Self().ForEachField([&](auto& data, auto)
+		{
+			using ValueType = typename std::decay_t<decltype(data)>::value_type;
+			data.resize(first + count);
+			stream.Read(reinterpret_cast<uint8_t*>(&data[first]), sizeof(ValueType) * count);
+		});
+	}
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize) override
+	{
+		const size_t first = AddEntities(entities, count);
+		MemoryInputStream stream(blob, blobSize);
+		Self().ForEachField([&](auto& data, auto)
+		{
+			typename std::decay_t<decltype(data)>::value_type value;
+			stream.Read(reinterpret_cast<uint8_t*>(&value), sizeof(value));
+			data.resize(first + count, value);
+		});
+	}
+	virtual void RemoveEntity(EntityId id) override
+	{
+		const IndexType index = m_Entities.Remove(id);
+		if (index == InvalidIndex)
+		{
+			return;
+		}
+		Self().ForEachField([index](auto& data, auto)
+		{
+			SwapAndPop(data, index);
+		});
+	}
+	virtual void SaveSnapshot(MemoryOutputStream& stream) const override
+	{
+		m_Entities.Save(stream);
+		Self().ForEachField([&stream](const auto& data, auto)
+		{
+			WriteArray(stream, data);
+		});
+	}
+	virtual void RestoreSnapshot(MemoryInputStream& stream) override
+	{
+		m_Entities.Restore(stream);
+		Self().ForEachField([&stream](auto& data, auto)
+		{
+			ReadArray(stream, data);
+		});
+	}
+	virtual bool SortEntities(const EntitySortKeys& keys) override
+	{
+		auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+		const stl::vector<IndexType> order = keys.SortOrder(m_Entities);
+		if (!order.empty())
+		{
+			m_Entities.Reorder(order);
+			Self().ForEachField([&order](auto& data, auto)
+			{
+				Permute(data, order);
+			});
+		}
+		return true;
+	}
+
+protected:
+	inline Derived& Self()
+	{
+		return static_cast<Derived&>(*this);
+	}
+	inline const Derived& Self() const
+	{
+		return static_cast<const Derived&>(*this);
+	}
+
+	// Inserts the entities at the back of m_Entities and returns the index of the first one.
+	// The ones that already had the component lose their data first, the arrays have to be grown by the caller.
+	size_t AddEntities(const EntityId* entities, size_t count)
+	{
+		for (size_t i = 0u; i < count; ++i)
+		{
+			if (m_Entities.Contains(entities[i]))
+			{
+				ReflectedComponentManager::RemoveEntity(entities[i]);
+			}
+		}
+		const size_t first = m_Entities.size();
+		for (size_t i = 0u; i < count; ++i)
+		{
+			m_Entities.Insert(entities[i]);
+		}
+		return first;
+	}
+
+	arena::sparse_set m_Entities;
+};
+
+template<typename Derived>
+constexpr typename ReflectedComponentManager<Derived>::IndexType ReflectedComponentManager<Derived>::InvalidIndex;
+
+}
+}
+
+#define ZMEY_REFLECTED_FIELD_MEMBER(Type, Name, ...) Type Name;
+#define ZMEY_REFLECTED_FIELD_ARRAY(Type, Name, ...) \
+	static_assert(std::is_trivially_copyable<Type>::value && !std::is_same<Type, bool>::value, #Name " can't be copied in bulk"); \
+	Zmey::arena::vector<Type> m_##Name;
+#define ZMEY_REFLECTED_FIELD_VISIT(Type, Name, ...) func(m_##Name, &Fields::Name);
+#define ZMEY_REFLECTED_FIELD_GETTER(Type, Name, ...) \
+	inline const Type& Get##Name(Zmey::EntityId id) const \
+	{ \
+		const auto index = m_Entities.IndexOf(id); \
+		ASSERT_FATAL(index != InvalidIndex); \
+		return m_##Name[index]; \
+	}
+
+#define DECLARE_REFLECTED_COMPONENT_MANAGER(ClassName, FIELDS) \
+	protected: \
+		FIELDS(ZMEY_REFLECTED_FIELD_ARRAY) \
+	public: \
+		ClassName(World& world) : Zmey::Components::ReflectedComponentManager<ClassName>(world) {} \
+		struct Fields \
+		{ \
+			FIELDS(ZMEY_REFLECTED_FIELD_MEMBER) \
+		}; \
+		FIELDS(ZMEY_REFLECTED_FIELD_GETTER) \
+		/* Calls func(array, pointer to the member of Fields) for each field */ \
+		template<typename Func> \
+		void ForEachField(Func&& func) \
+		{ \
+			FIELDS(ZMEY_REFLECTED_FIELD_VISIT) \
+		} \
+		template<typename Func> \
+		void ForEachField(Func&& func) const \
+		{ \
+			FIELDS(ZMEY_REFLECTED_FIELD_VISIT) \
+		} \
+		ZMEY_API static Zmey::ComponentIndex SZmeyComponentManagerIndex
+
+#define ZMEY_REFLECTED_FIELD_DEFAULT(Type, Name, Key, ...) \
+	{ \
+		Type value(__VA_ARGS__); \
+		blob.WriteData(Key, reinterpret_cast<uint8_t*>(&value), sizeof(value)); \
+	}
+#define ZMEY_REFLECTED_FIELD_TO_BLOB(Type, Name, Key, ...) \
+	if (rawJson.find(Key) != rawJson.end()) \
+	{ \
+		Type value; \
+		Zmey::Components::FieldFromJson(rawJson[Key], value); \
+		blob.WriteData(Key, reinterpret_cast<uint8_t*>(&value), sizeof(value)); \
+	}
+
+// Needs nlohmann/json.hpp and ComponentRegistry.h
+#define DEFINE_REFLECTED_BLOB_FUNCTIONS(DefaultsFunction, ToBlobFunction, FIELDS) \
+	void DefaultsFunction(Zmey::Components::IDataBlob& blob) \
+	{ \
+		FIELDS(ZMEY_REFLECTED_FIELD_DEFAULT) \
+	} \
+	void ToBlobFunction(const nlohmann::json& rawJson, Zmey::Components::IDataBlob& blob) \
+	{ \
+		FIELDS(ZMEY_REFLECTED_FIELD_TO_BLOB) \
+	}
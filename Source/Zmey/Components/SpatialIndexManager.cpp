@@ -0,0 +1,334 @@
+#include <Zmey/Components/SpatialIndexManager.h>
+
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+#include <Zmey/MemoryStream.h>
+#include <Zmey/Components/ComponentRegistry.h>
+#include <Zmey/Components/ReflectedComponentManager.h>
+#include <Zmey/Components/TransformManager.h>
+#include <Zmey/World.h>
+
+namespace Zmey
+{
+namespace Components
+{
+
+#define SPATIAL_FIELDS(FIELD) \
+	FIELD(float, Radius, "radius", 0.5f)
+
+DEFINE_REFLECTED_BLOB_FUNCTIONS(SpatialComponentDefaults, SpatialComponentToBlob, SPATIAL_FIELDS);
+
+void SpatialIndexManager::InitializeFromBlob(const tmp::vector<EntityId>& entities, Zmey::MemoryInputStream& stream)
+{
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<float> radii(entities.size());
+	stream.Read(reinterpret_cast<uint8_t*>(radii.data()), sizeof(float) * entities.size());
+	AddEntities(entities.data(), entities.size(), radii.data(), 1u);
+}
+
+void SpatialIndexManager::InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize)
+{
+	float radius;
+	Zmey::MemoryInputStream(blob, blobSize).Read(reinterpret_cast<uint8_t*>(&radius), sizeof(radius));
+	AddEntities(entities, count, &radius, 0u);
+}
+
+void SpatialIndexManager::AddEntities(const EntityId* entities, size_t count, const float* radii, size_t radiusStride)
+{
+	for (size_t i = 0u; i < count; ++i)
+	{
+		const auto existingIndex = m_Entities.IndexOf(entities[i]);
+		if (existingIndex != InvalidIndex)
+		{
+			m_Radii[existingIndex] = radii[i * radiusStride];
+			continue;
+		}
+		m_Entities.Insert(entities[i]);
+		m_Centers.push_back(Vector3(0.f));
+		m_Radii.push_back(radii[i * radiusStride]);
+		m_Cells.push_back(NoCell);
+		m_Next.push_back(InvalidIndex);
+		m_Prev.push_back(InvalidIndex);
+		m_Unplaced.push_back(entities[i]);
+	}
+}
+
+void SpatialIndexManager::LateSimulate()
+{
+	// The transforms come first as they have higher priority, so their world matrices are final by now
+	auto& transforms = GetWorld().GetManager<TransformManager>();
+	const arena::sparse_set& transformEntities = transforms.GetEntitySet();
+	ChangeTracker& changes = transforms.GetChanges();
+	changes.ForEachChangedSince(m_SeenTransformVersion, [&](IndexType transformIndex)
+	{
+		const IndexType index = m_Entities.IndexOf(transformEntities.EntityAt(transformIndex));
+		if (index != InvalidIndex)
+		{
+			Place(index, Vector3(transforms.InstanceAt(transformIndex).WorldMatrix()[3]));
+		}
+	});
+	m_SeenTransformVersion = changes.NextVersion();
+
+	// Entities that got the component after their transform last changed
+	for (EntityId id : m_Unplaced)
+	{
+		const IndexType index = m_Entities.IndexOf(id);
+		const IndexType transformIndex = transformEntities.IndexOf(id);
+		if (index != InvalidIndex && m_Cells[index] == NoCell && transformIndex != InvalidIndex)
+		{
+			Place(index, Vector3(transforms.InstanceAt(transformIndex).WorldMatrix()[3]));
+		}
+	}
+	m_Unplaced.clear();
+}
+
+void SpatialIndexManager::RemoveEntity(EntityId id)
+{
+	const auto index = m_Entities.Remove(id);
+	if (index == InvalidIndex)
+	{
+		return;
+	}
+	Unlink(index);
+	const IndexType last = IndexType(m_Centers.size() - 1u);
+	if (index != last)
+	{
+		const CellKey lastCell = m_Cells[last];
+		Unlink(last);
+		Link(index, lastCell);
+	}
+	SwapAndPop(m_Centers, index);
+	SwapAndPop(m_Radii, index);
+	m_Cells.pop_back();
+	m_Next.pop_back();
+	m_Prev.pop_back();
+}
+
+void SpatialIndexManager::SaveSnapshot(MemoryOutputStream& stream) const
+{
+	m_Entities.Save(stream);
+	WriteArray(stream, m_Centers);
+	WriteArray(stream, m_Radii);
+	WriteArray(stream, m_Cells);
+	WriteArray(stream, m_Unplaced);
+}
+
+void SpatialIndexManager::RestoreSnapshot(MemoryInputStream& stream)
+{
+	m_Entities.Restore(stream);
+	ReadArray(stream, m_Centers);
+	ReadArray(stream, m_Radii);
+	ReadArray(stream, m_Cells);
+	ReadArray(stream, m_Unplaced);
+
+	// The lists get rebuilt rather than saved as they are keyed on the cells
+	m_CellHeads.clear();
+	m_Next.assign(m_Cells.size(), InvalidIndex);
+	m_Prev.assign(m_Cells.size(), InvalidIndex);
+	for (IndexType index = 0u; index < m_Cells.size(); ++index)
+	{
+		const CellKey cell = m_Cells[index];
+		m_Cells[index] = NoCell;
+		Link(index, cell);
+	}
+}
+
+void SpatialIndexManager::SetRadius(EntityId id, float radius)
+{
+	const auto index = m_Entities.IndexOf(id);
+	ASSERT_RETURN(index != InvalidIndex);
+	m_Radii[index] = radius;
+	if (m_Cells[index] != NoCell)
+	{
+		Place(index, m_Centers[index]);
+	}
+}
+
+glm::ivec3 SpatialIndexManager::CellOf(const Vector3& position)
+{
+	const Vector3 cell = glm::floor(position * (1.f / CellSize));
+	return glm::ivec3(glm::clamp(cell, Vector3(float(-CellCoordinateLimit)), Vector3(float(CellCoordinateLimit - 1))));
+}
+
+void SpatialIndexManager::Place(IndexType index, const Vector3& center)
+{
+	m_Centers[index] = center;
+	const CellKey cell = m_Cells[index];
+	const bool isOversized = m_Radii[index] > CellSlack;
+	if (isOversized ? cell == OversizedCell : cell != NoCell && cell != OversizedCell && IsNearCell(cell, center))
+	{
+		return;
+	}
+	Unlink(index);
+	Link(index, isOversized ? OversizedCell : PackCell(CellOf(center)));
+}
+
+void SpatialIndexManager::Link(IndexType index, CellKey key)
+{
+	m_Cells[index] = key;
+	if (key == NoCell)
+	{
+		return;
+	}
+	if (key != OversizedCell)
+	{
+		const glm::ivec3 cell = UnpackCell(key);
+		m_MinCell = glm::min(m_MinCell, cell);
+		m_MaxCell = glm::max(m_MaxCell, cell);
+	}
+	IndexType& head = m_CellHeads.try_emplace(key, InvalidIndex).first->second;
+	m_Prev[index] = InvalidIndex;
+	m_Next[index] = head;
+	if (head != InvalidIndex)
+	{
+		m_Prev[head] = index;
+	}
+	head = index;
+}
+
+void SpatialIndexManager::Unlink(IndexType index)
+{
+	const CellKey key = m_Cells[index];
+	if (key == NoCell)
+	{
+		return;
+	}
+	const IndexType next = m_Next[index];
+	const IndexType prev = m_Prev[index];
+	if (next != InvalidIndex)
+	{
+		m_Prev[next] = prev;
+	}
+	if (prev != InvalidIndex)
+	{
+		m_Next[prev] = next;
+	}
+	else if (next != InvalidIndex)
+	{
+		m_CellHeads.at(key) = next;
+	}
+	else
+	{
+		m_CellHeads.erase(key);
+	}
+	m_Cells[index] = NoCell;
+}
+
+bool SpatialIndexManager::ClipRay(const Vector3& origin, const Vector3& direction, float maxDistance, float& enter, float& exit) const
+{
+	if (glm::any(glm::greaterThan(m_MinCell, m_MaxCell)))
+	{
+		return false;
+	}
+	const Vector3 boundsMin = Vector3(m_MinCell) * CellSize - 2.f * CellSlack;
+	const Vector3 boundsMax = Vector3(m_MaxCell + 1) * CellSize + 2.f * CellSlack;
+	enter = 0.f;
+	exit = maxDistance;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (direction[axis] == 0.f)
+		{
+			if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+			{
+				return false;
+			}
+			continue;
+		}
+		float slabEnter = (boundsMin[axis] - origin[axis]) / direction[axis];
+		float slabExit = (boundsMax[axis] - origin[axis]) / direction[axis];
+		if (slabEnter > slabExit)
+		{
+			std::swap(slabEnter, slabExit);
+		}
+		enter = std::max(enter, slabEnter);
+		exit = std::min(exit, slabExit);
+		if (enter > exit)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+tmp::vector<EntityId> SpatialIndexManager::FindInSphere(const Vector3& center, float radius) const
+{
+	tmp::vector<EntityId> result;
+	ForEachInSphere(center, radius, [&result](EntityId id)
+	{
+		result.push_back(id);
+	});
+	return result;
+}
+
+EntityId SpatialIndexManager::Raycast(const Vector3& origin, const Vector3& direction, float maxDistance, float* hitDistance) const
+{
+	EntityId closest = EntityId::NullEntity();
+	float closestDistance = maxDistance;
+	ForEachOnRay(origin, direction, maxDistance, [&](EntityId id, float distance)
+	{
+		if (distance <= closestDistance)
+		{
+			closest = id;
+			closestDistance = distance;
+		}
+	});
+	if (hitDistance)
+	{
+		*hitDistance = closestDistance;
+	}
+	return closest;
+}
+
+size_t SpatialIndexManager::FindNearest(const Vector3& point, size_t count, EntityId* result, float maxDistance) const
+{
+	if (count == 0u)
+	{
+		return 0u;
+	}
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<std::pair<float, IndexType>> candidates;
+	const float maxDistanceSquared = maxDistance < FLT_MAX ? maxDistance * maxDistance : FLT_MAX;
+	// Grow the cube around the point until the sphere that fits in it holds enough centers. Every center in
+	// that sphere is in one of the cells the cube covers, so the closest ones can't be missed.
+	for (float reach = CellSize; ; reach *= 2.f)
+	{
+		reach = std::min(reach, maxDistance);
+		// Centers may be a little out of their cells
+		const glm::ivec3 minCell = CellOf(point - Vector3(reach + CellSlack));
+		const glm::ivec3 maxCell = CellOf(point + Vector3(reach + CellSlack));
+		const bool coversAll = glm::all(glm::lessThanEqual(minCell, m_MinCell)) && glm::all(glm::greaterThanEqual(maxCell, m_MaxCell));
+		// Once all cells are in, the centers in the corners of the cube count too
+		const float reachSquared = reach == maxDistance || coversAll ? maxDistanceSquared : reach * reach;
+
+		candidates.clear();
+		auto gather = [&](IndexType index)
+		{
+			const Vector3 offset = m_Centers[index] - point;
+			const float distanceSquared = glm::dot(offset, offset);
+			if (distanceSquared <= reachSquared)
+			{
+				candidates.emplace_back(distanceSquared, index);
+			}
+		};
+		ForEachInCells(minCell, maxCell, gather);
+		ForEachOversized(gather);
+		if (candidates.size() >= count || coversAll || reach == maxDistance)
+		{
+			break;
+		}
+	}
+
+	count = std::min(count, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+	for (size_t i = 0u; i < count; ++i)
+	{
+		result[i] = m_Entities.EntityAt(candidates[i].second);
+	}
+	return count;
+}
+
+DEFINE_COMPONENT_MANAGER(SpatialIndexManager, Spatial, &Zmey::Components::SpatialComponentDefaults, &Zmey::Components::SpatialComponentToBlob);
+
+}
+}
@@ -0,0 +1,299 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+
+#include <Zmey/EntityManager.h>
+#include <Zmey/Components/ComponentRegistryCommon.h>
+#include <Zmey/Components/ComponentManager.h>
+#include <Zmey/Containers/FlatHashMap.h>
+#include <Zmey/Containers/SparseSet.h>
+#include <Zmey/Math/Math.h>
+
+namespace Zmey
+{
+
+namespace Components
+{
+
+// Finds the entities around a point without going through all of them.
+// Entities with the component are spheres around the world position of their transform, bucketed in a uniform grid
+// by their center. The grid is loose - a sphere is linked in a single cell and its center may wander a bit out of it,
+// while queries look half a cell further - so a moving entity gets relinked only once it's well into another cell.
+// Spheres too big for that are kept in a list of their own that every query goes through.
+// Positions are taken from the transforms that changed once their world matrices are updated in LateSimulate,
+// so queries see where entities were at the end of the last frame.
+// Queries don't change the index and can run from many jobs at once, as long as it isn't during LateSimulate.
+class SpatialIndexManager : public ComponentManager
+{
+	DECLARE_COMPONENT_MANAGER(SpatialIndexManager);
+public:
+	using IndexType = EntityId::IndexType;
+	static constexpr float CellSize = 8.f;
+
+	virtual void InitializeFromBlob(const tmp::vector<EntityId>&, Zmey::MemoryInputStream&) override;
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize) override;
+	virtual void Simulate(float deltaTime) override {}
+	virtual void LateSimulate() override;
+	virtual void RemoveEntity(EntityId id) override;
+	virtual void SaveSnapshot(MemoryOutputStream& stream) const override;
+	virtual void RestoreSnapshot(MemoryInputStream& stream) override;
+
+	ZMEY_API void SetRadius(EntityId id, float radius);
+	inline const arena::sparse_set& GetEntitySet() const
+	{
+		return m_Entities;
+	}
+
+	// Calls func(EntityId) for every sphere that overlaps the query sphere
+	template<typename Func>
+	void ForEachInSphere(const Vector3& center, float radius, const Func& func) const;
+	// Calls func(EntityId) for every sphere that overlaps the box
+	template<typename Func>
+	void ForEachInBox(const AABB& box, const Func& func) const;
+	// Calls func(EntityId, float distance) for every sphere the ray hits no further than maxDistance, in no particular order.
+	// The direction doesn't have to be normalized.
+	template<typename Func>
+	void ForEachOnRay(const Vector3& origin, const Vector3& direction, float maxDistance, const Func& func) const;
+
+	ZMEY_API tmp::vector<EntityId> FindInSphere(const Vector3& center, float radius) const;
+	// The closest sphere the ray hits, NullEntity if none
+	ZMEY_API EntityId Raycast(const Vector3& origin, const Vector3& direction, float maxDistance = FLT_MAX, float* hitDistance = nullptr) const;
+	// Fills result with up to count entities whose centers are the closest to the point, closest first.
+	// Returns how many were found.
+	ZMEY_API size_t FindNearest(const Vector3& point, size_t count, EntityId* result, float maxDistance = FLT_MAX) const;
+
+private:
+	static constexpr IndexType InvalidIndex = arena::sparse_set::InvalidIndex;
+	using CellKey = uint64_t;
+	// Cell coordinates are packed in 21 bits each
+	static constexpr int32_t CellCoordinateLimit = 1 << 20;
+	static constexpr CellKey OversizedCell = ~CellKey(0);
+	// Entities waiting for LateSimulate to get their position
+	static constexpr CellKey NoCell = ~CellKey(0) - 1u;
+	// Spheres up to this radius get linked in cells and their centers stay linked until they get this far out of the cell,
+	// which keeps them within the half cell around it that queries look at
+	static constexpr float CellSlack = 0.25f * CellSize;
+
+	static glm::ivec3 CellOf(const Vector3& position);
+	static inline CellKey PackCell(const glm::ivec3& cell)
+	{
+		return CellKey(cell.x + CellCoordinateLimit)
+			| (CellKey(cell.y + CellCoordinateLimit) << 21u)
+			| (CellKey(cell.z + CellCoordinateLimit) << 42u);
+	}
+	static inline glm::ivec3 UnpackCell(CellKey key)
+	{
+		const CellKey mask = (CellKey(1) << 21u) - 1u;
+		return glm::ivec3(int32_t(key & mask), int32_t((key >> 21u) & mask), int32_t((key >> 42u) & mask)) - CellCoordinateLimit;
+	}
+	static inline bool IsNearCell(CellKey key, const Vector3& center)
+	{
+		const Vector3 cellMin = Vector3(UnpackCell(key)) * CellSize;
+		return glm::all(glm::greaterThanEqual(center, cellMin - CellSlack)) && glm::all(glm::lessThanEqual(center, cellMin + (CellSize + CellSlack)));
+	}
+
+	void AddEntities(const EntityId* entities, size_t count, const float* radii, size_t radiusStride);
+	void Place(IndexType index, const Vector3& center);
+	void Link(IndexType index, CellKey key);
+	void Unlink(IndexType index);
+	// Cuts the ray to the part that passes through the used cells, false if it misses them
+	bool ClipRay(const Vector3& origin, const Vector3& direction, float maxDistance, float& enter, float& exit) const;
+
+	template<typename Func>
+	void ForEachInCell(IndexType head, const Func& func) const
+	{
+		for (IndexType index = head; index != InvalidIndex; index = m_Next[index])
+		{
+			func(index);
+		}
+	}
+	template<typename Func>
+	void ForEachOversized(const Func& func) const
+	{
+		auto oversized = m_CellHeads.find(OversizedCell);
+		if (oversized != m_CellHeads.end())
+		{
+			ForEachInCell(oversized->second, func);
+		}
+	}
+	// Calls func(IndexType) for every sphere linked in the cells between minCell and maxCell, inclusive
+	template<typename Func>
+	void ForEachInCells(glm::ivec3 minCell, glm::ivec3 maxCell, const Func& func) const;
+	// Calls func(IndexType) for every sphere whose center is in a cell the ray passes through or next to one
+	template<typename Func>
+	void ForEachNearRay(const Vector3& origin, const Vector3& direction, float maxDistance, const Func& func) const;
+	// Calls func(IndexType) for every sphere linked in a cell within the half cell around the box - all that may overlap it
+	template<typename Func>
+	void ForEachNearBox(const Vector3& min, const Vector3& max, const Func& func) const
+	{
+		const Vector3 margin(2.f * CellSlack);
+		ForEachInCells(CellOf(min - margin), CellOf(max + margin), func);
+		ForEachOversized(func);
+	}
+
+	// Packed, in the order of m_Entities
+	arena::sparse_set m_Entities;
+	arena::vector<Vector3> m_Centers;
+	arena::vector<float> m_Radii;
+	arena::vector<CellKey> m_Cells;
+	// The spheres of a cell form a list, the map holds the first sphere of each non-empty cell
+	arena::vector<IndexType> m_Next;
+	arena::vector<IndexType> m_Prev;
+	arena::flat_hash_map<CellKey, IndexType> m_CellHeads;
+	// Range of the cells that were ever used, queries don't look outside of it
+	glm::ivec3 m_MinCell = glm::ivec3(CellCoordinateLimit);
+	glm::ivec3 m_MaxCell = glm::ivec3(-CellCoordinateLimit);
+	arena::vector<EntityId> m_Unplaced;
+	uint32_t m_SeenTransformVersion = 0u;
+};
+
+template<typename Func>
+void SpatialIndexManager::ForEachInCells(glm::ivec3 minCell, glm::ivec3 maxCell, const Func& func) const
+{
+	minCell = glm::max(minCell, m_MinCell);
+	maxCell = glm::min(maxCell, m_MaxCell);
+	if (glm::any(glm::greaterThan(minCell, maxCell)))
+	{
+		return;
+	}
+	// Big ranges have more cells to look up than there are non-empty cells, go through the latter then
+	const glm::i64vec3 extent = glm::i64vec3(maxCell - minCell) + int64_t(1);
+	if (uint64_t(extent.x * extent.y * extent.z) > m_CellHeads.size())
+	{
+		for (const auto& cell : m_CellHeads)
+		{
+			if (cell.first == OversizedCell)
+			{
+				continue;
+			}
+			const glm::ivec3 coordinates = UnpackCell(cell.first);
+			if (glm::all(glm::greaterThanEqual(coordinates, minCell)) && glm::all(glm::lessThanEqual(coordinates, maxCell)))
+			{
+				ForEachInCell(cell.second, func);
+			}
+		}
+		return;
+	}
+	for (int32_t z = minCell.z; z <= maxCell.z; ++z)
+	{
+		for (int32_t y = minCell.y; y <= maxCell.y; ++y)
+		{
+			for (int32_t x = minCell.x; x <= maxCell.x; ++x)
+			{
+				auto cell = m_CellHeads.find(PackCell(glm::ivec3(x, y, z)));
+				if (cell != m_CellHeads.end())
+				{
+					ForEachInCell(cell->second, func);
+				}
+			}
+		}
+	}
+}
+
+template<typename Func>
+void SpatialIndexManager::ForEachInSphere(const Vector3& center, float radius, const Func& func) const
+{
+	const EntityId* entities = m_Entities.Entities();
+	ForEachNearBox(center - Vector3(radius), center + Vector3(radius), [&](IndexType index)
+	{
+		const float reach = radius + m_Radii[index];
+		const Vector3 offset = m_Centers[index] - center;
+		if (glm::dot(offset, offset) <= reach * reach)
+		{
+			func(entities[index]);
+		}
+	});
+}
+
+template<typename Func>
+void SpatialIndexManager::ForEachInBox(const AABB& box, const Func& func) const
+{
+	const EntityId* entities = m_Entities.Entities();
+	ForEachNearBox(box.Min, box.Max, [&](IndexType index)
+	{
+		const Vector3 closest = glm::clamp(m_Centers[index], box.Min, box.Max);
+		const Vector3 offset = m_Centers[index] - closest;
+		if (glm::dot(offset, offset) <= m_Radii[index] * m_Radii[index])
+		{
+			func(entities[index]);
+		}
+	});
+}
+
+template<typename Func>
+void SpatialIndexManager::ForEachOnRay(const Vector3& origin, const Vector3& direction, float maxDistance, const Func& func) const
+{
+	const Vector3 unitDirection = glm::normalize(direction);
+	const EntityId* entities = m_Entities.Entities();
+	auto testSphere = [&](IndexType index)
+	{
+		const Vector3 offset = origin - m_Centers[index];
+		const float projection = glm::dot(offset, unitDirection);
+		const float outside = glm::dot(offset, offset) - m_Radii[index] * m_Radii[index];
+		if (outside > 0.f && projection > 0.f)
+		{
+			return;
+		}
+		const float discriminant = projection * projection - outside;
+		if (discriminant < 0.f)
+		{
+			return;
+		}
+		// Rays that start inside the sphere hit it right away
+		const float distance = std::max(-projection - std::sqrt(discriminant), 0.f);
+		if (distance <= maxDistance)
+		{
+			func(entities[index], distance);
+		}
+	};
+	ForEachNearRay(origin, unitDirection, maxDistance, testSphere);
+	ForEachOversized(testSphere);
+}
+
+template<typename Func>
+void SpatialIndexManager::ForEachNearRay(const Vector3& origin, const Vector3& direction, float maxDistance, const Func& func) const
+{
+	float enter;
+	float exit;
+	if (!ClipRay(origin, direction, maxDistance, enter, exit))
+	{
+		return;
+	}
+	// Walk the cells the ray passes through. The first cell brings its neighbours along and every step after it
+	// only the slab of neighbours ahead, which covers each cell next to the ray exactly once.
+	const Vector3 start = origin + direction * enter;
+	glm::ivec3 cell = CellOf(start);
+	const glm::ivec3 lastCell = CellOf(origin + direction * exit);
+	glm::ivec3 step;
+	Vector3 nextBoundary;
+	Vector3 boundaryDistance;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		step[axis] = direction[axis] > 0.f ? 1 : (direction[axis] < 0.f ? -1 : 0);
+		if (step[axis] == 0)
+		{
+			nextBoundary[axis] = FLT_MAX;
+			continue;
+		}
+		const float boundary = float(cell[axis] + (step[axis] > 0 ? 1 : 0)) * CellSize;
+		nextBoundary[axis] = enter + (boundary - start[axis]) / direction[axis];
+		boundaryDistance[axis] = CellSize / std::abs(direction[axis]);
+	}
+	ForEachInCells(cell - 1, cell + 1, func);
+	const glm::ivec3 cellsLeft = glm::abs(lastCell - cell);
+	for (int32_t i = cellsLeft.x + cellsLeft.y + cellsLeft.z; i > 0; --i)
+	{
+		int axis = nextBoundary.x < nextBoundary.y ? 0 : 1;
+		axis = nextBoundary.z < nextBoundary[axis] ? 2 : axis;
+		cell[axis] += step[axis];
+		nextBoundary[axis] += boundaryDistance[axis];
+		glm::ivec3 slabMin = cell - 1;
+		glm::ivec3 slabMax = cell + 1;
+		slabMin[axis] = slabMax[axis] = cell[axis] + step[axis];
+		ForEachInCells(slabMin, slabMax, func);
+	}
+}
+
+}
+
+}
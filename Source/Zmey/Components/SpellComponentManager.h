@@ -1,10 +1,8 @@
 #pragma once
 
 #include <Zmey/EntityManager.h>
-#include <Zmey/Components/ComponentRegistryCommon.h>
-#include <Zmey/Components/ComponentManager.h>
-
-#include <functional>
+#include <Zmey/EventChannel.h>
+#include <Zmey/Components/ReflectedComponentManager.h>
 
 // TODO: Make this component extrernal
 namespace Zmey
@@ -14,48 +12,25 @@ namespace Components
 {
 
 // Add new attributes only from here and every thing will works auto magicly
-#define ITERATE_SPELL_ATTRIBUTES(MACRO) \
-				MACRO(float, InitialSpeed, "initial_speed", 500)\
-				MACRO(float, ImpactDamage, "impact_damage", 10)\
-				MACRO(float, InitialMass, "initial_mass", 1)\
-				MACRO(float, CooldownTime, "cooldown_time", 1)\
-				MACRO(float, LifeTime, "life_time", 2)
-
-struct SpellComponent : public Zmey::Components::ComponentManager
+#define ITERATE_SPELL_ATTRIBUTES(FIELD) \
+				FIELD(float, InitialSpeed, "initial_speed", 500.f)\
+				FIELD(float, ImpactDamage, "impact_damage", 10.f)\
+				FIELD(float, InitialMass, "initial_mass", 1.f)\
+				FIELD(float, CooldownTime, "cooldown_time", 1.f)\
+				FIELD(float, LifeTime, "life_time", 2.f)
+
+struct SpellComponent : public Zmey::Components::ReflectedComponentManager<SpellComponent>
 {
-	DECLARE_COMPONENT_MANAGER(SpellComponent);
+	DECLARE_REFLECTED_COMPONENT_MANAGER(SpellComponent, ITERATE_SPELL_ATTRIBUTES);
 // TODO DECLARE_EXTERNAL_COMPONENT_MANAGER(SpellComponent);
 public:
-	struct EntryDescriptor
-	{
-#define DECLARE_ATTRIBUTES(TYPE, PROPERTY, ...) TYPE PROPERTY;
-		ITERATE_SPELL_ATTRIBUTES(DECLARE_ATTRIBUTES)
-		Zmey::EntityId EntityId;
-	};
-
-	virtual void InitializeFromBlob(const Zmey::tmp::vector<Zmey::EntityId>&, Zmey::MemoryInputStream&) override;
 	virtual void Simulate(float deltaTime) override;
-	virtual void RemoveEntity(Zmey::EntityId id) override;
-	// TODO: Make component for this
-	using SpellExpireDelegate = std::function<void(Zmey::EntityId id)>;
-
-	ZMEY_API void SetSpellExpireListener(SpellExpireDelegate delegate) { m_SpellExpireCallback = delegate; };
+	// Spells whose life time ran out, they are already removed from the component but not destroyed
+	const Zmey::EventChannel<Zmey::EntityId>& GetExpiredSpells() const { return m_ExpiredSpells; }
 
-	ZMEY_API void Push(EntryDescriptor desc);
-
-#define DECLARE_GETTERS(TYPE, PROPERTY, ...) ZMEY_API TYPE Get##PROPERTY(Zmey::EntityId id);
-	ITERATE_SPELL_ATTRIBUTES(DECLARE_GETTERS)
-
-#define DECLARE_VECTOR_ATTRIBUTES(TYPE, PROPERTY, ...) std::vector<TYPE> m_##PROPERTY;
-	ITERATE_SPELL_ATTRIBUTES(DECLARE_VECTOR_ATTRIBUTES)
-	std::vector<Zmey::EntityId> m_EntityToIndex;
-
-	SpellExpireDelegate m_SpellExpireCallback;
+private:
+	Zmey::EventChannel<Zmey::EntityId> m_ExpiredSpells{ GetWorld() };
 };
 
 }
 }
-#undef DECLARE_ATTRIBUTES
-#undef DECLARE_GETTERS
-#undef DECLARE_VECTOR_ATTRIBUTES
-
@@ -48,33 +48,151 @@ void TagManager::InitializeFromBlob(const tmp::vector<EntityId>& entities, Zmey:
 			{
 				break;
 			}
-			m_Tags.push_back(EntityTagPair{ entityId, nextTag });
+			AddTag(entityId, nextTag);
 		}
 	}
 }
 
+void TagManager::InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize)
+{
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<Zmey::Name> tags;
+	Zmey::MemoryInputStream input(blob, blobSize);
+	Zmey::Name nextTag(Zmey::Name::NullName());
+	for (;;)
+	{
+		input.Read(reinterpret_cast<uint8_t*>(&nextTag), sizeof(Zmey::Name));
+		if (nextTag == Zmey::Name::NullName())
+		{
+			break;
+		}
+		tags.push_back(nextTag);
+	}
+	for (size_t i = 0u; i < count; ++i)
+	{
+		for (auto tag : tags)
+		{
+			AddTag(entities[i], tag);
+		}
+	}
+}
+
+void TagManager::AddTag(EntityId entity, Zmey::Name tag)
+{
+	if (HasTag(entity, tag))
+	{
+		return;
+	}
+	auto entityIndex = m_Entities.IndexOf(entity);
+	if (entityIndex == arena::sparse_set::InvalidIndex)
+	{
+		entityIndex = m_Entities.Insert(entity);
+		m_FirstLinks.push_back(InvalidLink);
+	}
+	auto& list = m_Lists.try_emplace(tag, m_Allocator).first->second;
+
+	uint32_t link = m_FreeLink;
+	if (link != InvalidLink)
+	{
+		m_FreeLink = m_Links[link].Next;
+	}
+	else
+	{
+		link = uint32_t(m_Links.size());
+		m_Links.emplace_back();
+	}
+	m_Links[link] = TagLink{ tag, uint32_t(list.Entities.size()), m_FirstLinks[entityIndex] };
+	m_FirstLinks[entityIndex] = link;
+	list.Entities.push_back(entity);
+	list.Links.push_back(link);
+}
+
 void TagManager::RemoveEntity(EntityId id)
 {
-	m_Tags.erase(std::remove_if(m_Tags.begin(), m_Tags.end(), [id](const EntityTagPair& pair) {
-		return pair.Entity == id;
-	}), m_Tags.end());
+	const auto entityIndex = m_Entities.Remove(id);
+	if (entityIndex == arena::sparse_set::InvalidIndex)
+	{
+		return;
+	}
+	for (uint32_t link = m_FirstLinks[entityIndex]; link != InvalidLink;)
+	{
+		TagLink& tagLink = m_Links[link];
+		// Move the last entity with the tag in the freed slot
+		auto& list = m_Lists.at(tagLink.Tag);
+		m_Links[list.Links.back()].Slot = tagLink.Slot;
+		SwapAndPop(list.Entities, tagLink.Slot);
+		SwapAndPop(list.Links, tagLink.Slot);
+
+		const uint32_t next = tagLink.Next;
+		tagLink.Next = m_FreeLink;
+		m_FreeLink = link;
+		link = next;
+	}
+	SwapAndPop(m_FirstLinks, entityIndex);
+}
+
+void TagManager::SaveSnapshot(MemoryOutputStream& stream) const
+{
+	m_Entities.Save(stream);
+	WriteArray(stream, m_FirstLinks);
+	WriteArray(stream, m_Links);
+	stream << m_FreeLink;
+	stream << uint64_t(m_Lists.size());
+	for (const auto& list : m_Lists)
+	{
+		stream << uint64_t(list.first);
+		WriteArray(stream, list.second.Entities);
+		WriteArray(stream, list.second.Links);
+	}
+}
+
+void TagManager::RestoreSnapshot(MemoryInputStream& stream)
+{
+	m_Entities.Restore(stream);
+	ReadArray(stream, m_FirstLinks);
+	ReadArray(stream, m_Links);
+	stream >> m_FreeLink;
+	// Tags missing from the snapshot keep their (empty) lists so that their memory gets reused
+	for (auto& list : m_Lists)
+	{
+		list.second.Entities.clear();
+		list.second.Links.clear();
+	}
+	uint64_t listCount;
+	stream >> listCount;
+	for (uint64_t i = 0u; i < listCount; ++i)
+	{
+		Zmey::Name tag;
+		stream >> tag;
+		auto& list = m_Lists.try_emplace(tag, m_Allocator).first->second;
+		ReadArray(stream, list.Entities);
+		ReadArray(stream, list.Links);
+	}
 }
 
 bool TagManager::HasTag(EntityId entity, Zmey::Name tag) const
 {
-	EntityTagPair pair{ entity, tag };
-	return std::find(m_Tags.cbegin(), m_Tags.cend(), pair) != m_Tags.cend();
+	const auto entityIndex = m_Entities.IndexOf(entity);
+	if (entityIndex == arena::sparse_set::InvalidIndex)
+	{
+		return false;
+	}
+	for (uint32_t link = m_FirstLinks[entityIndex]; link != InvalidLink; link = m_Links[link].Next)
+	{
+		if (m_Links[link].Tag == tag)
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 EntityId TagManager::FindFirstByTag(Zmey::Name tag) const
 {
-	auto it = std::find_if(m_Tags.cbegin(), m_Tags.cend(), [tag](const EntityTagPair& pair)
+	auto list = m_Lists.find(tag);
+	if (list != m_Lists.end() && !list->second.Entities.empty())
 	{
-		return pair.Tag == tag;
-	});
-	if (it != m_Tags.cend())
-	{
-		return it->Entity;
+		return list->second.Entities.front();
 	}
 	return Zmey::EntityId::NullEntity();
 }
@@ -82,16 +200,20 @@ EntityId TagManager::FindFirstByTag(Zmey::Name tag) const
 tmp::vector<EntityId> TagManager::FindAllByTag(Zmey::Name tag) const
 {
 	tmp::vector<EntityId> entities;
-	for (auto& pair : m_Tags)
+	entities.reserve(CountByTag(tag));
+	ForEachByTag(tag, [&entities](EntityId entity)
 	{
-		if (pair.Tag == tag)
-		{
-			entities.push_back(pair.Entity);
-		}
-	}
+		entities.push_back(entity);
+	});
 	return entities;
 }
 
+size_t TagManager::CountByTag(Zmey::Name tag) const
+{
+	auto list = m_Lists.find(tag);
+	return list != m_Lists.end() ? list->second.Entities.size() : 0u;
+}
+
 DEFINE_COMPONENT_MANAGER(TagManager, Tag, &Zmey::Components::TagComponentDefaults, &Zmey::Components::TagComponentToBlob);
 
 }
@@ -2,6 +2,8 @@
 #include <Zmey/EntityManager.h>
 #include <Zmey/Components/ComponentRegistryCommon.h>
 #include <Zmey/Components/ComponentManager.h>
+#include <Zmey/Containers/FlatHashMap.h>
+#include <Zmey/Containers/SparseSet.h>
 #include <Zmey/Hash.h>
 
 namespace Zmey
@@ -9,33 +11,75 @@ namespace Zmey
 
 namespace Components
 {
-	
+
+// Keeps a packed array of entities per tag and a list of tags per entity, linked to each other
+// so that tag queries cost O(result) and removing an entity costs O(tags on it).
 class TagManager : public ComponentManager
 {
 	DECLARE_COMPONENT_MANAGER(TagManager);
 public:
 
 	virtual void InitializeFromBlob(const tmp::vector<EntityId>&, Zmey::MemoryInputStream&) override;
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize) override;
 	virtual void Simulate(float deltaTime) override {}
 	virtual void RemoveEntity(EntityId id) override;
+	virtual void SaveSnapshot(MemoryOutputStream& stream) const override;
+	virtual void RestoreSnapshot(MemoryInputStream& stream) override;
 
 	ZMEY_API bool HasTag(EntityId entity, Zmey::Name tag) const;
 	ZMEY_API EntityId FindFirstByTag(Zmey::Name tag) const;
 	ZMEY_API tmp::vector<EntityId> FindAllByTag(Zmey::Name tag) const;
+	ZMEY_API size_t CountByTag(Zmey::Name tag) const;
+	// Calls func(EntityId) for every entity with the tag without allocating.
+	// Tags can't be added or removed from func.
+	template<typename Func>
+	void ForEachByTag(Zmey::Name tag, const Func& func) const;
 
 private:
-	struct EntityTagPair
+	static constexpr uint32_t InvalidLink = ~0u;
+
+	void AddTag(EntityId entity, Zmey::Name tag);
+
+	// Entities are swap-removed, Links[i] is the link of Entities[i]
+	struct TagList
+	{
+		TagList(AllocatorRef allocator)
+			: Entities(allocator)
+			, Links(allocator)
+		{}
+		arena::vector<EntityId> Entities;
+		arena::vector<uint32_t> Links;
+	};
+	// A node of the tag list of an entity, Slot is where the entity is in the TagList of Tag
+	struct TagLink
 	{
-		EntityId Entity;
 		Name Tag;
-		friend bool operator==(const EntityTagPair& lhs, const EntityTagPair& rhs)
-		{
-			return lhs.Entity == rhs.Entity && lhs.Tag == rhs.Tag;
-		}
+		uint32_t Slot;
+		uint32_t Next;
 	};
-	stl::vector<EntityTagPair> m_Tags;
+	// Captures the world's arena as the managers are created with it as the default allocator
+	AllocatorRef m_Allocator;
+	arena::flat_hash_map<Name, TagList> m_Lists;
+	// Entities with at least one tag and the first link of each, removed links go to a free list
+	arena::sparse_set m_Entities;
+	arena::vector<uint32_t> m_FirstLinks;
+	arena::vector<TagLink> m_Links;
+	uint32_t m_FreeLink = InvalidLink;
 };
 
+template<typename Func>
+void TagManager::ForEachByTag(Zmey::Name tag, const Func& func) const
+{
+	auto list = m_Lists.find(tag);
+	if (list == m_Lists.end())
+	{
+		return;
+	}
+	for (EntityId entity : list->second.Entities)
+	{
+		func(entity);
+	}
+}
 
 }
 
@@ -1,85 +1,427 @@
 #include <Zmey/Components/TransformManager.h>
 
+#include <algorithm>
+
 #include <nlohmann/json.hpp>
 
 #include <Zmey/MemoryStream.h>
+#include <Zmey/Modules.h>
 #include <Zmey/Components/ComponentRegistry.h>
+#include <Zmey/Components/EntitySortKeys.h>
+#include <Zmey/Components/ReflectedComponentManager.h>
+#include <Zmey/Job/ParallelFor.h>
+#include <Zmey/Math/BatchMath.h>
 
 namespace Zmey
 {
 namespace Components
 {
+namespace
+{
+constexpr EntityId::IndexType InvalidIndex = arena::sparse_set::InvalidIndex;
+// Below that many entities per batch the jobs cost more than they save
+constexpr uint32_t WorldMatrixBatchSize = 1024u;
+}
+
 TransformInstance TransformManager::Lookup(EntityId id)
 {
-	return TransformInstance(*this, m_EntityToIndex.at(id));
+	const auto index = m_Entities.IndexOf(id);
+	ASSERT_FATAL(index != InvalidIndex);
+	return TransformInstance(*this, index);
 }
 
 void TransformManager::Simulate(float deltaTime)
 {
 }
 
+void TransformManager::LateSimulate()
+{
+	// Whatever changed since the start of the previous step still has that step's world matrix, which is
+	// about to become the previous one. Done before the hierarchy rebuild so both arrays get reordered alike.
+	m_Changes.ForEachChangedSince(m_StepVersions[0], [this](IndexType index)
+	{
+		m_PreviousWorldMatrices[index] = m_WorldMatrices[index];
+	});
+	if (m_HierarchyChanged)
+	{
+		RebuildHierarchy();
+	}
+	UpdateWorldMatrices();
+	m_StepVersions[0] = m_StepVersions[1];
+	m_StepVersions[1] = m_Changes.NextVersion();
+}
+
+void TransformManager::AddRoots()
+{
+	const size_t oldSize = m_WorldMatrices.size();
+	const size_t newSize = m_Positions.size();
+	m_WorldMatrices.resize(newSize);
+	// New entities don't have a previous step to be interpolated from, they appear where they got added
+	m_PreviousWorldMatrices.resize(newSize);
+	if (newSize > oldSize)
+	{
+		BatchMath::ComposeTransforms(&m_Positions[oldSize], &m_Rotations[oldSize], &m_Scales[oldSize], &m_PreviousWorldMatrices[oldSize], newSize - oldSize);
+		std::copy(m_PreviousWorldMatrices.begin() + oldSize, m_PreviousWorldMatrices.end(), m_WorldMatrices.begin() + oldSize);
+	}
+	m_Dirty.resize(newSize, 1u);
+	m_Changes.Resize(newSize);
+	m_Parents.resize(newSize, EntityId::NullEntity());
+	m_ChildCounts.resize(newSize, 0u);
+	m_ParentIndices.resize(newSize, InvalidIndex);
+}
+
+bool TransformManager::IsInHierarchy(IndexType index) const
+{
+	return !(m_Parents[index] == EntityId::NullEntity()) || m_ChildCounts[index] > 0u;
+}
+
 void TransformManager::AddNewEntity(EntityId id, Vector3 pos, Vector3 scale, Quaternion rot)
 {
+	const auto existingIndex = m_Entities.IndexOf(id);
+	if (existingIndex != InvalidIndex)
+	{
+		m_Positions[existingIndex] = pos;
+		m_Scales[existingIndex] = scale;
+		m_Rotations[existingIndex] = rot;
+		m_Dirty[existingIndex] = 1u;
+		m_Changes.MarkChanged(existingIndex);
+		return;
+	}
+	m_Entities.Insert(id);
 	m_Positions.push_back(pos);
 	m_Scales.push_back(scale);
 	m_Rotations.push_back(rot);
-	m_EntityToIndex[id] = unsigned(m_Positions.size() - 1);
+	AddRoots();
+}
+
+void TransformManager::SetParent(EntityId child, EntityId parent)
+{
+	const auto childIndex = m_Entities.IndexOf(child);
+	ASSERT_RETURN(childIndex != InvalidIndex);
+	const EntityId oldParent = m_Parents[childIndex];
+	if (oldParent == parent)
+	{
+		return;
+	}
+
+	IndexType parentIndex = InvalidIndex;
+	if (!(parent == EntityId::NullEntity()))
+	{
+		parentIndex = m_Entities.IndexOf(parent);
+		ASSERT_RETURN(parentIndex != InvalidIndex);
+		// Refuse to make a cycle
+		for (IndexType ancestor = parentIndex; ancestor != InvalidIndex; ancestor = m_Entities.IndexOf(m_Parents[ancestor]))
+		{
+			ASSERT_RETURN(ancestor != childIndex);
+		}
+	}
+
+	if (!(oldParent == EntityId::NullEntity()))
+	{
+		--m_ParentedCount;
+		const auto oldParentIndex = m_Entities.IndexOf(oldParent);
+		if (oldParentIndex != InvalidIndex)
+		{
+			--m_ChildCounts[oldParentIndex];
+		}
+	}
+	if (parentIndex != InvalidIndex)
+	{
+		++m_ParentedCount;
+		++m_ChildCounts[parentIndex];
+	}
+	m_Parents[childIndex] = parent;
+	m_Dirty[childIndex] = 1u;
+	m_Changes.MarkChanged(childIndex);
+	m_HierarchyChanged = true;
+}
+
+EntityId TransformManager::GetParent(EntityId id) const
+{
+	const auto index = m_Entities.IndexOf(id);
+	ASSERT_RETURN_VALUE(index != InvalidIndex, EntityId::NullEntity());
+	// The parent might have been removed and the child not detached yet
+	return m_Entities.Contains(m_Parents[index]) ? m_Parents[index] : EntityId::NullEntity();
+}
+
+const Matrix4x4& TransformManager::GetWorldMatrix(EntityId id) const
+{
+	const auto index = m_Entities.IndexOf(id);
+	ASSERT_FATAL(index != InvalidIndex);
+	return m_WorldMatrices[index];
+}
+
+Matrix4x4 TransformManager::GetInterpolatedWorldMatrix(EntityId id, float alpha) const
+{
+	const auto index = m_Entities.IndexOf(id);
+	ASSERT_FATAL(index != InvalidIndex);
+	return InterpolateTransforms(m_PreviousWorldMatrices[index], m_WorldMatrices[index], alpha);
 }
 
 void TransformManager::RemoveEntity(EntityId id)
 {
-	auto findIt = m_EntityToIndex.find(id);
-	if (findIt != m_EntityToIndex.end())
+	const auto index = m_Entities.IndexOf(id);
+	if (index == InvalidIndex)
 	{
-		// TODO: remove data from entity indexes, or keep some kind of free list for this
-		m_EntityToIndex.erase(findIt);
+		return;
 	}
+	const IndexType lastIndex = IndexType(m_Entities.size() - 1u);
+	// Swapping two plain roots doesn't affect anyone else. Otherwise parent indices
+	// (and likely the depth order) have to be rebuilt. Children of the removed entity get detached then.
+	if (IsInHierarchy(index) || IsInHierarchy(lastIndex) || lastIndex < m_SortedCount)
+	{
+		m_HierarchyChanged = true;
+	}
+	if (!(m_Parents[index] == EntityId::NullEntity()))
+	{
+		--m_ParentedCount;
+		const auto parentIndex = m_Entities.IndexOf(m_Parents[index]);
+		if (parentIndex != InvalidIndex)
+		{
+			--m_ChildCounts[parentIndex];
+		}
+	}
+
+	m_Entities.Remove(id);
+	SwapAndPop(m_Positions, index);
+	SwapAndPop(m_Rotations, index);
+	SwapAndPop(m_Scales, index);
+	SwapAndPop(m_WorldMatrices, index);
+	SwapAndPop(m_PreviousWorldMatrices, index);
+	SwapAndPop(m_Dirty, index);
+	m_Changes.SwapAndPop(index);
+	SwapAndPop(m_Parents, index);
+	SwapAndPop(m_ChildCounts, index);
+	SwapAndPop(m_ParentIndices, index);
 }
 
-void TransformComponentDefaults(IDataBlob& blob)
+void TransformManager::SaveSnapshot(MemoryOutputStream& stream) const
 {
-	float position[3] = { 0.f, 0.f, 0.f };
-	blob.WriteData("position", reinterpret_cast<uint8_t*>(position), sizeof(position));
-	float rotation[4] = { 0.f, 0.f, 0.f, 1.f };
-	blob.WriteData("rotation", reinterpret_cast<uint8_t*>(rotation), sizeof(rotation));
-	float scale[3] = { 1.f, 1.f, 1.f };
-	blob.WriteData("scale", reinterpret_cast<uint8_t*>(scale), sizeof(scale));
+	m_Entities.Save(stream);
+	WriteArray(stream, m_Positions);
+	WriteArray(stream, m_Rotations);
+	WriteArray(stream, m_Scales);
+	WriteArray(stream, m_WorldMatrices);
+	WriteArray(stream, m_Dirty);
+	WriteArray(stream, m_Parents);
+	WriteArray(stream, m_ChildCounts);
+	WriteArray(stream, m_ParentIndices);
+	WriteArray(stream, m_LevelBegin);
+	stream << m_SortedCount << m_ParentedCount << m_HierarchyChanged;
 }
 
-void TransformComponentToBlob(const nlohmann::json& rawJson, IDataBlob& blob)
+void TransformManager::RestoreSnapshot(MemoryInputStream& stream)
 {
-	if (rawJson.find("position") != rawJson.end())
+	m_Entities.Restore(stream);
+	ReadArray(stream, m_Positions);
+	ReadArray(stream, m_Rotations);
+	ReadArray(stream, m_Scales);
+	ReadArray(stream, m_WorldMatrices);
+	ReadArray(stream, m_Dirty);
+	ReadArray(stream, m_Parents);
+	ReadArray(stream, m_ChildCounts);
+	ReadArray(stream, m_ParentIndices);
+	ReadArray(stream, m_LevelBegin);
+	stream >> m_SortedCount >> m_ParentedCount >> m_HierarchyChanged;
+	// Everything might be different as far as the consumers of the changes know
+	m_Changes.Clear();
+	m_Changes.Resize(m_Positions.size());
+	// Jumping to another state isn't something to interpolate over
+	m_PreviousWorldMatrices.assign(m_WorldMatrices.begin(), m_WorldMatrices.end());
+}
+
+bool TransformManager::SortEntities(const EntitySortKeys& keys)
+{
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	const stl::vector<IndexType> order = keys.SortOrder(m_Entities);
+	if (order.empty())
+	{
+		return true;
+	}
+	m_Entities.Reorder(order);
+	Permute(m_Positions, order);
+	Permute(m_Rotations, order);
+	Permute(m_Scales, order);
+	Permute(m_WorldMatrices, order);
+	Permute(m_PreviousWorldMatrices, order);
+	Permute(m_Dirty, order);
+	m_Changes.Permute(order);
+	Permute(m_Parents, order);
+	Permute(m_ChildCounts, order);
+	// The stable sort by depth keeps the new order within each depth
+	if (m_ParentedCount > 0u || m_HierarchyChanged)
+	{
+		RebuildHierarchy();
+	}
+	return true;
+}
+
+void TransformManager::RebuildHierarchy()
+{
+	m_HierarchyChanged = false;
+	const IndexType count = IndexType(m_Entities.size());
+	m_LevelBegin.clear();
+	if (m_ParentedCount == 0u)
+	{
+		// Flat, everything is a root and order doesn't matter
+		m_SortedCount = 0u;
+		std::fill(m_ParentIndices.begin(), m_ParentIndices.end(), InvalidIndex);
+		return;
+	}
+
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	// Resolve parents, children of removed entities become roots
+	for (IndexType i = 0u; i < count; ++i)
+	{
+		m_ParentIndices[i] = InvalidIndex;
+		if (m_Parents[i] == EntityId::NullEntity())
+		{
+			continue;
+		}
+		m_ParentIndices[i] = m_Entities.IndexOf(m_Parents[i]);
+		if (m_ParentIndices[i] == InvalidIndex)
+		{
+			m_Parents[i] = EntityId::NullEntity();
+			m_Dirty[i] = 1u;
+			--m_ParentedCount;
+		}
+	}
+
+	// Depth of every entity, walking up only until an ancestor with known depth
+	constexpr IndexType UnknownDepth = InvalidIndex;
+	tmp::vector<IndexType> depths(count, UnknownDepth);
+	tmp::vector<IndexType> path;
+	IndexType maxDepth = 0u;
+	for (IndexType i = 0u; i < count; ++i)
+	{
+		IndexType current = i;
+		while (depths[current] == UnknownDepth && m_ParentIndices[current] != InvalidIndex)
+		{
+			path.push_back(current);
+			current = m_ParentIndices[current];
+		}
+		IndexType depth = depths[current] == UnknownDepth ? 0u : depths[current];
+		depths[current] = depth;
+		while (!path.empty())
+		{
+			depths[path.back()] = ++depth;
+			path.pop_back();
+		}
+		maxDepth = std::max(maxDepth, depths[i]);
+	}
+
+	// Stable counting sort by depth
+	m_LevelBegin.resize(maxDepth + 2u, 0u);
+	for (IndexType i = 0u; i < count; ++i)
+	{
+		++m_LevelBegin[depths[i] + 1u];
+	}
+	for (IndexType depth = 1u; depth < m_LevelBegin.size(); ++depth)
+	{
+		m_LevelBegin[depth] += m_LevelBegin[depth - 1u];
+	}
+	tmp::vector<IndexType> order(count);
 	{
-		ASSERT_FATAL(rawJson["position"].is_array());
-		float position[3];
-		position[0] = rawJson["position"][0];
-		position[1] = rawJson["position"][1];
-		position[2] = rawJson["position"][2];
-		blob.WriteData("position", reinterpret_cast<uint8_t*>(position), sizeof(position));
+		tmp::vector<IndexType> next(m_LevelBegin.begin(), m_LevelBegin.end() - 1u);
+		for (IndexType i = 0u; i < count; ++i)
+		{
+			order[next[depths[i]]++] = i;
+		}
 	}
 
-	if (rawJson.find("rotation") != rawJson.end())
+	m_Entities.Reorder(order);
+	Permute(m_Positions, order);
+	Permute(m_Rotations, order);
+	Permute(m_Scales, order);
+	Permute(m_WorldMatrices, order);
+	Permute(m_PreviousWorldMatrices, order);
+	Permute(m_Dirty, order);
+	m_Changes.Permute(order);
+	Permute(m_Parents, order);
+	Permute(m_ChildCounts, order);
+	for (IndexType i = 0u; i < count; ++i)
 	{
-		ASSERT_FATAL(rawJson["rotation"].is_array());
-		float rotation[4];
-		rotation[0] = rawJson["rotation"][0];
-		rotation[1] = rawJson["rotation"][1];
-		rotation[2] = rawJson["rotation"][2];
-		rotation[3] = rawJson["rotation"][3];
-		blob.WriteData("rotation", reinterpret_cast<uint8_t*>(rotation), sizeof(rotation));
+		m_ParentIndices[i] = m_Entities.IndexOf(m_Parents[i]);
 	}
+	m_SortedCount = count;
+}
 
-	if (rawJson.find("scale") != rawJson.end())
+void TransformManager::UpdateWorldMatrices()
+{
+	// Calls func(runBegin, runEnd) for each run of consecutive dirty entities in [begin, end)
+	auto forEachDirtyRun = [this](uint32_t begin, uint32_t end, auto func)
+	{
+		for (uint32_t i = begin; i < end;)
+		{
+			if (!m_Dirty[i])
+			{
+				++i;
+				continue;
+			}
+			uint32_t runEnd = i + 1u;
+			while (runEnd < end && m_Dirty[runEnd])
+			{
+				++runEnd;
+			}
+			func(i, runEnd);
+			i = runEnd;
+		}
+	};
+	auto composeLocal = [this](uint32_t begin, uint32_t end)
+	{
+		BatchMath::ComposeTransforms(&m_Positions[begin], &m_Rotations[begin], &m_Scales[begin], &m_WorldMatrices[begin], end - begin);
+		// Also covers children that changed only because a parent did
+		m_Changes.MarkChanged(begin, end);
+	};
+	auto updateRoots = [&](uint32_t begin, uint32_t end)
+	{
+		forEachDirtyRun(begin, end, composeLocal);
+	};
+	// A child is updated if it changed itself or its parent got updated, which leaves the parent's flag set
+	auto updateChildren = [&](uint32_t begin, uint32_t end)
 	{
-		ASSERT_FATAL(rawJson["scale"].is_array());
-		float scale[3];
-		scale[0] = rawJson["scale"][0];
-		scale[1] = rawJson["scale"][1];
-		scale[2] = rawJson["scale"][2];
-		blob.WriteData("scale", reinterpret_cast<uint8_t*>(scale), sizeof(scale));
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			m_Dirty[i] |= m_Dirty[m_ParentIndices[i]];
+		}
+		forEachDirtyRun(begin, end, [this, &composeLocal](uint32_t runBegin, uint32_t runEnd)
+		{
+			composeLocal(runBegin, runEnd);
+			// Parents are scattered, copy them next to each other for the batch multiplication
+			constexpr uint32_t ChunkSize = 64u;
+			Matrix4x4 parents[ChunkSize];
+			for (uint32_t chunkBegin = runBegin; chunkBegin < runEnd; chunkBegin += ChunkSize)
+			{
+				const uint32_t chunkSize = std::min(ChunkSize, runEnd - chunkBegin);
+				for (uint32_t i = 0u; i < chunkSize; ++i)
+				{
+					parents[i] = m_WorldMatrices[m_ParentIndices[chunkBegin + i]];
+				}
+				BatchMath::MultiplyMatrices(parents, &m_WorldMatrices[chunkBegin], &m_WorldMatrices[chunkBegin], chunkSize);
+			}
+		});
+	};
+
+	const IndexType count = IndexType(m_Entities.size());
+	const IndexType sortedRoots = m_LevelBegin.size() > 1u ? m_LevelBegin[1] : 0u;
+	Job::ParallelFor(Modules.JobSystem, "Transform Roots", 0u, sortedRoots, WorldMatrixBatchSize, updateRoots);
+	Job::ParallelFor(Modules.JobSystem, "Transform Roots", m_SortedCount, count, WorldMatrixBatchSize, updateRoots);
+	// Each level only depends on the ones before it
+	for (size_t depth = 1u; depth + 1u < m_LevelBegin.size(); ++depth)
+	{
+		Job::ParallelFor(Modules.JobSystem, "Transform Children", m_LevelBegin[depth], m_LevelBegin[depth + 1u], WorldMatrixBatchSize, updateChildren);
 	}
+	std::fill(m_Dirty.begin(), m_Dirty.end(), uint8_t(0u));
 }
 
+// Written in the order InitializeFromBlob reads them
+#define TRANSFORM_FIELDS(FIELD) \
+	FIELD(Vector3, Position, "position", 0.f) \
+	FIELD(Quaternion, Rotation, "rotation", 1.f, 0.f, 0.f, 0.f) \
+	FIELD(Vector3, Scale, "scale", 1.f)
+
+DEFINE_REFLECTED_BLOB_FUNCTIONS(TransformComponentDefaults, TransformComponentToBlob, TRANSFORM_FIELDS);
+
 void TransformManager::InitializeFromBlob(const tmp::vector<EntityId>& entities, Zmey::MemoryInputStream& stream)
 {
 	EntityId::IndexType currentEntities = static_cast<EntityId::IndexType>(m_Positions.size());
@@ -95,11 +437,34 @@ void TransformManager::InitializeFromBlob(const tmp::vector<EntityId>& entities,
 	size_t scaleBufferLength = sizeof(Vector3) * entities.size();
 	stream.Read(reinterpret_cast<uint8_t*>(&m_Scales[currentEntities]), scaleBufferLength);
 
-	// Fill the entity map
-	for (EntityId::IndexType i = 0u; i < entities.size(); ++i)
+	// The data was read in the same order the entities get inserted
+	m_Entities.reserve(currentEntities + entities.size());
+	for (EntityId id : entities)
+	{
+		m_Entities.Insert(id);
+	}
+	AddRoots();
+}
+
+void TransformManager::InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize)
+{
+	Zmey::MemoryInputStream stream(blob, blobSize);
+	Vector3 position;
+	Quaternion rotation;
+	Vector3 scale;
+	stream.Read(reinterpret_cast<uint8_t*>(&position), sizeof(position));
+	stream.Read(reinterpret_cast<uint8_t*>(&rotation), sizeof(rotation));
+	stream.Read(reinterpret_cast<uint8_t*>(&scale), sizeof(scale));
+
+	const size_t newSize = m_Positions.size() + count;
+	m_Positions.resize(newSize, position);
+	m_Rotations.resize(newSize, rotation);
+	m_Scales.resize(newSize, scale);
+	for (size_t i = 0u; i < count; ++i)
 	{
-		m_EntityToIndex[entities[i]] = currentEntities + i;
+		m_Entities.Insert(entities[i]);
 	}
+	AddRoots();
 }
 
 DEFINE_COMPONENT_MANAGER_WITH_PRIORITY(TransformManager, Transform, &Zmey::Components::TransformComponentDefaults, &Zmey::Components::TransformComponentToBlob, 1);
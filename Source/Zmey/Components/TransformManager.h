@@ -1,6 +1,8 @@
 #pragma once
 #include <Zmey/Math/Math.h>
+#include <Zmey/Containers/SparseSet.h>
 #include <Zmey/EntityManager.h>
+#include <Zmey/Components/ChangeTracker.h>
 #include <Zmey/Components/ComponentRegistryCommon.h>
 #include <Zmey/Components/ComponentManager.h>
 
@@ -9,27 +11,89 @@ namespace Zmey
 
 namespace Components
 {
-	
+
+// Position, rotation and scale are local - relative to the parent if the entity has one.
+// World matrices are cached and recomputed in LateSimulate, only for entities whose local transform
+// or some ancestor's changed since.
 class TransformManager : public ComponentManager
 {
 	DECLARE_COMPONENT_MANAGER(TransformManager);
 public:
 
 	ZMEY_API struct TransformInstance Lookup(EntityId);
+	// Data of the entity at the given index of the entity set, see Query
+	inline struct TransformInstance InstanceAt(EntityId::IndexType index);
+	inline const arena::sparse_set& GetEntitySet() const
+	{
+		return m_Entities;
+	}
 
 	ZMEY_API void AddNewEntity(EntityId id, Vector3 pos, Vector3 scale, Quaternion rot);
+	// Attaches child to parent, the local transform of the child stays the same.
+	// Pass EntityId::NullEntity() to detach. Removing a parent detaches its children.
+	ZMEY_API void SetParent(EntityId child, EntityId parent);
+	ZMEY_API EntityId GetParent(EntityId id) const;
+	// As of the last LateSimulate
+	ZMEY_API const Matrix4x4& GetWorldMatrix(EntityId id) const;
+	inline const Matrix4x4& WorldMatrixAt(EntityId::IndexType index) const
+	{
+		return m_WorldMatrices[index];
+	}
+	// Between the world matrix of the LateSimulate before the last one (alpha 0) and the last one (alpha 1),
+	// for rendering in between two simulation steps
+	ZMEY_API Matrix4x4 GetInterpolatedWorldMatrix(EntityId id, float alpha) const;
+	// Indices of the entity set whose local transform got written or whose world matrix got recomputed
+	inline ChangeTracker& GetChanges()
+	{
+		return m_Changes;
+	}
+
 	virtual void InitializeFromBlob(const tmp::vector<EntityId>&, Zmey::MemoryInputStream&) override;
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize) override;
 	virtual void Simulate(float deltaTime) override;
+	virtual void LateSimulate() override;
 	virtual void RemoveEntity(EntityId id) override;
+	virtual void SaveSnapshot(MemoryOutputStream& stream) const override;
+	virtual void RestoreSnapshot(MemoryInputStream& stream) override;
+	// Parents still precede their children afterwards, entities get sorted within each depth
+	virtual bool SortEntities(const EntitySortKeys& keys) override;
 private:
+	using IndexType = EntityId::IndexType;
+	// Grows the hierarchy data to match the transforms, the new entities are roots
+	void AddRoots();
+	bool IsInHierarchy(IndexType index) const;
+	void RebuildHierarchy();
+	void UpdateWorldMatrices();
+
+	// Packed, in the order of m_Entities. Removing an entity moves the last one in its place.
 	// TODO: Store all 3 vectors in sequential memory
-	stl::vector<Vector3> m_Positions;
-	stl::vector<Quaternion> m_Rotations;
-	stl::vector<Vector3> m_Scales;
-	stl::unordered_map<EntityId, EntityId::IndexType> m_EntityToIndex;
+	arena::vector<Vector3> m_Positions;
+	arena::vector<Quaternion> m_Rotations;
+	arena::vector<Vector3> m_Scales;
+	arena::vector<Matrix4x4> m_WorldMatrices;
+	// The world matrices one LateSimulate earlier. Only the entities changed during the last two steps
+	// get copied over, the rest already match.
+	arena::vector<Matrix4x4> m_PreviousWorldMatrices;
+	// Taken at the end of the last two LateSimulates, the older one first
+	ChangeTracker::VersionType m_StepVersions[2] = { 0u, 0u };
+	// Set when the local transform changes, cleared once the world matrix is recomputed
+	arena::vector<uint8_t> m_Dirty;
+	ChangeTracker m_Changes;
+	arena::vector<EntityId> m_Parents;
+	arena::vector<uint32_t> m_ChildCounts;
+	arena::sparse_set m_Entities;
+
+	// Built by RebuildHierarchy, which sorts the first m_SortedCount entities by depth so parents precede children.
+	// Depth d takes [m_LevelBegin[d], m_LevelBegin[d + 1]). Entities added afterwards are all roots.
+	arena::vector<IndexType> m_ParentIndices;
+	arena::vector<IndexType> m_LevelBegin;
+	IndexType m_SortedCount = 0u;
+	uint32_t m_ParentedCount = 0u;
+	bool m_HierarchyChanged = false;
 	friend struct TransformInstance;
 };
 
+// Valid until an entity gets removed from the manager, don't hold on to it
 struct TransformInstance
 {
 	inline TransformInstance(TransformManager& manager, EntityId::IndexType index)
@@ -37,14 +101,34 @@ struct TransformInstance
 		, m_EntityIndex(index)
 	{
 	}
-	inline Vector3& Position() const { return m_Manager.m_Positions[m_EntityIndex]; }
-	inline Vector3& Scale() const { return m_Manager.m_Scales[m_EntityIndex]; }
-	inline Quaternion& Rotation() const { return m_Manager.m_Rotations[m_EntityIndex]; }
+	// The references may be written to, so accessing them marks the transform as changed and the world matrix for update
+	inline Vector3& Position() const { MarkChanged(); return m_Manager.m_Positions[m_EntityIndex]; }
+	inline Vector3& Scale() const { MarkChanged(); return m_Manager.m_Scales[m_EntityIndex]; }
+	inline Quaternion& Rotation() const { MarkChanged(); return m_Manager.m_Rotations[m_EntityIndex]; }
+	// Read only access, leaves the change tracking alone
+	inline const Vector3& GetPosition() const { return m_Manager.m_Positions[m_EntityIndex]; }
+	inline const Vector3& GetScale() const { return m_Manager.m_Scales[m_EntityIndex]; }
+	inline const Quaternion& GetRotation() const { return m_Manager.m_Rotations[m_EntityIndex]; }
+	inline const Matrix4x4& WorldMatrix() const { return m_Manager.m_WorldMatrices[m_EntityIndex]; }
+	inline Matrix4x4 InterpolatedWorldMatrix(float alpha) const
+	{
+		return InterpolateTransforms(m_Manager.m_PreviousWorldMatrices[m_EntityIndex], m_Manager.m_WorldMatrices[m_EntityIndex], alpha);
+	}
 private:
+	inline void MarkChanged() const
+	{
+		m_Manager.m_Dirty[m_EntityIndex] = 1u;
+		m_Manager.m_Changes.MarkChanged(m_EntityIndex);
+	}
 	TransformManager& m_Manager;
 	EntityId::IndexType m_EntityIndex;
 };
 
+inline TransformInstance TransformManager::InstanceAt(EntityId::IndexType index)
+{
+	return TransformInstance(*this, index);
+}
+
 }
 
 }
\ No newline at end of file
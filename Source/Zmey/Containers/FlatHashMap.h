@@ -0,0 +1,663 @@
+#pragma once
+#include <cstring>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <Zmey/Config.h>
+#include <Zmey/Logging.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define ZMEY_FLAT_HASH_SSE2 1
+	#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace Zmey
+{
+// Open-addressing hash table in the spirit of SwissTable.
+// Slots live in one flat array next to a control byte array. Each control byte is either
+// Empty, Deleted or the low 7 bits of the hash of the key stored in the slot, so a lookup
+// compares 16 control bytes at once and touches the slots only for likely matches.
+// Memory comes from AllocatorImpl (same contract as StlAllocatorTemplate), slots move on rehash.
+namespace FlatHashDetail
+{
+using ControlByte = int8_t;
+constexpr ControlByte Empty = -128;
+constexpr ControlByte Deleted = -2;
+constexpr size_t GroupWidth = 16;
+constexpr size_t MinCapacity = GroupWidth;
+
+inline unsigned CountTrailingZeros(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return unsigned(index);
+#else
+	return unsigned(__builtin_ctz(mask));
+#endif
+}
+
+// std::hash of integers (and thus of EntityId, Hash and all the graphics handles) is the identity
+// which would put every key in the same group, so spread the bits before splitting the hash
+inline uint64_t MixHash(size_t hash)
+{
+	uint64_t mixed = uint64_t(hash) * 0x9E3779B97F4A7C15ull;
+	return mixed ^ (mixed >> 32);
+}
+inline size_t H1(uint64_t hash)
+{
+	return size_t(hash >> 7);
+}
+inline ControlByte H2(uint64_t hash)
+{
+	return ControlByte(hash & 0x7F);
+}
+inline bool IsFull(ControlByte ctrl)
+{
+	return ctrl >= 0;
+}
+
+// 16 control bytes inspected together. Each query returns a bitmask with bit i set if byte i matches.
+struct Group
+{
+#if defined(ZMEY_FLAT_HASH_SSE2)
+	explicit Group(const ControlByte* ctrl)
+		: Ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)))
+	{}
+	inline uint32_t Match(ControlByte h2) const
+	{
+		return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), Ctrl)));
+	}
+	inline uint32_t MatchEmpty() const
+	{
+		return Match(Empty);
+	}
+	inline uint32_t MatchEmptyOrDeleted() const
+	{
+		// Both Empty and Deleted are negative and smaller than -1, full slots are positive
+		return uint32_t(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), Ctrl)));
+	}
+	__m128i Ctrl;
+#else
+	explicit Group(const ControlByte* ctrl)
+	{
+		std::memcpy(Ctrl, ctrl, GroupWidth);
+	}
+	inline uint32_t Match(ControlByte h2) const
+	{
+		uint32_t mask = 0u;
+		for (unsigned i = 0u; i < GroupWidth; ++i)
+		{
+			mask |= uint32_t(Ctrl[i] == h2) << i;
+		}
+		return mask;
+	}
+	inline uint32_t MatchEmpty() const
+	{
+		return Match(Empty);
+	}
+	inline uint32_t MatchEmptyOrDeleted() const
+	{
+		uint32_t mask = 0u;
+		for (unsigned i = 0u; i < GroupWidth; ++i)
+		{
+			mask |= uint32_t(Ctrl[i] < -1) << i;
+		}
+		return mask;
+	}
+	ControlByte Ctrl[GroupWidth];
+#endif
+};
+
+template<typename K, typename V>
+struct MapPolicy
+{
+	using SlotType = std::pair<K, V>;
+	static inline const K& KeyOf(const SlotType& slot)
+	{
+		return slot.first;
+	}
+};
+
+template<typename K>
+struct SetPolicy
+{
+	using SlotType = K;
+	static inline const K& KeyOf(const SlotType& slot)
+	{
+		return slot;
+	}
+};
+}
+
+template<typename Key, typename Policy, typename Hasher, typename KeyEqual, typename AllocatorImpl>
+class FlatHashTable
+{
+public:
+	using key_type = Key;
+	using value_type = typename Policy::SlotType;
+	using size_type = size_t;
+	using hasher = Hasher;
+	using key_equal = KeyEqual;
+
+	template<bool IsConst>
+	class IteratorTemplate
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = typename Policy::SlotType;
+		using difference_type = std::ptrdiff_t;
+		using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+		using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+
+		IteratorTemplate()
+			: m_Ctrl(nullptr)
+			, m_CtrlEnd(nullptr)
+			, m_Slot(nullptr)
+		{}
+		// Allow iterator -> const_iterator
+		template<bool OtherIsConst, typename = std::enable_if_t<IsConst || !OtherIsConst>>
+		IteratorTemplate(const IteratorTemplate<OtherIsConst>& other)
+			: m_Ctrl(other.m_Ctrl)
+			, m_CtrlEnd(other.m_CtrlEnd)
+			, m_Slot(other.m_Slot)
+		{}
+
+		inline reference operator*() const { return *m_Slot; }
+		inline pointer operator->() const { return m_Slot; }
+		inline IteratorTemplate& operator++()
+		{
+			++m_Ctrl;
+			++m_Slot;
+			SkipEmptySlots();
+			return *this;
+		}
+		inline IteratorTemplate operator++(int)
+		{
+			auto copy = *this;
+			++*this;
+			return copy;
+		}
+		template<bool OtherIsConst>
+		inline bool operator==(const IteratorTemplate<OtherIsConst>& other) const
+		{
+			return m_Ctrl == other.m_Ctrl;
+		}
+		template<bool OtherIsConst>
+		inline bool operator!=(const IteratorTemplate<OtherIsConst>& other) const
+		{
+			return m_Ctrl != other.m_Ctrl;
+		}
+	private:
+		IteratorTemplate(const FlatHashDetail::ControlByte* ctrl, const FlatHashDetail::ControlByte* ctrlEnd, pointer slot)
+			: m_Ctrl(ctrl)
+			, m_CtrlEnd(ctrlEnd)
+			, m_Slot(slot)
+		{
+			SkipEmptySlots();
+		}
+		inline void SkipEmptySlots()
+		{
+			while (m_Ctrl != m_CtrlEnd && !FlatHashDetail::IsFull(*m_Ctrl))
+			{
+				++m_Ctrl;
+				++m_Slot;
+			}
+		}
+		const FlatHashDetail::ControlByte* m_Ctrl;
+		const FlatHashDetail::ControlByte* m_CtrlEnd;
+		pointer m_Slot;
+
+		template<bool> friend class IteratorTemplate;
+		friend class FlatHashTable;
+	};
+	using iterator = IteratorTemplate<false>;
+	using const_iterator = IteratorTemplate<true>;
+
+	FlatHashTable()
+		: m_Ctrl(nullptr)
+		, m_Slots(nullptr)
+		, m_Capacity(0u)
+		, m_Size(0u)
+		, m_GrowthLeft(0u)
+	{
+		m_Allocator.Initialize();
+	}
+	FlatHashTable(const FlatHashTable& other)
+		: FlatHashTable()
+	{
+		CopyFrom(other);
+	}
+	FlatHashTable(FlatHashTable&& other)
+		: FlatHashTable()
+	{
+		Swap(other);
+	}
+	FlatHashTable& operator=(const FlatHashTable& other)
+	{
+		if (this != &other)
+		{
+			DestroyAndFree();
+			CopyFrom(other);
+		}
+		return *this;
+	}
+	FlatHashTable& operator=(FlatHashTable&& other)
+	{
+		if (this != &other)
+		{
+			DestroyAndFree();
+			Swap(other);
+		}
+		return *this;
+	}
+	~FlatHashTable()
+	{
+		DestroyAndFree();
+	}
+
+	inline iterator begin()
+	{
+		return iterator(m_Ctrl, m_Ctrl + m_Capacity, m_Slots);
+	}
+	inline iterator end()
+	{
+		return iterator(m_Ctrl + m_Capacity, m_Ctrl + m_Capacity, m_Slots + m_Capacity);
+	}
+	inline const_iterator begin() const
+	{
+		return const_iterator(m_Ctrl, m_Ctrl + m_Capacity, m_Slots);
+	}
+	inline const_iterator end() const
+	{
+		return const_iterator(m_Ctrl + m_Capacity, m_Ctrl + m_Capacity, m_Slots + m_Capacity);
+	}
+	inline const_iterator cbegin() const { return begin(); }
+	inline const_iterator cend() const { return end(); }
+
+	inline size_t size() const { return m_Size; }
+	inline bool empty() const { return m_Size == 0u; }
+	inline size_t capacity() const { return m_Capacity; }
+
+	inline iterator find(const Key& key)
+	{
+		size_t index = FindIndex(key);
+		return index == NotFound ? end() : IteratorAt(index);
+	}
+	inline const_iterator find(const Key& key) const
+	{
+		size_t index = FindIndex(key);
+		return index == NotFound ? end() : IteratorAt(index);
+	}
+	inline bool contains(const Key& key) const
+	{
+		return FindIndex(key) != NotFound;
+	}
+	inline size_t count(const Key& key) const
+	{
+		return contains(key) ? 1u : 0u;
+	}
+
+	template<typename... Args>
+	std::pair<iterator, bool> emplace_key(const Key& key, Args&&... args)
+	{
+		const uint64_t hash = HashKey(key);
+		size_t index = FindIndex(key, hash);
+		if (index != NotFound)
+		{
+			return std::make_pair(IteratorAt(index), false);
+		}
+		if (m_GrowthLeft == 0u)
+		{
+			Grow();
+		}
+		index = FindInsertIndex(hash);
+		m_GrowthLeft -= (m_Ctrl[index] == FlatHashDetail::Empty);
+		SetCtrl(index, FlatHashDetail::H2(hash));
+		new (m_Slots + index) value_type(std::forward<Args>(args)...);
+		++m_Size;
+		return std::make_pair(IteratorAt(index), true);
+	}
+
+	size_t erase(const Key& key)
+	{
+		size_t index = FindIndex(key);
+		if (index == NotFound)
+		{
+			return 0u;
+		}
+		EraseAt(index);
+		return 1u;
+	}
+	iterator erase(const_iterator it)
+	{
+		const size_t index = size_t(it.m_Ctrl - m_Ctrl);
+		EraseAt(index);
+		iterator next(m_Ctrl + index, m_Ctrl + m_Capacity, m_Slots + index);
+		return next;
+	}
+
+	void clear()
+	{
+		for (size_t i = 0u; i < m_Capacity; ++i)
+		{
+			if (FlatHashDetail::IsFull(m_Ctrl[i]))
+			{
+				m_Slots[i].~value_type();
+			}
+		}
+		if (m_Capacity)
+		{
+			std::memset(m_Ctrl, FlatHashDetail::Empty, m_Capacity + FlatHashDetail::GroupWidth);
+		}
+		m_Size = 0u;
+		m_GrowthLeft = MaxLoad(m_Capacity);
+	}
+
+	// Makes sure that `count` elements fit without rehashing
+	void reserve(size_t count)
+	{
+		size_t capacity = FlatHashDetail::MinCapacity;
+		while (MaxLoad(capacity) < count)
+		{
+			capacity *= 2u;
+		}
+		if (capacity > m_Capacity)
+		{
+			Rehash(capacity);
+		}
+	}
+
+	void swap(FlatHashTable& other)
+	{
+		Swap(other);
+	}
+
+protected:
+	static const size_t NotFound = size_t(-1);
+
+	static inline uint64_t HashKey(const Key& key)
+	{
+		return FlatHashDetail::MixHash(Hasher()(key));
+	}
+	// Keep the load factor under 7/8
+	static inline size_t MaxLoad(size_t capacity)
+	{
+		return capacity - capacity / 8u;
+	}
+
+	inline iterator IteratorAt(size_t index)
+	{
+		return iterator(m_Ctrl + index, m_Ctrl + m_Capacity, m_Slots + index);
+	}
+	inline const_iterator IteratorAt(size_t index) const
+	{
+		return const_iterator(m_Ctrl + index, m_Ctrl + m_Capacity, m_Slots + index);
+	}
+
+	inline size_t FindIndex(const Key& key) const
+	{
+		return FindIndex(key, HashKey(key));
+	}
+	size_t FindIndex(const Key& key, uint64_t hash) const
+	{
+		if (m_Capacity == 0u)
+		{
+			return NotFound;
+		}
+		const size_t mask = m_Capacity - 1u;
+		const FlatHashDetail::ControlByte h2 = FlatHashDetail::H2(hash);
+		size_t position = FlatHashDetail::H1(hash) & mask;
+		size_t step = 0u;
+		for (;;)
+		{
+			FlatHashDetail::Group group(m_Ctrl + position);
+			for (uint32_t matches = group.Match(h2); matches; matches &= matches - 1u)
+			{
+				const size_t index = (position + FlatHashDetail::CountTrailingZeros(matches)) & mask;
+				if (KeyEqual()(Policy::KeyOf(m_Slots[index]), key))
+				{
+					return index;
+				}
+			}
+			if (group.MatchEmpty())
+			{
+				return NotFound;
+			}
+			// Triangular probing visits every group of a power of 2 table
+			step += FlatHashDetail::GroupWidth;
+			position = (position + step) & mask;
+		}
+	}
+
+	size_t FindInsertIndex(uint64_t hash) const
+	{
+		const size_t mask = m_Capacity - 1u;
+		size_t position = FlatHashDetail::H1(hash) & mask;
+		size_t step = 0u;
+		for (;;)
+		{
+			FlatHashDetail::Group group(m_Ctrl + position);
+			const uint32_t free = group.MatchEmptyOrDeleted();
+			if (free)
+			{
+				return (position + FlatHashDetail::CountTrailingZeros(free)) & mask;
+			}
+			step += FlatHashDetail::GroupWidth;
+			position = (position + step) & mask;
+		}
+	}
+
+	inline void SetCtrl(size_t index, FlatHashDetail::ControlByte value)
+	{
+		m_Ctrl[index] = value;
+		// The first group is mirrored after the end so that groups can be loaded without wrapping around
+		if (index < FlatHashDetail::GroupWidth)
+		{
+			m_Ctrl[m_Capacity + index] = value;
+		}
+	}
+
+	void EraseAt(size_t index)
+	{
+		m_Slots[index].~value_type();
+		// Leave a tombstone so probe chains passing through this slot stay intact.
+		// Tombstones are reused by inserts and dropped on rehash
+		SetCtrl(index, FlatHashDetail::Deleted);
+		--m_Size;
+	}
+
+	void Grow()
+	{
+		if (m_Capacity == 0u)
+		{
+			Rehash(FlatHashDetail::MinCapacity);
+		}
+		else if (m_Size <= MaxLoad(m_Capacity) / 2u)
+		{
+			// Mostly tombstones, clean them up without growing
+			Rehash(m_Capacity);
+		}
+		else
+		{
+			Rehash(m_Capacity * 2u);
+		}
+	}
+
+	void Allocate(size_t capacity)
+	{
+		const size_t slotsSize = sizeof(value_type) * capacity;
+		void* memory = m_Allocator.Malloc(slotsSize + capacity + FlatHashDetail::GroupWidth, unsigned(alignof(value_type)));
+		m_Slots = reinterpret_cast<value_type*>(memory);
+		m_Ctrl = reinterpret_cast<FlatHashDetail::ControlByte*>(static_cast<uint8_t*>(memory) + slotsSize);
+		std::memset(m_Ctrl, FlatHashDetail::Empty, capacity + FlatHashDetail::GroupWidth);
+		m_Capacity = capacity;
+		m_GrowthLeft = MaxLoad(capacity);
+	}
+
+	void Rehash(size_t newCapacity)
+	{
+		FlatHashDetail::ControlByte* oldCtrl = m_Ctrl;
+		value_type* oldSlots = m_Slots;
+		const size_t oldCapacity = m_Capacity;
+
+		Allocate(newCapacity);
+		for (size_t i = 0u; i < oldCapacity; ++i)
+		{
+			if (FlatHashDetail::IsFull(oldCtrl[i]))
+			{
+				const uint64_t hash = HashKey(Policy::KeyOf(oldSlots[i]));
+				const size_t index = FindInsertIndex(hash);
+				SetCtrl(index, FlatHashDetail::H2(hash));
+				new (m_Slots + index) value_type(std::move(oldSlots[i]));
+				oldSlots[i].~value_type();
+			}
+		}
+		m_GrowthLeft -= m_Size;
+		if (oldSlots)
+		{
+			m_Allocator.Free(oldSlots);
+		}
+	}
+
+	void CopyFrom(const FlatHashTable& other)
+	{
+		if (other.m_Capacity == 0u)
+		{
+			return;
+		}
+		Allocate(other.m_Capacity);
+		std::memcpy(m_Ctrl, other.m_Ctrl, m_Capacity + FlatHashDetail::GroupWidth);
+		for (size_t i = 0u; i < m_Capacity; ++i)
+		{
+			if (FlatHashDetail::IsFull(m_Ctrl[i]))
+			{
+				new (m_Slots + i) value_type(other.m_Slots[i]);
+			}
+		}
+		m_Size = other.m_Size;
+		m_GrowthLeft = other.m_GrowthLeft;
+	}
+
+	void DestroyAndFree()
+	{
+		if (m_Capacity == 0u)
+		{
+			return;
+		}
+		clear();
+		m_Allocator.Free(m_Slots);
+		m_Ctrl = nullptr;
+		m_Slots = nullptr;
+		m_Capacity = 0u;
+		m_GrowthLeft = 0u;
+	}
+
+	void Swap(FlatHashTable& other)
+	{
+		std::swap(m_Ctrl, other.m_Ctrl);
+		std::swap(m_Slots, other.m_Slots);
+		std::swap(m_Capacity, other.m_Capacity);
+		std::swap(m_Size, other.m_Size);
+		std::swap(m_GrowthLeft, other.m_GrowthLeft);
+		std::swap(m_Allocator, other.m_Allocator);
+	}
+
+	FlatHashDetail::ControlByte* m_Ctrl;
+	value_type* m_Slots;
+	size_t m_Capacity;
+	size_t m_Size;
+	size_t m_GrowthLeft;
+	AllocatorImpl m_Allocator;
+};
+
+// Drop-in replacement for stl::unordered_map on hot paths.
+// Differences: references and iterators are invalidated by any insertion, and the stored
+// key is not const - don't modify it through an iterator.
+template<typename K, typename V, typename Hasher = std::hash<K>, typename KeyEqual = std::equal_to<K>, typename AllocatorImpl = DefaultAllocator>
+class FlatHashMap : public FlatHashTable<K, FlatHashDetail::MapPolicy<K, V>, Hasher, KeyEqual, AllocatorImpl>
+{
+	using Base = FlatHashTable<K, FlatHashDetail::MapPolicy<K, V>, Hasher, KeyEqual, AllocatorImpl>;
+public:
+	using mapped_type = V;
+	using typename Base::iterator;
+	using typename Base::const_iterator;
+	using typename Base::value_type;
+
+	template<typename... Args>
+	inline std::pair<iterator, bool> try_emplace(const K& key, Args&&... args)
+	{
+		return this->emplace_key(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+	}
+	inline std::pair<iterator, bool> insert(const value_type& value)
+	{
+		return this->emplace_key(value.first, value);
+	}
+	inline std::pair<iterator, bool> insert(value_type&& value)
+	{
+		const K key = value.first;
+		return this->emplace_key(key, std::move(value));
+	}
+	template<typename M>
+	inline std::pair<iterator, bool> insert_or_assign(const K& key, M&& value)
+	{
+		auto result = try_emplace(key, std::forward<M>(value));
+		if (!result.second)
+		{
+			result.first->second = std::forward<M>(value);
+		}
+		return result;
+	}
+	inline V& operator[](const K& key)
+	{
+		return try_emplace(key).first->second;
+	}
+	inline V& at(const K& key)
+	{
+		auto it = this->find(key);
+		ASSERT_FATAL(it != this->end());
+		return it->second;
+	}
+	inline const V& at(const K& key) const
+	{
+		auto it = this->find(key);
+		ASSERT_FATAL(it != this->end());
+		return it->second;
+	}
+};
+
+template<typename K, typename Hasher = std::hash<K>, typename KeyEqual = std::equal_to<K>, typename AllocatorImpl = DefaultAllocator>
+class FlatHashSet : public FlatHashTable<K, FlatHashDetail::SetPolicy<K>, Hasher, KeyEqual, AllocatorImpl>
+{
+	using Base = FlatHashTable<K, FlatHashDetail::SetPolicy<K>, Hasher, KeyEqual, AllocatorImpl>;
+public:
+	using typename Base::iterator;
+	inline std::pair<iterator, bool> insert(const K& key)
+	{
+		return this->emplace_key(key, key);
+	}
+};
+
+namespace stl
+{
+	template<typename K, typename V>
+	using flat_hash_map = FlatHashMap<K, V, std::hash<K>, std::equal_to<K>, DefaultAllocator>;
+	template<typename K>
+	using flat_hash_set = FlatHashSet<K, std::hash<K>, std::equal_to<K>, DefaultAllocator>;
+}
+// Bound to the default allocator at the time of construction, see ScopedDefaultAllocator
+namespace arena
+{
+	template<typename K, typename V>
+	using flat_hash_map = FlatHashMap<K, V, std::hash<K>, std::equal_to<K>, AllocatorRef>;
+	template<typename K>
+	using flat_hash_set = FlatHashSet<K, std::hash<K>, std::equal_to<K>, AllocatorRef>;
+}
+
+}
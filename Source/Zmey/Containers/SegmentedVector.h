@@ -0,0 +1,340 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <Zmey/Config.h>
+#include <Zmey/Logging.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace Zmey
+{
+// Append-only vector that can be pushed to from many threads at once.
+// Storage is split in segments that double in size (64, 128, 256...). A segment is allocated
+// lazily by whichever thread first needs it and never moves afterwards, so element addresses
+// stay valid while other threads keep appending.
+// Erasing only marks the element as dead (a tombstone) - readers that already hold a pointer to it
+// can keep using it. The dead elements are destroyed and the live ones packed together by compact(),
+// which must be called at a sync point when no other thread touches the container.
+namespace SegmentedDetail
+{
+constexpr uint32_t FirstSegmentBits = 6u;
+constexpr uint32_t FirstSegmentSize = 1u << FirstSegmentBits;
+// 64 << 26 elements is way more than a 32 bit index can address anyway
+constexpr uint32_t MaxSegments = 32u - FirstSegmentBits;
+
+inline uint32_t HighestBit(uint32_t value)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return uint32_t(index);
+#else
+	return 31u - uint32_t(__builtin_clz(value));
+#endif
+}
+
+inline uint32_t SegmentOf(uint32_t index)
+{
+	return HighestBit(index + FirstSegmentSize) - FirstSegmentBits;
+}
+
+inline uint32_t SegmentStart(uint32_t segment)
+{
+	return (FirstSegmentSize << segment) - FirstSegmentSize;
+}
+
+inline uint32_t SegmentSize(uint32_t segment)
+{
+	return FirstSegmentSize << segment;
+}
+
+enum SlotState : uint8_t
+{
+	Empty, // Not yet constructed or already compacted away
+	Alive,
+	Dead
+};
+}
+
+template<typename T, typename AllocatorImpl = DefaultAllocator>
+class ConcurrentSegmentedVector
+{
+	struct Slot
+	{
+		std::atomic<uint8_t> State;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+		inline T* Value()
+		{
+			return reinterpret_cast<T*>(&Storage);
+		}
+	};
+public:
+	using value_type = T;
+	using size_type = uint32_t;
+
+	template<bool IsConst>
+	class IteratorTemplate
+	{
+		using Owner = std::conditional_t<IsConst, const ConcurrentSegmentedVector, ConcurrentSegmentedVector>;
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using reference = std::conditional_t<IsConst, const T&, T&>;
+		using pointer = std::conditional_t<IsConst, const T*, T*>;
+
+		IteratorTemplate()
+			: m_Owner(nullptr)
+			, m_Index(EndIndex)
+			, m_Last(0u)
+		{}
+		// Allow iterator -> const_iterator
+		template<bool OtherIsConst, typename = std::enable_if_t<IsConst || !OtherIsConst>>
+		IteratorTemplate(const IteratorTemplate<OtherIsConst>& other)
+			: m_Owner(other.m_Owner)
+			, m_Index(other.m_Index)
+			, m_Last(other.m_Last)
+		{}
+
+		inline reference operator*() const { return *m_Owner->SlotAt(m_Index)->Value(); }
+		inline pointer operator->() const { return m_Owner->SlotAt(m_Index)->Value(); }
+		inline IteratorTemplate& operator++()
+		{
+			++m_Index;
+			SkipNonAlive();
+			return *this;
+		}
+		inline IteratorTemplate operator++(int)
+		{
+			auto copy = *this;
+			++*this;
+			return copy;
+		}
+		template<bool OtherIsConst>
+		inline bool operator==(const IteratorTemplate<OtherIsConst>& other) const
+		{
+			return m_Index == other.m_Index;
+		}
+		template<bool OtherIsConst>
+		inline bool operator!=(const IteratorTemplate<OtherIsConst>& other) const
+		{
+			return m_Index != other.m_Index;
+		}
+		// Position of the element, valid until the next compact()
+		inline size_type index() const
+		{
+			return m_Index;
+		}
+	private:
+		// Iterators that ran off the end all compare equal to end() no matter how many
+		// elements got appended between begin() and end()
+		static constexpr size_type EndIndex = ~size_type(0);
+
+		IteratorTemplate(Owner* owner, size_type last)
+			: m_Owner(owner)
+			, m_Index(0u)
+			, m_Last(last)
+		{
+			SkipNonAlive();
+		}
+		void SkipNonAlive()
+		{
+			while (m_Index < m_Last)
+			{
+				const uint32_t segment = SegmentedDetail::SegmentOf(m_Index);
+				Slot* slots = m_Owner->m_Segments[segment].load(std::memory_order_acquire);
+				if (!slots)
+				{
+					// Someone reserved a slot here but hasn't allocated the segment yet
+					m_Index = SegmentedDetail::SegmentStart(segment + 1u);
+					continue;
+				}
+				const uint32_t offset = m_Index - SegmentedDetail::SegmentStart(segment);
+				if (slots[offset].State.load(std::memory_order_acquire) == SegmentedDetail::Alive)
+				{
+					return;
+				}
+				++m_Index;
+			}
+			m_Index = EndIndex;
+		}
+
+		Owner* m_Owner;
+		size_type m_Index;
+		size_type m_Last;
+
+		template<bool> friend class IteratorTemplate;
+		friend class ConcurrentSegmentedVector;
+	};
+	using iterator = IteratorTemplate<false>;
+	using const_iterator = IteratorTemplate<true>;
+
+	ConcurrentSegmentedVector()
+		: m_Size(0u)
+	{
+		m_Allocator.Initialize();
+		for (auto& segment : m_Segments)
+		{
+			segment.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+	~ConcurrentSegmentedVector()
+	{
+		clear();
+		for (auto& segment : m_Segments)
+		{
+			Slot* slots = segment.load(std::memory_order_relaxed);
+			if (slots)
+			{
+				m_Allocator.Free(slots);
+			}
+		}
+	}
+	ConcurrentSegmentedVector(const ConcurrentSegmentedVector&) = delete;
+	ConcurrentSegmentedVector& operator=(const ConcurrentSegmentedVector&) = delete;
+
+	iterator begin() { return iterator(this, m_Size.load(std::memory_order_acquire)); }
+	iterator end() { return iterator(); }
+	const_iterator begin() const { return const_iterator(this, m_Size.load(std::memory_order_acquire)); }
+	const_iterator end() const { return const_iterator(); }
+	const_iterator cbegin() const { return begin(); }
+	const_iterator cend() const { return end(); }
+
+	// Thread-safe. Returns the index of the new element.
+	template<typename... Args>
+	size_type emplace_back(Args&&... args)
+	{
+		const size_type index = m_Size.fetch_add(1u, std::memory_order_relaxed);
+		ASSERT_FATAL(index < SegmentedDetail::SegmentStart(SegmentedDetail::MaxSegments));
+		Slot* slot = EnsureSlot(index);
+		new (slot->Value()) T(std::forward<Args>(args)...);
+		slot->State.store(SegmentedDetail::Alive, std::memory_order_release);
+		return index;
+	}
+	size_type push_back(const T& value)
+	{
+		return emplace_back(value);
+	}
+	size_type push_back(T&& value)
+	{
+		return emplace_back(std::move(value));
+	}
+
+	// Thread-safe. Marks the element as dead, it's destroyed on the next compact().
+	// Returns false if someone else erased it first.
+	bool erase(const_iterator it)
+	{
+		ASSERT_RETURN_VALUE(it.m_Owner == this && it.m_Index != const_iterator::EndIndex, false);
+		uint8_t expected = SegmentedDetail::Alive;
+		return SlotAt(it.m_Index)->State.compare_exchange_strong(expected, SegmentedDetail::Dead, std::memory_order_acq_rel);
+	}
+
+	// Not thread-safe! Destroys all dead elements and moves the live ones to the front, keeping their order.
+	// Indices and addresses of live elements change, segments are kept for reuse.
+	void compact()
+	{
+		const size_type size = m_Size.load(std::memory_order_acquire);
+		size_type write = 0u;
+		for (size_type read = 0u; read < size; ++read)
+		{
+			Slot* slot = SlotAt(read);
+			const uint8_t state = slot->State.load(std::memory_order_relaxed);
+			if (state == SegmentedDetail::Alive)
+			{
+				if (write != read)
+				{
+					Slot* target = SlotAt(write);
+					new (target->Value()) T(std::move(*slot->Value()));
+					target->State.store(SegmentedDetail::Alive, std::memory_order_relaxed);
+					slot->Value()->~T();
+					slot->State.store(SegmentedDetail::Empty, std::memory_order_relaxed);
+				}
+				++write;
+			}
+			else if (state == SegmentedDetail::Dead)
+			{
+				slot->Value()->~T();
+				slot->State.store(SegmentedDetail::Empty, std::memory_order_relaxed);
+			}
+			else
+			{
+				ASSERT(false && "compact() called while another thread is appending");
+			}
+		}
+		m_Size.store(write, std::memory_order_release);
+	}
+
+	// Not thread-safe! Destroys everything, segments are kept for reuse.
+	void clear()
+	{
+		const size_type size = m_Size.load(std::memory_order_acquire);
+		for (size_type i = 0u; i < size; ++i)
+		{
+			Slot* slot = SlotAt(i);
+			if (slot->State.load(std::memory_order_relaxed) != SegmentedDetail::Empty)
+			{
+				slot->Value()->~T();
+				slot->State.store(SegmentedDetail::Empty, std::memory_order_relaxed);
+			}
+		}
+		m_Size.store(0u, std::memory_order_release);
+	}
+
+	// Number of slots in use, including dead ones that are yet to be compacted
+	size_type size() const
+	{
+		return m_Size.load(std::memory_order_acquire);
+	}
+private:
+	Slot* SlotAt(size_type index) const
+	{
+		const uint32_t segment = SegmentedDetail::SegmentOf(index);
+		Slot* slots = m_Segments[segment].load(std::memory_order_acquire);
+		return slots + (index - SegmentedDetail::SegmentStart(segment));
+	}
+
+	Slot* EnsureSlot(size_type index)
+	{
+		const uint32_t segment = SegmentedDetail::SegmentOf(index);
+		Slot* slots = m_Segments[segment].load(std::memory_order_acquire);
+		if (!slots)
+		{
+			const uint32_t count = SegmentedDetail::SegmentSize(segment);
+			Slot* fresh = reinterpret_cast<Slot*>(m_Allocator.Malloc(sizeof(Slot) * count, unsigned(alignof(Slot))));
+			for (uint32_t i = 0u; i < count; ++i)
+			{
+				new (&fresh[i].State) std::atomic<uint8_t>(uint8_t(SegmentedDetail::Empty));
+			}
+			if (m_Segments[segment].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel))
+			{
+				slots = fresh;
+			}
+			else
+			{
+				// Lost the race, slots now holds the winner's segment
+				m_Allocator.Free(fresh);
+			}
+		}
+		return slots + (index - SegmentedDetail::SegmentStart(segment));
+	}
+
+	std::atomic<Slot*> m_Segments[SegmentedDetail::MaxSegments];
+	std::atomic<size_type> m_Size;
+	AllocatorImpl m_Allocator;
+};
+
+namespace stl
+{
+	template<typename T>
+	using concurrent_segmented_vector = ConcurrentSegmentedVector<T, DefaultAllocator>;
+}
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <Zmey/Config.h>
+#include <Zmey/Logging.h>
+#include <Zmey/EntityManager.h>
+#include <Zmey/MemoryStream.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+// Maps entities to indices in a packed array, meant for component managers that keep their
+// data in parallel dense vectors.
+// The sparse array is indexed directly by EntityId::GetIndex() so lookups are two array reads.
+// Stale ids are rejected by comparing the whole id (generation included) against the dense entry.
+// Removal swaps the last entity into the freed slot - mirror that in the component data with SwapAndPop
+// so that the data stays packed and in the same order as Entities().
+template<typename AllocatorImpl = DefaultAllocator>
+class SparseSet
+{
+public:
+	using IndexType = EntityId::IndexType;
+	static constexpr IndexType InvalidIndex = ~IndexType(0);
+
+	using iterator = const EntityId*;
+	using const_iterator = const EntityId*;
+
+	// Adds the entity at the back of the dense array and returns its index there
+	IndexType Insert(EntityId id)
+	{
+		const IndexType sparseIndex = id.GetIndex();
+		if (sparseIndex >= m_Sparse.size())
+		{
+			m_Sparse.resize(sparseIndex + 1u, InvalidIndex);
+		}
+		// Neither the entity nor an older generation of its index should be in the set
+		ASSERT_FATAL(m_Sparse[sparseIndex] == InvalidIndex);
+		const IndexType denseIndex = IndexType(m_Dense.size());
+		m_Dense.push_back(id);
+		m_Sparse[sparseIndex] = denseIndex;
+		return denseIndex;
+	}
+
+	inline IndexType IndexOf(EntityId id) const
+	{
+		const IndexType sparseIndex = id.GetIndex();
+		if (sparseIndex >= m_Sparse.size())
+		{
+			return InvalidIndex;
+		}
+		const IndexType denseIndex = m_Sparse[sparseIndex];
+		return denseIndex != InvalidIndex && m_Dense[denseIndex] == id ? denseIndex : InvalidIndex;
+	}
+
+	inline bool Contains(EntityId id) const
+	{
+		return IndexOf(id) != InvalidIndex;
+	}
+
+	// Removes the entity by moving the last one in its place.
+	// Returns the index the entity used to occupy or InvalidIndex if it wasn't in the set.
+	IndexType Remove(EntityId id)
+	{
+		const IndexType denseIndex = IndexOf(id);
+		if (denseIndex == InvalidIndex)
+		{
+			return InvalidIndex;
+		}
+		const EntityId last = m_Dense.back();
+		m_Dense[denseIndex] = last;
+		m_Sparse[last.GetIndex()] = denseIndex;
+		m_Sparse[id.GetIndex()] = InvalidIndex;
+		m_Dense.pop_back();
+		return denseIndex;
+	}
+
+	inline EntityId EntityAt(IndexType denseIndex) const
+	{
+		return m_Dense[denseIndex];
+	}
+	inline const EntityId* Entities() const
+	{
+		return m_Dense.data();
+	}
+	inline const_iterator begin() const
+	{
+		return m_Dense.data();
+	}
+	inline const_iterator end() const
+	{
+		return m_Dense.data() + m_Dense.size();
+	}
+	inline size_t size() const
+	{
+		return m_Dense.size();
+	}
+	inline bool empty() const
+	{
+		return m_Dense.empty();
+	}
+
+	// Moves the entity at order[i] to i for every i - mirror that in the component data with Permute.
+	// order has to hold each index of the set once.
+	template<typename Indices>
+	void Reorder(const Indices& order);
+
+	void reserve(size_t count)
+	{
+		m_Dense.reserve(count);
+	}
+	void clear()
+	{
+		m_Dense.clear();
+		m_Sparse.clear();
+	}
+
+	// See World::SaveSnapshot
+	void Save(MemoryOutputStream& stream) const
+	{
+		WriteArray(stream, m_Dense);
+		WriteArray(stream, m_Sparse);
+	}
+	void Restore(MemoryInputStream& stream)
+	{
+		ReadArray(stream, m_Dense);
+		ReadArray(stream, m_Sparse);
+	}
+private:
+	std::vector<EntityId, StlAllocatorTemplate<AllocatorImpl, EntityId>> m_Dense;
+	std::vector<IndexType, StlAllocatorTemplate<AllocatorImpl, IndexType>> m_Sparse;
+};
+
+template<typename AllocatorImpl>
+constexpr typename SparseSet<AllocatorImpl>::IndexType SparseSet<AllocatorImpl>::InvalidIndex;
+
+// The counterpart of SparseSet::Remove for the component data
+template<typename Vector>
+inline void SwapAndPop(Vector& data, size_t index)
+{
+	if (index + 1u != data.size())
+	{
+		data[index] = std::move(data.back());
+	}
+	data.pop_back();
+}
+
+// The counterpart of SparseSet::Reorder for the component data - data[i] becomes what was data[order[i]].
+// Gathers into a copy on the heap, as whole component arrays can be too big for the temp allocator.
+template<typename Vector, typename Indices>
+void Permute(Vector& data, const Indices& order)
+{
+	using ValueType = typename Vector::value_type;
+	stl::vector<ValueType> permuted;
+	permuted.reserve(order.size());
+	for (size_t i = 0u; i < order.size(); ++i)
+	{
+		permuted.push_back(std::move(data[order[i]]));
+	}
+	std::move(permuted.begin(), permuted.end(), data.begin());
+}
+
+template<typename AllocatorImpl>
+template<typename Indices>
+void SparseSet<AllocatorImpl>::Reorder(const Indices& order)
+{
+	ASSERT_FATAL(order.size() == m_Dense.size());
+	Permute(m_Dense, order);
+	for (IndexType i = 0u; i < m_Dense.size(); ++i)
+	{
+		m_Sparse[m_Dense[i].GetIndex()] = i;
+	}
+}
+
+namespace stl
+{
+	using sparse_set = SparseSet<DefaultAllocator>;
+}
+// Bound to the default allocator at the time of construction, see ScopedDefaultAllocator
+namespace arena
+{
+	using sparse_set = SparseSet<AllocatorRef>;
+}
+}
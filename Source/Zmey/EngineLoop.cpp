@@ -1,13 +1,16 @@
 #include <Zmey/EngineLoop.h>
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 
 #include <Zmey/Memory/Allocator.h>
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Memory/HeapProfiler.h>
 #include <Zmey/Logging.h>
 #include <Zmey/Modules.h>
 #include <Zmey/World.h>
+#include <Zmey/WorldScheduler.h>
 #include <Zmey/Game.h>
 #include <Zmey/Components/ComponentRegistry.h>
 #include <Zmey/Components/TransformManager.h>
@@ -71,6 +74,12 @@ EngineLoop::EngineLoop(Game* game)
 	Zmey::GLogHandler = StaticAlloc<StdOutLogHandler>();
 	Zmey::Modules.Initialize();
 	PROFILE_INITIALIZE;
+
+	auto settings = Zmey::Modules.SettingsManager.DataFor("HeapProfiler");
+	if (settings->ReadValue("Enabled", false))
+	{
+		HeapProfiler::Enable(size_t(settings->ReadValue("SampleIntervalBytes", int32_t(256 * 1024))));
+	}
 }
 
 void EngineLoop::RunJobEntryPoint(void* data)
@@ -86,29 +95,15 @@ void EngineLoop::Run()
 	Zmey::Modules.JobSystem.WaitForCompletion();
 	Zmey::Modules.Uninitialize();
 	profiler::dumpBlocksToFile("test_profile.prof");
+	// The profiler may have been turned off at runtime, what it sampled until then is still worth a report
+	if (HeapProfiler::HasSamples())
+	{
+		HeapProfiler::DumpReport("heap_profile.txt");
+	}
 }
 
 namespace
 {
-struct SimulateData
-{
-	Game* GameInstance;
-	World* WorldInstance;
-	float DeltaTime;
-};
-
-void SimulateFrame(void* data)
-{
-	auto simulateData = (SimulateData*)data;
-
-	Modules.InputController.DispatchActionEventsForFrame(simulateData->DeltaTime);
-
-	Modules.PhysicsEngine.Simulate(simulateData->DeltaTime);
-	simulateData->GameInstance->Simulate(simulateData->DeltaTime);
-	simulateData->WorldInstance->Simulate(simulateData->DeltaTime);
-	Modules.PhysicsEngine.FetchResults();
-}
-
 struct GatherDataData
 {
 	World* WorldInstance;
@@ -147,6 +142,13 @@ void EngineLoop::RunImpl()
 	using clock = std::chrono::high_resolution_clock;
 	clock::time_point lastFrameTmestamp = clock::now();
 
+	// The simulation advances in fixed steps, as many as fit in the time that passed, and rendering blends
+	// the last two. Beyond MaxStepsPerFrame the simulation gives up on catching up and runs slower instead.
+	auto simulationSettings = Modules.SettingsManager.DataFor("Simulation");
+	const float timeStep = 1.f / float(std::max(simulationSettings->ReadValue("TickRate", int32_t(60)), int32_t(1)));
+	const uint32_t maxStepsPerFrame = uint32_t(std::max(simulationSettings->ReadValue("MaxStepsPerFrame", int32_t(4)), int32_t(1)));
+	WorldScheduler scheduler(timeStep, maxStepsPerFrame);
+
 	// Create main Player view
 	Graphics::View playerView(Graphics::ViewType::PlayerView);
 	playerView.SetupProjection(swapchainSizes.x, swapchainSizes.y, glm::radians(90.0f), 0.1f, 1000.0f);
@@ -158,10 +160,10 @@ void EngineLoop::RunImpl()
 	ASSERT_FATAL(world);
 	Modules.ResourceLoader.ReleaseOwnershipOver(worldName);
 	m_World = const_cast<World*>(world);
-	m_Game->SetWorld(m_World);
+	scheduler.AddWorld(*m_World, m_Game);
 
 	m_Game->Initialize();
-	Modules.PhysicsEngine.SetWorld(*m_World);
+	m_World->SetSpatialSortInterval(uint32_t(std::max(simulationSettings->ReadValue("SpatialSortInterval", int32_t(0)), int32_t(0))));
 
 	// UI
 	{
@@ -190,6 +192,9 @@ void EngineLoop::RunImpl()
 
 		Modules.Platform.PumpMessages(windowHandle);
 
+		// Nothing is simulating at this point so it's safe to destroy resources freed last frame
+		Modules.ResourceLoader.CollectFreedResources();
+
 		// UI
 		{
 			auto& io = ImGui::GetIO();
@@ -197,16 +202,20 @@ void EngineLoop::RunImpl()
 			ImGui::NewFrame();
 		}
 
-		SimulateData simulateData{ m_Game, m_World, deltaTime };
-
-		Job::Counter simulateCounter;
-		Job::JobDecl simulateJob{ SimulateFrame, &simulateData };
-		Modules.JobSystem.RunJobs("Simulate", &simulateJob, 1, &simulateCounter);
-		Modules.JobSystem.WaitForCounter(&simulateCounter, 0);
+		// The local devices drive the world on screen
+		for (uint8_t player = 0u; player < InputController::MaxPlayerCount; ++player)
+		{
+			m_World->GetInput().SetPlayerState(player, Modules.InputController.GetPlayerState(player));
+		}
+		scheduler.Tick(deltaTime);
+		m_Game->UpdateUI(deltaTime);
 
 		// TODO: Compute visibility
 		// Gather render data
+		// The render job that used this frame data was waited on last frame
+		frameDatas[currentFrameData].Reset();
 		frameDatas[currentFrameData].FrameIndex = frameIndex++;
+		frameDatas[currentFrameData].InterpolationAlpha = scheduler.GetInterpolationAlpha(*m_World);
 		playerView.GatherData(frameDatas[currentFrameData]);
 
 		GatherDataData gatherData{ m_World, frameDatas[currentFrameData] };
@@ -229,7 +238,21 @@ void EngineLoop::RunImpl()
 	}
 	Modules.JobSystem.WaitForCounter(&renderCounter, 0);
 
+	scheduler.RemoveWorld(*m_World);
 	m_Game->Uninitialize();
+
+	// The modules the component managers talk to are still alive at this point
+	const MemoryArena::Stats worldMemory = m_World->GetMemoryStats();
+	FORMAT_LOG(Info, EngineLoop, "World memory: %llu bytes in use (%llu peak), %llu bytes reserved in %llu chunks and %llu large blocks",
+		uint64_t(worldMemory.BytesInUse), uint64_t(worldMemory.PeakBytesInUse),
+		uint64_t(worldMemory.BytesReserved), uint64_t(worldMemory.ChunkCount), uint64_t(worldMemory.LargeBlockCount));
+	const SharedAssetStats sharedAssets = Modules.ResourceLoader.GetSharedAssets().GetStats();
+	FORMAT_LOG(Info, EngineLoop, "Shared assets: %llu bytes mapped from %u files, %llu bytes referenced",
+		uint64_t(sharedAssets.MappedBytes), sharedAssets.FileCount, uint64_t(sharedAssets.ReferencedBytes));
+	m_Game->SetWorld(nullptr);
+	delete m_World;
+	m_World = nullptr;
+
 	Modules.Platform.KillWindow(windowHandle);
 	Modules.JobSystem.Quit();
 }
@@ -1,47 +1,198 @@
 #pragma once
 #include <Zmey/EntityManager.h>
+#include <Zmey/MemoryStream.h>
+
+#include <algorithm>
+#include <cstring>
 
 namespace Zmey
 {
 
-EntityId EntityManager::SpawnOne()
+EntityManager::EntityManager(IAllocator* allocator)
+	: m_Allocator(allocator)
+	, m_NextIndex(0u)
+	, m_FreeIndices(AllocatorRef(allocator))
+	, m_FreeBegin(0u)
+{
+	for (auto& segment : m_GenerationSegments)
+	{
+		segment.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+EntityManager::~EntityManager()
+{
+	for (auto& segment : m_GenerationSegments)
+	{
+		uint16_t* generations = segment.load(std::memory_order_relaxed);
+		if (generations)
+		{
+			m_Allocator->Free(generations);
+		}
+	}
+}
+
+uint16_t* EntityManager::GenerationOf(IndexType index) const
+{
+	const uint32_t segment = SegmentedDetail::SegmentOf(index);
+	uint16_t* generations = m_GenerationSegments[segment].load(std::memory_order_acquire);
+	return generations ? generations + (index - SegmentedDetail::SegmentStart(segment)) : nullptr;
+}
+
+void EntityManager::EnsureGenerations(IndexType begin, IndexType end)
 {
-	if (m_FreeIndices.size() == 0)
+	if (begin == end)
+	{
+		return;
+	}
+	const uint32_t lastSegment = SegmentedDetail::SegmentOf(end - 1u);
+	for (uint32_t segment = SegmentedDetail::SegmentOf(begin); segment <= lastSegment; ++segment)
 	{
-		m_Generation.push_back(0);
-		return EntityId(static_cast<uint32_t>(m_Generation.size() - 1u), 0u);
+		uint16_t* generations = m_GenerationSegments[segment].load(std::memory_order_acquire);
+		if (generations)
+		{
+			continue;
+		}
+		const size_t size = sizeof(uint16_t) * SegmentedDetail::SegmentSize(segment);
+		uint16_t* fresh = reinterpret_cast<uint16_t*>(m_Allocator->Malloc(size, unsigned(alignof(uint16_t))));
+		std::memset(fresh, 0, size);
+		if (!m_GenerationSegments[segment].compare_exchange_strong(generations, fresh, std::memory_order_acq_rel))
+		{
+			// Another spawn got here first
+			m_Allocator->Free(fresh);
+		}
 	}
-	else
+}
+
+EntityManager::IndexType EntityManager::SpawnFromFreeList(EntityId* entities, IndexType count)
+{
+	// The free list doesn't change while spawning, only m_FreeBegin moves
+	const IndexType freeEnd = IndexType(m_FreeIndices.size());
+	IndexType begin = m_FreeBegin.load(std::memory_order_relaxed);
+	IndexType taken;
+	do
 	{
-		uint32_t freeIndex = m_FreeIndices.front();
-		m_FreeIndices.pop();
-		return EntityId(freeIndex, m_Generation[freeIndex]);
+		taken = std::min(count, freeEnd - begin);
+		if (taken == 0u)
+		{
+			return 0u;
+		}
+	} while (!m_FreeBegin.compare_exchange_weak(begin, begin + taken, std::memory_order_relaxed));
+
+	for (IndexType i = 0u; i < taken; ++i)
+	{
+		const IndexType index = m_FreeIndices[begin + i];
+		entities[i] = EntityId(index, *GenerationOf(index));
 	}
+	return taken;
 }
 
-tmp::vector<EntityId> EntityManager::SpawnRange(EntityId::IndexType count)
+void EntityManager::Spawn(EntityId* entities, IndexType count)
 {
-	tmp::vector<EntityId> entities;
-	entities.reserve(count);
-	for (EntityId::IndexType i = 0; i < count; i++)
+	const IndexType reused = SpawnFromFreeList(entities, count);
+	const IndexType fresh = count - reused;
+	if (fresh == 0u)
 	{
-		entities.push_back(SpawnOne());
+		return;
 	}
+	const IndexType first = m_NextIndex.fetch_add(fresh, std::memory_order_relaxed);
+	ASSERT_FATAL(uint64_t(first) + fresh <= SegmentedDetail::SegmentStart(SegmentedDetail::MaxSegments));
+	EnsureGenerations(first, first + fresh);
+	for (IndexType i = 0u; i < fresh; ++i)
+	{
+		entities[reused + i] = EntityId(first + i, 0u);
+	}
+}
+
+EntityId EntityManager::SpawnOne()
+{
+	EntityId entity;
+	Spawn(&entity, 1u);
+	return entity;
+}
+
+tmp::vector<EntityId> EntityManager::SpawnRange(IndexType count)
+{
+	tmp::vector<EntityId> entities(count);
+	Spawn(entities.data(), count);
 	return entities;
 }
 
 void EntityManager::Destroy(EntityId id)
 {
-	if (m_Generation[id.Index] != id.Generation)
+	if (!IsAlive(id))
 	{
 		return;
 	}
-	++m_Generation[id.Index];
-	m_FreeIndices.push(id.Index);
+	++*GenerationOf(id.Index);
+	// Drop the taken part of the free list once it's at least half of it, so that it doesn't grow forever
+	const IndexType taken = m_FreeBegin.load(std::memory_order_relaxed);
+	if (taken > 0u && taken * 2u >= m_FreeIndices.size())
+	{
+		m_FreeIndices.erase(m_FreeIndices.begin(), m_FreeIndices.begin() + taken);
+		m_FreeBegin.store(0u, std::memory_order_relaxed);
+	}
+	m_FreeIndices.push_back(id.Index);
+}
+
+void EntityManager::Destroy(const EntityId* entities, size_t count)
+{
+	m_FreeIndices.reserve(m_FreeIndices.size() + count);
+	for (size_t i = 0u; i < count; ++i)
+	{
+		Destroy(entities[i]);
+	}
+}
+
+void EntityManager::SaveSnapshot(MemoryOutputStream& stream) const
+{
+	const IndexType count = m_NextIndex.load(std::memory_order_acquire);
+	stream << count;
+	for (uint32_t segment = 0u; count > 0u && segment <= SegmentedDetail::SegmentOf(count - 1u); ++segment)
+	{
+		const IndexType begin = SegmentedDetail::SegmentStart(segment);
+		const IndexType size = std::min(SegmentedDetail::SegmentSize(segment), count - begin);
+		stream.Write(reinterpret_cast<const uint8_t*>(GenerationOf(begin)), sizeof(uint16_t) * size);
+	}
+	const IndexType freeBegin = m_FreeBegin.load(std::memory_order_relaxed);
+	stream << IndexType(m_FreeIndices.size() - freeBegin);
+	stream.Write(reinterpret_cast<const uint8_t*>(m_FreeIndices.data() + freeBegin), sizeof(IndexType) * (m_FreeIndices.size() - freeBegin));
+}
+
+void EntityManager::RestoreSnapshot(MemoryInputStream& stream)
+{
+	const IndexType oldCount = m_NextIndex.load(std::memory_order_relaxed);
+	IndexType count;
+	stream >> count;
+	EnsureGenerations(0u, count);
+	for (uint32_t segment = 0u; count > 0u && segment <= SegmentedDetail::SegmentOf(count - 1u); ++segment)
+	{
+		const IndexType begin = SegmentedDetail::SegmentStart(segment);
+		const IndexType size = std::min(SegmentedDetail::SegmentSize(segment), count - begin);
+		stream.Read(reinterpret_cast<uint8_t*>(GenerationOf(begin)), sizeof(uint16_t) * size);
+	}
+	// Indices spawned after the snapshot was taken count as never used again
+	for (IndexType index = count; index < oldCount; ++index)
+	{
+		*GenerationOf(index) = 0u;
+	}
+	m_NextIndex.store(count, std::memory_order_release);
+
+	IndexType freeCount;
+	stream >> freeCount;
+	m_FreeIndices.resize(freeCount);
+	stream.Read(reinterpret_cast<uint8_t*>(m_FreeIndices.data()), sizeof(IndexType) * freeCount);
+	m_FreeBegin.store(0u, std::memory_order_relaxed);
 }
-bool EntityManager::IsAlive(EntityId id)
+
+bool EntityManager::IsAlive(EntityId id) const
 {
-	return m_Generation[id.Index] == id.Generation;
+	if (id.Index >= m_NextIndex.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	const uint16_t* generation = GenerationOf(id.Index);
+	return generation && *generation == id.Generation;
 }
 
 }
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
+#include <atomic>
+
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Containers/SegmentedVector.h>
 
 namespace Zmey
 {
+class MemoryInputStream;
+class MemoryOutputStream;
 
 struct EntityId
 {
@@ -42,6 +47,16 @@ struct EntityId
 		EntityId nullEntity{ 0xFFFFFFFFFFFFFFFF };
 		return nullEntity;
 	}
+
+	// Meant for containers that index by entity (see SparseSet), gameplay code shouldn't care
+	inline IndexType GetIndex() const
+	{
+		return Index;
+	}
+	inline uint16_t GetGeneration() const
+	{
+		return Generation;
+	}
 private:
 	EntityId(uint32_t index, uint16_t generation)
 		: Index(index)
@@ -54,16 +69,57 @@ private:
 	friend class EntityManager;
 };
 
+// Orders entities by index, for batches of entities (see World::QueueDestroyEntity)
+struct EntityIndexLess
+{
+	inline bool operator()(const EntityId& lhs, const EntityId& rhs) const
+	{
+		return lhs.GetIndex() < rhs.GetIndex() || (lhs.GetIndex() == rhs.GetIndex() && lhs.GetGeneration() < rhs.GetGeneration());
+	}
+};
+
+// Spawning is lock-free and can be done from many jobs at once - indices of destroyed entities are handed out
+// first, oldest first, then never used ones, which are reserved a whole range at a time.
+// Destroying isn't thread-safe and can't overlap with spawning, do it at a sync point (see World::QueueDestroyEntity).
 class EntityManager
 {
 public:
+	using IndexType = EntityId::IndexType;
+
+	// Entity tables live in the given allocator, usually the arena of the world that owns them
+	ZMEY_API explicit EntityManager(IAllocator* allocator);
+	ZMEY_API ~EntityManager();
+	EntityManager(const EntityManager&) = delete;
+	EntityManager& operator=(const EntityManager&) = delete;
+
+	// Thread-safe
 	ZMEY_API EntityId SpawnOne();
-	ZMEY_API tmp::vector<EntityId> SpawnRange(EntityId::IndexType count);
+	// Thread-safe, writes count new entities to the array
+	ZMEY_API void Spawn(EntityId* entities, IndexType count);
+	// Thread-safe
+	ZMEY_API tmp::vector<EntityId> SpawnRange(IndexType count);
 	ZMEY_API void Destroy(EntityId);
-	ZMEY_API bool IsAlive(EntityId);
+	ZMEY_API void Destroy(const EntityId* entities, size_t count);
+	// Thread-safe
+	ZMEY_API bool IsAlive(EntityId) const;
+
+	// See World::SaveSnapshot
+	void SaveSnapshot(MemoryOutputStream& stream) const;
+	void RestoreSnapshot(MemoryInputStream& stream);
 private:
-	stl::vector<uint16_t> m_Generation;
-	stl::queue<uint_fast32_t> m_FreeIndices;
+	// Hands out up to count indices from the free list, returns how many
+	IndexType SpawnFromFreeList(EntityId* entities, IndexType count);
+	void EnsureGenerations(IndexType begin, IndexType end);
+	uint16_t* GenerationOf(IndexType index) const;
+
+	IAllocator* m_Allocator;
+	// Segments double in size like in ConcurrentSegmentedVector and are allocated as the indices get reserved.
+	// Never used indices are at generation 0.
+	std::atomic<uint16_t*> m_GenerationSegments[SegmentedDetail::MaxSegments];
+	std::atomic<IndexType> m_NextIndex;
+	// Destroyed indices in the order of destruction, the ones before m_FreeBegin are already taken
+	arena::vector<IndexType> m_FreeIndices;
+	std::atomic<IndexType> m_FreeBegin;
 };
 
 }
@@ -0,0 +1,19 @@
+#include <Zmey/EventChannel.h>
+#include <Zmey/World.h>
+
+namespace Zmey
+{
+
+EventChannelBase::EventChannelBase(World& world)
+	: m_World(world)
+{
+	m_World.m_EventChannels.push_back(this);
+}
+
+EventChannelBase::~EventChannelBase()
+{
+	auto& channels = m_World.m_EventChannels;
+	channels.erase(std::remove(channels.begin(), channels.end(), this), channels.end());
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include <Zmey/Config.h>
+#include <Zmey/Containers/SegmentedVector.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+class World;
+
+// Registers the channel with the world, which publishes all of its channels at the start of World::LateSimulate
+class EventChannelBase
+{
+public:
+	ZMEY_API EventChannelBase(World& world);
+	ZMEY_API virtual ~EventChannelBase();
+	EventChannelBase(const EventChannelBase&) = delete;
+	EventChannelBase& operator=(const EventChannelBase&) = delete;
+protected:
+	virtual void Publish() = 0;
+private:
+	World& m_World;
+	friend class World;
+};
+
+// Notifications from one system to others that get handled in batches rather than as calls from inside the sender's loop.
+// Any job can Send at any time without locking. The events sent during a frame become readable as a single array
+// when the world publishes its channels at the start of LateSimulate, and stay readable until the next publish -
+// through the LateSimulate of the managers and the Simulate of the game and the managers the frame after.
+// Events from different jobs come in no particular order.
+// The buffers only grow when more events are sent in a frame than ever before, otherwise nothing gets allocated.
+// Channels owned by component managers allocate from the world's arena like the rest of their data.
+template<typename T>
+class EventChannel : public EventChannelBase
+{
+public:
+	EventChannel(World& world)
+		: EventChannelBase(world)
+		, m_SendCount(0u)
+	{}
+
+	// Thread-safe
+	void Send(const T& event)
+	{
+		const uint32_t index = m_SendCount.fetch_add(1u, std::memory_order_relaxed);
+		if (index < m_Pending.size())
+		{
+			m_Pending[index] = event;
+		}
+		else
+		{
+			m_Overflow.push_back(event);
+		}
+	}
+
+	// The events published last
+	inline const T* data() const
+	{
+		return m_Published.data();
+	}
+	inline uint32_t size() const
+	{
+		return m_PublishedCount;
+	}
+	inline const T* begin() const
+	{
+		return m_Published.data();
+	}
+	inline const T* end() const
+	{
+		return m_Published.data() + m_PublishedCount;
+	}
+
+protected:
+	virtual void Publish() override
+	{
+		const uint32_t sent = m_SendCount.load(std::memory_order_acquire);
+		const uint32_t capacity = uint32_t(m_Pending.size());
+		std::swap(m_Pending, m_Published);
+		m_PublishedCount = sent;
+		if (sent > capacity)
+		{
+			// The events that didn't fit got appended elsewhere, grow the buffers so they fit from now on
+			m_Published.resize(sent);
+			std::copy(m_Overflow.begin(), m_Overflow.end(), m_Published.begin() + capacity);
+			m_Overflow.clear();
+		}
+		m_Pending.resize(m_Published.size());
+		m_SendCount.store(0u, std::memory_order_release);
+	}
+
+private:
+	// Sized to the most events sent in a frame so far
+	arena::vector<T> m_Pending;
+	arena::vector<T> m_Published;
+	ConcurrentSegmentedVector<T, AllocatorRef> m_Overflow;
+	std::atomic<uint32_t> m_SendCount;
+	uint32_t m_PublishedCount = 0u;
+};
+
+}
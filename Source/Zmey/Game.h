@@ -14,7 +14,11 @@ public:
 	// Initializes the game and returns the name of the initial world
 	virtual Zmey::Name LoadResources() = 0;
 	virtual void Initialize() = 0;
+	// Runs once per fixed simulation step, possibly several times per frame and off the main thread
 	virtual void Simulate(float deltaTime) = 0;
+	// Runs once per rendered frame on the main thread after the worlds got stepped, for per-frame work like UI
+	virtual void UpdateUI(float deltaTime)
+	{}
 	virtual void Uninitialize() = 0;
 	class World* GetWorld()
 	{
@@ -28,6 +32,7 @@ private:
 	}
 	class World* m_World;
 	friend class EngineLoop;
+	friend class WorldScheduler;
 };
 
 }
\ No newline at end of file
@@ -15,55 +15,25 @@ namespace Graphics
 namespace Features
 {
 
-namespace
-{
-struct MeshRendererGatherJobData
-{
-	MeshHandle& HandleSlot;
-	Matrix4x4& MatrixSlot;
-
-	Components::TransformManager& TransformManager;
-	EntityId Id;
-	MeshHandle Handle;
-};
-
-void GatherDataEntryPoint(void* param)
-{
-	auto data = (MeshRendererGatherJobData*)param;
-
-	data->HandleSlot = data->Handle;
-	const auto& transform = data->TransformManager.Lookup(data->Id);
-
-	data->MatrixSlot =
-		glm::translate(transform.Position()) *
-		glm::toMat4(transform.Rotation()) *
-		glm::scale(transform.Scale());
-}
-}
-
 void MeshRenderer::GatherData(FrameData& frameData, World& world)
 {
 	auto& meshManager = world.GetManager<Components::MeshComponentManager>();
-	const auto& meshes = meshManager.GetMeshes();
-	frameData.MeshHandles.resize(meshes.size());
-	frameData.MeshTransforms.resize(meshes.size());
 	auto& transformManager = world.GetManager<Components::TransformManager>();
-
-	TEMP_ALLOCATOR_SCOPE;
-	tmp::vector<Job::JobDecl> jobs;
-	tmp::vector<MeshRendererGatherJobData> jobsData;
-	jobs.reserve(meshes.size());
-	jobsData.reserve(meshes.size());
-
-	for (auto i = 0u; i < meshes.size(); ++i)
+	auto meshes = world.Query<Components::MeshComponentManager, Components::TransformManager>();
+	frameData.MeshHandles.resize(meshes.MaxCount());
+	frameData.MeshTransforms.resize(meshes.MaxCount());
+
+	// World matrices are computed in World::LateSimulate, all that's left is to blend the last two steps
+	const float alpha = frameData.InterpolationAlpha;
+	size_t count = 0u;
+	meshes.ForEach([&](EntityId, EntityId::IndexType meshIndex, EntityId::IndexType transformIndex)
 	{
-		jobsData.push_back(MeshRendererGatherJobData{ frameData.MeshHandles[i], frameData.MeshTransforms[i], transformManager, std::get<0>(meshes[i]), std::get<1>(meshes[i])});
-		jobs.push_back(Job::JobDecl{ GatherDataEntryPoint, &jobsData[i] });
-	}
-
-	Job::Counter counter;
-	Modules.JobSystem.RunJobs("Mesh Gather Data", jobs.data(), uint32_t(jobs.size()), &counter);
-	Modules.JobSystem.WaitForCounter(&counter, 0);
+		frameData.MeshHandles[count] = meshManager.MeshAt(meshIndex);
+		frameData.MeshTransforms[count] = transformManager.InstanceAt(transformIndex).InterpolatedWorldMatrix(alpha);
+		++count;
+	});
+	frameData.MeshHandles.resize(count);
+	frameData.MeshTransforms.resize(count);
 }
 
 void MeshRenderer::PrepareData(FrameData& frameData, RendererData& data)
@@ -10,10 +10,35 @@ namespace Zmey
 namespace Graphics
 {
 
-// TODO: this needs better memory management.
-// Use some kind of block allocations
+// All containers allocate from a per-frame arena which is dropped at once by Reset
 struct FrameData
 {
+	FrameData()
+		: Allocations(256 * 1024)
+		, MeshHandles(AllocatorRef(&Allocations))
+		, MeshTransforms(AllocatorRef(&Allocations))
+		, UIVertexData(AllocatorRef(&Allocations))
+		, UIIndexData(AllocatorRef(&Allocations))
+		, UIDrawData(AllocatorRef(&Allocations))
+		, UIDrawVertexOffset(AllocatorRef(&Allocations))
+	{}
+	FrameData(const FrameData&) = delete;
+	FrameData& operator=(const FrameData&) = delete;
+
+	// Must not be called while the renderer still uses the data
+	void Reset()
+	{
+		MeshHandles = arena::vector<MeshHandle>(AllocatorRef(&Allocations));
+		MeshTransforms = arena::vector<Matrix4x4>(AllocatorRef(&Allocations));
+		UIVertexData = arena::vector<uint8_t>(AllocatorRef(&Allocations));
+		UIIndexData = arena::vector<uint8_t>(AllocatorRef(&Allocations));
+		UIDrawData = arena::vector<uint8_t>(AllocatorRef(&Allocations));
+		UIDrawVertexOffset = arena::vector<uint32_t>(AllocatorRef(&Allocations));
+		Allocations.Reset();
+	}
+
+	MemoryArena Allocations;
+
 	uint64_t FrameIndex;
 
 	// TODO(alex): handle multiple views
@@ -23,16 +48,18 @@ struct FrameData
 	Matrix4x4 ViewMatrix;
 	unsigned Width;
 	unsigned Height;
+	// How far between the last two simulation steps the frame is, 0 being the older one
+	float InterpolationAlpha = 1.f;
 
 	// Data for render
-	stl::vector<MeshHandle> MeshHandles;
-	stl::vector<Matrix4x4> MeshTransforms;
+	arena::vector<MeshHandle> MeshHandles;
+	arena::vector<Matrix4x4> MeshTransforms;
 
 	// UI Renderer data
-	stl::vector<uint8_t> UIVertexData;
-	stl::vector<uint8_t> UIIndexData;
-	stl::vector<uint8_t> UIDrawData;
-	stl::vector<uint32_t> UIDrawVertexOffset; // TODO: this has some duplicated values and is somewhat wastefull
+	arena::vector<uint8_t> UIVertexData;
+	arena::vector<uint8_t> UIIndexData;
+	arena::vector<uint8_t> UIDrawData;
+	arena::vector<uint32_t> UIDrawVertexOffset; // TODO: this has some duplicated values and is somewhat wastefull
 };
 
 }
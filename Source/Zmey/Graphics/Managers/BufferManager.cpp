@@ -23,7 +23,7 @@ void BufferManager::DestroyResources()
 	}
 }
 
-BufferHandle BufferManager::CreateStaticBuffer(Backend::BufferUsage usage, uint32_t size, void* data)
+BufferHandle BufferManager::CreateStaticBuffer(Backend::BufferUsage usage, uint32_t size, const void* data)
 {
 	BufferHandle handle = s_BufferNextId++;
 	auto buffer = m_Device->CreateBuffer(size, usage);
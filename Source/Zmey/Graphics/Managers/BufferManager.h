@@ -3,6 +3,7 @@
 #include <Zmey/Graphics/GraphicsObjects.h>
 #include <Zmey/Graphics/Backend/BackendDeclarations.h>
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Containers/FlatHashMap.h>
 
 namespace Zmey
 {
@@ -16,11 +17,11 @@ public:
 
 	void DestroyResources();
 
-	BufferHandle CreateStaticBuffer(Backend::BufferUsage usage, uint32_t size, void* data);
+	BufferHandle CreateStaticBuffer(Backend::BufferUsage usage, uint32_t size, const void* data);
 
 	const Backend::Buffer* GetBuffer(BufferHandle handle) const;
 private:
-	stl::unordered_map<BufferHandle, Backend::Buffer*> m_Buffers;
+	stl::flat_hash_map<BufferHandle, Backend::Buffer*> m_Buffers;
 	Backend::Device* m_Device;
 	static uint64_t s_BufferNextId;
 };
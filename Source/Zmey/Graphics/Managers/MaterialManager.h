@@ -2,6 +2,7 @@
 
 #include <Zmey/Graphics/GraphicsObjects.h>
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Containers/FlatHashMap.h>
 #include <Zmey/Math/Math.h>
 
 namespace Zmey
@@ -31,7 +32,7 @@ public:
 	MaterialHandle CreateMaterial(const MaterialDataHeader& material);
 	const Material* GetMaterial(MaterialHandle handle) const;
 private:
-	stl::unordered_map<MaterialHandle, Material> m_Material;
+	stl::flat_hash_map<MaterialHandle, Material> m_Material;
 };
 
 }
@@ -2,6 +2,7 @@
 
 #include <Zmey/Graphics/GraphicsObjects.h>
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Containers/FlatHashMap.h>
 #include <Zmey/Math/Math.h>
 
 namespace Zmey
@@ -39,7 +40,7 @@ public:
 	MeshHandle CreateMesh(Mesh mesh);
 	const Mesh* GetMesh(MeshHandle handle) const;
 private:
-	stl::unordered_map<MeshHandle, Mesh> m_Meshes;
+	stl::flat_hash_map<MeshHandle, Mesh> m_Meshes;
 	static uint64_t s_MeshNextId;
 };
 
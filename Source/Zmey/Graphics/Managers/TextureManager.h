@@ -3,6 +3,7 @@
 #include <Zmey/Graphics/GraphicsObjects.h>
 #include <Zmey/Graphics/Backend/BackendDeclarations.h>
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Containers/FlatHashMap.h>
 
 namespace Zmey
 {
@@ -20,7 +21,7 @@ public:
 
 	Backend::Texture* GetTexture(TextureHandle handle) const;
 private:
-	stl::unordered_map<TextureHandle, Backend::Texture*> m_Textures;
+	stl::flat_hash_map<TextureHandle, Backend::Texture*> m_Textures;
 	Backend::Device* m_Device;
 	static uint64_t s_TextureNextId;
 };
@@ -247,35 +247,36 @@ Renderer::Renderer()
 #undef REGISTER_FEATURE
 }
 
-MeshHandle Renderer::MeshLoaded(stl::vector<uint8_t>&& data)
+MeshHandle Renderer::MeshLoaded(const uint8_t* data, uint64_t size)
 {
-	if (data.size() < sizeof(MeshDataHeader))
+	if (size < sizeof(MeshDataHeader))
 	{
 		return MeshHandle(-1);
 	}
 	// TODO: move this code inside the mesh manager
-	MeshDataHeader* header = reinterpret_cast<MeshDataHeader*>(data.data());
+	const MeshDataHeader* header = reinterpret_cast<const MeshDataHeader*>(data);
 
 	Mesh newMesh;
 	newMesh.IndexCount = uint32_t(header->IndicesCount);
 	newMesh.VertexBuffer = m_Data.BufferManager.CreateStaticBuffer(
 		Backend::BufferUsage::Vertex,
 		uint32_t(header->VerticesCount * sizeof(MeshVertex)),
-		data.data() + sizeof(MeshDataHeader)
+		data + sizeof(MeshDataHeader)
 	);
 	newMesh.IndexBuffer = m_Data.BufferManager.CreateStaticBuffer(
 		Backend::BufferUsage::Index,
 		uint32_t(header->IndicesCount * sizeof(uint32_t)),
-		data.data() + sizeof(MeshDataHeader) + (header->VerticesCount * sizeof(MeshVertex))
+		data + sizeof(MeshDataHeader) + (header->VerticesCount * sizeof(MeshVertex))
 	);
 	// TODO: this ID must be the one returned from MaterialLoaded and not depend on internals of the material manager
 	newMesh.Material = header->MaterialIndex;
 	return m_Data.MeshManager.CreateMesh(newMesh);
 }
 
-MaterialHandle Renderer::MaterialLoaded(stl::vector<uint8_t>&& data)
+MaterialHandle Renderer::MaterialLoaded(const uint8_t* data, uint64_t size)
 {
-	return m_Data.MaterialManager.CreateMaterial(*reinterpret_cast<MaterialDataHeader*>(data.data()));
+	ASSERT_RETURN_VALUE(size >= sizeof(MaterialDataHeader), MaterialHandle(-1));
+	return m_Data.MaterialManager.CreateMaterial(*reinterpret_cast<const MaterialDataHeader*>(data));
 }
 
 TextureHandle Renderer::TextureLoaded(const uint8_t* data, uint64_t size)
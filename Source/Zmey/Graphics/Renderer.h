@@ -66,8 +66,8 @@ public:
 	UVector2 GetSwapChainSize();
 
 	// TODO: This is very weird to be here.
-	MeshHandle MeshLoaded(stl::vector<uint8_t>&& data);
-	MaterialHandle MaterialLoaded(stl::vector<uint8_t>&& data);
+	MeshHandle MeshLoaded(const uint8_t* data, uint64_t size);
+	MaterialHandle MaterialLoaded(const uint8_t* data, uint64_t size);
 	TextureHandle TextureLoaded(const uint8_t* data, uint64_t size);
 	TextureHandle UITextureLoaded(uint8_t* data, uint32_t width, uint32_t height);
 
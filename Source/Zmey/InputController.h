@@ -144,9 +144,9 @@ public:
 	InputController();
 	void DispatchActionEventsForFrame(float deltaTime);
 	ZMEY_API void AddListenerForAction(Zmey::Name actionName, uint8_t playerIndex, InputActionDelegate actionHandler);
-	ZMEY_API void RemoveListenerForAction(Zmey::Name actionName, uint8_t playerIndex, InputActionDelegate actionHandler);
-	/// <summary>
-	///  Causes a vibration on the gamepad connected with the specified player index
+	ZMEY_API void RemoveListenerForAction(Zmey::Name actionName, uint8_t playerIndex, InputActionDelegate actionHandler);
+	/// <summary>
+	///  Causes a vibration on the gamepad connected with the specified player index
 	/// </summary>
 	/// <param name = "playerIndex">The index of the gamepad which to fire.</param>
 	/// <param name = "leftMotorSpeed">The speed of the left motor, normalized between 0 and 1.</param>
@@ -154,6 +154,17 @@ public:
 	ZMEY_API void Vibrate(uint8_t playerIndex, float leftMotorSpeed, float rightMotorSpeed);
 	ZMEY_API static const uint8_t MaxPlayerCount = 8;
 
+	// Every world has a controller of its own. These route input to it wholesale - the state of the local
+	// devices from Modules.InputController or that of a remote player.
+	inline const InputState& GetPlayerState(uint8_t playerIndex) const
+	{
+		return m_CurrentState[playerIndex];
+	}
+	inline void SetPlayerState(uint8_t playerIndex, const InputState& state)
+	{
+		m_CurrentState[playerIndex] = state;
+	}
+
 	inline void SetButtonPressed(MouseButton button, bool isPressed)
 	{
 		m_CurrentState[MouseKeyboardPlayerIndex].MouseButtons[static_cast<uint8_t>(button)] = isPressed;
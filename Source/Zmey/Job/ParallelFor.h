@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+
+#include <Zmey/Job/JobSystem.h>
+
+namespace Zmey
+{
+namespace Job
+{
+namespace ParallelForDetail
+{
+constexpr uint32_t MaxBatches = 64u;
+
+template<typename Func>
+struct Batch
+{
+	const Func* Function;
+	uint32_t Begin;
+	uint32_t End;
+};
+
+template<typename Func>
+void RunBatch(void* data)
+{
+	auto batch = reinterpret_cast<Batch<Func>*>(data);
+	(*batch->Function)(batch->Begin, batch->End);
+}
+}
+
+// Splits [begin, end) into batches of at least minBatchSize elements and calls func(batchBegin, batchEnd)
+// for each of them in a separate job. Ranges that fit in a single batch are run right away on the calling job.
+// Can be called only from a Job as it waits for all batches to finish.
+template<typename Func>
+void ParallelFor(IJobSystem& jobSystem, const char* name, uint32_t begin, uint32_t end, uint32_t minBatchSize, const Func& func)
+{
+	using namespace ParallelForDetail;
+	if (begin >= end)
+	{
+		return;
+	}
+	const uint32_t count = end - begin;
+	const uint32_t batchSize = std::max(std::max(minBatchSize, 1u), (count + MaxBatches - 1u) / MaxBatches);
+	const uint32_t batchCount = (count + batchSize - 1u) / batchSize;
+	if (batchCount == 1u)
+	{
+		func(begin, end);
+		return;
+	}
+
+	Batch<Func> batches[MaxBatches];
+	JobDecl jobs[MaxBatches];
+	for (uint32_t i = 0u; i < batchCount; ++i)
+	{
+		batches[i].Function = &func;
+		batches[i].Begin = begin + i * batchSize;
+		batches[i].End = std::min(end, batches[i].Begin + batchSize);
+		jobs[i] = JobDecl{ &RunBatch<Func>, &batches[i] };
+	}
+	Counter counter;
+	jobSystem.RunJobs(name, jobs, batchCount, &counter);
+	jobSystem.WaitForCounter(&counter, 0);
+}
+
+}
+}
@@ -0,0 +1,231 @@
+#include <Zmey/Math/BatchMath.h>
+#include <Zmey/Math/BatchMathKernels.h>
+
+#include <atomic>
+
+#if defined(ZMEY_BATCHMATH_X86)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+		#include <immintrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+namespace Zmey
+{
+namespace BatchMath
+{
+namespace Detail
+{
+const KernelTable ScalarKernels = MakeKernelTable<ScalarOps>();
+}
+
+namespace
+{
+using namespace Detail;
+
+struct CpuFeatures
+{
+	bool SSE2 = false;
+	bool AVX2 = false;
+	bool AVX512 = false;
+};
+
+#if defined(ZMEY_BATCHMATH_X86)
+void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+{
+#if defined(_MSC_VER)
+	int result[4];
+	__cpuidex(result, int(leaf), int(subleaf));
+	for (int i = 0; i < 4; ++i)
+	{
+		registers[i] = uint32_t(result[i]);
+	}
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+uint64_t ReadXCR0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (uint64_t(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatures DetectCpuFeatures()
+{
+	enum Register { EAX, EBX, ECX, EDX };
+	CpuFeatures features;
+	uint32_t leaf0[4];
+	CpuId(0u, 0u, leaf0);
+	const uint32_t maxLeaf = leaf0[EAX];
+	uint32_t leaf1[4];
+	CpuId(1u, 0u, leaf1);
+	features.SSE2 = (leaf1[EDX] & (1u << 26)) != 0u;
+
+	// The wider registers are usable only if the OS saves them on context switch
+	const bool osxsave = (leaf1[ECX] & (1u << 27)) != 0u;
+	const bool avx = (leaf1[ECX] & (1u << 28)) != 0u;
+	const bool fma = (leaf1[ECX] & (1u << 12)) != 0u;
+	if (!osxsave || !avx || maxLeaf < 7u)
+	{
+		return features;
+	}
+	const uint64_t xcr0 = ReadXCR0();
+	const uint64_t ymmState = 0x6u; // SSE and AVX
+	const uint64_t zmmState = 0xE0u; // Opmask and the upper halves of zmm0-15 and zmm16-31
+	uint32_t leaf7[4];
+	CpuId(7u, 0u, leaf7);
+	const bool avx2 = (leaf7[EBX] & (1u << 5)) != 0u;
+	const bool avx512f = (leaf7[EBX] & (1u << 16)) != 0u;
+	features.AVX2 = avx2 && fma && (xcr0 & ymmState) == ymmState;
+	features.AVX512 = features.AVX2 && avx512f && (xcr0 & (ymmState | zmmState)) == (ymmState | zmmState);
+	return features;
+}
+#else
+CpuFeatures DetectCpuFeatures()
+{
+	return CpuFeatures{};
+}
+#endif
+
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
+
+const KernelTable* GetKernels(InstructionSet set)
+{
+	switch (set)
+	{
+#if defined(ZMEY_BATCHMATH_X86)
+	case InstructionSet::SSE2:
+		return &SSE2Kernels;
+	case InstructionSet::AVX2:
+		return &AVX2Kernels;
+	case InstructionSet::AVX512:
+		return &AVX512Kernels;
+#endif
+	default:
+		return &ScalarKernels;
+	}
+}
+
+InstructionSet DetectInstructionSet()
+{
+	const InstructionSet preferred[] = { InstructionSet::AVX512, InstructionSet::AVX2, InstructionSet::SSE2 };
+	for (auto set : preferred)
+	{
+		if (IsSupported(set))
+		{
+			return set;
+		}
+	}
+	return InstructionSet::Scalar;
+}
+
+std::atomic<int> GInstructionSet{ -1 };
+
+InstructionSet CurrentInstructionSet()
+{
+	int set = GInstructionSet.load(std::memory_order_relaxed);
+	if (set < 0)
+	{
+		// Racing threads detect the same thing so it doesn't matter who stores it
+		set = int(DetectInstructionSet());
+		GInstructionSet.store(set, std::memory_order_relaxed);
+	}
+	return InstructionSet(set);
+}
+
+inline const KernelTable& Kernels()
+{
+	return *GetKernels(CurrentInstructionSet());
+}
+}
+
+InstructionSet GetInstructionSet()
+{
+	return CurrentInstructionSet();
+}
+
+bool IsSupported(InstructionSet set)
+{
+	const CpuFeatures& features = GetCpuFeatures();
+	switch (set)
+	{
+	case InstructionSet::Scalar:
+		return true;
+	case InstructionSet::SSE2:
+		return features.SSE2;
+	case InstructionSet::AVX2:
+		return features.AVX2;
+	case InstructionSet::AVX512:
+		return features.AVX512;
+	default:
+		return false;
+	}
+}
+
+bool SetInstructionSet(InstructionSet set)
+{
+	if (!IsSupported(set))
+	{
+		return false;
+	}
+	GInstructionSet.store(int(set), std::memory_order_relaxed);
+	return true;
+}
+
+// The SIMD kernels leave out the elements that don't fill a whole register, the scalar ones finish them
+void ComposeTransforms(const Vector3* positions, const Quaternion* rotations, const Vector3* scales, Matrix4x4* out, size_t count)
+{
+	const size_t done = Kernels().ComposeTransforms(positions, rotations, scales, out, count);
+	ScalarKernels.ComposeTransforms(positions + done, rotations + done, scales + done, out + done, count - done);
+}
+
+void MultiplyMatrices(const Matrix4x4* lhs, const Matrix4x4* rhs, Matrix4x4* out, size_t count)
+{
+	const size_t done = Kernels().MultiplyMatrices(lhs, rhs, out, count);
+	ScalarKernels.MultiplyMatrices(lhs + done, rhs + done, out + done, count - done);
+}
+
+void MultiplyQuaternions(const Quaternion* lhs, const Quaternion* rhs, Quaternion* out, size_t count)
+{
+	const size_t done = Kernels().MultiplyQuaternions(lhs, rhs, out, count);
+	ScalarKernels.MultiplyQuaternions(lhs + done, rhs + done, out + done, count - done);
+}
+
+void NormalizeQuaternions(const Quaternion* in, Quaternion* out, size_t count)
+{
+	const size_t done = Kernels().NormalizeQuaternions(in, out, count);
+	ScalarKernels.NormalizeQuaternions(in + done, out + done, count - done);
+}
+
+void TransformPoints(const Matrix4x4& matrix, const Vector3* points, Vector3* out, size_t count)
+{
+	const size_t done = Kernels().TransformPoints(matrix, points, out, count);
+	ScalarKernels.TransformPoints(matrix, points + done, out + done, count - done);
+}
+
+void TransformAABBs(const Matrix4x4* matrices, const AABB* boxes, AABB* out, size_t count)
+{
+	const size_t done = Kernels().TransformAABBs(matrices, boxes, out, count);
+	ScalarKernels.TransformAABBs(matrices + done, boxes + done, out + done, count - done);
+}
+
+void FrustumTestAABBs(const Frustum& frustum, const AABB* boxes, uint8_t* visible, size_t count)
+{
+	const size_t done = Kernels().FrustumTestAABBs(frustum, boxes, visible, count);
+	ScalarKernels.FrustumTestAABBs(frustum, boxes + done, visible + done, count - done);
+}
+
+}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include <Zmey/Config.h>
+#include <Zmey/Math/Math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define ZMEY_BATCHMATH_X86 1
+#endif
+
+namespace Zmey
+{
+// Math over whole arrays of the engine's math types, e.g. the packed component data.
+// Each function has SSE2, AVX2 and AVX-512 versions and the widest one the CPU supports is picked on first use.
+// The scalar version is the fallback for other CPUs and for the elements that don't fill a whole SIMD register.
+// Unless stated otherwise the output may not overlap the inputs.
+namespace BatchMath
+{
+enum class InstructionSet : uint8_t
+{
+	Scalar,
+	SSE2,
+	AVX2,
+	AVX512,
+};
+ZMEY_API InstructionSet GetInstructionSet();
+ZMEY_API bool IsSupported(InstructionSet set);
+// Forces a specific version, meant for comparing them. Returns false if the CPU doesn't support it.
+ZMEY_API bool SetInstructionSet(InstructionSet set);
+
+// out[i] = translate(positions[i]) * toMat4(rotations[i]) * scale(scales[i])
+ZMEY_API void ComposeTransforms(const Vector3* positions, const Quaternion* rotations, const Vector3* scales, Matrix4x4* out, size_t count);
+// out[i] = lhs[i] * rhs[i], out may be the same array as either input
+ZMEY_API void MultiplyMatrices(const Matrix4x4* lhs, const Matrix4x4* rhs, Matrix4x4* out, size_t count);
+// out[i] = lhs[i] * rhs[i], out may be the same array as either input
+ZMEY_API void MultiplyQuaternions(const Quaternion* lhs, const Quaternion* rhs, Quaternion* out, size_t count);
+// out may be the same array as in, zero length quaternions become the identity
+ZMEY_API void NormalizeQuaternions(const Quaternion* in, Quaternion* out, size_t count);
+// out[i] = matrix * (points[i], 1), out may be the same array as points
+ZMEY_API void TransformPoints(const Matrix4x4& matrix, const Vector3* points, Vector3* out, size_t count);
+// out[i] is the box containing boxes[i] transformed by matrices[i], out may be the same array as boxes
+ZMEY_API void TransformAABBs(const Matrix4x4* matrices, const AABB* boxes, AABB* out, size_t count);
+// visible[i] is 1 if boxes[i] is at least partially inside the frustum and 0 otherwise.
+// Conservative - boxes near the frustum corners may pass without intersecting it.
+ZMEY_API void FrustumTestAABBs(const Frustum& frustum, const AABB* boxes, uint8_t* visible, size_t count);
+}
+}
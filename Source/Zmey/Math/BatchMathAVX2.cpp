@@ -0,0 +1,121 @@
+#include <cmath>
+#include <Zmey/Math/BatchMath.h>
+
+#if defined(ZMEY_BATCHMATH_X86)
+#include <immintrin.h>
+
+// MSVC exposes every intrinsic regardless of /arch, GCC and clang need the instruction set enabled.
+// The kernel templates get compiled for the target in effect where they are defined so their header goes
+// after the pragma, everything else is included before it so that shared inline code stays on the baseline.
+#if defined(__GNUC__) && !defined(__AVX2__)
+	#pragma GCC push_options
+	#pragma GCC target("avx2,fma")
+	#define ZMEY_BATCHMATH_POP_OPTIONS
+#endif
+#include <Zmey/Math/BatchMathKernels.h>
+
+namespace Zmey
+{
+namespace BatchMath
+{
+namespace Detail
+{
+namespace
+{
+struct AVX2Ops
+{
+	using Float = __m256;
+	using Mask = __m256;
+	static constexpr size_t Lanes = 8u;
+
+	static inline Float Set1(float value) { return _mm256_set1_ps(value); }
+	static inline Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static inline Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static inline Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static inline Float MulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+	static inline Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+	static inline Float Sqrt(Float a) { return _mm256_sqrt_ps(a); }
+	static inline Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+	static inline Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+	static inline Float Abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+	static inline Float Select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+	static inline Mask GreaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+	static inline Mask GreaterThan(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static inline Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	static inline void StoreMask(uint8_t* out, Mask mask)
+	{
+		const int bits = _mm256_movemask_ps(mask);
+		for (size_t lane = 0u; lane < Lanes; ++lane)
+		{
+			out[lane] = uint8_t((bits >> lane) & 1);
+		}
+	}
+	static inline __m256i Indices(size_t stride)
+	{
+		return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int(stride)));
+	}
+	static inline Float Gather(const float* base, size_t stride)
+	{
+		return _mm256_i32gather_ps(base, Indices(stride), sizeof(float));
+	}
+	// No scatter before AVX-512
+	static inline void Scatter(float* base, size_t stride, Float value)
+	{
+		alignas(32) float lanes[Lanes];
+		_mm256_store_ps(lanes, value);
+		for (size_t lane = 0u; lane < Lanes; ++lane)
+		{
+			base[lane * stride] = lanes[lane];
+		}
+	}
+	// Transposes the 4x4 blocks in both 128-bit halves
+	static inline void Transpose(Float& a, Float& b, Float& c, Float& d)
+	{
+		const Float t0 = _mm256_unpacklo_ps(a, b);
+		const Float t1 = _mm256_unpacklo_ps(c, d);
+		const Float t2 = _mm256_unpackhi_ps(a, b);
+		const Float t3 = _mm256_unpackhi_ps(c, d);
+		a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+	// Lanes i and i + 4 share a register so that the per-half transpose puts every lane in place
+	static inline Float LoadPair(const float* base, size_t stride, size_t lane)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(base + lane * stride)), _mm_loadu_ps(base + (lane + 4u) * stride), 1);
+	}
+	static inline void StorePair(float* base, size_t stride, size_t lane, Float value)
+	{
+		_mm_storeu_ps(base + lane * stride, _mm256_castps256_ps128(value));
+		_mm_storeu_ps(base + (lane + 4u) * stride, _mm256_extractf128_ps(value, 1));
+	}
+	static inline void Load4(const float* base, size_t stride, Float& a, Float& b, Float& c, Float& d)
+	{
+		a = LoadPair(base, stride, 0u);
+		b = LoadPair(base, stride, 1u);
+		c = LoadPair(base, stride, 2u);
+		d = LoadPair(base, stride, 3u);
+		Transpose(a, b, c, d);
+	}
+	static inline void Store4(float* base, size_t stride, Float a, Float b, Float c, Float d)
+	{
+		Transpose(a, b, c, d);
+		StorePair(base, stride, 0u, a);
+		StorePair(base, stride, 1u, b);
+		StorePair(base, stride, 2u, c);
+		StorePair(base, stride, 3u, d);
+	}
+};
+}
+
+const KernelTable AVX2Kernels = MakeKernelTable<AVX2Ops>();
+}
+}
+}
+
+#if defined(ZMEY_BATCHMATH_POP_OPTIONS)
+	#pragma GCC pop_options
+	#undef ZMEY_BATCHMATH_POP_OPTIONS
+#endif
+#endif
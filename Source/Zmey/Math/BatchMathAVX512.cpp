@@ -0,0 +1,118 @@
+#include <cmath>
+#include <Zmey/Math/BatchMath.h>
+
+#if defined(ZMEY_BATCHMATH_X86)
+#include <immintrin.h>
+
+// See BatchMathAVX2.cpp for why the kernels header goes after the pragma
+#if defined(__GNUC__) && !defined(__AVX512F__)
+	#pragma GCC push_options
+	#pragma GCC target("avx512f,avx2,fma")
+	#define ZMEY_BATCHMATH_POP_OPTIONS
+#endif
+#include <Zmey/Math/BatchMathKernels.h>
+
+namespace Zmey
+{
+namespace BatchMath
+{
+namespace Detail
+{
+namespace
+{
+// Sticks to AVX-512F so that it runs on every AVX-512 CPU
+struct AVX512Ops
+{
+	using Float = __m512;
+	using Mask = __mmask16;
+	static constexpr size_t Lanes = 16u;
+
+	static inline Float Set1(float value) { return _mm512_set1_ps(value); }
+	static inline Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+	static inline Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+	static inline Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+	static inline Float MulAdd(Float a, Float b, Float c) { return _mm512_fmadd_ps(a, b, c); }
+	static inline Float Div(Float a, Float b) { return _mm512_div_ps(a, b); }
+	static inline Float Sqrt(Float a) { return _mm512_sqrt_ps(a); }
+	static inline Float Min(Float a, Float b) { return _mm512_min_ps(a, b); }
+	static inline Float Max(Float a, Float b) { return _mm512_max_ps(a, b); }
+	static inline Float Abs(Float a)
+	{
+		return _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a), _mm512_set1_epi32(0x7FFFFFFF)));
+	}
+	static inline Float Select(Mask mask, Float a, Float b) { return _mm512_mask_blend_ps(mask, b, a); }
+	static inline Mask GreaterEqual(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+	static inline Mask GreaterThan(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static inline Mask And(Mask a, Mask b) { return Mask(a & b); }
+	static inline void StoreMask(uint8_t* out, Mask mask)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm512_cvtepi32_epi8(_mm512_maskz_set1_epi32(mask, 1)));
+	}
+	static inline __m512i Indices(size_t stride)
+	{
+		return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(int(stride)));
+	}
+	static inline Float Gather(const float* base, size_t stride)
+	{
+		return _mm512_i32gather_ps(Indices(stride), base, sizeof(float));
+	}
+	static inline void Scatter(float* base, size_t stride, Float value)
+	{
+		_mm512_i32scatter_ps(base, Indices(stride), value, sizeof(float));
+	}
+	// Transposes the 4x4 blocks in all four 128-bit quarters
+	static inline void Transpose(Float& a, Float& b, Float& c, Float& d)
+	{
+		const Float t0 = _mm512_unpacklo_ps(a, b);
+		const Float t1 = _mm512_unpacklo_ps(c, d);
+		const Float t2 = _mm512_unpackhi_ps(a, b);
+		const Float t3 = _mm512_unpackhi_ps(c, d);
+		a = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
+	// Lanes i, i + 4, i + 8 and i + 12 share a register so that the per-quarter transpose puts every lane in place
+	static inline Float LoadQuad(const float* base, size_t stride, size_t lane)
+	{
+		Float result = _mm512_castps128_ps512(_mm_loadu_ps(base + lane * stride));
+		result = _mm512_insertf32x4(result, _mm_loadu_ps(base + (lane + 4u) * stride), 1);
+		result = _mm512_insertf32x4(result, _mm_loadu_ps(base + (lane + 8u) * stride), 2);
+		return _mm512_insertf32x4(result, _mm_loadu_ps(base + (lane + 12u) * stride), 3);
+	}
+	static inline void StoreQuad(float* base, size_t stride, size_t lane, Float value)
+	{
+		_mm_storeu_ps(base + lane * stride, _mm512_castps512_ps128(value));
+		_mm_storeu_ps(base + (lane + 4u) * stride, _mm512_extractf32x4_ps(value, 1));
+		_mm_storeu_ps(base + (lane + 8u) * stride, _mm512_extractf32x4_ps(value, 2));
+		_mm_storeu_ps(base + (lane + 12u) * stride, _mm512_extractf32x4_ps(value, 3));
+	}
+	static inline void Load4(const float* base, size_t stride, Float& a, Float& b, Float& c, Float& d)
+	{
+		a = LoadQuad(base, stride, 0u);
+		b = LoadQuad(base, stride, 1u);
+		c = LoadQuad(base, stride, 2u);
+		d = LoadQuad(base, stride, 3u);
+		Transpose(a, b, c, d);
+	}
+	static inline void Store4(float* base, size_t stride, Float a, Float b, Float c, Float d)
+	{
+		Transpose(a, b, c, d);
+		StoreQuad(base, stride, 0u, a);
+		StoreQuad(base, stride, 1u, b);
+		StoreQuad(base, stride, 2u, c);
+		StoreQuad(base, stride, 3u, d);
+	}
+};
+}
+
+const KernelTable AVX512Kernels = MakeKernelTable<AVX512Ops>();
+}
+}
+}
+
+#if defined(ZMEY_BATCHMATH_POP_OPTIONS)
+	#pragma GCC pop_options
+	#undef ZMEY_BATCHMATH_POP_OPTIONS
+#endif
+#endif
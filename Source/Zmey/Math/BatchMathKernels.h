@@ -0,0 +1,356 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <Zmey/Math/BatchMath.h>
+
+// Internal to the BatchMath implementation.
+// Every kernel is written once against an Ops type that wraps one instruction set and processes
+// Ops::Lanes elements at a time - the elements are spread across the SIMD lanes, so the same code
+// serves 1 (scalar), 4 (SSE2), 8 (AVX2) and 16 (AVX-512) elements per iteration.
+// Kernels process count rounded down to a multiple of Lanes and return how many elements that was,
+// the rest is left to the scalar kernels.
+// Ops provides:
+//  Float, Mask, Lanes
+//  Set1, Add, Sub, Mul, MulAdd (a * b + c), Div, Sqrt, Min, Max, Abs, Select (mask ? a : b)
+//  GreaterEqual, GreaterThan, And, StoreMask (one 0/1 byte per lane)
+//  Gather/Scatter - one float per lane, lane i at base[i * stride]
+//  Load4/Store4 - four consecutive floats per lane, lane i at base + i * stride
+namespace Zmey
+{
+namespace BatchMath
+{
+namespace Detail
+{
+struct KernelTable
+{
+	size_t(*ComposeTransforms)(const Vector3*, const Quaternion*, const Vector3*, Matrix4x4*, size_t);
+	size_t(*MultiplyMatrices)(const Matrix4x4*, const Matrix4x4*, Matrix4x4*, size_t);
+	size_t(*MultiplyQuaternions)(const Quaternion*, const Quaternion*, Quaternion*, size_t);
+	size_t(*NormalizeQuaternions)(const Quaternion*, Quaternion*, size_t);
+	size_t(*TransformPoints)(const Matrix4x4&, const Vector3*, Vector3*, size_t);
+	size_t(*TransformAABBs)(const Matrix4x4*, const AABB*, AABB*, size_t);
+	size_t(*FrustumTestAABBs)(const Frustum&, const AABB*, uint8_t*, size_t);
+};
+
+extern const KernelTable ScalarKernels;
+#if defined(ZMEY_BATCHMATH_X86)
+extern const KernelTable SSE2Kernels;
+extern const KernelTable AVX2Kernels;
+extern const KernelTable AVX512Kernels;
+#endif
+
+struct ScalarOps
+{
+	using Float = float;
+	using Mask = bool;
+	static constexpr size_t Lanes = 1u;
+
+	static inline Float Set1(float value) { return value; }
+	static inline Float Add(Float a, Float b) { return a + b; }
+	static inline Float Sub(Float a, Float b) { return a - b; }
+	static inline Float Mul(Float a, Float b) { return a * b; }
+	static inline Float MulAdd(Float a, Float b, Float c) { return a * b + c; }
+	static inline Float Div(Float a, Float b) { return a / b; }
+	static inline Float Sqrt(Float a) { return std::sqrt(a); }
+	static inline Float Min(Float a, Float b) { return a < b ? a : b; }
+	static inline Float Max(Float a, Float b) { return a > b ? a : b; }
+	static inline Float Abs(Float a) { return std::fabs(a); }
+	static inline Float Select(Mask mask, Float a, Float b) { return mask ? a : b; }
+	static inline Mask GreaterEqual(Float a, Float b) { return a >= b; }
+	static inline Mask GreaterThan(Float a, Float b) { return a > b; }
+	static inline Mask And(Mask a, Mask b) { return a && b; }
+	static inline void StoreMask(uint8_t* out, Mask mask) { *out = mask ? 1u : 0u; }
+	static inline Float Gather(const float* base, size_t) { return *base; }
+	static inline void Scatter(float* base, size_t, Float value) { *base = value; }
+	static inline void Load4(const float* base, size_t, Float& a, Float& b, Float& c, Float& d)
+	{
+		a = base[0];
+		b = base[1];
+		c = base[2];
+		d = base[3];
+	}
+	static inline void Store4(float* base, size_t, Float a, Float b, Float c, Float d)
+	{
+		base[0] = a;
+		base[1] = b;
+		base[2] = c;
+		base[3] = d;
+	}
+};
+
+// Strides in floats
+constexpr size_t Vector3Stride = sizeof(Vector3) / sizeof(float);
+constexpr size_t QuaternionStride = sizeof(Quaternion) / sizeof(float);
+constexpr size_t MatrixStride = sizeof(Matrix4x4) / sizeof(float);
+constexpr size_t AABBStride = sizeof(AABB) / sizeof(float);
+static_assert(Vector3Stride == 3u && QuaternionStride == 4u && MatrixStride == 16u && AABBStride == 6u, "Unexpected math type layout");
+
+inline const float* Floats(const void* ptr)
+{
+	return reinterpret_cast<const float*>(ptr);
+}
+inline float* Floats(void* ptr)
+{
+	return reinterpret_cast<float*>(ptr);
+}
+
+template<typename Ops>
+struct Matrix
+{
+	// Column major, same as glm
+	typename Ops::Float M[4][4];
+
+	inline void Load(const Matrix4x4* matrices)
+	{
+		for (int column = 0; column < 4; ++column)
+		{
+			Ops::Load4(Floats(&matrices[0][column]), MatrixStride, M[column][0], M[column][1], M[column][2], M[column][3]);
+		}
+	}
+};
+
+template<typename Ops>
+size_t ComposeTransforms(const Vector3* positions, const Quaternion* rotations, const Vector3* scales, Matrix4x4* out, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	const F one = Ops::Set1(1.f);
+	const F two = Ops::Set1(2.f);
+	const F zero = Ops::Set1(0.f);
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		F x, y, z, w;
+		Ops::Load4(Floats(rotations + i), QuaternionStride, x, y, z, w);
+		const F x2 = Ops::Mul(x, two), y2 = Ops::Mul(y, two), z2 = Ops::Mul(z, two);
+		const F xx = Ops::Mul(x, x2), yy = Ops::Mul(y, y2), zz = Ops::Mul(z, z2);
+		const F xy = Ops::Mul(x, y2), xz = Ops::Mul(x, z2), yz = Ops::Mul(y, z2);
+		const F wx = Ops::Mul(w, x2), wy = Ops::Mul(w, y2), wz = Ops::Mul(w, z2);
+
+		const float* scale = Floats(scales + i);
+		const F sx = Ops::Gather(scale + 0, Vector3Stride);
+		const F sy = Ops::Gather(scale + 1, Vector3Stride);
+		const F sz = Ops::Gather(scale + 2, Vector3Stride);
+		float* matrix = Floats(out + i);
+		Ops::Store4(matrix + 0, MatrixStride,
+			Ops::Mul(Ops::Sub(one, Ops::Add(yy, zz)), sx),
+			Ops::Mul(Ops::Add(xy, wz), sx),
+			Ops::Mul(Ops::Sub(xz, wy), sx),
+			zero);
+		Ops::Store4(matrix + 4, MatrixStride,
+			Ops::Mul(Ops::Sub(xy, wz), sy),
+			Ops::Mul(Ops::Sub(one, Ops::Add(xx, zz)), sy),
+			Ops::Mul(Ops::Add(yz, wx), sy),
+			zero);
+		Ops::Store4(matrix + 8, MatrixStride,
+			Ops::Mul(Ops::Add(xz, wy), sz),
+			Ops::Mul(Ops::Sub(yz, wx), sz),
+			Ops::Mul(Ops::Sub(one, Ops::Add(xx, yy)), sz),
+			zero);
+
+		const float* position = Floats(positions + i);
+		Ops::Store4(matrix + 12, MatrixStride,
+			Ops::Gather(position + 0, Vector3Stride),
+			Ops::Gather(position + 1, Vector3Stride),
+			Ops::Gather(position + 2, Vector3Stride),
+			one);
+	}
+	return end;
+}
+
+template<typename Ops>
+size_t MultiplyMatrices(const Matrix4x4* lhs, const Matrix4x4* rhs, Matrix4x4* out, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		Matrix<Ops> a;
+		a.Load(lhs + i);
+		// lhs is read whole and each column of the result depends only on the same column of rhs, so out may alias either
+		for (int column = 0; column < 4; ++column)
+		{
+			F b0, b1, b2, b3;
+			Ops::Load4(Floats(&rhs[i][column]), MatrixStride, b0, b1, b2, b3);
+			F result[4];
+			for (int row = 0; row < 4; ++row)
+			{
+				result[row] = Ops::MulAdd(a.M[3][row], b3, Ops::MulAdd(a.M[2][row], b2, Ops::MulAdd(a.M[1][row], b1, Ops::Mul(a.M[0][row], b0))));
+			}
+			Ops::Store4(Floats(&out[i][column]), MatrixStride, result[0], result[1], result[2], result[3]);
+		}
+	}
+	return end;
+}
+
+template<typename Ops>
+size_t MultiplyQuaternions(const Quaternion* lhs, const Quaternion* rhs, Quaternion* out, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		F ax, ay, az, aw, bx, by, bz, bw;
+		Ops::Load4(Floats(lhs + i), QuaternionStride, ax, ay, az, aw);
+		Ops::Load4(Floats(rhs + i), QuaternionStride, bx, by, bz, bw);
+		const F x = Ops::Sub(Ops::MulAdd(aw, bx, Ops::MulAdd(ax, bw, Ops::Mul(ay, bz))), Ops::Mul(az, by));
+		const F y = Ops::Sub(Ops::MulAdd(aw, by, Ops::MulAdd(ay, bw, Ops::Mul(az, bx))), Ops::Mul(ax, bz));
+		const F z = Ops::Sub(Ops::MulAdd(aw, bz, Ops::MulAdd(az, bw, Ops::Mul(ax, by))), Ops::Mul(ay, bx));
+		const F w = Ops::Sub(Ops::Mul(aw, bw), Ops::MulAdd(ax, bx, Ops::MulAdd(ay, by, Ops::Mul(az, bz))));
+		Ops::Store4(Floats(out + i), QuaternionStride, x, y, z, w);
+	}
+	return end;
+}
+
+template<typename Ops>
+size_t NormalizeQuaternions(const Quaternion* in, Quaternion* out, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	const F zero = Ops::Set1(0.f);
+	const F one = Ops::Set1(1.f);
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		F x, y, z, w;
+		Ops::Load4(Floats(in + i), QuaternionStride, x, y, z, w);
+		const F length = Ops::Sqrt(Ops::MulAdd(x, x, Ops::MulAdd(y, y, Ops::MulAdd(z, z, Ops::Mul(w, w)))));
+		// Like glm, zero length quaternions become the identity
+		const auto valid = Ops::GreaterThan(length, zero);
+		const F inverse = Ops::Select(valid, Ops::Div(one, length), zero);
+		Ops::Store4(Floats(out + i), QuaternionStride,
+			Ops::Mul(x, inverse),
+			Ops::Mul(y, inverse),
+			Ops::Mul(z, inverse),
+			Ops::Select(valid, Ops::Mul(w, inverse), one));
+	}
+	return end;
+}
+
+template<typename Ops>
+size_t TransformPoints(const Matrix4x4& matrix, const Vector3* points, Vector3* out, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	F m[4][3];
+	for (int column = 0; column < 4; ++column)
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			m[column][row] = Ops::Set1(matrix[column][row]);
+		}
+	}
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		const float* point = Floats(points + i);
+		const F x = Ops::Gather(point + 0, Vector3Stride);
+		const F y = Ops::Gather(point + 1, Vector3Stride);
+		const F z = Ops::Gather(point + 2, Vector3Stride);
+		float* result = Floats(out + i);
+		for (int row = 0; row < 3; ++row)
+		{
+			Ops::Scatter(result + row, Vector3Stride, Ops::MulAdd(m[0][row], x, Ops::MulAdd(m[1][row], y, Ops::MulAdd(m[2][row], z, m[3][row]))));
+		}
+	}
+	return end;
+}
+
+template<typename Ops>
+size_t TransformAABBs(const Matrix4x4* matrices, const AABB* boxes, AABB* out, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	const F half = Ops::Set1(0.5f);
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		Matrix<Ops> m;
+		m.Load(matrices + i);
+		const float* box = Floats(boxes + i);
+		F center[3], extent[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const F min = Ops::Gather(box + axis, AABBStride);
+			const F max = Ops::Gather(box + 3 + axis, AABBStride);
+			center[axis] = Ops::Mul(Ops::Add(min, max), half);
+			extent[axis] = Ops::Mul(Ops::Sub(max, min), half);
+		}
+		// The new center is the transformed center, the new extent along each axis is the sum of the
+		// old extents projected on it
+		float* result = Floats(out + i);
+		for (int row = 0; row < 3; ++row)
+		{
+			const F newCenter = Ops::MulAdd(m.M[0][row], center[0], Ops::MulAdd(m.M[1][row], center[1], Ops::MulAdd(m.M[2][row], center[2], m.M[3][row])));
+			const F newExtent = Ops::MulAdd(Ops::Abs(m.M[0][row]), extent[0], Ops::MulAdd(Ops::Abs(m.M[1][row]), extent[1], Ops::Mul(Ops::Abs(m.M[2][row]), extent[2])));
+			Ops::Scatter(result + row, AABBStride, Ops::Sub(newCenter, newExtent));
+			Ops::Scatter(result + 3 + row, AABBStride, Ops::Add(newCenter, newExtent));
+		}
+	}
+	return end;
+}
+
+template<typename Ops>
+size_t FrustumTestAABBs(const Frustum& frustum, const AABB* boxes, uint8_t* visible, size_t count)
+{
+	using F = typename Ops::Float;
+	const size_t end = count / Ops::Lanes * Ops::Lanes;
+	const F half = Ops::Set1(0.5f);
+	const F zero = Ops::Set1(0.f);
+	F planes[Frustum::PlaneCount][4];
+	F absNormals[Frustum::PlaneCount][3];
+	for (int plane = 0; plane < Frustum::PlaneCount; ++plane)
+	{
+		for (int component = 0; component < 4; ++component)
+		{
+			planes[plane][component] = Ops::Set1(frustum.Planes[plane][component]);
+		}
+		for (int component = 0; component < 3; ++component)
+		{
+			absNormals[plane][component] = Ops::Set1(std::fabs(frustum.Planes[plane][component]));
+		}
+	}
+	for (size_t i = 0u; i < end; i += Ops::Lanes)
+	{
+		const float* box = Floats(boxes + i);
+		F center[3], extent[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const F min = Ops::Gather(box + axis, AABBStride);
+			const F max = Ops::Gather(box + 3 + axis, AABBStride);
+			center[axis] = Ops::Mul(Ops::Add(min, max), half);
+			extent[axis] = Ops::Mul(Ops::Sub(max, min), half);
+		}
+		// Signed distance of the center plus the box radius along the plane normal
+		auto inFront = [&](int plane)
+		{
+			const F distance = Ops::MulAdd(planes[plane][0], center[0], Ops::MulAdd(planes[plane][1], center[1], Ops::MulAdd(planes[plane][2], center[2], planes[plane][3])));
+			const F radius = Ops::MulAdd(absNormals[plane][0], extent[0], Ops::MulAdd(absNormals[plane][1], extent[1], Ops::Mul(absNormals[plane][2], extent[2])));
+			return Ops::GreaterEqual(Ops::Add(distance, radius), zero);
+		};
+		auto inside = inFront(0);
+		for (int plane = 1; plane < Frustum::PlaneCount; ++plane)
+		{
+			inside = Ops::And(inside, inFront(plane));
+		}
+		Ops::StoreMask(visible + i, inside);
+	}
+	return end;
+}
+
+// constexpr so that the tables are initialized statically and usable during static initialization
+template<typename Ops>
+constexpr KernelTable MakeKernelTable()
+{
+	return KernelTable{
+		&ComposeTransforms<Ops>,
+		&MultiplyMatrices<Ops>,
+		&MultiplyQuaternions<Ops>,
+		&NormalizeQuaternions<Ops>,
+		&TransformPoints<Ops>,
+		&TransformAABBs<Ops>,
+		&FrustumTestAABBs<Ops>,
+	};
+}
+
+}
+}
+}
@@ -0,0 +1,116 @@
+#include <Zmey/Math/BatchMathKernels.h>
+
+#if defined(ZMEY_BATCHMATH_X86)
+#include <emmintrin.h>
+
+namespace Zmey
+{
+namespace BatchMath
+{
+namespace Detail
+{
+namespace
+{
+struct SSE2Ops
+{
+	using Float = __m128;
+	using Mask = __m128;
+	static constexpr size_t Lanes = 4u;
+
+	static inline Float Set1(float value) { return _mm_set1_ps(value); }
+	static inline Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+	static inline Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	static inline Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+	static inline Float MulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	static inline Float Div(Float a, Float b) { return _mm_div_ps(a, b); }
+	static inline Float Sqrt(Float a) { return _mm_sqrt_ps(a); }
+	static inline Float Min(Float a, Float b) { return _mm_min_ps(a, b); }
+	static inline Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+	static inline Float Abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+	static inline Float Select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static inline Mask GreaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+	static inline Mask GreaterThan(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+	static inline Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	static inline void StoreMask(uint8_t* out, Mask mask)
+	{
+		const int bits = _mm_movemask_ps(mask);
+		for (size_t lane = 0u; lane < Lanes; ++lane)
+		{
+			out[lane] = uint8_t((bits >> lane) & 1);
+		}
+	}
+	// SSE2 has no gather or scatter, the compiler turns these into scalar loads and stores
+	static inline Float Gather(const float* base, size_t stride)
+	{
+		return _mm_setr_ps(base[0], base[stride], base[2 * stride], base[3 * stride]);
+	}
+	static inline void Scatter(float* base, size_t stride, Float value)
+	{
+		alignas(16) float lanes[Lanes];
+		_mm_store_ps(lanes, value);
+		for (size_t lane = 0u; lane < Lanes; ++lane)
+		{
+			base[lane * stride] = lanes[lane];
+		}
+	}
+	static inline void Load4(const float* base, size_t stride, Float& a, Float& b, Float& c, Float& d)
+	{
+		a = _mm_loadu_ps(base);
+		b = _mm_loadu_ps(base + stride);
+		c = _mm_loadu_ps(base + 2 * stride);
+		d = _mm_loadu_ps(base + 3 * stride);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+	}
+	static inline void Store4(float* base, size_t stride, Float a, Float b, Float c, Float d)
+	{
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		_mm_storeu_ps(base, a);
+		_mm_storeu_ps(base + stride, b);
+		_mm_storeu_ps(base + 2 * stride, c);
+		_mm_storeu_ps(base + 3 * stride, d);
+	}
+};
+
+// Spreading the matrices over the lanes needs all of lhs in registers and SSE2 has only 8 or 16 of them,
+// the classic one matrix at a time version is faster
+size_t MultiplyMatricesSSE2(const Matrix4x4* lhs, const Matrix4x4* rhs, Matrix4x4* out, size_t count)
+{
+	for (size_t i = 0u; i < count; ++i)
+	{
+		const float* a = Floats(lhs + i);
+		const __m128 a0 = _mm_loadu_ps(a);
+		const __m128 a1 = _mm_loadu_ps(a + 4);
+		const __m128 a2 = _mm_loadu_ps(a + 8);
+		const __m128 a3 = _mm_loadu_ps(a + 12);
+		for (int column = 0; column < 4; ++column)
+		{
+			const float* b = Floats(&rhs[i][column]);
+			__m128 result = _mm_mul_ps(a0, _mm_set1_ps(b[0]));
+			result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(b[1])));
+			result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(b[2])));
+			result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(b[3])));
+			_mm_storeu_ps(Floats(&out[i][column]), result);
+		}
+	}
+	return count;
+}
+
+constexpr KernelTable MakeSSE2KernelTable()
+{
+	return KernelTable{
+		&ComposeTransforms<SSE2Ops>,
+		&MultiplyMatricesSSE2,
+		&MultiplyQuaternions<SSE2Ops>,
+		&NormalizeQuaternions<SSE2Ops>,
+		&TransformPoints<SSE2Ops>,
+		&TransformAABBs<SSE2Ops>,
+		&FrustumTestAABBs<SSE2Ops>,
+	};
+}
+}
+
+const KernelTable SSE2Kernels = MakeSSE2KernelTable();
+}
+}
+}
+#endif
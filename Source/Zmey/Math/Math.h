@@ -20,11 +20,47 @@ using Matrix4x4 = glm::mat4x4;
 // TODO: Refactor into own header
 using Color = glm::vec4;
 
+struct AABB
+{
+	Vector3 Min;
+	Vector3 Max;
+};
+
+// Planes are (normal, distance) with normals pointing inwards, a point p is inside when
+// dot(normal, p) + distance >= 0 for every plane
+struct Frustum
+{
+	static constexpr int PlaneCount = 6;
+	Vector4 Planes[PlaneCount];
+};
+
 inline bool FloatClose(float x, float y, float epsilon = 0.001f)
 {
 	return fabsf(x - y) < epsilon;
 }
 
+// Blends transforms made of translation, rotation and scale - the translation and scale linearly and the rotation
+// along the shorter arc. Shear, which parents with non-uniform scale can introduce, is lost.
+inline Matrix4x4 InterpolateTransforms(const Matrix4x4& from, const Matrix4x4& to, float alpha)
+{
+	if (from == to)
+	{
+		return to;
+	}
+	const Vector3 fromScale(glm::length(Vector3(from[0])), glm::length(Vector3(from[1])), glm::length(Vector3(from[2])));
+	const Vector3 toScale(glm::length(Vector3(to[0])), glm::length(Vector3(to[1])), glm::length(Vector3(to[2])));
+	if (glm::min(glm::min(fromScale.x, fromScale.y), glm::min(glm::min(fromScale.z, toScale.x), glm::min(toScale.y, toScale.z))) <= 0.f)
+	{
+		// No rotation to extract
+		return from + (to - from) * alpha;
+	}
+	const Quaternion fromRotation = glm::quat_cast(glm::mat3(Vector3(from[0]) / fromScale.x, Vector3(from[1]) / fromScale.y, Vector3(from[2]) / fromScale.z));
+	const Quaternion toRotation = glm::quat_cast(glm::mat3(Vector3(to[0]) / toScale.x, Vector3(to[1]) / toScale.y, Vector3(to[2]) / toScale.z));
+	Matrix4x4 result = glm::mat4_cast(glm::slerp(fromRotation, toRotation, alpha)) * glm::scale(glm::mix(fromScale, toScale, alpha));
+	result[3] = glm::mix(from[3], to[3], alpha);
+	return result;
+}
+
 template<typename NumberType>
 inline NumberType Clamp(NumberType value, NumberType min, NumberType max)
 {
@@ -0,0 +1,486 @@
+#include <Zmey/Memory/HeapProfiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <Zmey/Logging.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+#if defined(ZMEY_PLATFORM_WIN)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <DbgHelp.h>
+	#pragma comment(lib, "dbghelp.lib")
+#else
+	#include <execinfo.h>
+#endif
+
+#if defined(_MSC_VER)
+	#define HEAP_PROFILER_NOINLINE __declspec(noinline)
+#else
+	#define HEAP_PROFILER_NOINLINE __attribute__((noinline))
+#endif
+
+namespace Zmey
+{
+namespace HeapProfiler
+{
+namespace
+{
+constexpr unsigned MaxFrames = 24;
+// Frames belonging to the profiler itself - CaptureStack, RecordSample, OnAllocation
+// and ProfilingAllocator's Malloc / Realloc. The first three are kept out of line so this holds.
+constexpr unsigned SkippedFrames = 4;
+constexpr uint32_t SiteCapacity = 4096;
+constexpr uint32_t LiveCapacity = 1 << 16;
+// Lookups never go further than this from the home slot, so every free costs a handful
+// of loads no matter how many tombstones pile up
+constexpr uint32_t MaxLiveProbes = 32;
+constexpr uint32_t InvalidSite = ~0u;
+
+struct Site
+{
+	uint64_t StackHash; // 0 means the slot is free
+	uint32_t FrameCount;
+	void* Frames[MaxFrames];
+	std::atomic<uint64_t> Samples;
+	std::atomic<uint64_t> AllocatedBytes;
+	std::atomic<uint64_t> AllocatedCount;
+	std::atomic<uint64_t> FreedBytes;
+	std::atomic<uint64_t> FreedCount;
+};
+
+// Sampled allocations that haven't been freed yet.
+// Inserts happen under GLock, frees remove their entry without taking it.
+struct LiveAllocation
+{
+	std::atomic<uintptr_t> Pointer; // 0 - free slot, Tombstone - removed
+	uint32_t SiteIndex;
+	uint64_t EstimatedBytes;
+	uint64_t EstimatedCount;
+};
+constexpr uintptr_t Tombstone = 1;
+
+Site* GSites = nullptr;
+uint32_t GSiteCount = 0;
+LiveAllocation* GLive = nullptr;
+std::atomic<uint32_t> GLiveCount(0);
+std::atomic<uint64_t> GDroppedSamples(0);
+
+std::atomic<bool> GEnabled(false);
+std::atomic<size_t> GSampleInterval(256 * 1024);
+std::atomic_flag GLock = ATOMIC_FLAG_INIT;
+
+thread_local bool tls_InProfiler = false;
+thread_local bool tls_Seeded = false;
+thread_local int64_t tls_BytesUntilSample = 0;
+thread_local uint64_t tls_RandomState = 0;
+
+struct SpinLock
+{
+	SpinLock()
+	{
+		while (GLock.test_and_set(std::memory_order_acquire))
+		{}
+	}
+	~SpinLock()
+	{
+		GLock.clear(std::memory_order_release);
+	}
+};
+
+struct ReentrancyGuard
+{
+	ReentrancyGuard() { tls_InProfiler = true; }
+	~ReentrancyGuard() { tls_InProfiler = false; }
+};
+
+inline uint64_t MixBits(uint64_t value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+// Distance to the next sample is exponentially distributed so that allocation patterns
+// repeating with a fixed period don't alias with the sampling
+int64_t NextSampleDistance()
+{
+	if (!tls_RandomState)
+	{
+		tls_RandomState = MixBits(reinterpret_cast<uintptr_t>(&tls_RandomState)) | 1;
+	}
+	tls_RandomState ^= tls_RandomState << 13;
+	tls_RandomState ^= tls_RandomState >> 7;
+	tls_RandomState ^= tls_RandomState << 17;
+	const double uniform = double((tls_RandomState >> 11) + 1) / double(1ull << 53);
+	return int64_t(-std::log(uniform) * double(GSampleInterval.load(std::memory_order_relaxed))) + 1;
+}
+
+HEAP_PROFILER_NOINLINE unsigned CaptureStack(void** frames)
+{
+#if defined(ZMEY_PLATFORM_WIN)
+	return ::RtlCaptureStackBackTrace(SkippedFrames, MaxFrames, frames, nullptr);
+#else
+	void* buffer[MaxFrames + SkippedFrames];
+	const int captured = ::backtrace(buffer, int(MaxFrames + SkippedFrames));
+	const unsigned count = captured > int(SkippedFrames) ? unsigned(captured) - SkippedFrames : 0u;
+	std::memcpy(frames, buffer + SkippedFrames, count * sizeof(void*));
+	return count;
+#endif
+}
+
+uint32_t FindOrAddSite(void** frames, unsigned frameCount)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (unsigned i = 0; i < frameCount; ++i)
+	{
+		hash = MixBits(hash ^ reinterpret_cast<uintptr_t>(frames[i]));
+	}
+	hash |= 1; // Keep 0 free to mark empty slots
+
+	for (uint32_t probe = 0, index = uint32_t(hash) & (SiteCapacity - 1); probe < SiteCapacity; ++probe, index = (index + 1) & (SiteCapacity - 1))
+	{
+		Site& site = GSites[index];
+		if (site.StackHash == hash)
+		{
+			return index;
+		}
+		if (site.StackHash == 0)
+		{
+			// Stop well before the table fills up so probes stay short
+			if (GSiteCount >= SiteCapacity / 4 * 3)
+			{
+				return InvalidSite;
+			}
+			site.StackHash = hash;
+			site.FrameCount = frameCount;
+			std::memcpy(site.Frames, frames, frameCount * sizeof(void*));
+			++GSiteCount;
+			return index;
+		}
+	}
+	return InvalidSite;
+}
+
+inline uint32_t LiveSlotFor(void* ptr)
+{
+	return uint32_t(MixBits(reinterpret_cast<uintptr_t>(ptr))) & (LiveCapacity - 1);
+}
+
+HEAP_PROFILER_NOINLINE void RecordSample(void* ptr, size_t size)
+{
+	ReentrancyGuard guard;
+	void* frames[MaxFrames];
+	const unsigned frameCount = CaptureStack(frames);
+
+	// An allocation of size bytes gets sampled with probability 1 - e^(-size / interval),
+	// each sample stands for 1 / probability allocations like it
+	const double interval = double(GSampleInterval.load(std::memory_order_relaxed));
+	const double probability = 1.0 - std::exp(-double(size) / interval);
+	const uint64_t estimatedCount = uint64_t(1.0 / probability + 0.5);
+	const uint64_t estimatedBytes = uint64_t(double(size) / probability + 0.5);
+
+	SpinLock lock;
+	const uint32_t siteIndex = FindOrAddSite(frames, frameCount);
+	if (siteIndex == InvalidSite)
+	{
+		GDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	Site& site = GSites[siteIndex];
+	site.Samples.fetch_add(1, std::memory_order_relaxed);
+	site.AllocatedBytes.fetch_add(estimatedBytes, std::memory_order_relaxed);
+	site.AllocatedCount.fetch_add(estimatedCount, std::memory_order_relaxed);
+
+	for (uint32_t probe = 0, index = LiveSlotFor(ptr); probe < MaxLiveProbes; ++probe, index = (index + 1) & (LiveCapacity - 1))
+	{
+		LiveAllocation& live = GLive[index];
+		const uintptr_t current = live.Pointer.load(std::memory_order_relaxed);
+		// Only inserts write into free slots and they are serialized by the lock
+		if (current == 0 || current == Tombstone)
+		{
+			live.SiteIndex = siteIndex;
+			live.EstimatedBytes = estimatedBytes;
+			live.EstimatedCount = estimatedCount;
+			live.Pointer.store(reinterpret_cast<uintptr_t>(ptr), std::memory_order_release);
+			GLiveCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+	// Can't tell when this one is freed, it will show as live forever
+	GDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+HEAP_PROFILER_NOINLINE void OnAllocation(void* ptr, size_t size)
+{
+	if (!GEnabled.load(std::memory_order_relaxed) || tls_InProfiler || !ptr)
+	{
+		return;
+	}
+	if (!tls_Seeded)
+	{
+		tls_Seeded = true;
+		tls_BytesUntilSample = NextSampleDistance();
+	}
+	tls_BytesUntilSample -= int64_t(size);
+	if (tls_BytesUntilSample > 0)
+	{
+		return;
+	}
+	RecordSample(ptr, size);
+	tls_BytesUntilSample = NextSampleDistance();
+}
+
+inline void OnFree(void* ptr)
+{
+	if (GLiveCount.load(std::memory_order_relaxed) == 0 || !ptr)
+	{
+		return;
+	}
+	const uintptr_t key = reinterpret_cast<uintptr_t>(ptr);
+	for (uint32_t probe = 0, index = LiveSlotFor(ptr); probe < MaxLiveProbes; ++probe, index = (index + 1) & (LiveCapacity - 1))
+	{
+		LiveAllocation& live = GLive[index];
+		uintptr_t current = live.Pointer.load(std::memory_order_acquire);
+		if (current == 0)
+		{
+			return;
+		}
+		if (current == key)
+		{
+			// Read before removing, once the slot is a tombstone an insert may reuse it
+			const uint32_t siteIndex = live.SiteIndex;
+			const uint64_t bytes = live.EstimatedBytes;
+			const uint64_t count = live.EstimatedCount;
+			if (live.Pointer.compare_exchange_strong(current, Tombstone, std::memory_order_acq_rel))
+			{
+				GSites[siteIndex].FreedBytes.fetch_add(bytes, std::memory_order_relaxed);
+				GSites[siteIndex].FreedCount.fetch_add(count, std::memory_order_relaxed);
+				GLiveCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return;
+		}
+	}
+}
+
+// Sits in front of the real GAllocator once the profiler gets enabled for the first time
+// and stays there, so frees of sampled memory are seen even after disabling.
+class ProfilingAllocator : public IAllocator
+{
+public:
+	ProfilingAllocator(IAllocator* inner)
+		: m_Inner(inner)
+	{}
+	virtual void* Malloc(size_t size, unsigned alignment) override
+	{
+		void* ptr = m_Inner->Malloc(size, alignment);
+		OnAllocation(ptr, size);
+		return ptr;
+	}
+	virtual void Free(void* ptr) override
+	{
+		OnFree(ptr);
+		m_Inner->Free(ptr);
+	}
+	virtual void* Realloc(void* ptr, size_t newSize) override
+	{
+		OnFree(ptr);
+		void* result = m_Inner->Realloc(ptr, newSize);
+		OnAllocation(result, newSize);
+		return result;
+	}
+private:
+	IAllocator* m_Inner;
+};
+
+void ResolveFrame(void* frame, char* buffer, size_t bufferSize)
+{
+#if defined(ZMEY_PLATFORM_WIN)
+	static bool symbolsInitialized = false;
+	if (!symbolsInitialized)
+	{
+		::SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+		::SymInitialize(::GetCurrentProcess(), nullptr, TRUE);
+		symbolsInitialized = true;
+	}
+	alignas(SYMBOL_INFO) char symbolStorage[sizeof(SYMBOL_INFO) + 256];
+	SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(symbolStorage);
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = 255;
+	DWORD64 displacement = 0;
+	if (!::SymFromAddr(::GetCurrentProcess(), DWORD64(frame), &displacement, symbol))
+	{
+		snprintf(buffer, bufferSize, "%p", frame);
+		return;
+	}
+	IMAGEHLP_LINE64 line;
+	line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+	DWORD lineDisplacement = 0;
+	if (::SymGetLineFromAddr64(::GetCurrentProcess(), DWORD64(frame), &lineDisplacement, &line))
+	{
+		snprintf(buffer, bufferSize, "%s (%s:%lu)", symbol->Name, line.FileName, line.LineNumber);
+	}
+	else
+	{
+		snprintf(buffer, bufferSize, "%s+0x%llx", symbol->Name, static_cast<unsigned long long>(displacement));
+	}
+#else
+	char** symbols = ::backtrace_symbols(&frame, 1);
+	snprintf(buffer, bufferSize, "%s", symbols ? symbols[0] : "?");
+	std::free(symbols);
+#endif
+}
+
+void WriteSites(FILE* file, const char* title, Site** sites, uint32_t count)
+{
+	fprintf(file, "==== %s ====\n", title);
+	char frameName[512];
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const Site& site = *sites[i];
+		const uint64_t allocatedBytes = site.AllocatedBytes.load(std::memory_order_relaxed);
+		const uint64_t allocatedCount = site.AllocatedCount.load(std::memory_order_relaxed);
+		const uint64_t freedBytes = site.FreedBytes.load(std::memory_order_relaxed);
+		const uint64_t freedCount = site.FreedCount.load(std::memory_order_relaxed);
+		fprintf(file, "#%u: ~%llu bytes in ~%llu allocations (live ~%llu bytes in ~%llu, freed ~%llu bytes in ~%llu), %llu samples\n",
+			i + 1,
+			static_cast<unsigned long long>(allocatedBytes),
+			static_cast<unsigned long long>(allocatedCount),
+			static_cast<unsigned long long>(allocatedBytes - std::min(freedBytes, allocatedBytes)),
+			static_cast<unsigned long long>(allocatedCount - std::min(freedCount, allocatedCount)),
+			static_cast<unsigned long long>(freedBytes),
+			static_cast<unsigned long long>(freedCount),
+			static_cast<unsigned long long>(site.Samples.load(std::memory_order_relaxed)));
+		for (uint32_t frame = 0; frame < site.FrameCount; ++frame)
+		{
+			ResolveFrame(site.Frames[frame], frameName, sizeof(frameName));
+			fprintf(file, "\t%s\n", frameName);
+		}
+	}
+	fprintf(file, "\n");
+}
+}
+
+void Enable(size_t sampleIntervalBytes)
+{
+	ASSERT_RETURN(GAllocator);
+	ASSERT_RETURN(sampleIntervalBytes > 0);
+	GSampleInterval.store(sampleIntervalBytes, std::memory_order_relaxed);
+	{
+		SpinLock lock;
+		if (!GSites)
+		{
+			// Not from GAllocator, the profiler shouldn't see its own bookkeeping
+			GSites = static_cast<Site*>(std::calloc(SiteCapacity, sizeof(Site)));
+			GLive = static_cast<LiveAllocation*>(std::calloc(LiveCapacity, sizeof(LiveAllocation)));
+			ASSERT_FATAL(GSites && GLive);
+			GAllocator = StaticAlloc<ProfilingAllocator>(GAllocator);
+		}
+	}
+	GEnabled.store(true, std::memory_order_relaxed);
+	LOG(Info, Memory, "Heap profiler enabled");
+}
+
+void Disable()
+{
+	GEnabled.store(false, std::memory_order_relaxed);
+}
+
+bool IsEnabled()
+{
+	return GEnabled.load(std::memory_order_relaxed);
+}
+
+bool HasSamples()
+{
+	SpinLock lock;
+	return GSiteCount > 0;
+}
+
+void Reset()
+{
+	SpinLock lock;
+	if (!GSites)
+	{
+		return;
+	}
+	// Frees racing with this either find their entry or miss it, both are fine
+	for (uint32_t i = 0; i < LiveCapacity; ++i)
+	{
+		GLive[i].Pointer.store(0, std::memory_order_relaxed);
+	}
+	GLiveCount.store(0, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < SiteCapacity; ++i)
+	{
+		Site& site = GSites[i];
+		site.StackHash = 0;
+		site.Samples.store(0, std::memory_order_relaxed);
+		site.AllocatedBytes.store(0, std::memory_order_relaxed);
+		site.AllocatedCount.store(0, std::memory_order_relaxed);
+		site.FreedBytes.store(0, std::memory_order_relaxed);
+		site.FreedCount.store(0, std::memory_order_relaxed);
+	}
+	GSiteCount = 0;
+	GDroppedSamples.store(0, std::memory_order_relaxed);
+}
+
+bool DumpReport(const char* filePath, unsigned topSites)
+{
+	ReentrancyGuard guard;
+	FILE* file = fopen(filePath, "w");
+	if (!file)
+	{
+		return false;
+	}
+	Site** sites = nullptr;
+	uint32_t siteCount = 0;
+	{
+		SpinLock lock;
+		if (GSites)
+		{
+			sites = static_cast<Site**>(std::malloc((GSiteCount + 1) * sizeof(Site*)));
+			for (uint32_t i = 0; i < SiteCapacity; ++i)
+			{
+				if (GSites[i].StackHash)
+				{
+					sites[siteCount++] = &GSites[i];
+				}
+			}
+		}
+	}
+	fprintf(file, "Heap profile, sample interval %llu bytes, %u call sites, %llu samples dropped\n\n",
+		static_cast<unsigned long long>(GSampleInterval.load(std::memory_order_relaxed)),
+		siteCount,
+		static_cast<unsigned long long>(GDroppedSamples.load(std::memory_order_relaxed)));
+
+	const uint32_t shownSites = std::min(siteCount, topSites);
+	std::sort(sites, sites + siteCount, [](const Site* lhs, const Site* rhs)
+	{
+		return lhs->AllocatedBytes.load(std::memory_order_relaxed) > rhs->AllocatedBytes.load(std::memory_order_relaxed);
+	});
+	WriteSites(file, "Top sites by bytes", sites, shownSites);
+	std::sort(sites, sites + siteCount, [](const Site* lhs, const Site* rhs)
+	{
+		return lhs->AllocatedCount.load(std::memory_order_relaxed) > rhs->AllocatedCount.load(std::memory_order_relaxed);
+	});
+	WriteSites(file, "Top sites by allocation count", sites, shownSites);
+
+	std::free(sites);
+	fclose(file);
+	return true;
+}
+}
+}
+
+
+#undef HEAP_PROFILER_NOINLINE
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+
+#include <Zmey/Config.h>
+
+namespace Zmey
+{
+// Sampling heap profiler.
+// While enabled, roughly every SampleIntervalBytes allocated on a thread the allocation that crosses
+// the threshold gets its call stack captured. Samples are aggregated by call site and scaled back up
+// to estimate the real number of allocations and bytes, so the overhead stays low even with
+// hundreds of thousands of allocations per frame.
+// Works by wrapping GAllocator, so everything that ends up there is covered - the global operator new,
+// stl:: containers through DefaultAllocator and ZmeyMalloc alike.
+namespace HeapProfiler
+{
+// Installs the profiling allocator on the first call. Must be called after GAllocator is set.
+// Calling Enable while already enabled just changes the interval.
+ZMEY_API void Enable(size_t sampleIntervalBytes = 256 * 1024);
+// Stops taking new samples. Samples that are still live keep being tracked until freed.
+ZMEY_API void Disable();
+ZMEY_API bool IsEnabled();
+// Whether any call site got sampled since the start or the last Reset, enabled or not
+ZMEY_API bool HasSamples();
+// Forgets all samples collected so far
+ZMEY_API void Reset();
+// Writes the top call sites by estimated allocated bytes and by allocation count,
+// along with how much of that is still live. Returns false if the file couldn't be opened.
+ZMEY_API bool DumpReport(const char* filePath, unsigned topSites = 20);
+}
+
+}
@@ -0,0 +1,250 @@
+#include <Zmey/Memory/HugePageAllocator.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include <Zmey/Logging.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+#if defined(ZMEY_PLATFORM_WIN)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+#endif
+
+namespace Zmey
+{
+namespace
+{
+enum class Backing : uint32_t
+{
+	Small,
+	ExplicitHugePages,
+	TransparentHugePages,
+	RegularPages
+};
+
+// Placed right before every pointer we hand out
+struct BlockHeader
+{
+	size_t Size;
+	size_t MappedSize;
+	Backing Type;
+};
+// Padded to a cache line so user data in mapped blocks stays cache line aligned
+constexpr size_t HeaderSize = HugePageBlockOverhead;
+constexpr size_t MaxSupportedAlignment = HeaderSize;
+static_assert(sizeof(BlockHeader) <= HeaderSize, "Block header doesn't fit in its padding");
+
+std::atomic<size_t> GBytesPerBacking[4];
+
+inline size_t RoundUp(size_t value, size_t multiple)
+{
+	return (value + multiple - 1) / multiple * multiple;
+}
+
+inline BlockHeader* HeaderOf(void* ptr)
+{
+	return reinterpret_cast<BlockHeader*>(static_cast<uint8_t*>(ptr) - HeaderSize);
+}
+
+class HugePageIAllocator : public IAllocator
+{
+public:
+	virtual void* Malloc(size_t size, unsigned alignment) override
+	{
+		return HugePageMalloc(size, alignment);
+	}
+	virtual void Free(void* ptr) override
+	{
+		HugePageFree(ptr);
+	}
+	virtual void* Realloc(void* ptr, size_t newSize) override
+	{
+		return HugePageRealloc(ptr, newSize);
+	}
+};
+
+#if defined(ZMEY_PLATFORM_WIN)
+size_t QueryLargePageSize()
+{
+	// Large pages can only be mapped by processes holding SeLockMemoryPrivilege.
+	// The privilege has to be granted to the user by policy, here we can only enable it for the process.
+	HANDLE token;
+	if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+	{
+		return 0;
+	}
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	bool enabled = ::LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)
+		&& ::AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr)
+		&& ::GetLastError() == ERROR_SUCCESS;
+	::CloseHandle(token);
+	if (!enabled)
+	{
+		LOG(Info, Memory, "SeLockMemoryPrivilege is not held, huge page allocations will use regular pages");
+		return 0;
+	}
+	return ::GetLargePageMinimum();
+}
+
+void* MapPages(size_t& size, Backing& type)
+{
+	static const size_t largePageSize = QueryLargePageSize();
+	if (largePageSize)
+	{
+		const size_t largeSize = RoundUp(size, largePageSize);
+		void* ptr = ::VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (ptr)
+		{
+			size = largeSize;
+			type = Backing::ExplicitHugePages;
+			return ptr;
+		}
+	}
+	size = RoundUp(size, HugePageSize);
+	type = Backing::RegularPages;
+	return ::VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void UnmapPages(void* ptr, size_t)
+{
+	::VirtualFree(ptr, 0, MEM_RELEASE);
+}
+#else
+void* MapPages(size_t& size, Backing& type)
+{
+	size = RoundUp(size, HugePageSize);
+#if defined(MAP_HUGETLB)
+	// Fails right away when no hugetlbfs pages are reserved, which is the common case
+	static std::atomic<bool> hugeTlbAvailable(true);
+	if (hugeTlbAvailable.load(std::memory_order_relaxed))
+	{
+		void* ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED)
+		{
+			type = Backing::ExplicitHugePages;
+			return ptr;
+		}
+		hugeTlbAvailable.store(false, std::memory_order_relaxed);
+	}
+#endif
+	// A huge page can only back a 2MB aligned range, so map a page more than needed and trim the mapping to an aligned start
+	void* mapping = ::mmap(nullptr, size + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	uint8_t* const mappingStart = static_cast<uint8_t*>(mapping);
+	uint8_t* const alignedStart = reinterpret_cast<uint8_t*>(RoundUp(reinterpret_cast<uintptr_t>(mappingStart), HugePageSize));
+	const size_t headSlack = size_t(alignedStart - mappingStart);
+	if (headSlack)
+	{
+		::munmap(mappingStart, headSlack);
+	}
+	if (HugePageSize - headSlack)
+	{
+		::munmap(alignedStart + size, HugePageSize - headSlack);
+	}
+	void* ptr = alignedStart;
+	type = Backing::RegularPages;
+#if defined(MADV_HUGEPAGE)
+	if (::madvise(ptr, size, MADV_HUGEPAGE) == 0)
+	{
+		type = Backing::TransparentHugePages;
+	}
+#endif
+	return ptr;
+}
+
+void UnmapPages(void* ptr, size_t size)
+{
+	::munmap(ptr, size);
+}
+#endif
+}
+
+void* HugePageMalloc(size_t size, unsigned alignment)
+{
+	ASSERT_RETURN_VALUE(alignment <= MaxSupportedAlignment, nullptr);
+	const size_t totalSize = size + HeaderSize;
+	BlockHeader* header = nullptr;
+	if (totalSize < HugePageMinAllocationSize)
+	{
+		header = reinterpret_cast<BlockHeader*>(GAllocator->Malloc(totalSize, alignment));
+		header->MappedSize = 0;
+		header->Type = Backing::Small;
+	}
+	else
+	{
+		size_t mappedSize = totalSize;
+		Backing type;
+		header = reinterpret_cast<BlockHeader*>(MapPages(mappedSize, type));
+		ASSERT_FATAL(header);
+		header->MappedSize = mappedSize;
+		header->Type = type;
+	}
+	header->Size = size;
+	GBytesPerBacking[uint32_t(header->Type)].fetch_add(header->Type == Backing::Small ? size : header->MappedSize, std::memory_order_relaxed);
+	return reinterpret_cast<uint8_t*>(header) + HeaderSize;
+}
+
+void HugePageFree(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	BlockHeader* header = HeaderOf(ptr);
+	GBytesPerBacking[uint32_t(header->Type)].fetch_sub(header->Type == Backing::Small ? header->Size : header->MappedSize, std::memory_order_relaxed);
+	if (header->Type == Backing::Small)
+	{
+		GAllocator->Free(header);
+	}
+	else
+	{
+		UnmapPages(header, header->MappedSize);
+	}
+}
+
+void* HugePageRealloc(void* ptr, size_t newSize)
+{
+	if (!ptr)
+	{
+		return HugePageMalloc(newSize, 0);
+	}
+	BlockHeader* header = HeaderOf(ptr);
+	// Mappings are rounded up to whole pages so there is usually room to grow in place
+	if (header->Type != Backing::Small && newSize + HeaderSize <= header->MappedSize)
+	{
+		header->Size = newSize;
+		return ptr;
+	}
+	void* result = HugePageMalloc(newSize, 0);
+	std::memcpy(result, ptr, header->Size < newSize ? header->Size : newSize);
+	HugePageFree(ptr);
+	return result;
+}
+
+HugePageStats GetHugePageStats()
+{
+	HugePageStats stats;
+	stats.ExplicitHugePageBytes = GBytesPerBacking[uint32_t(Backing::ExplicitHugePages)].load(std::memory_order_relaxed);
+	stats.TransparentHugePageBytes = GBytesPerBacking[uint32_t(Backing::TransparentHugePages)].load(std::memory_order_relaxed);
+	stats.RegularPageBytes = GBytesPerBacking[uint32_t(Backing::RegularPages)].load(std::memory_order_relaxed);
+	stats.SmallAllocationBytes = GBytesPerBacking[uint32_t(Backing::Small)].load(std::memory_order_relaxed);
+	return stats;
+}
+
+IAllocator* GetHugePageAllocator()
+{
+	static HugePageIAllocator allocator;
+	return &allocator;
+}
+
+}
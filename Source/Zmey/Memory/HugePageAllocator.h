@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+
+#include <Zmey/Config.h>
+#include <Zmey/Memory/Allocator.h>
+
+namespace Zmey
+{
+// Big allocations are mapped directly from the OS and backed by huge (2MB) pages when possible,
+// so large arrays that get swept every frame need a fraction of the TLB entries.
+// The backing is picked in this order:
+//  - explicit huge pages (MEM_LARGE_PAGES on Windows - needs the "Lock pages in memory" privilege,
+//    MAP_HUGETLB on Linux - needs reserved hugetlbfs pages)
+//  - transparent huge pages (Linux only, via madvise)
+//  - regular pages
+// Requests smaller than HugePageMinAllocationSize aren't worth a mapping and go to GAllocator,
+// so a growing container can start small and move to huge pages once it gets big.
+constexpr size_t HugePageSize = 2 * 1024 * 1024;
+constexpr size_t HugePageMinAllocationSize = 512 * 1024;
+// Every block carries a header this big, ask for HugePageSize - HugePageBlockOverhead to fill a single page
+constexpr size_t HugePageBlockOverhead = 64;
+
+struct HugePageStats
+{
+	size_t ExplicitHugePageBytes;
+	size_t TransparentHugePageBytes;
+	size_t RegularPageBytes;
+	size_t SmallAllocationBytes;
+};
+
+ZMEY_API void* HugePageMalloc(size_t size, unsigned alignment);
+ZMEY_API void HugePageFree(void* ptr);
+ZMEY_API void* HugePageRealloc(void* ptr, size_t newSize);
+ZMEY_API HugePageStats GetHugePageStats();
+// The same functions behind IAllocator, e.g. as the parent of a MemoryArena
+ZMEY_API IAllocator* GetHugePageAllocator();
+
+// Allocator impl for StlAllocatorTemplate, see huge:: in MemoryManagement.h
+class HugePageAllocator
+{
+public:
+	void Initialize()
+	{}
+	inline void* Malloc(size_t size, unsigned alignment)
+	{
+		return HugePageMalloc(size, alignment);
+	}
+	inline void Free(void* ptr)
+	{
+		HugePageFree(ptr);
+	}
+	inline void* Realloc(void* ptr, size_t newSize)
+	{
+		return HugePageRealloc(ptr, newSize);
+	}
+};
+
+}
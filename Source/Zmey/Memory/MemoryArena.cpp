@@ -0,0 +1,336 @@
+#include <Zmey/Memory/MemoryArena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+#include <Zmey/Logging.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+namespace
+{
+// Each allocation is preceded by its capacity, so Realloc knows how much to copy and Free where to recycle it
+using SizeHeader = size_t;
+constexpr size_t MinAlignment = 16;
+constexpr unsigned NoSizeClass = ~0u;
+
+inline char* AlignUp(char* ptr, size_t alignment)
+{
+	return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(ptr) + alignment - 1) & ~uintptr_t(alignment - 1));
+}
+
+inline size_t& SizeOf(void* ptr)
+{
+	return *(reinterpret_cast<SizeHeader*>(ptr) - 1);
+}
+
+// Rounds small sizes up to a power of two so freed blocks can be reused by any allocation of the same class
+inline size_t RoundToSizeClass(size_t size, unsigned& sizeClass)
+{
+	if (size > MemoryArena::MaxRecycledSize)
+	{
+		sizeClass = NoSizeClass;
+		return (size + MinAlignment - 1) & ~(MinAlignment - 1);
+	}
+	size_t capacity = MinAlignment;
+	sizeClass = 0u;
+	while (capacity < size)
+	{
+		capacity <<= 1;
+		++sizeClass;
+	}
+	return capacity;
+}
+}
+
+constexpr size_t MemoryArena::MaxRecycledSize;
+
+MemoryArena::MemoryArena(size_t chunkSize, IAllocator* parent)
+	: m_Parent(parent)
+	, m_CurrentChunk(nullptr)
+	, m_Cursor(nullptr)
+	, m_End(nullptr)
+	, m_ChunkSize(chunkSize)
+	, m_BytesInUse(0u)
+	, m_PeakBytesInUse(0u)
+	, m_BytesReserved(0u)
+	, m_ChunkCount(0u)
+	, m_LargeBlocks(nullptr)
+	, m_LargeBytesReserved(0u)
+	, m_LargeBlockCount(0u)
+{
+	std::fill(std::begin(m_FreeLists), std::end(m_FreeLists), nullptr);
+}
+
+MemoryArena::~MemoryArena()
+{
+	Release();
+}
+
+IAllocator* MemoryArena::Parent() const
+{
+	return m_Parent ? m_Parent : GAllocator;
+}
+
+void MemoryArena::AddChunk(size_t minSize)
+{
+	const size_t size = std::max(m_ChunkSize, minSize + sizeof(Chunk));
+	Chunk* chunk = reinterpret_cast<Chunk*>(Parent()->Malloc(size, alignof(Chunk)));
+	ASSERT_FATAL(chunk);
+	chunk->Previous = m_CurrentChunk;
+	chunk->Size = size;
+	m_CurrentChunk = chunk;
+	m_Cursor = reinterpret_cast<char*>(chunk + 1);
+	m_End = reinterpret_cast<char*>(chunk) + size;
+	m_BytesReserved += size;
+	++m_ChunkCount;
+}
+
+void MemoryArena::FreeChunks(Chunk* chunk)
+{
+	while (chunk)
+	{
+		Chunk* previous = chunk->Previous;
+		Parent()->Free(chunk);
+		chunk = previous;
+	}
+}
+
+void MemoryArena::RecycleRestOfChunk()
+{
+	if (!m_CurrentChunk)
+	{
+		return;
+	}
+	// Hand out what's left of the chunk as the biggest size classes that fit
+	for (;;)
+	{
+		char* ptr = AlignUp(m_Cursor + sizeof(SizeHeader), MinAlignment);
+		if (ptr + MinAlignment > m_End)
+		{
+			break;
+		}
+		const size_t available = std::min<size_t>(m_End - ptr, MaxRecycledSize);
+		unsigned sizeClass = 0u;
+		while ((MinAlignment << (sizeClass + 1)) <= available)
+		{
+			++sizeClass;
+		}
+		const size_t capacity = MinAlignment << sizeClass;
+		SizeOf(ptr) = capacity;
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(ptr);
+		block->Next = m_FreeLists[sizeClass];
+		m_FreeLists[sizeClass] = block;
+		m_Cursor = ptr + capacity;
+	}
+}
+
+void* MemoryArena::AllocateLarge(size_t capacity, size_t alignment)
+{
+	const size_t size = sizeof(LargeBlock) + sizeof(SizeHeader) + alignment + capacity;
+	void* memory = Parent()->Malloc(size, alignof(LargeBlock));
+	ASSERT_FATAL(memory);
+	char* ptr = AlignUp(static_cast<char*>(memory) + sizeof(LargeBlock) + sizeof(SizeHeader), alignment);
+	LargeBlock* block = reinterpret_cast<LargeBlock*>(ptr - sizeof(SizeHeader)) - 1;
+	block->Previous = nullptr;
+	block->Next = m_LargeBlocks;
+	block->Memory = memory;
+	block->Size = size;
+	if (m_LargeBlocks)
+	{
+		m_LargeBlocks->Previous = block;
+	}
+	m_LargeBlocks = block;
+	m_LargeBytesReserved += size;
+	m_BytesReserved += size;
+	++m_LargeBlockCount;
+	SizeOf(ptr) = capacity;
+	return ptr;
+}
+
+void MemoryArena::FreeLarge(void* ptr)
+{
+	LargeBlock* block = reinterpret_cast<LargeBlock*>(static_cast<char*>(ptr) - sizeof(SizeHeader)) - 1;
+	if (block->Previous)
+	{
+		block->Previous->Next = block->Next;
+	}
+	else
+	{
+		m_LargeBlocks = block->Next;
+	}
+	if (block->Next)
+	{
+		block->Next->Previous = block->Previous;
+	}
+	m_LargeBytesReserved -= block->Size;
+	m_BytesReserved -= block->Size;
+	--m_LargeBlockCount;
+	Parent()->Free(block->Memory);
+}
+
+void MemoryArena::FreeLargeBlocks()
+{
+	while (m_LargeBlocks)
+	{
+		LargeBlock* next = m_LargeBlocks->Next;
+		Parent()->Free(m_LargeBlocks->Memory);
+		m_LargeBlocks = next;
+	}
+	m_BytesReserved -= m_LargeBytesReserved;
+	m_LargeBytesReserved = 0u;
+	m_LargeBlockCount = 0u;
+}
+
+void* MemoryArena::AllocateUnlocked(size_t size, unsigned alignment)
+{
+	unsigned sizeClass;
+	const size_t capacity = RoundToSizeClass(size, sizeClass);
+	m_BytesInUse += capacity;
+	m_PeakBytesInUse = std::max(m_PeakBytesInUse, m_BytesInUse);
+	const size_t actualAlignment = std::max<size_t>(alignment, MinAlignment);
+	if (sizeClass == NoSizeClass)
+	{
+		return AllocateLarge(capacity, actualAlignment);
+	}
+	// Recycled blocks are only guaranteed the minimum alignment
+	if (alignment <= MinAlignment && m_FreeLists[sizeClass])
+	{
+		FreeBlock* block = m_FreeLists[sizeClass];
+		m_FreeLists[sizeClass] = block->Next;
+		return block;
+	}
+
+	char* ptr = AlignUp(m_Cursor + sizeof(SizeHeader), actualAlignment);
+	if (!m_CurrentChunk || ptr + capacity > m_End)
+	{
+		RecycleRestOfChunk();
+		AddChunk(capacity + actualAlignment + sizeof(SizeHeader));
+		ptr = AlignUp(m_Cursor + sizeof(SizeHeader), actualAlignment);
+	}
+	m_Cursor = ptr + capacity;
+	SizeOf(ptr) = capacity;
+	return ptr;
+}
+
+void* MemoryArena::Malloc(size_t size, unsigned alignment)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return AllocateUnlocked(size, alignment);
+}
+
+void MemoryArena::Free(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	FreeUnlocked(ptr);
+}
+
+void MemoryArena::FreeUnlocked(void* ptr)
+{
+	const size_t capacity = SizeOf(ptr);
+	m_BytesInUse -= capacity;
+	if (capacity > MaxRecycledSize)
+	{
+		FreeLarge(ptr);
+		return;
+	}
+	if (static_cast<char*>(ptr) + capacity == m_Cursor)
+	{
+		m_Cursor = static_cast<char*>(ptr) - sizeof(SizeHeader);
+		return;
+	}
+	unsigned sizeClass;
+	if (RoundToSizeClass(capacity, sizeClass) == capacity)
+	{
+		FreeBlock* block = static_cast<FreeBlock*>(ptr);
+		block->Next = m_FreeLists[sizeClass];
+		m_FreeLists[sizeClass] = block;
+	}
+}
+
+void* MemoryArena::Realloc(void* ptr, size_t newSize)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (!ptr)
+	{
+		return AllocateUnlocked(newSize, 0);
+	}
+	size_t& capacity = SizeOf(ptr);
+	if (newSize <= capacity)
+	{
+		return ptr;
+	}
+	// Grow in place if this is the last allocation and it still fits
+	unsigned sizeClass;
+	const size_t newCapacity = RoundToSizeClass(newSize, sizeClass);
+	if (sizeClass != NoSizeClass && static_cast<char*>(ptr) + capacity == m_Cursor
+		&& static_cast<char*>(ptr) + newCapacity <= m_End)
+	{
+		m_BytesInUse = m_BytesInUse - capacity + newCapacity;
+		m_PeakBytesInUse = std::max(m_PeakBytesInUse, m_BytesInUse);
+		capacity = newCapacity;
+		m_Cursor = static_cast<char*>(ptr) + newCapacity;
+		return ptr;
+	}
+	void* result = AllocateUnlocked(newSize, 0);
+	std::memcpy(result, ptr, capacity);
+	FreeUnlocked(ptr);
+	return result;
+}
+
+void MemoryArena::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	FreeLargeBlocks();
+	if (m_ChunkCount > 1u)
+	{
+		// Coalesce into a single chunk that would have fit everything
+		const size_t neededSize = m_BytesReserved;
+		FreeChunks(m_CurrentChunk);
+		m_CurrentChunk = nullptr;
+		m_BytesReserved = 0u;
+		m_ChunkCount = 0u;
+		AddChunk(neededSize);
+	}
+	else if (m_CurrentChunk)
+	{
+		m_Cursor = reinterpret_cast<char*>(m_CurrentChunk + 1);
+	}
+	std::fill(std::begin(m_FreeLists), std::end(m_FreeLists), nullptr);
+	m_BytesInUse = 0u;
+}
+
+void MemoryArena::Release()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	FreeLargeBlocks();
+	FreeChunks(m_CurrentChunk);
+	m_CurrentChunk = nullptr;
+	m_Cursor = nullptr;
+	m_End = nullptr;
+	m_BytesInUse = 0u;
+	m_BytesReserved = 0u;
+	m_ChunkCount = 0u;
+	std::fill(std::begin(m_FreeLists), std::end(m_FreeLists), nullptr);
+}
+
+MemoryArena::Stats MemoryArena::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Stats stats;
+	stats.BytesInUse = m_BytesInUse;
+	stats.PeakBytesInUse = m_PeakBytesInUse;
+	stats.BytesReserved = m_BytesReserved;
+	stats.ChunkCount = m_ChunkCount;
+	stats.LargeBlockCount = m_LargeBlockCount;
+	return stats;
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <mutex>
+
+#include <Zmey/Config.h>
+#include <Zmey/Memory/Allocator.h>
+
+namespace Zmey
+{
+// Bump allocator for data that lives and dies together - everything in a world, everything in a frame.
+// Memory is carved out of big chunks taken from the parent allocator. Free gives memory back right away
+// when it's the most recent allocation (which covers the common vector growth pattern). Other blocks up to
+// MaxRecycledSize go to per size class free lists for later allocations to reuse, so containers that
+// churn (deques, node based maps) don't grow the arena forever. Anything bigger (hash table buckets,
+// grid cells) gets a block of its own from the parent, which goes straight back to it on Free.
+// Everything else is reclaimed at once by Reset or Release.
+// Bind containers to an arena with AllocatorRef / the arena:: aliases in MemoryManagement.h.
+class MemoryArena : public IAllocator
+{
+public:
+	struct Stats
+	{
+		size_t BytesInUse;
+		size_t PeakBytesInUse;
+		size_t BytesReserved;
+		size_t ChunkCount;
+		size_t LargeBlockCount;
+	};
+	// Allocations are rounded up to a power of two up to this size and recycled on Free,
+	// bigger ones are passed on to the parent
+	static constexpr size_t MaxRecycledSize = 64 * 1024;
+
+	// parent == nullptr means GAllocator
+	ZMEY_API explicit MemoryArena(size_t chunkSize = 64 * 1024, IAllocator* parent = nullptr);
+	ZMEY_API virtual ~MemoryArena();
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+	ZMEY_API virtual void* Malloc(size_t size, unsigned alignment) override;
+	ZMEY_API virtual void Free(void* ptr) override;
+	ZMEY_API virtual void* Realloc(void* ptr, size_t newSize) override;
+
+	// Invalidates all allocations. Keeps a single chunk big enough for everything
+	// allocated so far, so an arena that gets reset every frame settles on one chunk.
+	ZMEY_API void Reset();
+	// Invalidates all allocations and gives all memory back to the parent
+	ZMEY_API void Release();
+
+	ZMEY_API Stats GetStats() const;
+private:
+	struct Chunk
+	{
+		Chunk* Previous;
+		size_t Size;
+	};
+	struct FreeBlock
+	{
+		FreeBlock* Next;
+	};
+	// Sits right before the size header of an allocation bigger than MaxRecycledSize
+	struct LargeBlock
+	{
+		LargeBlock* Previous;
+		LargeBlock* Next;
+		void* Memory;
+		size_t Size;
+	};
+	// 16, 32, ..., MaxRecycledSize
+	static constexpr unsigned SizeClassCount = 13;
+	static_assert((size_t(16) << (SizeClassCount - 1)) == MaxRecycledSize, "Size classes must go up to MaxRecycledSize");
+	void* AllocateUnlocked(size_t size, unsigned alignment);
+	void FreeUnlocked(void* ptr);
+	void* AllocateLarge(size_t capacity, size_t alignment);
+	void FreeLarge(void* ptr);
+	void FreeLargeBlocks();
+	void RecycleRestOfChunk();
+	void AddChunk(size_t minSize);
+	void FreeChunks(Chunk* chunk);
+	IAllocator* Parent() const;
+
+	mutable std::mutex m_Mutex;
+	IAllocator* m_Parent;
+	Chunk* m_CurrentChunk;
+	char* m_Cursor;
+	char* m_End;
+	size_t m_ChunkSize;
+	size_t m_BytesInUse;
+	size_t m_PeakBytesInUse;
+	size_t m_BytesReserved;
+	size_t m_ChunkCount;
+	LargeBlock* m_LargeBlocks;
+	size_t m_LargeBytesReserved;
+	size_t m_LargeBlockCount;
+	FreeBlock* m_FreeLists[SizeClassCount];
+};
+
+}
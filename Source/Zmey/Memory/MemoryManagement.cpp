@@ -7,6 +7,23 @@ ZMEY_API Zmey::IAllocator* GAllocator = nullptr;
 Zmey::StaticDataAllocator<1024 * 8> GStaticDataAllocator;
 template class ThreadLocalLinearAllocator<tls_TempAllocatorSize>;
 thread_local Zmey::LinearAllocator<tls_TempAllocatorSize> Zmey::TempAllocator::tls_Alloc;
+
+namespace
+{
+thread_local IAllocator* tls_DefaultAllocator = nullptr;
+}
+
+IAllocator* GetDefaultAllocator()
+{
+	return tls_DefaultAllocator;
+}
+
+IAllocator* SetDefaultAllocator(IAllocator* allocator)
+{
+	IAllocator* previous = tls_DefaultAllocator;
+	tls_DefaultAllocator = allocator;
+	return previous;
+}
 }
 
 void* operator new(std::size_t size)
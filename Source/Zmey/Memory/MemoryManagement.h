@@ -6,16 +6,14 @@
 #include <vector>
 #include <queue>
 #include <unordered_map>
-#pragma warning(push)
-#pragma warning(disable: 4530) // Exceptions
-#include <concurrent_vector.h>
-#pragma warning(pop)
 
 #include <Zmey/Config.h>
 #include <Zmey/Memory/Allocator.h>
 #include "StlAllocator.h"
 #include "LinearAllocator.h"
 #include "PoolAllocator.h"
+#include "HugePageAllocator.h"
+#include "MemoryArena.h"
 
 namespace Zmey
 {
@@ -174,6 +172,71 @@ public:
 	}
 };
 
+// Allocator used by default constructed AllocatorRefs on the calling thread.
+// nullptr (the default) means GAllocator.
+ZMEY_API IAllocator* GetDefaultAllocator();
+// Returns the previous default
+ZMEY_API IAllocator* SetDefaultAllocator(IAllocator* allocator);
+
+// Sets the default allocator of the thread for the lifetime of the object, e.g. to make
+// everything created while loading a world go to the world's arena.
+// Don't keep one alive across WaitForCounter, the job may resume on another thread.
+class ScopedDefaultAllocator
+{
+public:
+	ScopedDefaultAllocator(IAllocator* allocator)
+		: m_Previous(SetDefaultAllocator(allocator))
+	{}
+	~ScopedDefaultAllocator()
+	{
+		SetDefaultAllocator(m_Previous);
+	}
+	ScopedDefaultAllocator(const ScopedDefaultAllocator&) = delete;
+	ScopedDefaultAllocator& operator=(const ScopedDefaultAllocator&) = delete;
+private:
+	IAllocator* m_Previous;
+};
+
+// Points to an allocator picked at construction - either given explicitly or the thread's default one.
+// Used by the arena:: containers.
+class AllocatorRef
+{
+public:
+	using IsReference = std::true_type;
+
+	AllocatorRef()
+		: m_Allocator(GetDefaultAllocator())
+	{}
+	AllocatorRef(IAllocator* allocator)
+		: m_Allocator(allocator)
+	{}
+	void Initialize()
+	{}
+	inline void* Malloc(size_t size, unsigned alignment)
+	{
+		return Get()->Malloc(size, alignment);
+	}
+	inline void Free(void* ptr)
+	{
+		Get()->Free(ptr);
+	}
+	inline void* Realloc(void* ptr, size_t newSize)
+	{
+		return Get()->Realloc(ptr, newSize);
+	}
+	// GAllocator is looked up on use as containers might get constructed before it is set up
+	inline IAllocator* Get() const
+	{
+		return m_Allocator ? m_Allocator : GAllocator;
+	}
+	inline bool operator==(const AllocatorRef& other) const
+	{
+		return Get() == other.Get();
+	}
+private:
+	IAllocator* m_Allocator;
+};
+
 namespace stl
 {
 	template<typename Base>
@@ -230,8 +293,6 @@ namespace stl
 	template<typename T>
 	using small_vector = vector<T>;
 	template<typename T>
-	using concurrent_vector = Concurrency::concurrent_vector<T, StlAllocatorTemplate<DefaultAllocator, T>>;
-	template<typename T>
 	using deque = std::deque<T, StlAllocatorTemplate<DefaultAllocator, T>>;
 	template<typename T>
 	using queue = std::queue<T, stl::deque<T>>;
@@ -271,6 +332,29 @@ namespace pool
 	template<typename T, unsigned short ObjectCount = 256>
 	using vector = std::vector<T, StlAllocatorTemplate<PoolAllocator<T, ObjectCount>, T>>;
 }
+// Namespace for containers bound to a specific allocator, usually a MemoryArena.
+// Pass the allocator on construction - arena::vector<int> ints(AllocatorRef(&arena)) -
+// or leave it out to use the current default allocator, see ScopedDefaultAllocator.
+namespace arena
+{
+	template<typename T>
+	using allocator = StlAllocatorTemplate<AllocatorRef, T>;
+	template<typename T>
+	using vector = std::vector<T, allocator<T>>;
+	template<typename T>
+	using deque = std::deque<T, allocator<T>>;
+	template<typename T>
+	using queue = std::queue<T, arena::deque<T>>;
+	template<typename K, typename V>
+	using unordered_map = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, allocator<std::pair<const K, V>>>;
+	using string = std::basic_string<char, std::char_traits<char>, allocator<char>>;
+}
+// Namespace for big arrays that get swept often, see HugePageAllocator.h
+namespace huge
+{
+	template<typename T>
+	using vector = std::vector<T, StlAllocatorTemplate<HugePageAllocator, T>>;
+}
 // Namespace for types which are supposed to hold global variables
 namespace global
 {
@@ -1,11 +1,62 @@
 #pragma once
 #include <cstddef>
 #include <cassert>
+#include <type_traits>
 
 namespace Zmey
 {
+namespace StlAllocatorDetail
+{
+template<class...>
+struct MakeVoid
+{
+	using type = void;
+};
+// Impls that point to an allocator living elsewhere (see AllocatorRef) declare
+// `using IsReference = std::true_type;`
+template<class AllocatorImpl, class = void>
+struct IsReference : std::false_type
+{};
+template<class AllocatorImpl>
+struct IsReference<AllocatorImpl, typename MakeVoid<typename AllocatorImpl::IsReference>::type> : AllocatorImpl::IsReference
+{};
+
+template<class AllocatorImpl>
+inline bool ImplsEqual(const AllocatorImpl& lhs, const AllocatorImpl& rhs, std::true_type /*isReference*/)
+{
+	return lhs == rhs;
+}
+template<class AllocatorImpl>
+inline bool ImplsEqual(const AllocatorImpl& lhs, const AllocatorImpl& rhs, std::false_type /*isReference*/)
+{
+	// Stateless impls all use the same memory, stateful by-value ones can only free their own
+	return std::is_empty<AllocatorImpl>::value || &lhs == &rhs;
+}
+
+// Rebound allocators share the impl only when that's safe - a stateful by-value impl (e.g. PoolAllocator)
+// may point into its own storage, so the rebound allocator gets a fresh one
+template<class AllocatorImpl>
+using CopyImplOnRebind = std::integral_constant<bool, IsReference<AllocatorImpl>::value || std::is_empty<AllocatorImpl>::value>;
+
+template<class Allocator>
+inline Allocator SelectOnCopy(const Allocator& /*allocator*/, std::true_type /*isReference*/)
+{
+	// Copies don't inherit the arena of the source, same as std::pmr
+	return Allocator();
+}
+template<class Allocator>
+inline Allocator SelectOnCopy(const Allocator& allocator, std::false_type /*isReference*/)
+{
+	return allocator;
+}
+}
+
 // StdAllocatorTemplate uses the curiously-recurring template pattern idiom.
-// AllocatorImpl must implement Initialize, Malloc, Free and Realloc
+// AllocatorImpl must implement Initialize, Malloc, Free and Realloc.
+// Stateless impls (DefaultAllocator, TempAllocator) make every allocator instance equal.
+// Reference impls (AllocatorRef) get std::pmr semantics - allocators are equal when they point to the
+// same memory, they don't propagate on copy / move assignment or swap and a copied container
+// gets the current default allocator instead of the source's one.
 template<class AllocatorImpl, class T>
 struct StlAllocatorTemplate
 {
@@ -23,13 +74,31 @@ struct StlAllocatorTemplate
 		typedef StlAllocatorTemplate<AllocatorImpl, U> other;
 	};
 
+	typedef std::false_type propagate_on_container_copy_assignment;
+	typedef std::false_type propagate_on_container_move_assignment;
+	typedef std::false_type propagate_on_container_swap;
+	typedef std::is_empty<AllocatorImpl> is_always_equal;
+
 	StlAllocatorTemplate()
 	{
 		m_Impl.Initialize();
 	}
+	StlAllocatorTemplate(const AllocatorImpl& impl)
+		: m_Impl(impl)
+	{
+	}
 	template <class U>
-	StlAllocatorTemplate(const StlAllocatorTemplate<AllocatorImpl, U>& /*other*/)
+	StlAllocatorTemplate(const StlAllocatorTemplate<AllocatorImpl, U>& other)
+		: StlAllocatorTemplate(other.GetImpl(), StlAllocatorDetail::CopyImplOnRebind<AllocatorImpl>())
+	{
+	}
+	StlAllocatorTemplate select_on_container_copy_construction() const
+	{
+		return StlAllocatorDetail::SelectOnCopy(*this, StlAllocatorDetail::IsReference<AllocatorImpl>());
+	}
+	const AllocatorImpl& GetImpl() const
 	{
+		return m_Impl;
 	}
 	T* allocate(std::size_t n)
 	{
@@ -40,12 +109,21 @@ struct StlAllocatorTemplate
 		m_Impl.Free(p);
 	}
 private:
+	StlAllocatorTemplate(const AllocatorImpl& impl, std::true_type /*copyImpl*/)
+		: m_Impl(impl)
+	{
+	}
+	StlAllocatorTemplate(const AllocatorImpl& /*impl*/, std::false_type /*copyImpl*/)
+	{
+		m_Impl.Initialize();
+	}
+
 	AllocatorImpl m_Impl;
 };
 template <class AllocatorImpl, class T, class U>
 bool operator==(const StlAllocatorTemplate<AllocatorImpl, T>& lhs, const StlAllocatorTemplate<AllocatorImpl, U>& rhs)
 {
-	return &lhs == &rhs;
+	return StlAllocatorDetail::ImplsEqual(lhs.GetImpl(), rhs.GetImpl(), StlAllocatorDetail::IsReference<AllocatorImpl>());
 }
 template <class AllocatorImpl, class T, class U>
 bool operator!=(const StlAllocatorTemplate<AllocatorImpl, T>& lhs, const StlAllocatorTemplate<AllocatorImpl, U>& rhs)
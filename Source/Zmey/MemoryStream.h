@@ -26,6 +26,21 @@ public:
 		std::memcpy(m_Buffer.get() + m_Size, data, size);
 		m_Size += size;
 	}
+	// Keeps the buffer for the next writes
+	void Clear()
+	{
+		m_Size = 0;
+	}
+	// Bytes past the old size are left uninitialized
+	void Resize(uint64_t size)
+	{
+		GrowIfNeeded(size);
+		m_Size = size;
+	}
+	uint8_t* GetData()
+	{
+		return m_Buffer.get();
+	}
 	const uint8_t* GetData() const
 	{
 		return m_Buffer.get();
@@ -99,6 +114,11 @@ public:
 		return m_ReaderPosition >= m_BufferSize;
 	}
 
+	uint64_t GetPosition() const
+	{
+		return m_ReaderPosition;
+	}
+
 	template<typename T>
 	friend typename std::enable_if<std::is_integral<T>::value, MemoryInputStream&>::type
 		operator>>(MemoryInputStream& stream, T& value)
@@ -128,4 +148,20 @@ private:
 	const uint8_t* m_Buffer;
 };
 
+// Whole arrays of plain data, e.g. the component data in world snapshots
+template<typename Vector>
+void WriteArray(MemoryOutputStream& stream, const Vector& data)
+{
+	stream << uint64_t(data.size());
+	stream.Write(reinterpret_cast<const uint8_t*>(data.data()), sizeof(typename Vector::value_type) * data.size());
+}
+template<typename Vector>
+void ReadArray(MemoryInputStream& stream, Vector& data)
+{
+	uint64_t size;
+	stream >> size;
+	data.resize(size_t(size));
+	stream.Read(reinterpret_cast<uint8_t*>(data.data()), sizeof(typename Vector::value_type) * size);
+}
+
 }
@@ -17,6 +17,10 @@ inline physx::PxVec3 ZmeyVectorToPxVector(const Zmey::Vector3& vec)
 {
 	return physx::PxVec3(vec.x, vec.y, vec.z);
 }
+inline Zmey::Vector3 PxVectorToZmeyVector(const physx::PxVec3& vec)
+{
+	return Zmey::Vector3(vec.x, vec.y, vec.z);
+}
 
 void PhysicsActor::ApplyForce(const Zmey::Vector3& force)
 {
@@ -39,6 +43,29 @@ void PhysicsActor::TeleportTo(const Zmey::Vector3& point)
 	m_Actor.setGlobalPose(pose);
 }
 
+void PhysicsActor::SetPose(const Zmey::Vector3& position, const Zmey::Quaternion& rotation)
+{
+	m_Actor.setGlobalPose(physx::PxTransform(ZmeyVectorToPxVector(position), physx::PxQuat(rotation.x, rotation.y, rotation.z, rotation.w)));
+}
+
+Zmey::Vector3 PhysicsActor::GetLinearVelocity() const
+{
+	return m_IsStatic ? Zmey::Vector3(0.f) : PxVectorToZmeyVector(static_cast<const physx::PxRigidBody&>(m_Actor).getLinearVelocity());
+}
+
+Zmey::Vector3 PhysicsActor::GetAngularVelocity() const
+{
+	return m_IsStatic ? Zmey::Vector3(0.f) : PxVectorToZmeyVector(static_cast<const physx::PxRigidBody&>(m_Actor).getAngularVelocity());
+}
+
+void PhysicsActor::SetVelocity(const Zmey::Vector3& linear, const Zmey::Vector3& angular)
+{
+	ASSERT(!m_IsStatic);
+	auto& body = static_cast<physx::PxRigidBody&>(m_Actor);
+	body.setLinearVelocity(ZmeyVectorToPxVector(linear));
+	body.setAngularVelocity(ZmeyVectorToPxVector(angular));
+}
+
 PhysicsActor::PhysicsActor(physx::PxRigidActor& pxActor, bool isStatic)
 	: m_Actor(pxActor)
 	, m_IsStatic(isStatic)
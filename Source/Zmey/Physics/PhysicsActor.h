@@ -20,6 +20,16 @@ public:
 	void ApplyForce(const Zmey::Vector3& force);
 	void ApplyImpulse(const Zmey::Vector3& force);
 	void TeleportTo(const Zmey::Vector3& point);
+	// Unlike TeleportTo, works for static actors too
+	void SetPose(const Zmey::Vector3& position, const Zmey::Quaternion& rotation);
+	// Zero for static actors
+	Zmey::Vector3 GetLinearVelocity() const;
+	Zmey::Vector3 GetAngularVelocity() const;
+	void SetVelocity(const Zmey::Vector3& linear, const Zmey::Vector3& angular);
+	inline bool IsStatic() const
+	{
+		return m_IsStatic;
+	}
 private:
 	PhysicsActor(physx::PxRigidActor& pxActor, bool isStatic);
 	friend class PhysicsEngine;
@@ -4,7 +4,11 @@
 
 #include <Zmey/MemoryStream.h>
 #include <Zmey/Components/ComponentRegistry.h>
+#include <Zmey/Components/EntitySortKeys.h>
+#include <Zmey/Components/ReflectedComponentManager.h>
+#include <Zmey/Components/TransformManager.h>
 #include <Zmey/Modules.h>
+#include <Zmey/World.h>
 
 namespace Zmey
 {
@@ -16,26 +20,18 @@ void PhysicsComponentManager::Simulate(float deltaTime)
 }
 
 
-void PhysicsComponentDefaults(Components::IDataBlob& blob)
-{
-	bool dynamic = false;
-	blob.WriteData("dynamic", reinterpret_cast<uint8_t*>(&dynamic), sizeof(dynamic));
-}
+#define PHYSICS_FIELDS(FIELD) \
+	FIELD(bool, Dynamic, "dynamic", false)
 
-void PhysicsComponentToBlob(const nlohmann::json& rawJson, Components::IDataBlob& blob)
-{
-	if (rawJson.find("dynamic") != rawJson.end())
-	{
-		ASSERT_FATAL(rawJson["dynamic"].is_boolean());
-		bool dynamic = rawJson["dynamic"];
-		blob.WriteData("dynamic", reinterpret_cast<uint8_t*>(&dynamic), sizeof(dynamic));
-	}
-}
+DEFINE_REFLECTED_BLOB_FUNCTIONS(PhysicsComponentDefaults, PhysicsComponentToBlob, PHYSICS_FIELDS);
 
 void PhysicsComponentManager::InitializeFromBlob(const tmp::vector<EntityId>& entities, Zmey::MemoryInputStream& stream)
 {
 	auto& physEngine = Zmey::Modules.PhysicsEngine;
-	physEngine.SetWorld(GetWorld());
+	if (!m_Scene)
+	{
+		m_Scene = physEngine.CreateScene(GetWorld());
+	}
 
 	Zmey::Physics::PhysicsMaterialDescription defaultMat;
 	defaultMat.Friction = 0.5;
@@ -43,40 +39,156 @@ void PhysicsComponentManager::InitializeFromBlob(const tmp::vector<EntityId>& en
 	defaultMat.Density = 0.5;
 	physEngine.CreatePhysicsMaterial(Zmey::Name("default"), defaultMat);
 
-	Zmey::Physics::PhysicsActorDescription actorDescription;
-	actorDescription.IsStatic = true;
-	actorDescription.Mass = 70;
-	actorDescription.IsTrigger = false;
-	actorDescription.Material = Zmey::Name("default");
 	auto capsuleGeometry = physEngine.CreateSphereGeometry(0.1f);
-	actorDescription.Geometry = capsuleGeometry.get();
 	for (auto& entityId : entities)
 	{
 		bool dynamic = false;
 		stream.Read(reinterpret_cast<uint8_t*>(&dynamic), sizeof(dynamic));
-		actorDescription.IsStatic = !dynamic;
-		auto actor = physEngine.CreatePhysicsActor(entityId, actorDescription);
+		auto actor = CreateActor(entityId, dynamic, capsuleGeometry.get());
+		const auto existingIndex = m_Entities.IndexOf(entityId);
+		if (existingIndex != arena::sparse_set::InvalidIndex)
+		{
+			m_Actors[existingIndex] = std::move(actor);
+			m_Dynamic[existingIndex] = dynamic;
+			continue;
+		}
+		m_Entities.Insert(entityId);
 		m_Actors.push_back(std::move(actor));
-		m_EntityToActor[entityId] = static_cast<EntityId::IndexType>(m_Actors.size() - 1u);
+		m_Dynamic.push_back(dynamic);
+	}
+}
+
+stl::unique_ptr<Zmey::Physics::PhysicsActor> PhysicsComponentManager::CreateActor(EntityId entity, bool dynamic, Zmey::Physics::Geometry* geometry)
+{
+	Zmey::Physics::PhysicsActorDescription actorDescription;
+	actorDescription.IsStatic = !dynamic;
+	actorDescription.Mass = 70;
+	actorDescription.IsTrigger = false;
+	actorDescription.Material = Zmey::Name("default");
+	actorDescription.Geometry = geometry;
+	return Zmey::Modules.PhysicsEngine.CreatePhysicsActor(*m_Scene, entity, actorDescription);
+}
+
+void PhysicsComponentManager::InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize)
+{
+	// Actors get created one by one anyway, but the material and the geometry only once
+	bool dynamic = false;
+	Zmey::MemoryInputStream(blob, blobSize).Read(reinterpret_cast<uint8_t*>(&dynamic), sizeof(dynamic));
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<EntityId> entityVec(entities, entities + count);
+	tmp::vector<uint8_t> data(count * sizeof(dynamic));
+	for (size_t i = 0u; i < count; ++i)
+	{
+		std::memcpy(&data[i * sizeof(dynamic)], &dynamic, sizeof(dynamic));
 	}
+	Zmey::MemoryInputStream stream(data.data(), data.size());
+	InitializeFromBlob(entityVec, stream);
 }
 
 void PhysicsComponentManager::RemoveEntity(EntityId id)
 {
-	auto index = m_EntityToActor[id];
-	m_EntityToActor.erase(id);
-	// TODO: remove me from the actors list and refill m_EntityToActor map
-	m_Actors[index].reset();
+	const auto index = m_Entities.Remove(id);
+	if (index != arena::sparse_set::InvalidIndex)
+	{
+		SwapAndPop(m_Actors, index);
+		SwapAndPop(m_Dynamic, index);
+	}
 }
 
-Zmey::Physics::PhysicsActor* PhysicsComponentManager::Lookup(EntityId entity)
+void PhysicsComponentManager::SaveSnapshot(Zmey::MemoryOutputStream& stream) const
 {
-	auto it = m_EntityToActor.find(entity);
-	if (it != m_EntityToActor.end())
+	m_Entities.Save(stream);
+	WriteArray(stream, m_Dynamic);
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<Zmey::Vector3> linearVelocities(m_Actors.size());
+	tmp::vector<Zmey::Vector3> angularVelocities(m_Actors.size());
+	for (size_t i = 0u; i < m_Actors.size(); ++i)
 	{
-		return m_Actors[it->second].get();
+		linearVelocities[i] = m_Actors[i]->GetLinearVelocity();
+		angularVelocities[i] = m_Actors[i]->GetAngularVelocity();
 	}
-	return nullptr;
+	WriteArray(stream, linearVelocities);
+	WriteArray(stream, angularVelocities);
+}
+
+void PhysicsComponentManager::RestoreSnapshot(Zmey::MemoryInputStream& stream)
+{
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<EntityId> oldEntities(m_Entities.begin(), m_Entities.end());
+	tmp::vector<uint8_t> oldDynamic(m_Dynamic.begin(), m_Dynamic.end());
+	tmp::vector<stl::unique_ptr<Zmey::Physics::PhysicsActor>> oldActors;
+	oldActors.reserve(m_Actors.size());
+	for (auto& actor : m_Actors)
+	{
+		oldActors.push_back(std::move(actor));
+	}
+
+	m_Entities.Restore(stream);
+	ReadArray(stream, m_Dynamic);
+	ReadArray(stream, m_RestoredLinearVelocities);
+	ReadArray(stream, m_RestoredAngularVelocities);
+	m_Actors.clear();
+	m_Actors.resize(m_Entities.size());
+	// Actors of entities that are still around are kept, the rest get released when oldActors goes away
+	for (size_t i = 0u; i < oldEntities.size(); ++i)
+	{
+		const auto index = m_Entities.IndexOf(oldEntities[i]);
+		if (index != arena::sparse_set::InvalidIndex && m_Dynamic[index] == oldDynamic[i])
+		{
+			m_Actors[index] = std::move(oldActors[i]);
+		}
+	}
+}
+
+void PhysicsComponentManager::FinishRestoringSnapshot()
+{
+	auto& transformManager = GetWorld().GetManager<Zmey::Components::TransformManager>();
+	Zmey::Physics::PhysicsEngine::GeometryPtr geometry;
+	for (EntityId::IndexType i = 0u; i < m_Actors.size(); ++i)
+	{
+		const EntityId entity = m_Entities.EntityAt(i);
+		if (!m_Actors[i])
+		{
+			// Destroyed after the snapshot was taken, the new actor starts at the restored transform
+			ASSERT_FATAL(m_Scene);
+			if (!geometry)
+			{
+				geometry = Zmey::Modules.PhysicsEngine.CreateSphereGeometry(0.1f);
+			}
+			m_Actors[i] = CreateActor(entity, m_Dynamic[i] != 0u, geometry.get());
+		}
+		else
+		{
+			auto transform = transformManager.Lookup(entity);
+			m_Actors[i]->SetPose(transform.GetPosition(), transform.GetRotation());
+		}
+		if (m_Dynamic[i])
+		{
+			m_Actors[i]->SetVelocity(m_RestoredLinearVelocities[i], m_RestoredAngularVelocities[i]);
+		}
+	}
+	m_RestoredLinearVelocities.clear();
+	m_RestoredAngularVelocities.clear();
+}
+
+bool PhysicsComponentManager::SortEntities(const Zmey::Components::EntitySortKeys& keys)
+{
+	// The actors know their entities rather than indices, so only the pointers move
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	const stl::vector<EntityId::IndexType> order = keys.SortOrder(m_Entities);
+	if (!order.empty())
+	{
+		m_Entities.Reorder(order);
+		Permute(m_Actors, order);
+		Permute(m_Dynamic, order);
+	}
+	return true;
+}
+
+Zmey::Physics::PhysicsActor* PhysicsComponentManager::Lookup(EntityId entity)
+{
+	const auto index = m_Entities.IndexOf(entity);
+	return index != arena::sparse_set::InvalidIndex ? m_Actors[index].get() : nullptr;
 }
 
 DEFINE_COMPONENT_MANAGER(PhysicsComponentManager, Physics, PhysicsComponentDefaults, PhysicsComponentToBlob);
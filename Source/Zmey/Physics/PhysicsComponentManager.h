@@ -1,8 +1,10 @@
 #pragma once
 #include <Zmey/Math/Math.h>
 #include <Zmey/EntityManager.h>
+#include <Zmey/Containers/SparseSet.h>
 #include <Zmey/Components/ComponentRegistryCommon.h>
 #include <Zmey/Components/ComponentManager.h>
+#include <Zmey/Physics/PhysicsEngine.h>
 
 namespace Zmey
 {
@@ -16,12 +18,43 @@ class PhysicsComponentManager : public Zmey::Components::ComponentManager
 	DECLARE_COMPONENT_MANAGER(PhysicsComponentManager);
 public:
 	ZMEY_API Zmey::Physics::PhysicsActor* Lookup(EntityId entity);
+	// Data of the entity at the given index of the entity set, see Components::Query
+	inline Zmey::Physics::PhysicsActor* ActorAt(EntityId::IndexType index)
+	{
+		return m_Actors[index].get();
+	}
+	inline const arena::sparse_set& GetEntitySet() const
+	{
+		return m_Entities;
+	}
+	// The scene of this world, created along with the first actor. Null while the world has none.
+	inline Zmey::Physics::PhysicsScene* GetScene()
+	{
+		return m_Scene.get();
+	}
 	virtual void InitializeFromBlob(const tmp::vector<EntityId>&, Zmey::MemoryInputStream&) override;
+	virtual void InitializeFromTemplate(const EntityId* entities, size_t count, const uint8_t* blob, size_t blobSize) override;
 	virtual void Simulate(float deltaTime) override;
 	virtual void RemoveEntity(EntityId id) override;
+	// Saves which entities have actors, whether they are dynamic and their velocities. The poses come from the transforms.
+	virtual void SaveSnapshot(Zmey::MemoryOutputStream& stream) const override;
+	// Releases the actors of entities that aren't in the snapshot, the rest get their pose and velocity
+	// (and actors that are missing get created) in FinishRestoringSnapshot once the transforms are restored
+	virtual void RestoreSnapshot(Zmey::MemoryInputStream& stream) override;
+	virtual void FinishRestoringSnapshot() override;
+	virtual bool SortEntities(const Zmey::Components::EntitySortKeys& keys) override;
 private:
-	stl::unordered_map<EntityId, EntityId::IndexType> m_EntityToActor;
-	stl::vector<stl::unique_ptr<Zmey::Physics::PhysicsActor>> m_Actors;
+	stl::unique_ptr<Zmey::Physics::PhysicsActor> CreateActor(EntityId entity, bool dynamic, Zmey::Physics::Geometry* geometry);
+
+	// Declared first so that the actors get released before their scene
+	stl::unique_ptr<Zmey::Physics::PhysicsScene> m_Scene;
+	// Packed, in the order of m_Entities
+	arena::vector<stl::unique_ptr<Zmey::Physics::PhysicsActor>> m_Actors;
+	arena::vector<uint8_t> m_Dynamic;
+	arena::sparse_set m_Entities;
+	// Read by RestoreSnapshot, applied and cleared by FinishRestoringSnapshot
+	arena::vector<Zmey::Vector3> m_RestoredLinearVelocities;
+	arena::vector<Zmey::Vector3> m_RestoredAngularVelocities;
 };
 
 }
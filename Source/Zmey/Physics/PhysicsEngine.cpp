@@ -83,17 +83,29 @@ public:
 	{
 		return 3; // TODO: get this from somewhere
 	}
+
+	// Parks the calling job until the jobs queued so far got to run. Unlike blocking the thread, this keeps
+	// the worker running jobs in the meantime, the tasks submitted above among them.
+	static void YieldToQueuedJobs()
+	{
+		Job::Counter counter;
+		Job::JobDecl job{ EmptyJobEntryPoint, nullptr };
+		Zmey::Modules.JobSystem.RunJobs("PhysX Wait", &job, 1, &counter);
+		Zmey::Modules.JobSystem.WaitForCounter(&counter, 0);
+	}
+private:
+	static void EmptyJobEntryPoint(void*)
+	{}
 };
 
 
-const float PhysicsEngine::TimeStep = 1 / 60.f;
+const uint32_t PhysicsScene::ScratchMemorySize = 1024 * 1024; // 1mb
+const uint32_t PhysicsScene::ScratchMemoryAlignment = 16 * 1024; // 16 KB align needed
 
 PhysicsEngine::PhysicsEngine()
 	: m_Allocator(StaticAlloc<PhysicsAllocator>())
 	, m_ErrorReporter(StaticAlloc<PhysicsErrorReporter>())
 	, m_CpuDispatcher(StaticAlloc<PhysicsCpuDispatcher>())
-	, m_World(nullptr)
-	, m_TimeAccumulator(0.f)
 {
 	m_Foundation.reset(PxCreateFoundation(PX_FOUNDATION_VERSION, *m_Allocator, *m_ErrorReporter));
 	ASSERT_FATAL(m_Foundation);
@@ -107,7 +119,15 @@ PhysicsEngine::PhysicsEngine()
 #endif
 	m_Physics.reset(PxCreatePhysics(PX_PHYSICS_VERSION, *m_Foundation, scale, recordMemoryAllocations, m_VisualDebugger.get()));
 	ASSERT_FATAL(m_Physics);
-	
+	LOG(Info, Physics, "Physics system initialized!");
+}
+
+PhysicsEngine::~PhysicsEngine()
+{}
+
+stl::unique_ptr<PhysicsScene> PhysicsEngine::CreateScene(Zmey::World& world)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
 	physx::PxSceneDesc sceneDesc(m_Physics->getTolerancesScale());
 	sceneDesc.gravity = physx::PxVec3(0.0f, 0.0f, 0.0f);
 
@@ -123,25 +143,43 @@ PhysicsEngine::PhysicsEngine()
 
 	sceneDesc.broadPhaseType = physx::PxBroadPhaseType::eSAP; // TODO: Switch to MBP
 
-	m_Scene.reset(m_Physics->createScene(sceneDesc));
-	ASSERT_FATAL(m_Scene);
+	physx::PxScene* scene = m_Physics->createScene(sceneDesc);
+	ASSERT_FATAL(scene);
 
-	physx::PxSceneWriteLock scopedLock(*m_Scene);
-	m_Scene->setVisualizationParameter(physx::PxVisualizationParameter::eSCALE, 1.f);
-	m_Scene->setVisualizationParameter(physx::PxVisualizationParameter::eCOLLISION_SHAPES, 1.0f);
-	LOG(Info, Physics, "Physics system initialized!");
+	{
+		physx::PxSceneWriteLock scopedLock(*scene);
+		scene->setVisualizationParameter(physx::PxVisualizationParameter::eSCALE, 1.f);
+		scene->setVisualizationParameter(physx::PxVisualizationParameter::eCOLLISION_SHAPES, 1.0f);
+	}
 
-	physx::PxPvdSceneClient* pvdClient = m_Scene->getScenePvdClient();
+	physx::PxPvdSceneClient* pvdClient = scene->getScenePvdClient();
 	if (pvdClient)
 	{
 		pvdClient->setScenePvdFlag(physx::PxPvdSceneFlag::eTRANSMIT_CONSTRAINTS, true);
 		pvdClient->setScenePvdFlag(physx::PxPvdSceneFlag::eTRANSMIT_CONTACTS, true);
 		pvdClient->setScenePvdFlag(physx::PxPvdSceneFlag::eTRANSMIT_SCENEQUERIES, true);
 	}
+	return stl::unique_ptr<PhysicsScene>(new PhysicsScene(world, *scene));
 }
 
-PhysicsEngine::~PhysicsEngine()
-{}
+PhysicsScene::PhysicsScene(Zmey::World& world, physx::PxScene& scene)
+	: m_World(world)
+	, m_Scene(scene)
+	, m_HasIssuedSimulate(false)
+{
+	m_ScratchMemory.resize(ScratchMemorySize + ScratchMemoryAlignment);
+}
+
+PhysicsScene::~PhysicsScene()
+{
+	// A step that is still running has to finish before the scene goes away
+	if (m_HasIssuedSimulate)
+	{
+		WaitForStep();
+		m_Scene.fetchResults(true);
+	}
+	m_Scene.release();
+}
 
 void PhysicsEngine::CreateDebuggerConnection()
 {
@@ -164,78 +202,90 @@ void PhysicsEngine::CreateDebuggerConnection()
 #endif
 }
 
-void PhysicsEngine::Simulate(float deltaTime)
+void PhysicsScene::Simulate(float deltaTime)
 {
-	m_TimeAccumulator += deltaTime;
-	if (m_TimeAccumulator < PhysicsEngine::TimeStep)
 	{
-		return;
-	}
+		physx::PxSceneWriteLock writeLock(m_Scene);
+		void* scratchMemoryAddress = m_ScratchMemory.data();
+		size_t sizeWithAlignment = m_ScratchMemory.size();
 
-	m_TimeAccumulator -= PhysicsEngine::TimeStep;
-	TEMP_ALLOCATOR_SCOPE;
-	const uint32_t desiredSize = 1024 * 1024; // 1mb
-	const uint32_t alignment = 16 * 1024; // 16 KB align needed
-	size_t sizeWithAlignment = desiredSize + alignment;
-	tmp::unique_array<uint8_t> scratchMemory = tmp::make_unique_array<uint8_t>(sizeWithAlignment);
-	{
-		physx::PxSceneWriteLock writeLock(*m_Scene);
-		void* scratchMemoryAddress = scratchMemory.get();
-
-		m_Scene->simulate(
-			PhysicsEngine::TimeStep,
+		m_Scene.simulate(
+			deltaTime,
 			nullptr,
-			std::align(alignment, desiredSize, scratchMemoryAddress, sizeWithAlignment),
-			desiredSize);
+			std::align(ScratchMemoryAlignment, ScratchMemorySize, scratchMemoryAddress, sizeWithAlignment),
+			ScratchMemorySize);
 	}
 	m_HasIssuedSimulate = true;
 }
 
+void PhysicsScene::WaitForStep()
+{
+	// Blocking in fetchResults would hold up the worker thread while the tasks of the step wait in the job queue.
+	// Once every worker did that for a world of its own there would be nobody left to run them.
+	while (!m_Scene.checkResults(false))
+	{
+		PhysicsCpuDispatcher::YieldToQueuedJobs();
+	}
+}
+
 inline void SetZmeyTransformFromPhysx(Zmey::Components::TransformInstance& transform, const physx::PxTransform& pxTransform)
 {
-	transform.Position().x = pxTransform.p.x;
-	transform.Position().y = pxTransform.p.y;
-	transform.Position().z = pxTransform.p.z;
-	transform.Rotation().x = pxTransform.q.x;
-	transform.Rotation().y = pxTransform.q.y;
-	transform.Rotation().z = pxTransform.q.z;
-	transform.Rotation().w = pxTransform.q.w;
+	Zmey::Vector3& position = transform.Position();
+	Zmey::Quaternion& rotation = transform.Rotation();
+	position.x = pxTransform.p.x;
+	position.y = pxTransform.p.y;
+	position.z = pxTransform.p.z;
+	rotation.x = pxTransform.q.x;
+	rotation.y = pxTransform.q.y;
+	rotation.z = pxTransform.q.z;
+	rotation.w = pxTransform.q.w;
 }
 
 inline void SetPhysxTransformFromZmey(physx::PxTransform& pxTransform, const Zmey::Components::TransformInstance& transform)
 {
-	pxTransform.p.x = transform.Position().x;
-	pxTransform.p.y = transform.Position().y;
-	pxTransform.p.z = transform.Position().z;
-	pxTransform.q.x = transform.Rotation().x;
-	pxTransform.q.y = transform.Rotation().y;
-	pxTransform.q.z = transform.Rotation().z;
-	pxTransform.q.w = transform.Rotation().w;
+	const Zmey::Vector3& position = transform.GetPosition();
+	const Zmey::Quaternion& rotation = transform.GetRotation();
+	pxTransform.p.x = position.x;
+	pxTransform.p.y = position.y;
+	pxTransform.p.z = position.z;
+	pxTransform.q.x = rotation.x;
+	pxTransform.q.y = rotation.y;
+	pxTransform.q.z = rotation.z;
+	pxTransform.q.w = rotation.w;
 }
 
-void PhysicsEngine::FetchResults()
+void PhysicsScene::FetchResults()
 {
 	if (!m_HasIssuedSimulate)
 	{
 		return;
 	}
 
+	WaitForStep();
 	{
-		physx::PxSceneReadLock writeLock(*m_Scene);
+		physx::PxSceneReadLock writeLock(m_Scene);
 
 		physx::PxU32 error(physx::PxErrorCode::eNO_ERROR);
-		m_Scene->fetchResults(true, &error);
+		// Returns right away, the step is done
+		m_Scene.fetchResults(true, &error);
 		ASSERT(error == physx::PxErrorCode::eNO_ERROR);
 	}
 	m_HasIssuedSimulate = false;
 
 	physx::PxU32 activeTransformsCount = -1;
-	auto activeTransforms = m_Scene->getActiveTransforms(activeTransformsCount);
-	auto& transformManager = m_World->GetManager<Zmey::Components::TransformManager>();
+	auto activeTransforms = m_Scene.getActiveTransforms(activeTransformsCount);
+	auto& transformManager = m_World.GetManager<Zmey::Components::TransformManager>();
+	const auto& transformEntities = transformManager.GetEntitySet();
 	for (physx::PxU32 i = 0; i < activeTransformsCount; ++i)
 	{
 		auto entityId = static_cast<Zmey::EntityId>(reinterpret_cast<uint64_t>(activeTransforms[i].userData));
-		auto transform = transformManager.Lookup(entityId);
+		// The entity may have lost its transform since the actor was created, e.g. by a rollback
+		const auto index = transformEntities.IndexOf(entityId);
+		if (index == arena::sparse_set::InvalidIndex)
+		{
+			continue;
+		}
+		auto transform = transformManager.InstanceAt(index);
 		// TODO This currently copies transforms as an array of structs; change to SoA.
 		SetZmeyTransformFromPhysx(transform, activeTransforms[i].actor2World);
 	}
@@ -260,12 +310,13 @@ PhysicsEngine::GeometryPtr PhysicsEngine::CreateCapsuleGeometry(float radius, fl
 	return result;
 }
 
-stl::unique_ptr<PhysicsActor> PhysicsEngine::CreatePhysicsActor(EntityId entityId, const PhysicsActorDescription& actorDescription)
+stl::unique_ptr<PhysicsActor> PhysicsEngine::CreatePhysicsActor(PhysicsScene& scene, EntityId entityId, const PhysicsActorDescription& actorDescription)
 {
+	std::unique_lock<std::mutex> lock(m_Mutex);
 	const CombinedMaterialInfo* material = FindMaterial(actorDescription.Material);
 	ASSERT(material);
 	physx::PxRigidActor* actor = nullptr;
-	auto actorTransform = m_World->GetManager<Zmey::Components::TransformManager>().Lookup(entityId);
+	auto actorTransform = scene.m_World.GetManager<Zmey::Components::TransformManager>().Lookup(entityId);
 	physx::PxTransform currentTransform;
 	SetPhysxTransformFromZmey(currentTransform, actorTransform);
 	if (actorDescription.IsStatic)
@@ -283,14 +334,26 @@ stl::unique_ptr<PhysicsActor> PhysicsEngine::CreatePhysicsActor(EntityId entityI
 	actor->attachShape(*shape);
 	actor->userData = reinterpret_cast<void*>(static_cast<uint64_t>(entityId));
 	shape->release();
-	m_Scene->addActor(*actor);
+	lock.unlock();
+	scene.m_Scene.addActor(*actor);
 
 	stl::unique_ptr<Zmey::Physics::PhysicsActor> physicsActor(new Zmey::Physics::PhysicsActor(*actor, actorDescription.IsStatic));
 	return physicsActor;
 }
 void PhysicsEngine::CreatePhysicsMaterial(Zmey::Name name, const PhysicsMaterialDescription& description)
 {
+	std::lock_guard<std::mutex> lock(m_Mutex);
 	auto material = m_Physics->createMaterial(description.Friction, description.Friction, description.Restitution);
+	for (auto& materialNamePair : m_Materials)
+	{
+		if (materialNamePair.first == name)
+		{
+			// Shapes in other scenes may be simulating with the old material, they keep a reference to it
+			materialNamePair.second.PhysxMaterial->release();
+			materialNamePair.second = CombinedMaterialInfo{ material, description };
+			return;
+		}
+	}
 	m_Materials.push_back(std::make_pair(name, CombinedMaterialInfo{ material, description }));
 }
 
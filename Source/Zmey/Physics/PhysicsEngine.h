@@ -1,4 +1,6 @@
 #pragma once
+#include <mutex>
+
 #include <Zmey/Config.h>
 #include <Zmey/EntityManager.h>
 #include <Zmey/Hash.h>
@@ -13,8 +15,8 @@ class PxFoundation;
 class PxMaterial;
 class PxPhysics;
 class PxScene;
-class PxGeometryHolder;
-class PxPvd;
+class PxGeometryHolder;
+class PxPvd;
 class PxPvdTransport;
 }
 namespace Zmey
@@ -46,6 +48,33 @@ struct PhysicsMaterialDescription
 	float Density;
 };
 
+// The part of the physics simulation that belongs to a single world. Scenes of different worlds can be stepped
+// at the same time, the engine keeps only what they share - the PhysX SDK, the materials and the CPU dispatcher.
+class PhysicsScene
+{
+public:
+	~PhysicsScene();
+	// Steps the scene by exactly deltaTime, the world scheduler calls it with its fixed time step
+	void Simulate(float deltaTime);
+	// Waits for the step to finish and copies the transforms of the actors that moved to the world.
+	// Has to be called from a job, the worker runs other jobs while waiting.
+	void FetchResults();
+private:
+	PhysicsScene(Zmey::World& world, physx::PxScene& scene);
+	void WaitForStep();
+	friend class PhysicsEngine;
+
+	Zmey::World& m_World;
+	physx::PxScene& m_Scene;
+	// Handed to PhysX on every simulate, has to outlive the step until FetchResults
+	huge::vector<uint8_t> m_ScratchMemory;
+	bool m_HasIssuedSimulate;
+
+	static const uint32_t ScratchMemorySize;
+	static const uint32_t ScratchMemoryAlignment;
+};
+
+// Thread-safe, worlds create their scenes and actors from their own jobs
 class PhysicsEngine
 {
 public:
@@ -56,12 +85,10 @@ public:
 	GeometryPtr CreateBoxGeometry(float width, float height, float depth) const;
 	GeometryPtr CreateSphereGeometry(float radius) const;
 	GeometryPtr CreateCapsuleGeometry(float radius, float height) const;
-	stl::unique_ptr<PhysicsActor> CreatePhysicsActor(EntityId, const PhysicsActorDescription&);
+	stl::unique_ptr<PhysicsScene> CreateScene(Zmey::World& world);
+	stl::unique_ptr<PhysicsActor> CreatePhysicsActor(PhysicsScene& scene, EntityId, const PhysicsActorDescription&);
+	// Replaces the description of a material with the same name
 	void CreatePhysicsMaterial(Zmey::Name, const PhysicsMaterialDescription&);
-	
-	void Simulate(float deltaTime);
-	void FetchResults();
-	void SetWorld(Zmey::World& world) { m_World = &world; }
 private:
 	// This struct is neccessary because we'd like to add some properties to the material
 	// (such as density) instead of keeping them on the actor like physx does.
@@ -86,22 +113,16 @@ private:
 	using physx_ptr = stl::unique_ptr<T, PhysxDeleter<T>>;
 	physx_ptr<physx::PxFoundation> m_Foundation;
 	physx_ptr<physx::PxPvdTransport> m_Transport;
-	physx_ptr<physx::PxPvd> m_VisualDebugger;
+	physx_ptr<physx::PxPvd> m_VisualDebugger;
 	physx_ptr<physx::PxPhysics> m_Physics;
-	// TODO: The scene should be part of the world, not the engine
-	physx_ptr<physx::PxScene> m_Scene;
 
 	stl::vector<std::pair<Zmey::Name, CombinedMaterialInfo>> m_Materials;
+	// Guards the materials and the creation of PhysX objects
+	std::mutex m_Mutex;
 
 	PhysicsAllocator* m_Allocator;
 	PhysicsErrorReporter* m_ErrorReporter;
 	PhysicsCpuDispatcher* m_CpuDispatcher;
-
-	Zmey::World* m_World;
-
-	static const float TimeStep;
-	float m_TimeAccumulator;
-	bool m_HasIssuedSimulate;
 };
 
 }
@@ -1,6 +1,5 @@
 #include <Zmey/ResourceLoader/ResourceLoader.h>
 
-#include <fstream>
 #include <utility>
 
 #include <Zmey/Modules.h>
@@ -26,10 +25,7 @@ void ResourceLoader::ReleaseOwnershipOver(Zmey::Name name)
 	});
 	if (it != m_Worlds.end())
 	{
-		// concurrent_vector doesn't support erase, so swap and resize
-		// TODO Are the following 3 operations thread transactional?
-		std::swap(it, m_Worlds.end() - 1);
-		m_Worlds.resize(m_Worlds.size() - 1);
+		m_Worlds.erase(it);
 	}
 }
 #define FIRST_IN_ALL_RESOURCE_COLLECTIONS(Function, Name) \
@@ -40,7 +36,7 @@ void ResourceLoader::ReleaseOwnershipOver(Zmey::Name name)
 	Function(Name, m_BufferedData)
 
 template<typename T>
-bool ResourceLoader::ResourceExistsInCollection(Zmey::Name name, const stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection)
+bool ResourceLoader::ResourceExistsInCollection(Zmey::Name name, const stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection)
 {
 	return FindResourceIteratorInCollection(name, collection) != collection.end();
 }
@@ -51,17 +47,17 @@ bool ResourceLoader::IsResourceReady(Zmey::Name name)
 }
 
 template<typename T>
-bool ResourceLoader::TryFreeFromCollection(Zmey::Name name, stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection)
+bool ResourceLoader::TryFreeFromCollection(Zmey::Name name, stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection)
 {
 	auto it = FindResourceIteratorInCollection(name, collection);
-	if (it != collection.end())
+	// A concurrent free of the same resource might win the erase, try the next match if so
+	while (it != collection.end())
 	{
-		auto& lastPair = collection[collection.size() - 1];
-		// concurrent_vector doesn't support erase, so swap and resize
-		// TODO Are the following 3 operations thread transactional?
-		it->swap(lastPair);
-		collection.resize(collection.size() - 1);
-		return true;
+		if (collection.erase(it))
+		{
+			return true;
+		}
+		it = FindResourceIteratorInCollection(name, collection);
 	}
 	return false;
 }
@@ -70,6 +66,15 @@ void ResourceLoader::FreeResource(Zmey::Name name)
 	FIRST_IN_ALL_RESOURCE_COLLECTIONS(TryFreeFromCollection, name);
 }
 
+void ResourceLoader::CollectFreedResources()
+{
+	m_Meshes.compact();
+	m_Materials.compact();
+	m_TextContents.compact();
+	m_Worlds.compact();
+	m_BufferedData.compact();
+}
+
 void ResourceLoader::WaitForResource(Zmey::Name name)
 {
 	while (!IsResourceReady(name))
@@ -83,15 +88,15 @@ void ResourceLoader::WaitForAllResources(const tmp::vector<Zmey::Name>& resource
 	{}
 }
 
-void OnResourceMeshLoaded(ResourceLoader* loader, Zmey::Name name, stl::vector<uint8_t>&& data)
+void OnResourceMeshLoaded(ResourceLoader* loader, Zmey::Name name, const SharedAssetRef& data)
 {
-	auto handle = Modules.Renderer.MeshLoaded(std::move(data));
+	auto handle = Modules.Renderer.MeshLoaded(data.data(), data.size());
 	loader->m_Meshes.push_back(std::make_pair(name, handle));
 	FORMAT_LOG(Info, ResourceLoader, "Just loaded mesh for name: %llu", static_cast<uint64_t>(name));
 }
-void OnResourceMaterialLoaded(ResourceLoader* loader, Zmey::Name name, stl::vector<uint8_t>&& data)
+void OnResourceMaterialLoaded(ResourceLoader* loader, Zmey::Name name, const SharedAssetRef& data)
 {
-	auto handle = Modules.Renderer.MaterialLoaded(std::move(data));
+	auto handle = Modules.Renderer.MaterialLoaded(data.data(), data.size());
 	loader->m_Materials.push_back(std::make_pair(name, handle));
 	FORMAT_LOG(Info, ResourceLoader, "Just loaded material for name: %llu", static_cast<uint64_t>(name));
 }
@@ -105,7 +110,7 @@ void OnResourceLoaded(ResourceLoader* loader, Zmey::Name name, World* world)
 	loader->m_Worlds.push_back(std::make_pair(name, world));
 	FORMAT_LOG(Info, ResourceLoader, "Just loaded asset for name: %llu", static_cast<uint64_t>(name));
 }
-void OnResourceLoaded(ResourceLoader* loader, Zmey::Name name, stl::vector<uint8_t>&& data)
+void OnResourceLoaded(ResourceLoader* loader, Zmey::Name name, SharedAssetRef&& data)
 {
 	loader->m_BufferedData.push_back(std::make_pair(name, std::move(data)));
 	FORMAT_LOG(Info, ResourceLoader, "Just loaded asset for name: %llu", static_cast<uint64_t>(name));
@@ -120,69 +125,33 @@ Zmey::Name ResourceLoader::LoadResource(const stl::string& path)
 		return name;
 	}
 
+	// Cooked files are only ever read, so they get mapped rather than copied. Meshes and materials are done
+	// with the data once the renderer has uploaded it, the class blobs stay mapped while anyone references them.
+	SharedAssetRef data = m_SharedAssets.Map(path);
+	ASSERT(data);
 	if (Utilities::EndsWith(path, ".typebin"))
 	{
 		// TODO: Add task
-		{
-			std::ifstream stream(path.c_str(), std::ios::binary);
-			ASSERT(stream.good());
-			stream.seekg(0, std::ios::end);
-			size_t size = stream.tellg();
-			stream.seekg(0);
-
-			stl::vector<uint8_t> data(size);
-			stream.read((char*)data.data(), size);
-			OnResourceLoaded(this, name, std::move(data));
-		}
+		OnResourceLoaded(this, name, std::move(data));
 	}
 	else if (Utilities::EndsWith(path, ".worldbin"))
 	{
 		// TODO: add task
 		{
-			std::ifstream stream(path.c_str(), std::ios::binary);
-			ASSERT(stream.good());
-			stream.seekg(0, std::ios::end);
-			size_t size = stream.tellg();
-			stream.seekg(0);
-
-			stl::unique_array<uint8_t> buffer = stl::make_unique_array<uint8_t>(size);
-			stream.read((char*)buffer.get(), size);
 			World* world = new World();
-			world->InitializeFromBuffer(buffer.get(), size);
+			world->InitializeFromBuffer(data.data(), data.size());
 			OnResourceLoaded(this, name, world);
 		}
 	}
 	else if (Utilities::EndsWith(path, ".material"))
 	{
 		// TODO: add task
-		{
-			// TODO: maybe temp memory ?
-			std::ifstream stream(path.c_str(), std::ios::binary);
-			ASSERT(stream.good());
-			stream.seekg(0, std::ios::end);
-			size_t size = stream.tellg();
-			stream.seekg(0);
-
-			stl::vector<uint8_t> data(size);
-			stream.read((char*)data.data(), size);
-			OnResourceMaterialLoaded(this, name, std::move(data));
-		}
+		OnResourceMaterialLoaded(this, name, data);
 	}
 	else
 	{
 		// TODO: add task
-		{
-			// TODO: maybe temp memory ?
-			std::ifstream stream(path.c_str(), std::ios::binary);
-			ASSERT(stream.good());
-			stream.seekg(0, std::ios::end);
-			size_t size = stream.tellg();
-			stream.seekg(0);
-
-			stl::vector<uint8_t> data(size);
-			stream.read((char*)data.data(), size);
-			OnResourceMeshLoaded(this, name, std::move(data));
-		}
+		OnResourceMeshLoaded(this, name, data);
 	}
 	return name;
 }
@@ -1,7 +1,11 @@
 #pragma once
+#include <algorithm>
+
 #include <Zmey/Memory/MemoryManagement.h>
+#include <Zmey/Containers/SegmentedVector.h>
 #include <Zmey/Hash.h>
 #include <Zmey/Graphics/GraphicsObjects.h>
+#include <Zmey/ResourceLoader/SharedAssetStore.h>
 
 struct aiScene;
 
@@ -17,8 +21,8 @@ class World;
 class ResourceLoader
 {
 	template<typename T>
-	typename stl::concurrent_vector<std::pair<Zmey::Name, T>>::iterator
-		FindResourceIteratorInCollection(Zmey::Name name, stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection) const
+	typename stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>::iterator
+		FindResourceIteratorInCollection(Zmey::Name name, stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection) const
 	{
 		auto it = std::find_if(collection.begin(), collection.end(), [name](const std::pair<Zmey::Name, T>& data)
 		{
@@ -27,8 +31,8 @@ class ResourceLoader
 		return it;
 	}
 	template<typename T>
-	typename stl::concurrent_vector<std::pair<Zmey::Name, T>>::const_iterator
-		FindResourceIteratorInCollection(Zmey::Name name, const stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection) const
+	typename stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>::const_iterator
+		FindResourceIteratorInCollection(Zmey::Name name, const stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection) const
 	{
 		auto it = std::find_if(collection.cbegin(), collection.cend(), [name](const std::pair<Zmey::Name, T>& data)
 		{
@@ -38,7 +42,7 @@ class ResourceLoader
 	}
 	template<typename T>
 	const T* FindResourceInCollection(Zmey::Name name,
-		const stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection) const
+		const stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection) const
 	{
 		auto it = FindResourceIteratorInCollection(name, collection);
 		if (it != collection.end())
@@ -47,6 +51,14 @@ class ResourceLoader
 		}
 		return nullptr;
 	}
+	// The elements move on every CollectFreedResources, so lookups hand out copies
+	template<typename T>
+	T CopyResourceFromCollection(Zmey::Name name,
+		const stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection, const T& missing) const
+	{
+		const T* resource = FindResourceInCollection(name, collection);
+		return resource ? *resource : missing;
+	}
 public:
 	ResourceLoader();
 	~ResourceLoader();
@@ -64,47 +76,61 @@ public:
 
 	// Use non-template methods for public access so as the client doesn't have to wonder
 	// what exact type should he pass in the templated function.
+	// All of them return copies that stay valid however long they are kept, resources that aren't loaded
+	// come back as an invalid handle, a null world, an empty buffer or an empty string.
 
-	ZMEY_API const Graphics::MeshHandle* AsMeshHandle(Zmey::Name name) const
+	ZMEY_API Graphics::MeshHandle AsMeshHandle(Zmey::Name name) const
 	{
-		return FindResourceInCollection(name, m_Meshes);
+		return CopyResourceFromCollection(name, m_Meshes, Graphics::MeshHandle(-1));
 	}
-	ZMEY_API const Graphics::MaterialHandle* AsMaterialHandle(Zmey::Name name) const
+	ZMEY_API Graphics::MaterialHandle AsMaterialHandle(Zmey::Name name) const
 	{
-		return FindResourceInCollection(name, m_Materials);
+		return CopyResourceFromCollection(name, m_Materials, Graphics::MaterialHandle(-1));
 	}
 	ZMEY_API const World* AsWorld(Zmey::Name name) const
 	{
-		World* const* world = FindResourceInCollection(name, m_Worlds);
-		return world ? *world : nullptr;
+		return CopyResourceFromCollection(name, m_Worlds, static_cast<World*>(nullptr));
 	}
-	ZMEY_API const stl::vector<uint8_t>* AsBuffer(Zmey::Name name) const
+	// The reference keeps the data mapped even after the resource gets freed
+	ZMEY_API SharedAssetRef AsBuffer(Zmey::Name name) const
 	{
-		return FindResourceInCollection(name, m_BufferedData);
+		return CopyResourceFromCollection(name, m_BufferedData, SharedAssetRef());
 	}
-	ZMEY_API const stl::string* AsText(Zmey::Name name) const
+	ZMEY_API stl::string AsText(Zmey::Name name) const
 	{
-		return FindResourceInCollection(name, m_TextContents);
+		return CopyResourceFromCollection(name, m_TextContents, stl::string());
 	}
 	ZMEY_API void ReleaseOwnershipOver(Zmey::Name);
 	ZMEY_API void FreeResource(Zmey::Name name);
+	// Destroys resources freed since the last call. Freed resources stay valid until then
+	// so lookups running on other threads never see them destroyed under their feet.
+	// Must be called when no loads or lookups are in flight.
+	ZMEY_API void CollectFreedResources();
+
+	// All cooked files get mapped through it rather than read into memory of their own
+	inline const SharedAssetStore& GetSharedAssets() const
+	{
+		return m_SharedAssets;
+	}
 private:
 	template<typename T>
-	bool TryFreeFromCollection(Zmey::Name name, stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection);
+	bool TryFreeFromCollection(Zmey::Name name, stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection);
 	template<typename T>
-	bool ResourceExistsInCollection(Zmey::Name name, const stl::concurrent_vector<std::pair<Zmey::Name, T>>& collection);
+	bool ResourceExistsInCollection(Zmey::Name name, const stl::concurrent_segmented_vector<std::pair<Zmey::Name, T>>& collection);
 	// Callback for the task system
-	friend void OnResourceMeshLoaded(ResourceLoader*, Zmey::Name, stl::vector<uint8_t>&&);
-	friend void OnResourceMaterialLoaded(ResourceLoader*, Zmey::Name, stl::vector<uint8_t>&&);
+	friend void OnResourceMeshLoaded(ResourceLoader*, Zmey::Name, const SharedAssetRef&);
+	friend void OnResourceMaterialLoaded(ResourceLoader*, Zmey::Name, const SharedAssetRef&);
 	friend void OnResourceLoaded(ResourceLoader*, Zmey::Name, const tmp::string&);
 	friend void OnResourceLoaded(ResourceLoader*, Zmey::Name, World*);
-	friend void OnResourceLoaded(ResourceLoader*, Zmey::Name, stl::vector<uint8_t>&&);
+	friend void OnResourceLoaded(ResourceLoader*, Zmey::Name, SharedAssetRef&&);
 
-	stl::concurrent_vector<std::pair<Zmey::Name, Graphics::MeshHandle>> m_Meshes;
-	stl::concurrent_vector<std::pair<Zmey::Name, Graphics::MaterialHandle>> m_Materials;
-	stl::concurrent_vector<std::pair<Zmey::Name, stl::string>> m_TextContents;
-	stl::concurrent_vector<std::pair<Zmey::Name, World*>> m_Worlds;
-	stl::concurrent_vector<std::pair<Zmey::Name, stl::vector<uint8_t>>> m_BufferedData;
+	// Declared first as the buffers below reference it
+	SharedAssetStore m_SharedAssets;
+	stl::concurrent_segmented_vector<std::pair<Zmey::Name, Graphics::MeshHandle>> m_Meshes;
+	stl::concurrent_segmented_vector<std::pair<Zmey::Name, Graphics::MaterialHandle>> m_Materials;
+	stl::concurrent_segmented_vector<std::pair<Zmey::Name, stl::string>> m_TextContents;
+	stl::concurrent_segmented_vector<std::pair<Zmey::Name, World*>> m_Worlds;
+	stl::concurrent_segmented_vector<std::pair<Zmey::Name, SharedAssetRef>> m_BufferedData;
 };
 
 }
\ No newline at end of file
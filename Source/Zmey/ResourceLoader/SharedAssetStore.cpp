@@ -0,0 +1,200 @@
+#include <Zmey/ResourceLoader/SharedAssetStore.h>
+
+#include <algorithm>
+
+#include <Zmey/Logging.h>
+
+#if defined(ZMEY_PLATFORM_WIN)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace Zmey
+{
+namespace
+{
+// Empty files have nothing to map and keep a null view
+bool MapFile(const char* path, const uint8_t*& data, size_t& size)
+{
+#if defined(ZMEY_PLATFORM_WIN)
+	HANDLE file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(file, &fileSize))
+	{
+		::CloseHandle(file);
+		return false;
+	}
+	size = size_t(fileSize.QuadPart);
+	data = nullptr;
+	if (size == 0u)
+	{
+		::CloseHandle(file);
+		return true;
+	}
+	// The view keeps the mapping and the file open on its own
+	HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	::CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+	data = reinterpret_cast<const uint8_t*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	::CloseHandle(mapping);
+	return data != nullptr;
+#else
+	const int file = ::open(path, O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	if (::fstat(file, &fileStat) != 0)
+	{
+		::close(file);
+		return false;
+	}
+	size = size_t(fileStat.st_size);
+	data = nullptr;
+	if (size == 0u)
+	{
+		::close(file);
+		return true;
+	}
+	void* view = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+	::close(file);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+	data = reinterpret_cast<const uint8_t*>(view);
+	return true;
+#endif
+}
+
+void UnmapFile(const uint8_t* data, size_t size)
+{
+	if (!data)
+	{
+		return;
+	}
+#if defined(ZMEY_PLATFORM_WIN)
+	::UnmapViewOfFile(data);
+#else
+	::munmap(const_cast<uint8_t*>(data), size);
+#endif
+}
+}
+
+SharedAssetRef::SharedAssetRef(const SharedAssetRef& other)
+	: m_Mapping(other.m_Mapping)
+{
+	if (m_Mapping)
+	{
+		// The other reference keeps the count above zero, so the store can't be unmapping it
+		m_Mapping->RefCount.fetch_add(1u, std::memory_order_relaxed);
+	}
+}
+
+SharedAssetRef& SharedAssetRef::operator=(const SharedAssetRef& other)
+{
+	if (m_Mapping != other.m_Mapping)
+	{
+		SharedAssetRef copy(other);
+		Release();
+		std::swap(m_Mapping, copy.m_Mapping);
+	}
+	return *this;
+}
+
+SharedAssetRef& SharedAssetRef::operator=(SharedAssetRef&& other)
+{
+	if (this != &other)
+	{
+		Release();
+		m_Mapping = other.m_Mapping;
+		other.m_Mapping = nullptr;
+	}
+	return *this;
+}
+
+SharedAssetRef::~SharedAssetRef()
+{
+	Release();
+}
+
+void SharedAssetRef::Release()
+{
+	if (m_Mapping)
+	{
+		m_Mapping->Store->Release(m_Mapping);
+		m_Mapping = nullptr;
+	}
+}
+
+SharedAssetStore::~SharedAssetStore()
+{
+	ASSERT(m_Mappings.empty() && "Shared assets are still referenced");
+}
+
+SharedAssetRef SharedAssetStore::Map(const stl::string& path)
+{
+	const Zmey::Name pathName(path.c_str());
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto it = std::find_if(m_Mappings.begin(), m_Mappings.end(), [pathName](const SharedAssetDetail::Mapping* mapping)
+	{
+		return mapping->Path == pathName;
+	});
+	if (it != m_Mappings.end())
+	{
+		(*it)->RefCount.fetch_add(1u, std::memory_order_relaxed);
+		return SharedAssetRef(*it);
+	}
+
+	const uint8_t* data = nullptr;
+	size_t size = 0u;
+	if (!MapFile(path.c_str(), data, size))
+	{
+		FORMAT_LOG(Error, ResourceLoader, "Failed to map %s", path.c_str());
+		return SharedAssetRef();
+	}
+	auto mapping = new SharedAssetDetail::Mapping{ this, pathName, data, size, { 1u } };
+	m_Mappings.push_back(mapping);
+	return SharedAssetRef(mapping);
+}
+
+void SharedAssetStore::Release(SharedAssetDetail::Mapping* mapping)
+{
+	// Dropping the last reference happens under the lock so that Map can't hand out the mapping meanwhile
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (mapping->RefCount.fetch_sub(1u, std::memory_order_acq_rel) != 1u)
+	{
+		return;
+	}
+	m_Mappings.erase(std::find(m_Mappings.begin(), m_Mappings.end(), mapping));
+	UnmapFile(mapping->Data, mapping->Size);
+	delete mapping;
+}
+
+SharedAssetStats SharedAssetStore::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	SharedAssetStats stats{ uint32_t(m_Mappings.size()), 0u, 0u };
+	for (const auto mapping : m_Mappings)
+	{
+		stats.MappedBytes += mapping->Size;
+		stats.ReferencedBytes += mapping->Size * mapping->RefCount.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+}
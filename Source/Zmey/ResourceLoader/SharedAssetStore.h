@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <Zmey/Config.h>
+#include <Zmey/Hash.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+class SharedAssetStore;
+
+namespace SharedAssetDetail
+{
+struct Mapping
+{
+	SharedAssetStore* Store;
+	Zmey::Name Path;
+	const uint8_t* Data;
+	size_t Size;
+	std::atomic<uint32_t> RefCount;
+};
+}
+
+// A reference to the contents of a cooked file, which stay mapped as long as any reference to them exists
+class SharedAssetRef
+{
+public:
+	SharedAssetRef()
+		: m_Mapping(nullptr)
+	{}
+	ZMEY_API SharedAssetRef(const SharedAssetRef& other);
+	SharedAssetRef(SharedAssetRef&& other)
+		: m_Mapping(other.m_Mapping)
+	{
+		other.m_Mapping = nullptr;
+	}
+	ZMEY_API SharedAssetRef& operator=(const SharedAssetRef& other);
+	ZMEY_API SharedAssetRef& operator=(SharedAssetRef&& other);
+	ZMEY_API ~SharedAssetRef();
+
+	inline const uint8_t* data() const
+	{
+		return m_Mapping ? m_Mapping->Data : nullptr;
+	}
+	inline size_t size() const
+	{
+		return m_Mapping ? m_Mapping->Size : 0u;
+	}
+	explicit operator bool() const
+	{
+		return m_Mapping != nullptr;
+	}
+private:
+	explicit SharedAssetRef(SharedAssetDetail::Mapping* mapping)
+		: m_Mapping(mapping)
+	{}
+	void Release();
+
+	SharedAssetDetail::Mapping* m_Mapping;
+	friend class SharedAssetStore;
+};
+
+struct SharedAssetStats
+{
+	uint32_t FileCount;
+	// Each file counted once, that's what the process keeps resident
+	size_t MappedBytes;
+	// Each file counted once per reference, that's what a copy per user would take
+	size_t ReferencedBytes;
+};
+
+// Immutable cooked data - class blobs, worlds, meshes - mapped read-only straight from the files.
+// Within a process every user of a file shares a single mapping, e.g. all worlds that register the same class.
+// Across processes the mappings share their physical pages through the OS file cache, so matches hosted by
+// different processes don't pay for their own copies either. A file gets unmapped once its last reference is gone.
+// Thread-safe.
+class SharedAssetStore
+{
+public:
+	SharedAssetStore() = default;
+	SharedAssetStore(const SharedAssetStore&) = delete;
+	SharedAssetStore& operator=(const SharedAssetStore&) = delete;
+	ZMEY_API ~SharedAssetStore();
+
+	// Returns an empty reference if the file can't be mapped
+	ZMEY_API SharedAssetRef Map(const stl::string& path);
+	ZMEY_API SharedAssetStats GetStats() const;
+private:
+	void Release(SharedAssetDetail::Mapping* mapping);
+
+	mutable std::mutex m_Mutex;
+	stl::vector<SharedAssetDetail::Mapping*> m_Mappings;
+	friend class SharedAssetRef;
+};
+
+}
@@ -1,30 +1,184 @@
 #pragma once
 #include <Zmey/World.h>
+#include <Zmey/EventChannel.h>
 #include <Zmey/Memory/MemoryManagement.h>
 #include <Zmey/MemoryStream.h>
+#include <Zmey/WorldSnapshot.h>
 #include <Zmey/Components/ComponentRegistry.h>
+#include <Zmey/Components/TransformManager.h>
 #include <Zmey/Modules.h>
 #include <Zmey/Utilities.h>
 
+#include <algorithm>
+#include <bitset>
+
 namespace Zmey
 {
+namespace
+{
+using ComponentSet = std::bitset<256u>;
+
+bool ShortNameEquals(const char* shortName, const char* begin, const char* end)
+{
+	for (; begin != end; ++begin, ++shortName)
+	{
+		if (!*shortName || ToLower(*shortName) != ToLower(*begin))
+		{
+			return false;
+		}
+	}
+	return !*shortName;
+}
+
+ComponentSet ParseComponentList(const char* list, ComponentIndex managerCount)
+{
+	ComponentSet result;
+	const char* it = list;
+	while (*it)
+	{
+		while (*it == ',' || *it == ' ')
+		{
+			++it;
+		}
+		const char* nameBegin = it;
+		while (*it && *it != ',' && *it != ' ')
+		{
+			++it;
+		}
+		if (it == nameBegin)
+		{
+			continue;
+		}
+		if (it - nameBegin == 1 && *nameBegin == '*')
+		{
+			result.set();
+			continue;
+		}
+		ComponentIndex index = 0u;
+		while (index < managerCount && !ShortNameEquals(Components::GetComponentManagerAtIndex(index)->ShortName, nameBegin, it))
+		{
+			++index;
+		}
+		ASSERT_FATAL(index < managerCount);
+		result.set(index);
+	}
+	return result;
+}
+
+// Since 1.1 every component block starts with the index of its manager next to the name hash,
+// which saves the lookup as long as the registry hasn't changed since the data got written
+const Components::ComponentManagerEntry& ReadComponentManager(MemoryInputStream& stream, bool hasIndex)
+{
+	uint64_t componentHash;
+	stream >> componentHash;
+	ComponentIndex componentIndex = InvalidComponentIndex;
+	if (hasIndex)
+	{
+		stream >> componentIndex;
+	}
+	return Components::ResolveComponentManager(componentHash, componentIndex);
+}
+
+bool ReadFormatVersion(MemoryInputStream& stream)
+{
+	tmp::small_string versionString;
+	stream >> versionString;
+	ASSERT_FATAL(versionString == "1.0" || versionString == "1.1");
+	return versionString != "1.0";
+}
+}
 
 World::World()
+	// Whole huge pages as the big component arrays get swept every frame
+	: m_Allocations(HugePageSize - HugePageBlockOverhead, GetHugePageAllocator())
+	, m_EntityManager(&m_Allocations)
+	, m_ComponentManagers(AllocatorRef(&m_Allocations))
+	, m_ClassRegistry(AllocatorRef(&m_Allocations))
+	, m_SimulateJobs(AllocatorRef(&m_Allocations))
+	, m_SimulateStageBegin(AllocatorRef(&m_Allocations))
+	, m_DestroyQueue(AllocatorRef(&m_Allocations))
+	, m_EventChannels(AllocatorRef(&m_Allocations))
+	, m_SpatialSortKeys(AllocatorRef(&m_Allocations))
 {
+	ScopedDefaultAllocator scope(&m_Allocations);
 	using namespace Zmey::Components;
 	ComponentIndex i = 0u;
 	for (const ComponentManagerEntry* entry = GetComponentManagerAtIndex(0); entry; entry = GetComponentManagerAtIndex(++i))
 	{
-		m_ComponentManagers.push_back(entry->Instantiate(*this));
+		m_ComponentManagers.push_back(entry->Instantiate(*this, m_Allocations));
+	}
+	BuildSimulateSchedule();
+}
+
+void World::BuildSimulateSchedule()
+{
+	using namespace Zmey::Components;
+	const ComponentIndex count = ComponentIndex(m_ComponentManagers.size());
+	ASSERT_FATAL(count <= ComponentSet().size());
+	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	tmp::vector<ComponentSet> reads(count);
+	tmp::vector<ComponentSet> writes(count);
+	for (ComponentIndex i = 0u; i < count; ++i)
+	{
+		const ComponentManagerEntry* entry = GetComponentManagerAtIndex(i);
+		reads[i] = ParseComponentList(entry->Reads, count);
+		writes[i] = ParseComponentList(entry->Writes, count);
+		writes[i].set(i);
+	}
+
+	// Each manager goes one stage after the last manager before it that it conflicts with,
+	// which keeps index order between conflicting managers
+	tmp::vector<uint32_t> stages(count, 0u);
+	uint32_t stageCount = 0u;
+	for (ComponentIndex i = 0u; i < count; ++i)
+	{
+		for (ComponentIndex j = 0u; j < i; ++j)
+		{
+			const bool conflict = (writes[i] & (reads[j] | writes[j])).any() || (writes[j] & reads[i]).any();
+			if (conflict)
+			{
+				stages[i] = std::max(stages[i], stages[j] + 1u);
+			}
+		}
+		stageCount = std::max(stageCount, stages[i] + 1u);
+	}
+
+	m_SimulateJobs.clear();
+	m_SimulateStageBegin.clear();
+	for (uint32_t stage = 0u; stage < stageCount; ++stage)
+	{
+		m_SimulateStageBegin.push_back(uint32_t(m_SimulateJobs.size()));
+		for (ComponentIndex i = 0u; i < count; ++i)
+		{
+			if (stages[i] == stage)
+			{
+				m_SimulateJobs.push_back(Job::JobDecl{ &World::SimulateManager, m_ComponentManagers[i] });
+			}
+		}
+	}
+	m_SimulateStageBegin.push_back(uint32_t(m_SimulateJobs.size()));
+}
+
+void World::SimulateManager(void* data)
+{
+	auto manager = reinterpret_cast<Components::ComponentManager*>(data);
+	manager->Simulate(manager->GetWorld().m_SimulateDeltaTime);
+}
+
+World::~World()
+{
+	// Managers may hold resources outside of the arena (physics actors for one) so they still get destructed.
+	// Their memory goes away with the arena.
+	for (auto manager : m_ComponentManagers)
+	{
+		manager->~ComponentManager();
 	}
 }
 
 void World::InitializeFromBuffer(const uint8_t* buffer, size_t size)
 {
 	Zmey::MemoryInputStream stream(buffer, size);
-	tmp::small_string versionString;
-	stream >> versionString;
-	assert(versionString == "1.0");
+	const bool hasComponentIndices = ReadFormatVersion(stream);
 
 	// Read resources
 	uint64_t resourceCount;
@@ -52,8 +206,7 @@ void World::InitializeFromBuffer(const uint8_t* buffer, size_t size)
 	Zmey::Modules.ResourceLoader.WaitForAllResources(dependentResources);
 	for (auto i = 0; i < classNames.size(); ++i)
 	{
-		auto buffer = Zmey::Modules.ResourceLoader.AsBuffer(classPaths[i]);
-		AddClassToRegistry(classNames[i], buffer->data(), buffer-> size());
+		AddClassToRegistry(classNames[i], Zmey::Modules.ResourceLoader.AsBuffer(classPaths[i]));
 	}
 	// Read entities
 	using EntityIndex = Zmey::EntityId::IndexType;
@@ -66,9 +219,7 @@ void World::InitializeFromBuffer(const uint8_t* buffer, size_t size)
 	while (!stream.IsEOF())
 	{
 		// Read the next component
-		uint64_t componentHash;
-		stream >> componentHash;
-		auto managerEntry = Zmey::Components::GetComponentManager(componentHash);
+		auto& managerEntry = ReadComponentManager(stream, hasComponentIndices);
 		// Read the indices of the entities that have this component
 		EntityIndex entitiesWithComponentCount;
 		stream >> entitiesWithComponentCount;
@@ -91,49 +242,151 @@ void World::InitializeFromBuffer(const uint8_t* buffer, size_t size)
 
 void World::Simulate(float deltaTime)
 {
+	m_SimulateDeltaTime = deltaTime;
+	for (size_t stage = 0u; stage + 1u < m_SimulateStageBegin.size(); ++stage)
+	{
+		Job::JobDecl* jobs = &m_SimulateJobs[m_SimulateStageBegin[stage]];
+		const uint32_t jobCount = m_SimulateStageBegin[stage + 1u] - m_SimulateStageBegin[stage];
+		if (jobCount == 1u)
+		{
+			jobs->EntryPoint(jobs->Data);
+			continue;
+		}
+		Job::Counter counter;
+		Modules.JobSystem.RunJobs("World Simulate", jobs, jobCount, &counter);
+		Modules.JobSystem.WaitForCounter(&counter, 0);
+	}
+}
+
+void World::LateSimulate()
+{
+	DestroyQueuedEntities();
+	for (auto channel : m_EventChannels)
+	{
+		channel->Publish();
+	}
 	for (ComponentIndex i = 0u; i < m_ComponentManagers.size(); ++i)
 	{
-		m_ComponentManagers[i]->Simulate(deltaTime);
+		m_ComponentManagers[i]->LateSimulate();
 	}
+	ContinueSpatialSort();
 }
 
+void World::SetSpatialSortInterval(uint32_t frames)
+{
+	m_SpatialSortInterval = frames;
+}
+
+void World::ContinueSpatialSort()
+{
+	if (m_SpatialSortCursor == InvalidComponentIndex)
+	{
+		if (m_SpatialSortInterval == 0u || ++m_FramesSinceSpatialSort < m_SpatialSortInterval)
+		{
+			return;
+		}
+		m_FramesSinceSpatialSort = 0u;
+		m_SpatialSortKeys.BuildFromTransforms(GetManager<Components::TransformManager>());
+		m_SpatialSortCursor = 0u;
+	}
+	// Managers that don't sort don't count towards the one per frame
+	while (m_SpatialSortCursor < m_ComponentManagers.size() && !m_ComponentManagers[m_SpatialSortCursor++]->SortEntities(m_SpatialSortKeys))
+	{
+	}
+	if (m_SpatialSortCursor == m_ComponentManagers.size())
+	{
+		m_SpatialSortCursor = InvalidComponentIndex;
+	}
+}
 
-void World::AddClassToRegistry(Zmey::Name className, const uint8_t* buffer, size_t size)
+
+void World::AddClassToRegistry(Zmey::Name className, const SharedAssetRef& blob)
 {
-	stl::vector<uint8_t> bufferContainer(size);
-	std::memcpy(&bufferContainer[0], buffer, size);
-	m_ClassRegistry[className] = std::move(bufferContainer);
+	// operator[] would create the entry with the default allocator and moving into it would copy
+	m_ClassRegistry.erase(className);
+	m_ClassRegistry.emplace(className, ClassTemplate(blob, AllocatorRef(&m_Allocations)));
 }
 
-EntityId World::SpawnEntity(Zmey::Name actorType)
+void World::DecodeClass(ClassTemplate& classTemplate, EntityId entity)
 {
-	auto it = m_ClassRegistry.find(actorType);
-	ASSERT_FATAL(it != m_ClassRegistry.end());
-	auto entityId = m_EntityManager.SpawnOne();
 	auto tempScope = TempAllocator::GetTlsAllocator().ScopeNow();
-	tmp::vector<EntityId> entityVec = { entityId };
+	tmp::vector<EntityId> entityVec = { entity };
 
-	Zmey::MemoryInputStream stream(it->second.data(), it->second.size());
-	
-	tmp::small_string versionString;
-	stream >> versionString;
-	assert(versionString == "1.0");
+	Zmey::MemoryInputStream stream(classTemplate.Blob.data(), classTemplate.Blob.size());
+	const bool hasComponentIndices = ReadFormatVersion(stream);
 
 	uint64_t classNameHash;
 	stream >> classNameHash;
 
+	classTemplate.Components.clear();
 	while (!stream.IsEOF())
 	{
 		// Read the next component
-		uint64_t componentHash;
-		stream >> componentHash;
-		auto managerEntry = Zmey::Components::GetComponentManager(componentHash);
-		// Tell the component to read its data
+		auto& managerEntry = ReadComponentManager(stream, hasComponentIndices);
+		// Tell the component to read its data and remember where it was
+		const uint64_t dataBegin = stream.GetPosition();
 		m_ComponentManagers[managerEntry.Index]->InitializeFromBlob(entityVec, stream);
+		classTemplate.Components.push_back(ClassTemplate::Component{ managerEntry.Index, uint32_t(dataBegin), uint32_t(stream.GetPosition() - dataBegin) });
 	}
+	classTemplate.IsDecoded = true;
+}
+
+EntityId World::SpawnEntity(Zmey::Name actorType)
+{
+	EntityId entityId;
+	SpawnEntities(actorType, &entityId, 1u);
 	return entityId;
 }
 
+void World::SpawnEntities(Zmey::Name actorType, EntityId* entities, size_t count, const SpawnOverrides& overrides)
+{
+	auto it = m_ClassRegistry.find(actorType);
+	ASSERT_FATAL(it != m_ClassRegistry.end());
+	if (count == 0u)
+	{
+		return;
+	}
+	ClassTemplate& classTemplate = it->second;
+	m_EntityManager.Spawn(entities, EntityId::IndexType(count));
+
+	size_t initialized = 0u;
+	if (!classTemplate.IsDecoded)
+	{
+		DecodeClass(classTemplate, entities[0]);
+		initialized = 1u;
+	}
+	if (initialized < count)
+	{
+		for (const auto& component : classTemplate.Components)
+		{
+			m_ComponentManagers[component.Manager]->InitializeFromTemplate(entities + initialized, count - initialized,
+				classTemplate.Blob.data() + component.Offset, component.Size);
+		}
+	}
+
+	if (overrides.Positions || overrides.Rotations)
+	{
+		auto& transforms = GetManager<Components::TransformManager>();
+		for (size_t i = 0u; i < count; ++i)
+		{
+			auto transform = transforms.Lookup(entities[i]);
+			if (overrides.Positions)
+			{
+				transform.Position() = overrides.Positions[i];
+			}
+			if (overrides.Rotations)
+			{
+				transform.Rotation() = overrides.Rotations[i];
+			}
+		}
+	}
+}
+
+MemoryArena::Stats World::GetMemoryStats() const
+{
+	return m_Allocations.GetStats();
+}
+
 void World::DestroyEntity(EntityId id)
 {
 	m_EntityManager.Destroy(id);
@@ -143,4 +396,62 @@ void World::DestroyEntity(EntityId id)
 	}
 }
 
+void World::QueueDestroyEntity(EntityId id)
+{
+	std::lock_guard<std::mutex> lock(m_DestroyQueueMutex);
+	m_DestroyQueue.push_back(id);
+}
+
+void World::DestroyQueuedEntities()
+{
+	std::lock_guard<std::mutex> lock(m_DestroyQueueMutex);
+	if (m_DestroyQueue.empty())
+	{
+		return;
+	}
+	// Entities may get queued more than once or destroyed directly in the meantime
+	std::sort(m_DestroyQueue.begin(), m_DestroyQueue.end(), EntityIndexLess());
+	m_DestroyQueue.erase(std::unique(m_DestroyQueue.begin(), m_DestroyQueue.end()), m_DestroyQueue.end());
+	m_DestroyQueue.erase(std::remove_if(m_DestroyQueue.begin(), m_DestroyQueue.end(), [this](EntityId id)
+	{
+		return !m_EntityManager.IsAlive(id);
+	}), m_DestroyQueue.end());
+
+	m_EntityManager.Destroy(m_DestroyQueue.data(), m_DestroyQueue.size());
+	for (auto& manager : m_ComponentManagers)
+	{
+		manager->RemoveEntities(m_DestroyQueue.data(), m_DestroyQueue.size());
+	}
+	m_DestroyQueue.clear();
+}
+
+void World::SaveSnapshot(WorldSnapshot& snapshot) const
+{
+	MemoryOutputStream& stream = snapshot.m_Data;
+	stream.Clear();
+	m_EntityManager.SaveSnapshot(stream);
+	for (auto manager : m_ComponentManagers)
+	{
+		manager->SaveSnapshot(stream);
+	}
+}
+
+void World::RestoreSnapshot(const WorldSnapshot& snapshot)
+{
+	MemoryInputStream stream(snapshot.GetData(), snapshot.GetSize());
+	m_EntityManager.RestoreSnapshot(stream);
+	for (auto manager : m_ComponentManagers)
+	{
+		manager->RestoreSnapshot(stream);
+	}
+	ASSERT(stream.IsEOF());
+	for (auto manager : m_ComponentManagers)
+	{
+		manager->FinishRestoringSnapshot();
+	}
+
+	std::lock_guard<std::mutex> lock(m_DestroyQueueMutex);
+	m_DestroyQueue.clear();
+}
+
 }
\ No newline at end of file
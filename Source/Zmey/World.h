@@ -1,18 +1,41 @@
 #pragma once
+#include <mutex>
+
 #include <Zmey/Memory/MemoryManagement.h>
 #include <Zmey/EntityManager.h>
 #include <Zmey/Hash.h>
+#include <Zmey/InputController.h>
 #include <Zmey/Components/ComponentRegistryCommon.h>
 #include <Zmey/Components/ComponentManager.h>
+#include <Zmey/Components/EntitySortKeys.h>
+#include <Zmey/Components/Query.h>
 #include <Zmey/Graphics/GraphicsObjects.h>
+#include <Zmey/Job/JobSystem.h>
+#include <Zmey/Math/Math.h>
+#include <Zmey/ResourceLoader/SharedAssetStore.h>
 
 namespace Zmey
 {
+class EventChannelBase;
+class WorldSnapshot;
+
+// Per entity values that replace the ones from the class in World::SpawnEntities, null arrays keep the class values
+struct SpawnOverrides
+{
+	const Vector3* Positions = nullptr;
+	const Quaternion* Rotations = nullptr;
+};
 
+// Everything a world owns - entity tables, component managers and their data, the class registry -
+// is allocated from its arena, so tearing a world down is a matter of destroying the managers and
+// releasing a handful of chunks.
 class World
 {
 public:
-	World();
+	ZMEY_API World();
+	ZMEY_API ~World();
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
 	EntityManager& GetEntityManager()
 	{
 		return m_EntityManager;
@@ -22,21 +45,101 @@ public:
 	{
 		return *reinterpret_cast<T*>(m_ComponentManagers[T::SZmeyComponentManagerIndex]);
 	}
+	// Entities that have all of the components, e.g. world.Query<TransformManager, MeshComponentManager>()
+	template<typename... Managers>
+	Components::Query<Managers...> Query()
+	{
+		return Components::Query<Managers...>(GetManager<Managers>()...);
+	}
+	// Dispatches actions to the listeners of this world once per simulation step. Input reaches it only through
+	// InputController::SetPlayerState, the engine loop routes the local devices to the world it renders.
+	InputController& GetInput()
+	{
+		return m_Input;
+	}
 	// Get manager by its index. This is meant to be used from scripting only, use the other overload from CPP
 	Components::ComponentManager& GetManager(ComponentIndex index)
 	{
 		return *m_ComponentManagers[index];
 	}
 	void InitializeFromBuffer(const uint8_t* buffer, size_t size);
-	void AddClassToRegistry(Zmey::Name className, const uint8_t* buffer, size_t size);
+	// The class keeps a reference to the blob instead of a copy, worlds that register the same class share it
+	ZMEY_API void AddClassToRegistry(Zmey::Name className, const SharedAssetRef& blob);
 	ZMEY_API EntityId SpawnEntity(Zmey::Name actorClass);
+	// Spawns count entities of the class at once - every manager initializes all of them in a single call
+	ZMEY_API void SpawnEntities(Zmey::Name actorClass, EntityId* entities, size_t count, const SpawnOverrides& overrides = SpawnOverrides());
+	// Can be called only from a Job as managers that don't conflict run as parallel jobs
 	void Simulate(float deltaTime);
+	// Destroys the queued entities and publishes the events sent since the last call (see EventChannel)
+	// before the managers' LateSimulate
+	ZMEY_API void LateSimulate();
+
+	// Every that many calls to LateSimulate, starts putting the packed data of the managers in the order of the
+	// Morton codes of the entities' positions, so that entities close to each other are close in memory as well.
+	// One manager gets sorted per LateSimulate (see ComponentManager::SortEntities). 0, the default, turns it off.
+	ZMEY_API void SetSpatialSortInterval(uint32_t frames);
 
+	// Removes the entity from every manager right away
 	ZMEY_API void DestroyEntity(EntityId id);
+	// Destroys the entity at the next sync point - the start of LateSimulate - along with all others queued
+	// until then, so that managers can remove them in one pass. Can be called from any job.
+	ZMEY_API void QueueDestroyEntity(EntityId id);
+	ZMEY_API void DestroyQueuedEntities();
+
+	// Copies the entity tables and the state of every manager that supports it (see ComponentManager::SaveSnapshot)
+	// to the snapshot. Take it between frames.
+	ZMEY_API void SaveSnapshot(WorldSnapshot& snapshot) const;
+	// Puts the world back in the state it was in when the snapshot got saved, queued destructions are dropped
+	ZMEY_API void RestoreSnapshot(const WorldSnapshot& snapshot);
+
+	// How much memory the world is using and has reserved
+	ZMEY_API MemoryArena::Stats GetMemoryStats() const;
 private:
+	// A class blob split into the data of each of its components, so that spawning doesn't parse it again
+	struct ClassTemplate
+	{
+		struct Component
+		{
+			ComponentIndex Manager;
+			uint32_t Offset;
+			uint32_t Size;
+		};
+		ClassTemplate(const SharedAssetRef& blob, AllocatorRef allocator)
+			: Blob(blob)
+			, Components(allocator)
+		{}
+		SharedAssetRef Blob;
+		// Only the managers know the size of their data, so the split happens when the first entity gets spawned
+		arena::vector<Component> Components;
+		bool IsDecoded = false;
+	};
+	void DecodeClass(ClassTemplate& classTemplate, EntityId entity);
+
+	// Groups the managers in stages so that no two managers in a stage touch the same components
+	void BuildSimulateSchedule();
+	static void SimulateManager(void* manager);
+	void ContinueSpatialSort();
+
+	// Memory that lives as long as the world
+	MemoryArena m_Allocations;
 	EntityManager m_EntityManager;
-	stl::vector<Components::ComponentManager*> m_ComponentManagers;
-	stl::unordered_map<Zmey::Name, stl::vector<uint8_t>> m_ClassRegistry;
+	InputController m_Input;
+	arena::vector<Components::ComponentManager*> m_ComponentManagers;
+	arena::unordered_map<Zmey::Name, ClassTemplate> m_ClassRegistry;
+	// A Simulate job per manager, stage s takes [m_SimulateStageBegin[s], m_SimulateStageBegin[s + 1])
+	arena::vector<Job::JobDecl> m_SimulateJobs;
+	arena::vector<uint32_t> m_SimulateStageBegin;
+	float m_SimulateDeltaTime = 0.f;
+	arena::vector<EntityId> m_DestroyQueue;
+	std::mutex m_DestroyQueueMutex;
+	arena::vector<EventChannelBase*> m_EventChannels;
+	// The keys are computed at the start of each round of sorting and used by all managers in it
+	Components::EntitySortKeys m_SpatialSortKeys;
+	uint32_t m_SpatialSortInterval = 0u;
+	uint32_t m_FramesSinceSpatialSort = 0u;
+	// The next manager to sort in the current round, if there is one
+	ComponentIndex m_SpatialSortCursor = InvalidComponentIndex;
+	friend class EventChannelBase;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include <Zmey/WorldScheduler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <Zmey/Game.h>
+#include <Zmey/Logging.h>
+#include <Zmey/Modules.h>
+#include <Zmey/World.h>
+#include <Zmey/Physics/PhysicsComponentManager.h>
+
+namespace Zmey
+{
+namespace
+{
+void StepWorld(World& world, Game* game, float timeStep)
+{
+	auto stepScope = TempAllocator::GetTlsAllocator().ScopeNow();
+	world.GetInput().DispatchActionEventsForFrame(timeStep);
+
+	// The scene appears with the first physics actor, which may get spawned during the step
+	Physics::PhysicsScene* physicsScene = world.GetManager<Physics::PhysicsComponentManager>().GetScene();
+	if (physicsScene)
+	{
+		physicsScene->Simulate(timeStep);
+	}
+	if (game)
+	{
+		game->Simulate(timeStep);
+	}
+	world.Simulate(timeStep);
+	if (physicsScene)
+	{
+		physicsScene->FetchResults();
+	}
+	world.LateSimulate();
+}
+}
+
+WorldScheduler::WorldScheduler(float timeStep, uint32_t maxStepsPerTick)
+	: m_TimeStep(timeStep)
+	, m_MaxStepsPerTick(std::max(maxStepsPerTick, 1u))
+	, m_TickDeltaTime(0.f)
+{
+	ASSERT_FATAL(timeStep > 0.f);
+}
+
+void WorldScheduler::AddWorld(World& world, Game* game, float budgetSeconds)
+{
+	ASSERT_FATAL(std::none_of(m_Worlds.begin(), m_Worlds.end(), [&world](const ScheduledWorld& scheduled)
+	{
+		return scheduled.WorldInstance == &world;
+	}));
+	if (game)
+	{
+		game->SetWorld(&world);
+	}
+	m_Worlds.push_back(ScheduledWorld{ this, &world, game, budgetSeconds, 0.f, WorldStats() });
+}
+
+void WorldScheduler::RemoveWorld(World& world)
+{
+	auto it = std::find_if(m_Worlds.begin(), m_Worlds.end(), [&world](const ScheduledWorld& scheduled)
+	{
+		return scheduled.WorldInstance == &world;
+	});
+	ASSERT_RETURN(it != m_Worlds.end());
+	m_Worlds.erase(it);
+}
+
+void WorldScheduler::Tick(float deltaTime)
+{
+	if (m_Worlds.empty())
+	{
+		return;
+	}
+	m_TickDeltaTime = deltaTime;
+	m_Jobs.clear();
+	for (auto& scheduled : m_Worlds)
+	{
+		m_Jobs.push_back(Job::JobDecl{ &WorldScheduler::TickWorld, &scheduled });
+	}
+	Job::Counter counter;
+	Modules.JobSystem.RunJobs("Tick World", m_Jobs.data(), uint32_t(m_Jobs.size()), &counter);
+	Modules.JobSystem.WaitForCounter(&counter, 0);
+}
+
+void WorldScheduler::TickWorld(void* data)
+{
+	auto scheduled = reinterpret_cast<ScheduledWorld*>(data);
+	scheduled->Scheduler->Advance(*scheduled);
+}
+
+void WorldScheduler::Advance(ScheduledWorld& scheduled)
+{
+	using clock = std::chrono::high_resolution_clock;
+	const clock::time_point tickStart = clock::now();
+
+	scheduled.UnsimulatedTime += m_TickDeltaTime;
+	const uint32_t dueSteps = uint32_t(std::min(std::floor(scheduled.UnsimulatedTime / m_TimeStep), float(m_MaxStepsPerTick)));
+	uint32_t step = 0u;
+	for (; step < dueSteps; ++step)
+	{
+		if (step > 0u && scheduled.Budget > 0.f && std::chrono::duration<float>(clock::now() - tickStart).count() >= scheduled.Budget)
+		{
+			break;
+		}
+		StepWorld(*scheduled.WorldInstance, scheduled.GameInstance, m_TimeStep);
+		scheduled.UnsimulatedTime -= m_TimeStep;
+	}
+	// A world that took all the steps it may still drops the time beyond the next step. One that ran out of budget
+	// keeps up to a tick's worth of steps to catch up on.
+	const uint32_t keptSteps = step == m_MaxStepsPerTick ? 1u : m_MaxStepsPerTick;
+	scheduled.UnsimulatedTime = std::min(scheduled.UnsimulatedTime, keptSteps * m_TimeStep);
+
+	scheduled.Stats.Steps = step;
+	scheduled.Stats.DeferredSteps = dueSteps - step;
+	scheduled.Stats.Milliseconds = std::chrono::duration<float, std::milli>(clock::now() - tickStart).count();
+	if (step < dueSteps)
+	{
+		++scheduled.Stats.OverBudgetTicks;
+	}
+}
+
+const WorldScheduler::ScheduledWorld& WorldScheduler::Find(const World& world) const
+{
+	auto it = std::find_if(m_Worlds.begin(), m_Worlds.end(), [&world](const ScheduledWorld& scheduled)
+	{
+		return scheduled.WorldInstance == &world;
+	});
+	ASSERT_FATAL(it != m_Worlds.end());
+	return *it;
+}
+
+float WorldScheduler::GetInterpolationAlpha(const World& world) const
+{
+	return std::min(Find(world).UnsimulatedTime / m_TimeStep, 1.f);
+}
+
+const WorldScheduler::WorldStats& WorldScheduler::GetStats(const World& world) const
+{
+	return Find(world).Stats;
+}
+
+}
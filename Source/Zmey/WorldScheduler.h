@@ -0,0 +1,69 @@
+#pragma once
+#include <Zmey/Config.h>
+#include <Zmey/Job/JobSystem.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+namespace Zmey
+{
+class Game;
+class World;
+
+// Advances any number of independent worlds - the matches a server hosts, for one - in fixed time steps.
+// Worlds keep their physics scene and input to themselves, so each one gets ticked in a job of its own and all of
+// them run in parallel on the shared job system.
+// A world with a time budget stops taking steps once its tick has run longer than that and catches up on the
+// following ticks instead. It always takes at least one step so that it can't stall.
+class WorldScheduler
+{
+public:
+	struct WorldStats
+	{
+		// Steps taken in the last tick
+		uint32_t Steps = 0u;
+		// Steps due in the last tick that got left for the next ones because of the budget
+		uint32_t DeferredSteps = 0u;
+		float Milliseconds = 0.f;
+		// Ticks that ran out of budget since the world got added
+		uint32_t OverBudgetTicks = 0u;
+	};
+
+	// Beyond maxStepsPerTick a world gives up on catching up and runs slower instead
+	ZMEY_API WorldScheduler(float timeStep, uint32_t maxStepsPerTick);
+	// The scheduler owns neither the world nor the game. The game, if there is one, gets attached to the world -
+	// so add the world before initializing the game - and simulated along with it.
+	// A budget of 0 lets the world take as long as it needs.
+	ZMEY_API void AddWorld(World& world, Game* game, float budgetSeconds = 0.f);
+	ZMEY_API void RemoveWorld(World& world);
+	// Advances every world by deltaTime and returns once all of them are done. Can be called only from a Job.
+	ZMEY_API void Tick(float deltaTime);
+
+	// How far the time of the world is between its last two steps, for rendering
+	ZMEY_API float GetInterpolationAlpha(const World& world) const;
+	ZMEY_API const WorldStats& GetStats(const World& world) const;
+	inline float GetTimeStep() const
+	{
+		return m_TimeStep;
+	}
+private:
+	struct ScheduledWorld
+	{
+		WorldScheduler* Scheduler;
+		World* WorldInstance;
+		Game* GameInstance;
+		float Budget;
+		float UnsimulatedTime;
+		WorldStats Stats;
+	};
+	static void TickWorld(void* data);
+	void Advance(ScheduledWorld& scheduled);
+	const ScheduledWorld& Find(const World& world) const;
+
+	// Don't move during a tick as the jobs point to them
+	stl::vector<ScheduledWorld> m_Worlds;
+	stl::vector<Job::JobDecl> m_Jobs;
+	float m_TimeStep;
+	uint32_t m_MaxStepsPerTick;
+	float m_TickDeltaTime;
+};
+
+}
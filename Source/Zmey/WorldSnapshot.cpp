@@ -0,0 +1,61 @@
+#include <Zmey/WorldSnapshot.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace Zmey
+{
+
+void WorldSnapshotDelta::Build(const WorldSnapshot& base, const WorldSnapshot& target)
+{
+	m_Data.Clear();
+	const uint64_t targetSize = target.GetSize();
+	const uint64_t commonSize = std::min(base.GetSize(), targetSize);
+	m_Data << targetSize;
+
+	// Blocks that reach past the end of base always differ
+	auto blockDiffers = [&](uint64_t offset)
+	{
+		const uint64_t end = std::min(offset + BlockSize, targetSize);
+		return end > commonSize || std::memcmp(base.GetData() + offset, target.GetData() + offset, end - offset) != 0;
+	};
+	for (uint64_t offset = 0u; offset < targetSize;)
+	{
+		if (!blockDiffers(offset))
+		{
+			offset += BlockSize;
+			continue;
+		}
+		uint64_t runEnd = offset + BlockSize;
+		while (runEnd < targetSize && blockDiffers(runEnd))
+		{
+			runEnd += BlockSize;
+		}
+		runEnd = std::min(runEnd, targetSize);
+		m_Data << offset << uint64_t(runEnd - offset);
+		m_Data.Write(target.GetData() + offset, runEnd - offset);
+		offset = runEnd;
+	}
+}
+
+void WorldSnapshotDelta::Apply(const WorldSnapshot& base, WorldSnapshot& result) const
+{
+	ASSERT_FATAL(&base != &result);
+	MemoryInputStream stream(m_Data.GetData(), m_Data.GetDataSize());
+	uint64_t targetSize;
+	stream >> targetSize;
+
+	// Whatever is past the end of base is covered by the runs
+	result.m_Data.Resize(targetSize);
+	uint8_t* data = result.m_Data.GetData();
+	std::memcpy(data, base.GetData(), std::min(base.GetSize(), targetSize));
+	while (!stream.IsEOF())
+	{
+		uint64_t offset;
+		uint64_t size;
+		stream >> offset >> size;
+		stream.Read(data + offset, size);
+	}
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <Zmey/Config.h>
+#include <Zmey/MemoryStream.h>
+
+namespace Zmey
+{
+
+// The state of a world as saved by World::SaveSnapshot - the entity tables and the data of every
+// manager that supports snapshots, one after the other, mostly as whole arrays.
+// Keep snapshots around and save into them again, their buffers get reused.
+// Only meaningful to the process that saved it, it's not a file format.
+class WorldSnapshot
+{
+public:
+	inline const uint8_t* GetData() const
+	{
+		return m_Data.GetData();
+	}
+	inline uint64_t GetSize() const
+	{
+		return m_Data.GetDataSize();
+	}
+private:
+	MemoryOutputStream m_Data;
+	friend class World;
+	friend class WorldSnapshotDelta;
+};
+
+// The parts of a snapshot that differ from an older one, for rollback history and sending over the network.
+// Compares the snapshots in blocks of BlockSize bytes and keeps the runs of blocks that changed.
+class WorldSnapshotDelta
+{
+public:
+	static constexpr uint64_t BlockSize = 64u;
+
+	// Rebuilds the delta so that applying it to base gives target
+	ZMEY_API void Build(const WorldSnapshot& base, const WorldSnapshot& target);
+	// Writes base with the delta applied to result, which can't be base itself
+	ZMEY_API void Apply(const WorldSnapshot& base, WorldSnapshot& result) const;
+
+	inline uint64_t GetSize() const
+	{
+		return m_Data.GetDataSize();
+	}
+private:
+	// Size of the target and then runs of (offset, size, bytes)
+	MemoryOutputStream m_Data;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "Benchmark.h"
+
+#include <cmath>
+#include <limits>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <Zmey/Math/BatchMath.h>
+
+// Compares every instruction set BatchMath supports on this CPU against plain glm and times them.
+// The sizes around the SIMD widths make sure the scalar tails get checked as well.
+namespace
+{
+using namespace Zmey;
+using namespace Zmey::BatchMath;
+
+const char* const InstructionSetNames[] = { "Scalar", "SSE2", "AVX2", "AVX512" };
+const size_t TestSizes[] = { 0u, 1u, 3u, 7u, 15u, 16u, 17u, 33u, 100u };
+const size_t BenchmarkSize = 10000u;
+const uint32_t BenchmarkRepetitions = 200u;
+
+class Inputs
+{
+public:
+	explicit Inputs(size_t count)
+		: Positions(count)
+		, Scales(count)
+		, Rotations(count)
+		, OtherRotations(count)
+		, Boxes(count)
+	{
+		for (size_t i = 0u; i < count; ++i)
+		{
+			Positions[i] = RandomVector(-10.f, 10.f);
+			Scales[i] = RandomVector(0.1f, 3.f);
+			Rotations[i] = RandomRotation();
+			OtherRotations[i] = RandomRotation();
+			const Vector3 a = RandomVector(-10.f, 10.f);
+			const Vector3 b = RandomVector(-10.f, 10.f);
+			Boxes[i] = AABB{ glm::min(a, b), glm::max(a, b) };
+		}
+	}
+
+	float Random(float min, float max)
+	{
+		return std::uniform_real_distribution<float>(min, max)(m_Random);
+	}
+	Vector3 RandomVector(float min, float max)
+	{
+		return Vector3(Random(min, max), Random(min, max), Random(min, max));
+	}
+	Quaternion RandomRotation()
+	{
+		return glm::normalize(Quaternion(Random(-1.f, 1.f), Random(-1.f, 1.f), Random(-1.f, 1.f), Random(-1.f, 1.f)));
+	}
+
+	std::vector<Vector3> Positions;
+	std::vector<Vector3> Scales;
+	std::vector<Quaternion> Rotations;
+	std::vector<Quaternion> OtherRotations;
+	std::vector<AABB> Boxes;
+private:
+	std::mt19937 m_Random{ 1u };
+};
+
+bool IsClose(float expected, float actual)
+{
+	return std::fabs(expected - actual) <= 1e-3f * (1.f + std::fabs(expected) + std::fabs(actual));
+}
+
+template<typename T>
+bool AreClose(const T& expected, const T& actual, int components)
+{
+	for (int i = 0; i < components; ++i)
+	{
+		if (!IsClose(expected[i], actual[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AreClose(const Matrix4x4& expected, const Matrix4x4& actual)
+{
+	for (int column = 0; column < 4; ++column)
+	{
+		if (!AreClose(expected[column], actual[column], 4))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+Matrix4x4 ComposeReference(const Vector3& position, const Quaternion& rotation, const Vector3& scale)
+{
+	return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scale);
+}
+
+AABB TransformAABBReference(const Matrix4x4& matrix, const AABB& box)
+{
+	AABB result{ Vector3(std::numeric_limits<float>::max()), Vector3(std::numeric_limits<float>::lowest()) };
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const Vector3 point((corner & 1) ? box.Max.x : box.Min.x, (corner & 2) ? box.Max.y : box.Min.y, (corner & 4) ? box.Max.z : box.Min.z);
+		const Vector3 transformed(matrix * Vector4(point, 1.f));
+		result.Min = glm::min(result.Min, transformed);
+		result.Max = glm::max(result.Max, transformed);
+	}
+	return result;
+}
+
+// The [-5, 5] cube, which the reference test below can check exactly
+Frustum MakeCubeFrustum()
+{
+	Frustum frustum;
+	frustum.Planes[0] = Vector4(1.f, 0.f, 0.f, 5.f);
+	frustum.Planes[1] = Vector4(-1.f, 0.f, 0.f, 5.f);
+	frustum.Planes[2] = Vector4(0.f, 1.f, 0.f, 5.f);
+	frustum.Planes[3] = Vector4(0.f, -1.f, 0.f, 5.f);
+	frustum.Planes[4] = Vector4(0.f, 0.f, 1.f, 5.f);
+	frustum.Planes[5] = Vector4(0.f, 0.f, -1.f, 5.f);
+	return frustum;
+}
+
+void Validate(Benchmarks::Context& context, const char* setName, size_t count)
+{
+	char what[128];
+	auto describe = [&](const char* function)
+	{
+		snprintf(what, sizeof(what), "%s %s with %zu elements", setName, function, count);
+		return what;
+	};
+
+	Inputs inputs(count);
+	std::vector<Matrix4x4> matrices(count);
+	std::vector<Matrix4x4> otherMatrices(count);
+	std::vector<Matrix4x4> products(count);
+
+	ComposeTransforms(inputs.Positions.data(), inputs.Rotations.data(), inputs.Scales.data(), matrices.data(), count);
+	bool matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		matches &= AreClose(ComposeReference(inputs.Positions[i], inputs.Rotations[i], inputs.Scales[i]), matrices[i]);
+	}
+	context.Check(matches, describe("ComposeTransforms"));
+
+	ComposeTransforms(inputs.Positions.data(), inputs.OtherRotations.data(), inputs.Scales.data(), otherMatrices.data(), count);
+	MultiplyMatrices(matrices.data(), otherMatrices.data(), products.data(), count);
+	matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		matches &= AreClose(matrices[i] * otherMatrices[i], products[i]);
+	}
+	context.Check(matches, describe("MultiplyMatrices"));
+
+	products = otherMatrices;
+	MultiplyMatrices(matrices.data(), products.data(), products.data(), count);
+	matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		matches &= AreClose(matrices[i] * otherMatrices[i], products[i]);
+	}
+	context.Check(matches, describe("MultiplyMatrices in place"));
+
+	std::vector<Quaternion> rotations(count);
+	MultiplyQuaternions(inputs.Rotations.data(), inputs.OtherRotations.data(), rotations.data(), count);
+	matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		matches &= AreClose(inputs.Rotations[i] * inputs.OtherRotations[i], rotations[i], 4);
+	}
+	context.Check(matches, describe("MultiplyQuaternions"));
+
+	// Every fifth quaternion has zero length to check it becomes the identity like in glm
+	std::vector<Quaternion> unnormalized(count);
+	for (size_t i = 0u; i < count; ++i)
+	{
+		unnormalized[i] = i % 5u == 0u ? Quaternion(0.f, 0.f, 0.f, 0.f) : Quaternion(inputs.Random(-10.f, 10.f), inputs.Random(-10.f, 10.f), inputs.Random(-10.f, 10.f), inputs.Random(-10.f, 10.f));
+	}
+	rotations = unnormalized;
+	NormalizeQuaternions(rotations.data(), rotations.data(), count);
+	matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		matches &= AreClose(glm::normalize(unnormalized[i]), rotations[i], 4);
+	}
+	context.Check(matches, describe("NormalizeQuaternions in place"));
+
+	if (count > 0u)
+	{
+		std::vector<Vector3> points(count);
+		TransformPoints(matrices[0], inputs.Positions.data(), points.data(), count);
+		matches = true;
+		for (size_t i = 0u; i < count; ++i)
+		{
+			matches &= AreClose(Vector3(matrices[0] * Vector4(inputs.Positions[i], 1.f)), points[i], 3);
+		}
+		context.Check(matches, describe("TransformPoints"));
+	}
+
+	std::vector<AABB> boxes(count);
+	TransformAABBs(matrices.data(), inputs.Boxes.data(), boxes.data(), count);
+	matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		const AABB expected = TransformAABBReference(matrices[i], inputs.Boxes[i]);
+		matches &= AreClose(expected.Min, boxes[i].Min, 3) && AreClose(expected.Max, boxes[i].Max, 3);
+	}
+	context.Check(matches, describe("TransformAABBs"));
+
+	std::vector<uint8_t> visible(count);
+	FrustumTestAABBs(MakeCubeFrustum(), inputs.Boxes.data(), visible.data(), count);
+	matches = true;
+	for (size_t i = 0u; i < count; ++i)
+	{
+		bool expected = true;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			expected &= inputs.Boxes[i].Max[axis] >= -5.f && inputs.Boxes[i].Min[axis] <= 5.f;
+		}
+		matches &= visible[i] == (expected ? 1u : 0u);
+	}
+	context.Check(matches, describe("FrustumTestAABBs"));
+}
+
+void ReportNanosecondsPerElement(Benchmarks::Context& context, const char* setName, const char* function, double milliseconds)
+{
+	char what[64];
+	snprintf(what, sizeof(what), "%s %s", setName, function);
+	context.Report(what, milliseconds * 1e6 / BenchmarkSize, "ns/element");
+}
+
+void Measure(Benchmarks::Context& context, const char* setName)
+{
+	Inputs inputs(BenchmarkSize);
+	std::vector<Matrix4x4> matrices(BenchmarkSize);
+	std::vector<Matrix4x4> products(BenchmarkSize);
+	std::vector<AABB> boxes(BenchmarkSize);
+	std::vector<uint8_t> visible(BenchmarkSize);
+	const Frustum frustum = MakeCubeFrustum();
+
+	ReportNanosecondsPerElement(context, setName, "ComposeTransforms", Benchmarks::MeasureMilliseconds(BenchmarkRepetitions, [&]
+	{
+		ComposeTransforms(inputs.Positions.data(), inputs.Rotations.data(), inputs.Scales.data(), matrices.data(), BenchmarkSize);
+	}));
+	ReportNanosecondsPerElement(context, setName, "MultiplyMatrices", Benchmarks::MeasureMilliseconds(BenchmarkRepetitions, [&]
+	{
+		MultiplyMatrices(matrices.data(), matrices.data(), products.data(), BenchmarkSize);
+	}));
+	ReportNanosecondsPerElement(context, setName, "TransformAABBs", Benchmarks::MeasureMilliseconds(BenchmarkRepetitions, [&]
+	{
+		TransformAABBs(matrices.data(), inputs.Boxes.data(), boxes.data(), BenchmarkSize);
+	}));
+	ReportNanosecondsPerElement(context, setName, "FrustumTestAABBs", Benchmarks::MeasureMilliseconds(BenchmarkRepetitions, [&]
+	{
+		FrustumTestAABBs(frustum, inputs.Boxes.data(), visible.data(), BenchmarkSize);
+	}));
+}
+
+// What the transform manager did per element before it used BatchMath
+void MeasureGlm(Benchmarks::Context& context)
+{
+	Inputs inputs(BenchmarkSize);
+	std::vector<Matrix4x4> matrices(BenchmarkSize);
+	std::vector<Matrix4x4> products(BenchmarkSize);
+
+	ReportNanosecondsPerElement(context, "glm", "ComposeTransforms", Benchmarks::MeasureMilliseconds(BenchmarkRepetitions, [&]
+	{
+		for (size_t i = 0u; i < BenchmarkSize; ++i)
+		{
+			matrices[i] = ComposeReference(inputs.Positions[i], inputs.Rotations[i], inputs.Scales[i]);
+		}
+	}));
+	ReportNanosecondsPerElement(context, "glm", "MultiplyMatrices", Benchmarks::MeasureMilliseconds(BenchmarkRepetitions, [&]
+	{
+		for (size_t i = 0u; i < BenchmarkSize; ++i)
+		{
+			products[i] = matrices[i] * matrices[i];
+		}
+	}));
+}
+}
+
+BENCHMARK(BatchMath)
+{
+	const InstructionSet detected = GetInstructionSet();
+	for (uint8_t set = 0u; set < 4u; ++set)
+	{
+		const char* setName = InstructionSetNames[set];
+		if (!SetInstructionSet(InstructionSet(set)))
+		{
+			printf("BatchMath: %s is not supported by this CPU, skipping it\n", setName);
+			continue;
+		}
+		for (size_t count : TestSizes)
+		{
+			Validate(context, setName, count);
+		}
+		Measure(context, setName);
+	}
+	SetInstructionSet(detected);
+	MeasureGlm(context);
+}
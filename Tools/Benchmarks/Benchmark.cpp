@@ -0,0 +1,45 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+
+#include "BenchmarkRegistry.h"
+
+namespace Benchmarks
+{
+namespace
+{
+// Only the first few failures of a benchmark get printed, the rest are just counted
+const uint32_t MaxPrintedFailures = 10u;
+}
+
+Registration::Registration(const char* name, BenchmarkFunction function)
+{
+	GetRegisteredBenchmarks().push_back(RegisteredBenchmark{ name, function });
+}
+
+std::vector<RegisteredBenchmark>& GetRegisteredBenchmarks()
+{
+	// Function local so it's constructed before the registrations in other files use it
+	static std::vector<RegisteredBenchmark> benchmarks;
+	return benchmarks;
+}
+
+void Context::Report(const char* what, double value, const char* unit)
+{
+	printf("%s: %s %.3f %s\n", m_BenchmarkName, what, value, unit);
+}
+
+void Context::Check(bool condition, const char* what)
+{
+	if (condition)
+	{
+		return;
+	}
+	if (m_Failures < MaxPrintedFailures)
+	{
+		printf("%s: FAILED %s\n", m_BenchmarkName, what);
+	}
+	++m_Failures;
+}
+
+}
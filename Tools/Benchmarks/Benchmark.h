@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+namespace Benchmarks
+{
+class Context;
+using BenchmarkFunction = void(*)(Context&);
+
+// Makes a benchmark known to main, see BENCHMARK
+struct Registration
+{
+	Registration(const char* name, BenchmarkFunction function);
+};
+
+// Passed to every benchmark to report what it measured and whether its results match the reference implementation.
+// Benchmarks run on a job, one after the other, so they may use the job system but have the machine to themselves.
+class Context
+{
+public:
+	explicit Context(const char* benchmarkName)
+		: m_BenchmarkName(benchmarkName)
+	{}
+	// Prints a line of the form "Benchmark: what value unit"
+	void Report(const char* what, double value, const char* unit);
+	// Counts a failure and prints what failed unless too many did already
+	void Check(bool condition, const char* what);
+	inline uint32_t GetFailures() const
+	{
+		return m_Failures;
+	}
+private:
+	const char* m_BenchmarkName;
+	uint32_t m_Failures = 0u;
+};
+
+class Stopwatch
+{
+public:
+	Stopwatch()
+		: m_Start(std::chrono::high_resolution_clock::now())
+	{}
+	inline double Milliseconds() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_Start).count();
+	}
+private:
+	std::chrono::high_resolution_clock::time_point m_Start;
+};
+
+// Runs func the given number of times and returns the average time of a run in milliseconds
+template<typename Func>
+double MeasureMilliseconds(uint32_t repetitions, const Func& func)
+{
+	Stopwatch stopwatch;
+	for (uint32_t i = 0u; i < repetitions; ++i)
+	{
+		func();
+	}
+	return stopwatch.Milliseconds() / repetitions;
+}
+
+}
+
+// Defines and registers a benchmark, its name is what selects it on the command line:
+//	BENCHMARK(Query)
+//	{
+//		context.Report("Iteration", MeasureMilliseconds(10, [&] { ... }), "ms");
+//	}
+#define BENCHMARK(Name) \
+	static void Name##Benchmark(Benchmarks::Context& context); \
+	static Benchmarks::Registration Name##Registration(#Name, Name##Benchmark); \
+	static void Name##Benchmark(Benchmarks::Context& context)
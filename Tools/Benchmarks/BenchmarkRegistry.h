@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+
+#include "Benchmark.h"
+
+namespace Benchmarks
+{
+struct RegisteredBenchmark
+{
+	const char* Name;
+	BenchmarkFunction Function;
+};
+// In the order the files got initialized, main sorts them by name
+std::vector<RegisteredBenchmark>& GetRegisteredBenchmarks();
+}
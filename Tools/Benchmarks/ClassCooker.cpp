@@ -0,0 +1,117 @@
+#include "ClassCooker.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include <Zmey/Modules.h>
+#include <Zmey/MemoryStream.h>
+#include <Zmey/World.h>
+#include <Zmey/Components/ComponentRegistry.h>
+
+namespace Benchmarks
+{
+namespace
+{
+// The properties of a component in the order they were first written, later writes replace the defaults
+class ComponentData : public Zmey::Components::IDataBlob
+{
+public:
+	virtual void WriteData(Zmey::Hash dataName, const uint8_t* data, uint16_t dataSize) override
+	{
+		Find(dataName).assign(data, data + dataSize);
+	}
+	virtual void WriteData(Zmey::Hash dataName, const char* text, uint16_t textSize) override
+	{
+		auto& value = Find(dataName);
+		value.assign(text, text + textSize);
+		value.push_back(0); // terminating zero
+	}
+	virtual void RequestResource(const char*, uint16_t) override
+	{}
+	void WriteTo(Zmey::MemoryOutputStream& stream) const
+	{
+		for (const auto& property : m_Properties)
+		{
+			stream.Write(property.second.data(), property.second.size());
+		}
+	}
+private:
+	std::vector<uint8_t>& Find(Zmey::Hash dataName)
+	{
+		for (auto& property : m_Properties)
+		{
+			if (property.first == dataName)
+			{
+				return property.second;
+			}
+		}
+		m_Properties.emplace_back(dataName, std::vector<uint8_t>());
+		return m_Properties.back().second;
+	}
+
+	std::vector<std::pair<Zmey::Hash, std::vector<uint8_t>>> m_Properties;
+};
+
+const Zmey::Components::ComponentManagerEntry& FindManager(const std::string& componentName)
+{
+	return Zmey::Components::GetComponentManager(Zmey::Hash(Zmey::HashHelpers::CaseInsensitiveStringWrapper(componentName.c_str())));
+}
+}
+
+Zmey::Name AddClass(Zmey::World& world, const char* typeJson)
+{
+	const nlohmann::json type = nlohmann::json::parse(typeJson);
+	const std::string className = type["name"];
+	const std::string path = className + ".typebin";
+	auto& resourceLoader = Zmey::Modules.ResourceLoader;
+	const Zmey::Name name(className.c_str());
+	// The file can't be rewritten while it's mapped, the worlds that follow reuse the loaded blob
+	if (resourceLoader.IsResourceReady(Zmey::Name(path.c_str())))
+	{
+		world.AddClassToRegistry(name, resourceLoader.AsBuffer(Zmey::Name(path.c_str())));
+		return name;
+	}
+
+	std::vector<nlohmann::json> components = type["components"];
+	// Same order as Incinerator - by priority and then by name
+	std::stable_sort(components.begin(), components.end(), [](const nlohmann::json& lhs, const nlohmann::json& rhs)
+	{
+		const auto& lhsManager = FindManager(lhs["name"]);
+		const auto& rhsManager = FindManager(rhs["name"]);
+		if (lhsManager.Priority != rhsManager.Priority)
+		{
+			return rhsManager.Priority < lhsManager.Priority;
+		}
+		return lhsManager.ShortNameHash < rhsManager.ShortNameHash;
+	});
+
+	Zmey::MemoryOutputStream stream;
+	stream << "1.1"; // Version
+	stream << static_cast<uint64_t>(Zmey::Hash(Zmey::HashHelpers::CaseInsensitiveStringWrapper(className.c_str())));
+	for (const auto& component : components)
+	{
+		const auto& manager = FindManager(component["name"]);
+		stream << static_cast<uint64_t>(manager.ShortNameHash);
+		stream << manager.Index;
+		ComponentData data;
+		manager.DefaultsToBlob(data);
+		manager.ToBlob(component, data);
+		data.WriteTo(stream);
+	}
+
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::out | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(stream.GetData()), stream.GetDataSize());
+	}
+	const Zmey::Name resource = resourceLoader.LoadResource(path.c_str());
+	resourceLoader.WaitForResource(resource);
+	world.AddClassToRegistry(name, resourceLoader.AsBuffer(resource));
+	return name;
+}
+
+}
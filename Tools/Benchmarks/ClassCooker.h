@@ -0,0 +1,15 @@
+#pragma once
+#include <Zmey/Hash.h>
+
+namespace Zmey
+{
+class World;
+}
+
+namespace Benchmarks
+{
+// Cooks a class from the contents of a .type file the way Incinerator does and registers it with the world.
+// The cooked blob goes to <class name>.typebin in the working directory and gets loaded through the
+// ResourceLoader, so all worlds that register the class share it as they would in the game.
+Zmey::Name AddClass(Zmey::World& world, const char* typeJson);
+}
@@ -0,0 +1,114 @@
+#include "Benchmark.h"
+
+#include <vector>
+
+#include <Zmey/World.h>
+#include <Zmey/Components/SpellComponentManager.h>
+#include <Zmey/Components/TagManager.h>
+#include <Zmey/Components/TransformManager.h>
+#include <Zmey/Physics/PhysicsComponentManager.h>
+#include "ClassCooker.h"
+
+// Spawns 10k spells a frame, one SpawnEntity at a time in one world and with a single SpawnEntities in another,
+// and destroys them at the end of the frame. Both worlds have to end up with the same entities and components.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t SpawnsPerFrame = 10000u;
+const uint32_t FrameCount = 10u;
+
+// The game's Spell without the mesh, which needs the level's glTF
+const char* const SpellType = R"({
+	"name" : "Spell",
+	"components" : [
+		{ "name" : "physics", "dynamic" : true },
+		{ "name" : "projectilespell", "initial_speed" : 100.0, "impact_damage" : 1.0, "life_time" : 5.0, "cooldown_time" : 1.0, "initial_mass" : 1.0 },
+		{ "name" : "tag", "tags" : ["spell"] },
+		{ "name" : "transform" }
+	]
+})";
+
+bool HasSpellComponents(World& world, const std::vector<EntityId>& entities, const std::vector<Vector3>& positions)
+{
+	auto& transforms = world.GetManager<Components::TransformManager>();
+	auto& spells = world.GetManager<Components::SpellComponent>();
+	auto& tags = world.GetManager<Components::TagManager>();
+	auto& physics = world.GetManager<Physics::PhysicsComponentManager>();
+	if (tags.CountByTag(Name("spell")) != entities.size() || spells.GetEntitySet().size() != entities.size())
+	{
+		return false;
+	}
+	for (size_t i = 0u; i < entities.size(); ++i)
+	{
+		if (transforms.Lookup(entities[i]).GetPosition() != positions[i] || spells.GetInitialSpeed(entities[i]) != 100.f
+			|| spells.GetLifeTime(entities[i]) != 5.f || !physics.Lookup(entities[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void DestroyAll(World& world, const std::vector<EntityId>& entities)
+{
+	for (EntityId entity : entities)
+	{
+		world.QueueDestroyEntity(entity);
+	}
+	world.DestroyQueuedEntities();
+}
+}
+
+BENCHMARK(ClassSpawn)
+{
+	World oneByOne;
+	World batched;
+	const Name spell = Benchmarks::AddClass(oneByOne, SpellType);
+	Benchmarks::AddClass(batched, SpellType);
+
+	std::vector<Vector3> positions(SpawnsPerFrame);
+	for (uint32_t i = 0u; i < SpawnsPerFrame; ++i)
+	{
+		positions[i] = Vector3(float(i % 100u), 1.f, float(i / 100u));
+	}
+	SpawnOverrides overrides;
+	overrides.Positions = positions.data();
+
+	std::vector<EntityId> spawnedOneByOne(SpawnsPerFrame);
+	std::vector<EntityId> spawnedBatched(SpawnsPerFrame);
+	double oneByOneMilliseconds = 0.;
+	double batchedMilliseconds = 0.;
+	double destroyMilliseconds = 0.;
+	for (uint32_t frame = 0u; frame < FrameCount; ++frame)
+	{
+		{
+			Benchmarks::Stopwatch stopwatch;
+			auto& transforms = oneByOne.GetManager<Components::TransformManager>();
+			for (uint32_t i = 0u; i < SpawnsPerFrame; ++i)
+			{
+				spawnedOneByOne[i] = oneByOne.SpawnEntity(spell);
+				transforms.Lookup(spawnedOneByOne[i]).Position() = positions[i];
+			}
+			oneByOneMilliseconds += stopwatch.Milliseconds();
+		}
+		{
+			Benchmarks::Stopwatch stopwatch;
+			batched.SpawnEntities(spell, spawnedBatched.data(), SpawnsPerFrame, overrides);
+			batchedMilliseconds += stopwatch.Milliseconds();
+		}
+		if (frame == 0u)
+		{
+			context.Check(spawnedOneByOne == spawnedBatched, "SpawnEntities hands out the same entities as SpawnEntity");
+			context.Check(HasSpellComponents(oneByOne, spawnedOneByOne, positions), "SpawnEntity initializes every component of the class");
+			context.Check(HasSpellComponents(batched, spawnedBatched, positions), "SpawnEntities initializes every component of the class");
+		}
+		DestroyAll(oneByOne, spawnedOneByOne);
+		Benchmarks::Stopwatch stopwatch;
+		DestroyAll(batched, spawnedBatched);
+		destroyMilliseconds += stopwatch.Milliseconds();
+	}
+	context.Report("SpawnEntity 10k times a frame", oneByOneMilliseconds / FrameCount, "ms");
+	context.Report("SpawnEntities 10k a frame", batchedMilliseconds / FrameCount, "ms");
+	context.Report("Destroying 10k queued entities a frame", destroyMilliseconds / FrameCount, "ms");
+}
@@ -0,0 +1,89 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <Zmey/EntityManager.h>
+#include <Zmey/Modules.h>
+#include <Zmey/Job/ParallelFor.h>
+#include <Zmey/Memory/MemoryArena.h>
+
+// Spawns a million entities one at a time, in a single batch, from recycled indices and from many jobs at once.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t EntityCount = 1000000u;
+// How many entities each job spawns at a time in the concurrent case, e.g. one spawn request of a system
+const uint32_t ConcurrentBatchSize = 64u;
+
+bool AreAllAlive(const EntityManager& entityManager, const std::vector<EntityId>& entities)
+{
+	return std::all_of(entities.begin(), entities.end(), [&entityManager](EntityId entity)
+	{
+		return entityManager.IsAlive(entity);
+	});
+}
+
+bool AreIndicesUnique(std::vector<EntityId> entities)
+{
+	std::sort(entities.begin(), entities.end(), EntityIndexLess());
+	return std::adjacent_find(entities.begin(), entities.end(), [](EntityId lhs, EntityId rhs)
+	{
+		return lhs.GetIndex() == rhs.GetIndex();
+	}) == entities.end();
+}
+}
+
+BENCHMARK(EntitySpawn)
+{
+	std::vector<EntityId> entities(EntityCount);
+	{
+		MemoryArena arena;
+		EntityManager entityManager(&arena);
+		Benchmarks::Stopwatch stopwatch;
+		for (uint32_t i = 0u; i < EntityCount; ++i)
+		{
+			entities[i] = entityManager.SpawnOne();
+		}
+		context.Report("SpawnOne 1M times", stopwatch.Milliseconds(), "ms");
+		context.Check(AreAllAlive(entityManager, entities) && AreIndicesUnique(entities), "SpawnOne hands out unique live entities");
+	}
+	{
+		MemoryArena arena;
+		EntityManager entityManager(&arena);
+		Benchmarks::Stopwatch stopwatch;
+		entityManager.Spawn(entities.data(), EntityCount);
+		context.Report("Spawn 1M at once", stopwatch.Milliseconds(), "ms");
+		context.Check(AreAllAlive(entityManager, entities) && AreIndicesUnique(entities), "Spawn hands out unique live entities");
+
+		// Half of the new entities reuse the destroyed indices
+		entityManager.Destroy(entities.data(), EntityCount / 2u);
+		std::vector<EntityId> reused(EntityCount);
+		stopwatch = Benchmarks::Stopwatch();
+		entityManager.Spawn(reused.data(), EntityCount);
+		context.Report("Spawn 1M at once with 500k destroyed", stopwatch.Milliseconds(), "ms");
+		context.Check(AreAllAlive(entityManager, reused) && AreIndicesUnique(reused), "Spawn reuses destroyed indices without duplicates");
+		context.Check(std::none_of(entities.begin(), entities.begin() + EntityCount / 2u, [&entityManager](EntityId entity)
+		{
+			return entityManager.IsAlive(entity);
+		}), "Destroyed entities stay dead after their indices get reused");
+	}
+	{
+		MemoryArena arena;
+		EntityManager entityManager(&arena);
+		// A quarter of the indices come from the free list to have both paths race
+		entityManager.Spawn(entities.data(), EntityCount / 4u);
+		entityManager.Destroy(entities.data(), EntityCount / 4u);
+		Benchmarks::Stopwatch stopwatch;
+		Job::ParallelFor(Modules.JobSystem, "Spawn benchmark", 0u, EntityCount / ConcurrentBatchSize, 1u, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t batch = begin; batch < end; ++batch)
+			{
+				entityManager.Spawn(&entities[batch * ConcurrentBatchSize], ConcurrentBatchSize);
+			}
+		});
+		context.Report("Spawn 1M from jobs, 64 at a time", stopwatch.Milliseconds(), "ms");
+		context.Check(AreAllAlive(entityManager, entities) && AreIndicesUnique(entities), "Concurrent spawns hand out unique live entities");
+	}
+}
@@ -0,0 +1,152 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <Zmey/EntityManager.h>
+#include <Zmey/Hash.h>
+#include <Zmey/Containers/FlatHashMap.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+// Compares stl::flat_hash_map with the stl::unordered_map it replaced on the engine's two kinds of keys -
+// entities, as in the component managers, and name hashes, as in the resource and class registries.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t KeyCount = 100000u;
+const uint32_t Repetitions = 10u;
+const uint32_t ChurnCount = 1000000u;
+
+std::vector<EntityId> MakeEntities(EntityManager& entityManager, uint32_t count)
+{
+	std::vector<EntityId> entities(count);
+	entityManager.Spawn(entities.data(), count);
+	return entities;
+}
+
+std::vector<Hash> MakeNameHashes(const char* prefix, uint32_t count)
+{
+	std::vector<Hash> hashes;
+	hashes.reserve(count);
+	char name[64];
+	for (uint32_t i = 0u; i < count; ++i)
+	{
+		snprintf(name, sizeof(name), "%s/asset_%u.typebin", prefix, i);
+		hashes.push_back(Hash(static_cast<const char*>(name)));
+	}
+	return hashes;
+}
+
+double NanosecondsPerOperation(double milliseconds, uint32_t operations)
+{
+	return milliseconds * 1e6 / operations;
+}
+
+template<typename Map, typename Key>
+void Fill(Map& map, const std::vector<Key>& keys)
+{
+	for (uint32_t i = 0u; i < keys.size(); ++i)
+	{
+		map[keys[i]] = i;
+	}
+}
+
+template<typename Map, typename Key>
+uint32_t CountFound(const Map& map, const std::vector<Key>& keys)
+{
+	uint32_t found = 0u;
+	for (const Key& key : keys)
+	{
+		found += map.find(key) != map.end() ? 1u : 0u;
+	}
+	return found;
+}
+
+// Erases a random key and puts it back with a new value, the way entities come and go
+template<typename Map, typename Key>
+void Churn(Map& map, const std::vector<Key>& keys, uint32_t seed)
+{
+	std::mt19937 random(seed);
+	for (uint32_t i = 0u; i < ChurnCount; ++i)
+	{
+		const Key& key = keys[random() % keys.size()];
+		map.erase(key);
+		map[key] = i;
+	}
+}
+
+template<typename Flat, typename Unordered>
+bool HaveSameContents(const Flat& flat, const Unordered& unordered)
+{
+	if (flat.size() != unordered.size())
+	{
+		return false;
+	}
+	for (const auto& entry : unordered)
+	{
+		auto found = flat.find(entry.first);
+		if (found == flat.end() || found->second != entry.second)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename Key>
+void Compare(Benchmarks::Context& context, const char* keyName, const std::vector<Key>& keys, const std::vector<Key>& missingKeys)
+{
+	char what[128];
+	auto report = [&](const char* operation, const char* map, double milliseconds, uint32_t operations)
+	{
+		snprintf(what, sizeof(what), "%s %s, %s", keyName, operation, map);
+		context.Report(what, NanosecondsPerOperation(milliseconds, operations), "ns/op");
+	};
+
+	report("insert", "flat_hash_map", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		stl::flat_hash_map<Key, uint32_t> map;
+		Fill(map, keys);
+	}), KeyCount);
+	report("insert", "unordered_map", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		stl::unordered_map<Key, uint32_t> map;
+		Fill(map, keys);
+	}), KeyCount);
+
+	stl::flat_hash_map<Key, uint32_t> flat;
+	stl::unordered_map<Key, uint32_t> unordered;
+	Fill(flat, keys);
+	Fill(unordered, keys);
+	context.Check(HaveSameContents(flat, unordered), "Both maps hold the same entries after inserting");
+
+	// Lookups in a different order than the inserts
+	std::vector<Key> shuffled = keys;
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1u));
+	uint32_t flatFound = 0u;
+	uint32_t unorderedFound = 0u;
+	report("lookup hit", "flat_hash_map", Benchmarks::MeasureMilliseconds(Repetitions, [&] { flatFound = CountFound(flat, shuffled); }), KeyCount);
+	report("lookup hit", "unordered_map", Benchmarks::MeasureMilliseconds(Repetitions, [&] { unorderedFound = CountFound(unordered, shuffled); }), KeyCount);
+	context.Check(flatFound == KeyCount && unorderedFound == KeyCount, "Both maps find every key");
+	report("lookup miss", "flat_hash_map", Benchmarks::MeasureMilliseconds(Repetitions, [&] { flatFound = CountFound(flat, missingKeys); }), KeyCount);
+	report("lookup miss", "unordered_map", Benchmarks::MeasureMilliseconds(Repetitions, [&] { unorderedFound = CountFound(unordered, missingKeys); }), KeyCount);
+	context.Check(flatFound == 0u && unorderedFound == 0u, "Neither map finds a missing key");
+
+	report("erase and reinsert", "flat_hash_map", Benchmarks::MeasureMilliseconds(1u, [&] { Churn(flat, keys, 2u); }), ChurnCount);
+	report("erase and reinsert", "unordered_map", Benchmarks::MeasureMilliseconds(1u, [&] { Churn(unordered, keys, 2u); }), ChurnCount);
+	context.Check(HaveSameContents(flat, unordered), "Both maps hold the same entries after erasing and reinserting");
+}
+}
+
+BENCHMARK(FlatHashMap)
+{
+	EntityManager entityManager(GAllocator);
+	const std::vector<EntityId> entities = MakeEntities(entityManager, KeyCount);
+	const std::vector<EntityId> missingEntities = MakeEntities(entityManager, KeyCount);
+	Compare(context, "EntityId", entities, missingEntities);
+
+	Compare(context, "Hash", MakeNameHashes("Content/Present", KeyCount), MakeNameHashes("Content/Missing", KeyCount));
+}
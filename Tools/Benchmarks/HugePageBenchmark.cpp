@@ -0,0 +1,120 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <Zmey/Math/BatchMath.h>
+#include <Zmey/Math/Math.h>
+#include <Zmey/Memory/HugePageAllocator.h>
+#include <Zmey/Memory/MemoryManagement.h>
+
+// Runs the transform gather over TransformManager's arrays for a million entities, once in huge::vector
+// and once in stl::vector, to show what huge page backing buys. World arenas draw their chunks from the
+// same huge page allocator, so the huge::vector numbers are what the world's TransformManager gets.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t EntityCount = 1000000u;
+const uint32_t Repetitions = 10u;
+
+template<template<typename> class Vector>
+struct TransformArrays
+{
+	TransformArrays()
+		: Positions(EntityCount)
+		, Rotations(EntityCount)
+		, Scales(EntityCount, Vector3(1.f))
+		, WorldMatrices(EntityCount)
+	{
+		for (uint32_t i = 0u; i < EntityCount; ++i)
+		{
+			Positions[i] = Vector3(float(i % 1000u), 0.f, float(i / 1000u));
+		}
+	}
+	Vector<Vector3> Positions;
+	Vector<Quaternion> Rotations;
+	Vector<Vector3> Scales;
+	Vector<Matrix4x4> WorldMatrices;
+};
+
+template<typename T>
+using StlVector = stl::vector<T>;
+template<typename T>
+using HugeVector = huge::vector<T>;
+
+struct Timings
+{
+	double Compose;
+	double Gather;
+	float Sum;
+};
+
+// Composes the world matrices in order, as TransformManager::Simulate does, and then reads them
+// in the order another manager would look its entities up
+template<template<typename> class Vector>
+Timings Measure(TransformArrays<Vector>& transforms, const std::vector<uint32_t>& lookupOrder)
+{
+	Timings timings;
+	timings.Compose = Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		BatchMath::ComposeTransforms(transforms.Positions.data(), transforms.Rotations.data(), transforms.Scales.data(), transforms.WorldMatrices.data(), EntityCount);
+	});
+	float sum = 0.f;
+	timings.Gather = Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		sum = 0.f;
+		for (uint32_t index : lookupOrder)
+		{
+			sum += transforms.WorldMatrices[index][3].x + transforms.Positions[index].z;
+		}
+	});
+	timings.Sum = sum;
+	return timings;
+}
+
+double ToMegabytes(size_t bytes)
+{
+	return double(bytes) / (1024. * 1024.);
+}
+}
+
+BENCHMARK(HugePage)
+{
+	std::vector<uint32_t> lookupOrder(EntityCount);
+	for (uint32_t i = 0u; i < EntityCount; ++i)
+	{
+		lookupOrder[i] = i;
+	}
+	std::shuffle(lookupOrder.begin(), lookupOrder.end(), std::mt19937(1u));
+
+	const HugePageStats before = GetHugePageStats();
+	Timings huge;
+	Timings regular;
+	{
+		TransformArrays<HugeVector> hugeTransforms;
+		const HugePageStats allocated = GetHugePageStats();
+		const size_t mappedBytes = (allocated.ExplicitHugePageBytes - before.ExplicitHugePageBytes)
+			+ (allocated.TransparentHugePageBytes - before.TransparentHugePageBytes)
+			+ (allocated.RegularPageBytes - before.RegularPageBytes);
+		context.Check(mappedBytes >= EntityCount * (2u * sizeof(Vector3) + sizeof(Quaternion) + sizeof(Matrix4x4)), "The transform arrays are mapped by the huge page allocator");
+		context.Report("Explicit huge page backing", ToMegabytes(allocated.ExplicitHugePageBytes - before.ExplicitHugePageBytes), "MB");
+		context.Report("Transparent huge page backing", ToMegabytes(allocated.TransparentHugePageBytes - before.TransparentHugePageBytes), "MB");
+		context.Report("Regular page backing", ToMegabytes(allocated.RegularPageBytes - before.RegularPageBytes), "MB");
+		huge = Measure(hugeTransforms, lookupOrder);
+	}
+	{
+		TransformArrays<StlVector> stlTransforms;
+		regular = Measure(stlTransforms, lookupOrder);
+	}
+	context.Check(huge.Sum == regular.Sum, "Both backings gather the same transforms");
+	const HugePageStats after = GetHugePageStats();
+	context.Check(after.ExplicitHugePageBytes == before.ExplicitHugePageBytes && after.TransparentHugePageBytes == before.TransparentHugePageBytes
+		&& after.RegularPageBytes == before.RegularPageBytes, "The transform arrays are unmapped once freed");
+
+	context.Report("Compose 1M world matrices, huge::vector", huge.Compose, "ms");
+	context.Report("Compose 1M world matrices, stl::vector", regular.Compose, "ms");
+	context.Report("Gather 1M transforms in lookup order, huge::vector", huge.Gather, "ms");
+	context.Report("Gather 1M transforms in lookup order, stl::vector", regular.Gather, "ms");
+}
@@ -0,0 +1,81 @@
+#include "Benchmark.h"
+
+#include <vector>
+
+#include <Zmey/Modules.h>
+#include <Zmey/World.h>
+#include <Zmey/Components/Query.h>
+#include <Zmey/Components/TransformManager.h>
+#include <Zmey/Containers/SparseSet.h>
+
+// Moves a million transforms by their velocity through a query and through a Lookup per entity,
+// the way systems joined two managers before queries existed.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t EntityCount = 1000000u;
+const uint32_t Repetitions = 10u;
+const float TimeStep = 1.f / 60.f;
+
+// Stands in for a gameplay manager - three out of four entities have a velocity
+struct VelocityManager
+{
+	const arena::sparse_set& GetEntitySet() const
+	{
+		return Entities;
+	}
+	arena::sparse_set Entities;
+	std::vector<Vector3> Velocities;
+};
+}
+
+BENCHMARK(Query)
+{
+	World world;
+	auto& transforms = world.GetManager<Components::TransformManager>();
+	VelocityManager velocities;
+	for (uint32_t i = 0u; i < EntityCount; ++i)
+	{
+		const EntityId entity = world.GetEntityManager().SpawnOne();
+		transforms.AddNewEntity(entity, Vector3(float(i), 0.f, 0.f), Vector3(1.f), Quaternion());
+		if (i % 4u != 0u)
+		{
+			velocities.Entities.Insert(entity);
+			velocities.Velocities.push_back(Vector3(1.f, 0.f, 0.f));
+		}
+	}
+
+	Components::Query<Components::TransformManager, VelocityManager> query(transforms, velocities);
+	uint32_t visited = 0u;
+	bool matches = true;
+	query.ForEach([&](EntityId entity, EntityId::IndexType transformIndex, EntityId::IndexType velocityIndex)
+	{
+		++visited;
+		matches &= transforms.GetEntitySet().EntityAt(transformIndex) == entity && velocities.Entities.EntityAt(velocityIndex) == entity;
+	});
+	context.Check(visited == velocities.Entities.size(), "ForEach visits every entity with a velocity");
+	context.Check(matches, "ForEach passes the indices of the entity in each manager");
+
+	context.Report("ForEach", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		query.ForEach([&](EntityId, EntityId::IndexType transformIndex, EntityId::IndexType velocityIndex)
+		{
+			transforms.InstanceAt(transformIndex).Position() += velocities.Velocities[velocityIndex] * TimeStep;
+		});
+	}), "ms");
+	context.Report("ParallelForEach", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		query.ParallelForEach(Modules.JobSystem, "Query benchmark", [&](EntityId, EntityId::IndexType transformIndex, EntityId::IndexType velocityIndex)
+		{
+			transforms.InstanceAt(transformIndex).Position() += velocities.Velocities[velocityIndex] * TimeStep;
+		});
+	}), "ms");
+	context.Report("Lookup per entity", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		for (EntityId::IndexType i = 0u; i < velocities.Entities.size(); ++i)
+		{
+			transforms.Lookup(velocities.Entities.EntityAt(i)).Position() += velocities.Velocities[i] * TimeStep;
+		}
+	}), "ms");
+}
@@ -0,0 +1,181 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <Zmey/Config.h>
+#include <Zmey/Modules.h>
+#include <Zmey/World.h>
+#include <Zmey/Components/SpellComponentManager.h>
+#include <Zmey/Components/TagManager.h>
+#include <Zmey/ResourceLoader/ResourceLoader.h>
+#include <Zmey/ResourceLoader/SharedAssetStore.h>
+#include "ClassCooker.h"
+
+#if defined(ZMEY_PLATFORM_WIN)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <Windows.h>
+	#include <Psapi.h>
+#else
+	#include <unistd.h>
+#endif
+
+// Hosts 16 matches in one process. Every match registers the same cooked class and spawns from it,
+// then a file the size of a level's meshes gets mapped once for all matches and read into a copy per match.
+// Reports the shared store's stats and how much resident memory each way takes.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t MatchCount = 16u;
+const uint32_t SpawnsPerMatch = 1000u;
+const size_t LevelAssetBytes = 16u * 1024u * 1024u;
+const size_t PageBytes = 4096u;
+
+const char* const MatchSpellType = R"({
+	"name" : "MatchSpell",
+	"components" : [
+		{ "name" : "projectilespell", "initial_speed" : 100.0, "impact_damage" : 1.0, "life_time" : 5.0, "cooldown_time" : 1.0, "initial_mass" : 1.0 },
+		{ "name" : "tag", "tags" : ["spell"] },
+		{ "name" : "transform" }
+	]
+})";
+
+// The process' resident set - the working set on Windows
+size_t GetResidentBytes()
+{
+#if defined(ZMEY_PLATFORM_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return 0u;
+	}
+	return counters.WorkingSetSize;
+#else
+	size_t totalPages = 0u;
+	size_t residentPages = 0u;
+	std::ifstream statm("/proc/self/statm");
+	statm >> totalPages >> residentPages;
+	return residentPages * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+double ToMegabytes(size_t bytes)
+{
+	return double(bytes) / (1024. * 1024.);
+}
+
+// Reads a byte from every page so they all become resident
+uint64_t TouchPages(const uint8_t* data, size_t size)
+{
+	uint64_t sum = 0u;
+	for (size_t offset = 0u; offset < size; offset += PageBytes)
+	{
+		sum += data[offset];
+	}
+	return sum;
+}
+
+bool SpawnsFromClass(World& world, Name type)
+{
+	std::vector<EntityId> entities(SpawnsPerMatch);
+	world.SpawnEntities(type, entities.data(), SpawnsPerMatch);
+	auto& spells = world.GetManager<Components::SpellComponent>();
+	if (world.GetManager<Components::TagManager>().CountByTag(Name("spell")) != SpawnsPerMatch)
+	{
+		return false;
+	}
+	for (EntityId entity : entities)
+	{
+		if (spells.GetInitialSpeed(entity) != 100.f || spells.GetLifeTime(entity) != 5.f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+}
+
+BENCHMARK(SharedAsset)
+{
+	const SharedAssetStore& loaderAssets = Modules.ResourceLoader.GetSharedAssets();
+
+	// Class blobs, shared between the matches' worlds
+	{
+		const SharedAssetStats before = loaderAssets.GetStats();
+		std::vector<std::unique_ptr<World>> matches;
+		Name type;
+		for (uint32_t i = 0u; i < MatchCount; ++i)
+		{
+			matches.emplace_back(new World);
+			type = Benchmarks::AddClass(*matches.back(), MatchSpellType);
+		}
+		const SharedAssetStats registered = loaderAssets.GetStats();
+		const size_t classBytes = registered.MappedBytes - before.MappedBytes;
+		context.Check(registered.FileCount == before.FileCount + 1u, "The class is mapped once for all matches");
+		context.Check(registered.ReferencedBytes - before.ReferencedBytes >= MatchCount * classBytes, "Every match references the mapped class");
+
+		bool allSpawned = true;
+		for (auto& match : matches)
+		{
+			allSpawned &= SpawnsFromClass(*match, type);
+		}
+		context.Check(allSpawned, "Every match spawns from the shared class");
+
+		context.Report("Class blob mapped", double(classBytes), "bytes");
+		context.Report("Class blob a copy per match would take", double(MatchCount * classBytes), "bytes");
+		matches.clear();
+		context.Check(loaderAssets.GetStats().ReferencedBytes == before.ReferencedBytes + classBytes, "Only the loader references the class once the matches are gone");
+	}
+
+	// A level's worth of meshes, mapped once versus read into a copy per match
+	const char* const levelAssetPath = "SharedAssetLevel.bin";
+	{
+		std::vector<uint8_t> contents(LevelAssetBytes);
+		for (size_t i = 0u; i < contents.size(); ++i)
+		{
+			contents[i] = uint8_t(i * 31u);
+		}
+		std::ofstream file(levelAssetPath, std::ios::binary | std::ios::out | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+	}
+	uint64_t mappedSum = 0u;
+	size_t mappedResident = 0u;
+	{
+		SharedAssetStore store;
+		const size_t residentBefore = GetResidentBytes();
+		std::vector<SharedAssetRef> matchAssets;
+		for (uint32_t i = 0u; i < MatchCount; ++i)
+		{
+			matchAssets.push_back(store.Map(levelAssetPath));
+			mappedSum += TouchPages(matchAssets.back().data(), matchAssets.back().size());
+		}
+		mappedResident = GetResidentBytes() - residentBefore;
+		const SharedAssetStats stats = store.GetStats();
+		context.Check(matchAssets.back().size() == LevelAssetBytes, "The level asset gets mapped");
+		context.Check(stats.FileCount == 1u && stats.MappedBytes == LevelAssetBytes && stats.ReferencedBytes == MatchCount * LevelAssetBytes,
+			"The store counts one file referenced by every match");
+	}
+	uint64_t copiedSum = 0u;
+	size_t copiedResident = 0u;
+	{
+		const size_t residentBefore = GetResidentBytes();
+		std::vector<std::vector<uint8_t>> matchAssets(MatchCount);
+		for (auto& contents : matchAssets)
+		{
+			std::ifstream file(levelAssetPath, std::ios::binary | std::ios::in);
+			contents.resize(LevelAssetBytes);
+			file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+			copiedSum += TouchPages(contents.data(), contents.size());
+		}
+		copiedResident = GetResidentBytes() - residentBefore;
+	}
+	std::remove(levelAssetPath);
+	context.Check(mappedSum == copiedSum, "Mapped and copied contents match");
+
+	context.Report("Level asset resident with 16 matches, mapped", ToMegabytes(mappedResident), "MB");
+	context.Report("Level asset resident with 16 matches, a copy each", ToMegabytes(copiedResident), "MB");
+}
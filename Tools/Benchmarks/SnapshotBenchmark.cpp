@@ -0,0 +1,253 @@
+#include "Benchmark.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <Zmey/World.h>
+#include <Zmey/WorldSnapshot.h>
+#include <Zmey/Components/TagManager.h>
+#include <Zmey/Components/TransformManager.h>
+#include <Zmey/Physics/PhysicsActor.h>
+#include <Zmey/Physics/PhysicsComponentManager.h>
+#include "ClassCooker.h"
+
+// Saves a world, changes it, restores it and checks that every entity, transform, tag and physics actor
+// is back as it was, then times saving, restoring and building and applying deltas between snapshots.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t EntityCount = 10000u;
+// Entities destroyed, spawned and moved between the two snapshots
+const uint32_t ChangeCount = 1000u;
+const uint32_t Repetitions = 20u;
+
+const char* const BallType = R"({
+	"name" : "SnapshotBall",
+	"components" : [
+		{ "name" : "physics", "dynamic" : true },
+		{ "name" : "tag", "tags" : ["ball"] },
+		{ "name" : "projectilespell", "life_time" : 100.0 },
+		{ "name" : "transform" }
+	]
+})";
+const char* const WallType = R"({
+	"name" : "SnapshotWall",
+	"components" : [
+		{ "name" : "physics", "dynamic" : false },
+		{ "name" : "tag", "tags" : ["wall"] },
+		{ "name" : "transform" }
+	]
+})";
+
+// Everything about an entity a restore has to bring back
+struct EntityState
+{
+	bool IsAlive;
+	Vector3 Position;
+	Quaternion Rotation;
+	bool HasActor;
+	bool IsStatic;
+	Vector3 LinearVelocity;
+	Vector3 AngularVelocity;
+	bool IsBall;
+
+	bool operator==(const EntityState& other) const
+	{
+		if (IsAlive != other.IsAlive)
+		{
+			return false;
+		}
+		return !IsAlive || (Position == other.Position && Rotation == other.Rotation && HasActor == other.HasActor && IsStatic == other.IsStatic
+			&& LinearVelocity == other.LinearVelocity && AngularVelocity == other.AngularVelocity && IsBall == other.IsBall);
+	}
+};
+
+class SnapshotWorld
+{
+public:
+	SnapshotWorld()
+		: m_Transforms(m_World.GetManager<Components::TransformManager>())
+		, m_Physics(m_World.GetManager<Physics::PhysicsComponentManager>())
+		, m_Tags(m_World.GetManager<Components::TagManager>())
+		, m_Ball(Benchmarks::AddClass(m_World, BallType))
+		, m_Wall(Benchmarks::AddClass(m_World, WallType))
+	{}
+
+	World& Get()
+	{
+		return m_World;
+	}
+	// Every fourth entity is a wall, balls get moving
+	void Spawn(uint32_t count)
+	{
+		std::vector<Vector3> positions(count);
+		for (auto& position : positions)
+		{
+			position = Vector3(Random(), Random(), Random());
+		}
+		std::vector<EntityId> spawned(count);
+		SpawnOverrides overrides;
+		overrides.Positions = positions.data();
+		const uint32_t wallCount = count / 4u;
+		m_World.SpawnEntities(m_Wall, spawned.data(), wallCount, overrides);
+		overrides.Positions += wallCount;
+		m_World.SpawnEntities(m_Ball, spawned.data() + wallCount, count - wallCount, overrides);
+		for (uint32_t i = wallCount; i < count; ++i)
+		{
+			m_Physics.Lookup(spawned[i])->SetVelocity(Vector3(Random(), Random(), Random()), Vector3(Random(), 0.f, 0.f));
+		}
+		m_Alive.insert(m_Alive.end(), spawned.begin(), spawned.end());
+		m_Everyone.insert(m_Everyone.end(), spawned.begin(), spawned.end());
+	}
+	void Change(uint32_t count)
+	{
+		for (uint32_t i = 0u; i < count; ++i)
+		{
+			const size_t destroyed = m_Random() % m_Alive.size();
+			m_World.DestroyEntity(m_Alive[destroyed]);
+			m_Alive[destroyed] = m_Alive.back();
+			m_Alive.pop_back();
+		}
+		Spawn(count);
+		for (uint32_t i = 0u; i < count; ++i)
+		{
+			const EntityId moved = m_Alive[m_Random() % m_Alive.size()];
+			m_Transforms.Lookup(moved).Position() += Vector3(1.f, 0.f, 0.f);
+			auto actor = m_Physics.Lookup(moved);
+			if (!actor->IsStatic())
+			{
+				actor->SetVelocity(Vector3(Random(), 0.f, 0.f), Vector3(0.f));
+			}
+		}
+	}
+	// The state of every entity spawned so far, dead ones included
+	std::vector<EntityState> Capture()
+	{
+		std::vector<EntityState> states(m_Everyone.size());
+		for (size_t i = 0u; i < m_Everyone.size(); ++i)
+		{
+			const EntityId entity = m_Everyone[i];
+			EntityState& state = states[i];
+			state.IsAlive = m_World.GetEntityManager().IsAlive(entity);
+			if (!state.IsAlive)
+			{
+				continue;
+			}
+			const auto transform = m_Transforms.Lookup(entity);
+			state.Position = transform.GetPosition();
+			state.Rotation = transform.GetRotation();
+			const auto actor = m_Physics.Lookup(entity);
+			state.HasActor = actor != nullptr;
+			state.IsStatic = actor && actor->IsStatic();
+			state.LinearVelocity = actor ? actor->GetLinearVelocity() : Vector3(0.f);
+			state.AngularVelocity = actor ? actor->GetAngularVelocity() : Vector3(0.f);
+			state.IsBall = m_Tags.HasTag(entity, Name("ball"));
+		}
+		return states;
+	}
+	// Only the ones spawned until the snapshot got saved, restoring it forgets the rest
+	std::vector<EntityState> Capture(size_t entityCount)
+	{
+		std::vector<EntityState> states = Capture();
+		states.resize(entityCount);
+		return states;
+	}
+	size_t GetSpawnedCount() const
+	{
+		return m_Everyone.size();
+	}
+	void ResetAlive(const std::vector<EntityId>& alive)
+	{
+		m_Alive = alive;
+	}
+	const std::vector<EntityId>& GetAlive() const
+	{
+		return m_Alive;
+	}
+private:
+	float Random()
+	{
+		return std::uniform_real_distribution<float>(-100.f, 100.f)(m_Random);
+	}
+
+	World m_World;
+	Components::TransformManager& m_Transforms;
+	Physics::PhysicsComponentManager& m_Physics;
+	Components::TagManager& m_Tags;
+	Name m_Ball;
+	Name m_Wall;
+	std::mt19937 m_Random{ 1u };
+	std::vector<EntityId> m_Alive;
+	std::vector<EntityId> m_Everyone;
+};
+
+bool AreSame(const WorldSnapshot& lhs, const WorldSnapshot& rhs)
+{
+	return lhs.GetSize() == rhs.GetSize() && std::memcmp(lhs.GetData(), rhs.GetData(), size_t(lhs.GetSize())) == 0;
+}
+}
+
+BENCHMARK(Snapshot)
+{
+	SnapshotWorld world;
+	world.Spawn(EntityCount);
+	auto& tags = world.Get().GetManager<Components::TagManager>();
+
+	WorldSnapshot before;
+	world.Get().SaveSnapshot(before);
+	const size_t spawnedBefore = world.GetSpawnedCount();
+	const std::vector<EntityId> aliveBefore = world.GetAlive();
+	const std::vector<EntityState> statesBefore = world.Capture();
+	const size_t ballsBefore = tags.CountByTag(Name("ball"));
+
+	world.Change(ChangeCount);
+	WorldSnapshot after;
+	world.Get().SaveSnapshot(after);
+	const std::vector<EntityState> statesAfter = world.Capture();
+
+	WorldSnapshotDelta delta;
+	delta.Build(before, after);
+	WorldSnapshot rebuilt;
+	delta.Apply(before, rebuilt);
+	context.Check(AreSame(rebuilt, after), "Applying a delta gives the snapshot it was built for");
+
+	world.Get().RestoreSnapshot(before);
+	context.Check(world.Capture(spawnedBefore) == statesBefore, "Restoring brings back every entity, transform, tag and physics actor");
+	context.Check(tags.CountByTag(Name("ball")) == ballsBefore, "Restoring brings back the tag lists");
+	WorldSnapshot again;
+	world.Get().SaveSnapshot(again);
+	context.Check(AreSame(again, before), "Saving right after a restore gives the same snapshot");
+
+	// The restored world keeps going like the original did
+	world.ResetAlive(aliveBefore);
+	world.Change(ChangeCount);
+	world.Get().RestoreSnapshot(rebuilt);
+	const std::vector<EntityState> statesRebuilt = world.Capture(statesAfter.size());
+	context.Check(statesRebuilt == statesAfter, "Restoring a snapshot rebuilt from a delta brings back the later state");
+
+	context.Report("Snapshot size", double(before.GetSize()) / 1024., "KB");
+	context.Report("Delta size", double(delta.GetSize()) / 1024., "KB");
+	context.Report("SaveSnapshot", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		world.Get().SaveSnapshot(after);
+	}), "ms");
+	context.Report("RestoreSnapshot", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		world.Get().RestoreSnapshot(before);
+	}), "ms");
+	context.Report("RestoreSnapshot after 1000 changes", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		world.Get().RestoreSnapshot(rebuilt);
+		world.Get().RestoreSnapshot(before);
+	}) / 2., "ms");
+	context.Report("WorldSnapshotDelta::Build", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		delta.Build(before, rebuilt);
+	}), "ms");
+	context.Report("WorldSnapshotDelta::Apply", Benchmarks::MeasureMilliseconds(Repetitions, [&]
+	{
+		delta.Apply(before, again);
+	}), "ms");
+}
@@ -0,0 +1,341 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <Zmey/Modules.h>
+#include <Zmey/World.h>
+#include <Zmey/Components/SpatialIndexManager.h>
+#include <Zmey/Components/TransformManager.h>
+#include <Zmey/Job/ParallelFor.h>
+#include "ClassCooker.h"
+
+// Checks the spatial index queries against going through every entity while entities move and get destroyed,
+// then times keeping the index of 100k moving entities up to date and querying it.
+namespace
+{
+using namespace Zmey;
+
+const char* const IndexedType = R"({
+	"name" : "SpatialIndexed",
+	"components" : [
+		{ "name" : "spatial", "radius" : 0.5 },
+		{ "name" : "transform" }
+	]
+})";
+// The same without the index, to tell its cost from the rest of LateSimulate
+const char* const UnindexedType = R"({
+	"name" : "SpatialUnindexed",
+	"components" : [
+		{ "name" : "transform" }
+	]
+})";
+
+const uint32_t ValidationEntityCount = 2000u;
+const float ValidationExtent = 100.f;
+const uint32_t ValidationFrames = 10u;
+const uint32_t QueriesPerFrame = 30u;
+
+const uint32_t EntityCount = 100000u;
+const float Extent = 1000.f;
+const uint32_t FrameCount = 20u;
+const uint32_t QueryCount = 10000u;
+const float QueryRadius = 10.f;
+const size_t NearestCount = 16u;
+const float RayLength = 200.f;
+
+class RandomPoints
+{
+public:
+	float Random(float extent)
+	{
+		return std::uniform_real_distribution<float>(-0.5f * extent, 0.5f * extent)(m_Random);
+	}
+	Vector3 Point(float extent)
+	{
+		return Vector3(Random(extent), Random(extent), Random(extent));
+	}
+	uint32_t Index(size_t count)
+	{
+		return uint32_t(m_Random() % count);
+	}
+private:
+	std::mt19937 m_Random{ 3u };
+};
+
+std::vector<EntityId> SpawnScattered(World& world, Name type, uint32_t count, float extent, RandomPoints& random)
+{
+	std::vector<Vector3> positions(count);
+	for (auto& position : positions)
+	{
+		position = random.Point(extent);
+	}
+	std::vector<EntityId> entities(count);
+	SpawnOverrides overrides;
+	overrides.Positions = positions.data();
+	world.SpawnEntities(type, entities.data(), count, overrides);
+	world.LateSimulate();
+	return entities;
+}
+
+// What the index should find, by going through all entities
+class BruteForce
+{
+public:
+	BruteForce(World& world, const std::vector<EntityId>& entities, const std::vector<float>& radii)
+	{
+		auto& transforms = world.GetManager<Components::TransformManager>();
+		for (size_t i = 0u; i < entities.size(); ++i)
+		{
+			if (world.GetEntityManager().IsAlive(entities[i]))
+			{
+				m_Spheres.push_back(Sphere{ entities[i], Vector3(transforms.GetWorldMatrix(entities[i])[3]), radii[i] });
+			}
+		}
+	}
+	std::vector<EntityId> InSphere(const Vector3& center, float radius) const
+	{
+		return Collect([&](const Sphere& sphere)
+		{
+			return glm::length(sphere.Center - center) <= radius + sphere.Radius;
+		});
+	}
+	std::vector<EntityId> InBox(const AABB& box) const
+	{
+		return Collect([&](const Sphere& sphere)
+		{
+			return glm::length(sphere.Center - glm::clamp(sphere.Center, box.Min, box.Max)) <= sphere.Radius;
+		});
+	}
+	std::vector<EntityId> OnRay(const Vector3& origin, const Vector3& direction, float maxDistance) const
+	{
+		const Vector3 unitDirection = glm::normalize(direction);
+		return Collect([&](const Sphere& sphere)
+		{
+			const Vector3 offset = origin - sphere.Center;
+			const float projection = glm::dot(offset, unitDirection);
+			const float outside = glm::dot(offset, offset) - sphere.Radius * sphere.Radius;
+			const float discriminant = projection * projection - outside;
+			return !(outside > 0.f && projection > 0.f) && discriminant >= 0.f
+				&& std::max(-projection - std::sqrt(discriminant), 0.f) <= maxDistance;
+		});
+	}
+	// Distances of the closest centers, closest first
+	std::vector<float> NearestDistances(const Vector3& point, size_t count) const
+	{
+		std::vector<float> distances;
+		for (const auto& sphere : m_Spheres)
+		{
+			distances.push_back(glm::length(sphere.Center - point));
+		}
+		std::sort(distances.begin(), distances.end());
+		distances.resize(std::min(count, distances.size()));
+		return distances;
+	}
+private:
+	struct Sphere
+	{
+		EntityId Entity;
+		Vector3 Center;
+		float Radius;
+	};
+	template<typename Predicate>
+	std::vector<EntityId> Collect(const Predicate& predicate) const
+	{
+		std::vector<EntityId> result;
+		for (const auto& sphere : m_Spheres)
+		{
+			if (predicate(sphere))
+			{
+				result.push_back(sphere.Entity);
+			}
+		}
+		std::sort(result.begin(), result.end(), EntityIndexLess());
+		return result;
+	}
+
+	std::vector<Sphere> m_Spheres;
+};
+
+std::vector<EntityId> Sorted(std::vector<EntityId> entities)
+{
+	std::sort(entities.begin(), entities.end(), EntityIndexLess());
+	return entities;
+}
+
+void Validate(Benchmarks::Context& context)
+{
+	World world;
+	const Name type = Benchmarks::AddClass(world, IndexedType);
+	RandomPoints random;
+	auto& transforms = world.GetManager<Components::TransformManager>();
+	auto& index = world.GetManager<Components::SpatialIndexManager>();
+	std::vector<EntityId> entities = SpawnScattered(world, type, ValidationEntityCount, ValidationExtent, random);
+	// Some spheres too big for the grid cells
+	std::vector<float> radii(entities.size(), 0.5f);
+	for (size_t i = 0u; i < entities.size(); i += 200u)
+	{
+		radii[i] = 20.f;
+		index.SetRadius(entities[i], radii[i]);
+	}
+
+	bool spheresMatch = true;
+	bool boxesMatch = true;
+	bool raysMatch = true;
+	bool nearestMatch = true;
+	for (uint32_t frame = 0u; frame < ValidationFrames; ++frame)
+	{
+		for (uint32_t i = 0u; i < ValidationEntityCount / 3u; ++i)
+		{
+			const EntityId moved = entities[random.Index(entities.size())];
+			if (world.GetEntityManager().IsAlive(moved))
+			{
+				transforms.Lookup(moved).Position() += random.Point(30.f);
+			}
+		}
+		for (uint32_t i = 0u; i < 20u; ++i)
+		{
+			world.QueueDestroyEntity(entities[random.Index(entities.size())]);
+		}
+		world.LateSimulate();
+
+		const BruteForce expected(world, entities, radii);
+		for (uint32_t query = 0u; query < QueriesPerFrame; ++query)
+		{
+			const Vector3 center = random.Point(ValidationExtent);
+			const float radius = float(random.Index(40u));
+			std::vector<EntityId> found;
+			index.ForEachInSphere(center, radius, [&found](EntityId entity)
+			{
+				found.push_back(entity);
+			});
+			spheresMatch &= Sorted(found) == expected.InSphere(center, radius);
+
+			const AABB box{ center - Vector3(radius), center + Vector3(0.5f * radius) };
+			found.clear();
+			index.ForEachInBox(box, [&found](EntityId entity)
+			{
+				found.push_back(entity);
+			});
+			boxesMatch &= Sorted(found) == expected.InBox(box);
+
+			const Vector3 origin = random.Point(1.5f * ValidationExtent);
+			const Vector3 direction = query % 5u == 0u ? Vector3(0.f, 0.f, 1.f) : random.Point(1.f);
+			const float maxDistance = query % 3u == 0u ? FLT_MAX : float(random.Index(200u));
+			found.clear();
+			index.ForEachOnRay(origin, direction, maxDistance, [&found](EntityId entity, float)
+			{
+				found.push_back(entity);
+			});
+			raysMatch &= Sorted(found) == expected.OnRay(origin, direction, maxDistance);
+
+			EntityId nearest[NearestCount];
+			const size_t count = 1u + random.Index(NearestCount);
+			const size_t nearestFound = index.FindNearest(center, count, nearest);
+			const std::vector<float> distances = expected.NearestDistances(center, count);
+			nearestMatch &= nearestFound == distances.size();
+			for (size_t i = 0u; nearestMatch && i < nearestFound; ++i)
+			{
+				nearestMatch &= std::abs(glm::length(Vector3(transforms.GetWorldMatrix(nearest[i])[3]) - center) - distances[i]) <= 1e-3f;
+			}
+		}
+	}
+	context.Check(spheresMatch, "ForEachInSphere finds the same entities as going through all of them");
+	context.Check(boxesMatch, "ForEachInBox finds the same entities as going through all of them");
+	context.Check(raysMatch, "ForEachOnRay finds the same entities as going through all of them");
+	context.Check(nearestMatch, "FindNearest finds the closest entities, closest first");
+}
+
+// Moves every entity a bit and returns the average time of LateSimulate
+double MeasureMovingFrames(World& world, const std::vector<EntityId>& entities, RandomPoints& random)
+{
+	auto& transforms = world.GetManager<Components::TransformManager>();
+	double milliseconds = 0.;
+	for (uint32_t frame = 0u; frame < FrameCount; ++frame)
+	{
+		for (EntityId entity : entities)
+		{
+			transforms.Lookup(entity).Position() += random.Point(2.f);
+		}
+		Benchmarks::Stopwatch stopwatch;
+		world.LateSimulate();
+		milliseconds += stopwatch.Milliseconds();
+	}
+	return milliseconds / FrameCount;
+}
+}
+
+BENCHMARK(SpatialIndex)
+{
+	Validate(context);
+
+	World indexedWorld;
+	World unindexedWorld;
+	RandomPoints random;
+	const std::vector<EntityId> indexed = SpawnScattered(indexedWorld, Benchmarks::AddClass(indexedWorld, IndexedType), EntityCount, Extent, random);
+	const std::vector<EntityId> unindexed = SpawnScattered(unindexedWorld, Benchmarks::AddClass(unindexedWorld, UnindexedType), EntityCount, Extent, random);
+	const double indexedFrame = MeasureMovingFrames(indexedWorld, indexed, random);
+	const double unindexedFrame = MeasureMovingFrames(unindexedWorld, unindexed, random);
+	context.Report("LateSimulate with 100k moving entities", indexedFrame, "ms");
+	context.Report("Of which updating the index", indexedFrame - unindexedFrame, "ms");
+
+	const auto& index = indexedWorld.GetManager<Components::SpatialIndexManager>();
+	std::vector<Vector3> points(QueryCount);
+	std::vector<Vector3> directions(QueryCount);
+	for (uint32_t i = 0u; i < QueryCount; ++i)
+	{
+		points[i] = random.Point(Extent);
+		directions[i] = random.Point(1.f);
+	}
+	size_t hits = 0u;
+	const double sphereMilliseconds = Benchmarks::MeasureMilliseconds(1u, [&]
+	{
+		for (const Vector3& point : points)
+		{
+			index.ForEachInSphere(point, QueryRadius, [&hits](EntityId)
+			{
+				++hits;
+			});
+		}
+	});
+	context.Report("ForEachInSphere radius 10", sphereMilliseconds * 1000. / QueryCount, "us/query");
+	context.Report("Found per sphere", double(hits) / QueryCount, "entities");
+	context.Report("FindNearest 16", Benchmarks::MeasureMilliseconds(1u, [&]
+	{
+		EntityId nearest[NearestCount];
+		for (const Vector3& point : points)
+		{
+			index.FindNearest(point, NearestCount, nearest);
+		}
+	}) * 1000. / QueryCount, "us/query");
+	context.Report("Raycast 200", Benchmarks::MeasureMilliseconds(1u, [&]
+	{
+		for (uint32_t i = 0u; i < QueryCount; ++i)
+		{
+			index.Raycast(points[i], directions[i], RayLength);
+		}
+	}) * 1000. / QueryCount, "us/query");
+
+	std::atomic<size_t> parallelHits(0u);
+	const double parallelMilliseconds = Benchmarks::MeasureMilliseconds(1u, [&]
+	{
+		Job::ParallelFor(Modules.JobSystem, "Spatial index benchmark", 0u, QueryCount, 64u, [&](uint32_t begin, uint32_t end)
+		{
+			size_t batchHits = 0u;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				index.ForEachInSphere(points[i], QueryRadius, [&batchHits](EntityId)
+				{
+					++batchHits;
+				});
+			}
+			parallelHits += batchHits;
+		});
+	});
+	context.Check(parallelHits == hits, "Sphere queries from many jobs find the same entities");
+	context.Report("ForEachInSphere radius 10 from jobs", parallelMilliseconds * 1000. / QueryCount, "us/query");
+}
@@ -0,0 +1,150 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <Zmey/World.h>
+#include <Zmey/Components/ComponentRegistry.h>
+#include <Zmey/Components/EntitySortKeys.h>
+#include <Zmey/Components/SpatialIndexManager.h>
+#include <Zmey/Components/SpellComponentManager.h>
+#include <Zmey/Components/TransformManager.h>
+#include "ClassCooker.h"
+
+// Times gathering data from two managers through a query and looking entities up around points,
+// with the packed data in spawn order and after World::SetSpatialSortInterval put it in Morton order.
+namespace
+{
+using namespace Zmey;
+
+const uint32_t EntityCount = 300000u;
+const float Extent = 1000.f;
+const uint32_t SphereQueryCount = 2000u;
+const float SphereRadius = 6.f;
+// Best of that many runs, the first ones warm the caches up
+const uint32_t Runs = 7u;
+
+const char* const ScatteredType = R"({
+	"name" : "SpatialSortScattered",
+	"components" : [
+		{ "name" : "spatial", "radius" : 0.5 },
+		{ "name" : "transform" }
+	]
+})";
+
+struct Timings
+{
+	double Gather;
+	double SphereQueries;
+};
+
+Timings Measure(World& world, const std::vector<Vector3>& centers)
+{
+	auto& transforms = world.GetManager<Components::TransformManager>();
+	auto& spells = world.GetManager<Components::SpellComponent>();
+	const auto& index = world.GetManager<Components::SpatialIndexManager>();
+	Timings best{ 1e9, 1e9 };
+	float sink = 0.f;
+	for (uint32_t run = 0u; run < Runs; ++run)
+	{
+		Benchmarks::Stopwatch stopwatch;
+		world.Query<Components::SpellComponent, Components::TransformManager>().ForEach([&](EntityId entity, EntityId::IndexType, EntityId::IndexType transformIndex)
+		{
+			sink += transforms.WorldMatrixAt(transformIndex)[3].x * spells.GetInitialSpeed(entity);
+		});
+		best.Gather = std::min(best.Gather, stopwatch.Milliseconds());
+
+		stopwatch = Benchmarks::Stopwatch();
+		for (const Vector3& center : centers)
+		{
+			index.ForEachInSphere(center, SphereRadius, [&](EntityId entity)
+			{
+				sink += transforms.GetWorldMatrix(entity)[3].y + spells.GetLifeTime(entity);
+			});
+		}
+		best.SphereQueries = std::min(best.SphereQueries, stopwatch.Milliseconds());
+	}
+	// Keeps the loops from getting optimized away
+	if (sink == 0.f)
+	{
+		printf("SpatialSort: nothing gathered\n");
+	}
+	return best;
+}
+
+bool IsSortedByKey(const Components::EntitySortKeys& keys, const arena::sparse_set& entities)
+{
+	return std::is_sorted(entities.begin(), entities.end(), [&keys](EntityId lhs, EntityId rhs)
+	{
+		return keys.KeyOf(lhs) < keys.KeyOf(rhs);
+	});
+}
+}
+
+BENCHMARK(SpatialSort)
+{
+	World world;
+	const Name type = Benchmarks::AddClass(world, ScatteredType);
+	std::mt19937 random(1u);
+	std::uniform_real_distribution<float> coordinate(0.f, Extent);
+	// A flat level like the game's, spawned in no particular order
+	std::vector<Vector3> positions(EntityCount);
+	for (auto& position : positions)
+	{
+		position = Vector3(coordinate(random), 0.05f * coordinate(random), coordinate(random));
+	}
+	std::vector<EntityId> entities(EntityCount);
+	SpawnOverrides overrides;
+	overrides.Positions = positions.data();
+	world.SpawnEntities(type, entities.data(), EntityCount, overrides);
+	// Another manager that got its entities in a different order
+	auto& spells = world.GetManager<Components::SpellComponent>();
+	std::vector<EntityId> shuffled = entities;
+	std::shuffle(shuffled.begin(), shuffled.end(), random);
+	for (EntityId entity : shuffled)
+	{
+		Components::SpellComponent::Fields fields{};
+		fields.LifeTime = 1e9f;
+		fields.InitialSpeed = float(entity.GetIndex());
+		spells.AddEntity(entity, fields);
+	}
+	world.LateSimulate();
+
+	std::vector<Vector3> centers(SphereQueryCount);
+	for (auto& center : centers)
+	{
+		center = Vector3(coordinate(random), 25.f, coordinate(random));
+	}
+	const Timings spawnOrder = Measure(world, centers);
+
+	// Sorts one manager per LateSimulate, a frame more starts the next round
+	world.SetSpatialSortInterval(1u);
+	double worstFrame = 0.;
+	for (ComponentIndex frame = 0u; frame <= Components::GetComponentManagerCount(); ++frame)
+	{
+		Benchmarks::Stopwatch stopwatch;
+		world.LateSimulate();
+		worstFrame = std::max(worstFrame, stopwatch.Milliseconds());
+	}
+	world.SetSpatialSortInterval(0u);
+
+	auto& transforms = world.GetManager<Components::TransformManager>();
+	Components::EntitySortKeys keys;
+	keys.BuildFromTransforms(transforms);
+	context.Check(IsSortedByKey(keys, transforms.GetEntitySet()), "Transforms are in Morton order");
+	context.Check(IsSortedByKey(keys, spells.GetEntitySet()), "Spells are in Morton order");
+	bool dataMatches = true;
+	for (uint32_t i = 0u; i < EntityCount; ++i)
+	{
+		dataMatches &= Vector3(transforms.GetWorldMatrix(entities[i])[3]) == positions[i] && spells.GetInitialSpeed(entities[i]) == float(entities[i].GetIndex());
+	}
+	context.Check(dataMatches, "Every entity keeps its data after sorting");
+
+	const Timings mortonOrder = Measure(world, centers);
+	context.Report("Query gather in spawn order", spawnOrder.Gather, "ms");
+	context.Report("Query gather in Morton order", mortonOrder.Gather, "ms");
+	context.Report("2000 sphere queries with lookups in spawn order", spawnOrder.SphereQueries, "ms");
+	context.Report("2000 sphere queries with lookups in Morton order", mortonOrder.SphereQueries, "ms");
+	context.Report("Worst LateSimulate while sorting", worstFrame, "ms");
+}
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <Zmey/EngineLoop.h>
+#include <Zmey/Modules.h>
+#include "Benchmark.h"
+#include "BenchmarkRegistry.h"
+
+// Runs every benchmark, or only the ones named on the command line, e.g.
+//	Benchmarks.exe BatchMath Query
+// Exits with 1 if any of them found results that don't match the reference implementation.
+namespace
+{
+struct RunData
+{
+	std::vector<const char*> Filter;
+	uint32_t Failures = 0u;
+};
+
+void RunBenchmarks(void* data)
+{
+	RunData& run = *reinterpret_cast<RunData*>(data);
+	auto& benchmarks = Benchmarks::GetRegisteredBenchmarks();
+	std::sort(benchmarks.begin(), benchmarks.end(), [](const Benchmarks::RegisteredBenchmark& lhs, const Benchmarks::RegisteredBenchmark& rhs)
+	{
+		return std::strcmp(lhs.Name, rhs.Name) < 0;
+	});
+	for (const auto& benchmark : benchmarks)
+	{
+		const bool selected = run.Filter.empty() || std::any_of(run.Filter.begin(), run.Filter.end(), [&benchmark](const char* name)
+		{
+			return std::strcmp(name, benchmark.Name) == 0;
+		});
+		if (!selected)
+		{
+			continue;
+		}
+		Benchmarks::Context context(benchmark.Name);
+		benchmark.Function(context);
+		run.Failures += context.GetFailures();
+	}
+	Zmey::Modules.JobSystem.Quit();
+}
+}
+
+int main(int argc, char** argv)
+{
+	RunData run;
+	for (int i = 1; i < argc; ++i)
+	{
+		run.Filter.push_back(argv[i]);
+	}
+	Zmey::EngineLoop loop(nullptr); // Neccessary to initialize the engine
+	Zmey::Job::JobDecl job{ RunBenchmarks, &run };
+	Zmey::Modules.JobSystem.RunJobs("Benchmarks", &job, 1, nullptr);
+	Zmey::Modules.JobSystem.WaitForCompletion();
+	Zmey::Modules.Uninitialize();
+	printf("%u failures\n", run.Failures);
+	return run.Failures != 0u ? 1 : 0;
+}
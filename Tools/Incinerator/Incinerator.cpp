@@ -56,6 +56,15 @@ bool CompareComponentNames(const std::string& lhs, const std::string& rhs)
 	return lhsHash < rhsHash;
 }
 
+// The game takes the manager at the index right away if its name still matches, see World::InitializeFromBuffer
+void WriteComponentManager(Zmey::MemoryOutputStream& memstream, const std::string& componentName)
+{
+	Zmey::Hash componentNameHash(Zmey::HashHelpers::CaseInsensitiveStringWrapper(componentName.c_str()));
+	const auto& manager = Zmey::Components::GetComponentManager(componentNameHash);
+	memstream << static_cast<uint64_t>(manager.ShortNameHash);
+	memstream << manager.Index;
+}
+
 }
 
 void Incinerator::Incinerate(const Options& options)
@@ -163,13 +172,12 @@ void Incinerator::ComponentEntry::RequestResource(const char* resourcePath, uint
 void Incinerator::IncinerateClass(const std::string& destinationFolder, const std::string& className)
 {
 	Zmey::MemoryOutputStream memstream;
-	memstream << "1.0"; // Version
+	memstream << "1.1"; // Version
 	Zmey::Hash classNameHash(Zmey::HashHelpers::CaseInsensitiveStringWrapper(className.c_str()));
 	memstream << static_cast<uint64_t>(classNameHash);
 	for (const auto& fullComponentInfo : m_ClassIndex[className].Components)
 	{
-		Zmey::Hash componentNameHash(Zmey::HashHelpers::CaseInsensitiveStringWrapper(fullComponentInfo.ComponentName.c_str()));
-		memstream << static_cast<uint64_t>(componentNameHash);
+		WriteComponentManager(memstream, fullComponentInfo.ComponentName);
 
 		size_t propertiesCountForComponent = fullComponentInfo.PropertyData.size();
 		// Iterate over all properties for this component
@@ -287,7 +295,7 @@ void Incinerator::IncinerateWorld(const std::string& destinationFolder, const st
 
 	// Serialization time
 	Zmey::MemoryOutputStream memstream;
-	memstream << "1.0"; // Version
+	memstream << "1.1"; // Version
 
 	// Resources
 	memstream << (uint64_t) resourceList.size();
@@ -300,8 +308,7 @@ void Incinerator::IncinerateWorld(const std::string& destinationFolder, const st
 	memstream << maxEntityIndex;
 	for (const auto& fullComponentInfo : entitiesForComponent)
 	{
-		Zmey::Hash componentNameHash(fullComponentInfo.first.c_str());
-		memstream << static_cast<uint64_t>(componentNameHash);
+		WriteComponentManager(memstream, fullComponentInfo.first);
 		memstream << static_cast<Zmey::EntityId::IndexType>(fullComponentInfo.second.size());
 		for (const auto& entityData : fullComponentInfo.second)
 		{